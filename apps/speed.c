@@ -210,7 +210,8 @@ typedef enum OPTION_choice {
     OPT_COMMON,
     OPT_ELAPSED, OPT_EVP, OPT_HMAC, OPT_DECRYPT, OPT_ENGINE, OPT_MULTI,
     OPT_MR, OPT_MB, OPT_MISALIGN, OPT_ASYNCJOBS, OPT_R_ENUM, OPT_PROV_ENUM,
-    OPT_PRIMES, OPT_SECONDS, OPT_BYTES, OPT_AEAD, OPT_CMAC
+    OPT_PRIMES, OPT_SECONDS, OPT_BYTES, OPT_AEAD, OPT_CMAC, OPT_BATCH,
+    OPT_XOFLEN
 } OPTION_CHOICE;
 
 const OPTIONS speed_options[] = {
@@ -241,6 +242,10 @@ const OPTIONS speed_options[] = {
      "Time decryption instead of encryption (only EVP)"},
     {"aead", OPT_AEAD, '-',
      "Benchmark EVP-named AEAD cipher in TLS-like sequence"},
+    {"batch", OPT_BATCH, 'p',
+     "Hash the specified number of messages at once with EVP-named digest"},
+    {"xoflen", OPT_XOFLEN, 'p',
+     "Output length of an extendable-output digest with -batch"},
 
     OPT_SECTION("Timing"),
     {"elapsed", OPT_ELAPSED, '-',
@@ -499,6 +504,8 @@ static long c[ALGOR_NUM][SIZE_NUM];
 static char *evp_mac_mdname = "md5";
 static char *evp_hmac_name = NULL;
 static const char *evp_md_name = NULL;
+static int digest_batch = 0;
+static int digest_xoflen = 0;
 static char *evp_mac_ciphername = "aes-128-cbc";
 static char *evp_cmac_name = NULL;
 
@@ -561,6 +568,47 @@ static int EVP_Digest_md_loop(void *args)
     return EVP_Digest_loop(evp_md_name, D_EVP, args);
 }
 
+static int EVP_Digest_batch_loop(void *args)
+{
+    loopargs_t *tempargs = *(loopargs_t **) args;
+    const void **data;
+    size_t *counts;
+    unsigned char *mdbuf, **mds;
+    int count, i, ret;
+    int mdsize = digest_xoflen > EVP_MAX_MD_SIZE ? digest_xoflen
+                                                 : EVP_MAX_MD_SIZE;
+    EVP_MD *md = NULL;
+
+    if (!opt_md_silent(evp_md_name, &md))
+        return -1;
+    data = app_malloc(digest_batch * sizeof(*data), "batch data pointers");
+    counts = app_malloc(digest_batch * sizeof(*counts), "batch lengths");
+    mds = app_malloc(digest_batch * sizeof(*mds), "batch digest pointers");
+    mdbuf = app_malloc(digest_batch * mdsize, "batch digests");
+    for (i = 0; i < digest_batch; i++) {
+        data[i] = tempargs->buf;
+        counts[i] = (size_t)lengths[testnum];
+        mds[i] = mdbuf + i * mdsize;
+    }
+    for (count = 0; COND(c[D_EVP][testnum]); count += digest_batch) {
+        if (digest_xoflen > 0)
+            ret = EVP_DigestXOF_batch(data, counts, digest_batch, mds,
+                                      digest_xoflen, md);
+        else
+            ret = EVP_Digest_batch(data, counts, digest_batch, mds, md);
+        if (!ret) {
+            count = -1;
+            break;
+        }
+    }
+    OPENSSL_free(data);
+    OPENSSL_free(counts);
+    OPENSSL_free(mds);
+    OPENSSL_free(mdbuf);
+    EVP_MD_free(md);
+    return count;
+}
+
 static int EVP_Digest_MD2_loop(void *args)
 {
     return EVP_Digest_loop("md2", D_MD2, args);
@@ -1601,6 +1649,12 @@ int speed_main(int argc, char **argv)
         case OPT_AEAD:
             aead = 1;
             break;
+        case OPT_BATCH:
+            digest_batch = opt_int_arg();
+            break;
+        case OPT_XOFLEN:
+            digest_xoflen = opt_int_arg();
+            break;
         }
     }
 
@@ -1724,6 +1778,15 @@ int speed_main(int argc, char **argv)
             goto end;
         }
     }
+    if (digest_batch > 0 && evp_md_name == NULL) {
+        BIO_printf(bio_err, "-batch can be used only with an EVP-named"
+                            " digest\n");
+        goto end;
+    }
+    if (digest_xoflen > 0 && digest_batch == 0) {
+        BIO_printf(bio_err, "-xoflen can be used only with -batch\n");
+        goto end;
+    }
     if (multiblock) {
         if (evp_cipher == NULL) {
             BIO_printf(bio_err, "-mb can be used only with a multi-block"
@@ -2250,7 +2313,10 @@ int speed_main(int argc, char **argv)
                 print_message(names[D_EVP], c[D_EVP][testnum], lengths[testnum],
                               seconds.sym);
                 Time_F(START);
-                count = run_benchmark(async_jobs, EVP_Digest_md_loop, loopargs);
+                count = run_benchmark(async_jobs, digest_batch > 0
+                                                  ? EVP_Digest_batch_loop
+                                                  : EVP_Digest_md_loop,
+                                      loopargs);
                 d = Time_F(STOP);
                 print_result(D_EVP, testnum, count, d);
                 if (count < 0)
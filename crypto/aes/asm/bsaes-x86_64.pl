@@ -95,6 +95,16 @@
 # Add bsaes_xts_[en|de]crypt. Less-than-80-bytes-block performance is
 # suboptimal, but XTS is meant to be used with larger blocks...
 #
+# October 2021.
+#
+# Add AVX2 flavour of CTR subroutine, which processes 16 blocks per
+# round function invocation. In addition it handles trailing blocks
+# with bit-sliced code instead of table-driven asm_AES_encrypt and is
+# therefore constant-time. 128-bit key performance on 16KB buffer:
+#
+#		SSSE3		AVX2
+# Skylake-X	4.9		2.4	cycles per byte
+#
 #						<appro@openssl.org>
 
 # $output is the last argument if it looks like a file (it has an extension)
@@ -109,6 +119,27 @@ $0 =~ m/(.*[\/\\])[^\/\\]+$/; $dir=$1;
 ( $xlate="${dir}../../perlasm/x86_64-xlate.pl" and -f $xlate) or
 die "can't locate x86_64-xlate.pl";
 
+$avx=0;
+
+if (`$ENV{CC} -Wa,-v -c -o /dev/null -x assembler /dev/null 2>&1`
+		=~ /GNU assembler version ([2-9]\.[0-9]+)/) {
+	$avx = ($1>=2.19) + ($1>=2.22);
+}
+
+if (!$avx && $win64 && ($flavour =~ /nasm/ || $ENV{ASM} =~ /nasm/) &&
+	    `nasm -v 2>&1` =~ /NASM version ([2-9]\.[0-9]+)/) {
+	$avx = ($1>=2.09) + ($1>=2.10);
+}
+
+if (!$avx && $win64 && ($flavour =~ /masm/ || $ENV{ASM} =~ /ml64/) &&
+	    `ml64 2>&1` =~ /Version ([0-9]+)\./) {
+	$avx = ($1>=10) + ($1>=11);
+}
+
+if (!$avx && `$ENV{CC} -v 2>&1` =~ /((?:clang|LLVM) version|.*based on LLVM) ([0-9]+\.[0-9]+)/) {
+	$avx = ($2>=3.0) + ($2>3.0);
+}
+
 open OUT,"| \"$^X\" \"$xlate\" $flavour \"$output\""
     or die "can't call $xlate: $!";
 *STDOUT=*OUT;
@@ -945,6 +976,114 @@ $code.=<<___;
 .cfi_endproc
 .size	_bsaes_decrypt8,.-_bsaes_decrypt8
 ___
+
+######################################################################
+# AVX2 flavour of _bsaes_encrypt8_bitslice. Bit-sliced round functions
+# never move data across 128-bit lanes, which means that on %ymm
+# registers they process two independent groups of 8 blocks, lower and
+# upper lanes, at once. The key schedule is expected to be duplicated
+# in both lanes, i.e. it takes 0x100 bytes per round. The code is
+# emitted by the very subroutines above and translated to three-operand
+# VEX form by avx2ify.
+#
+sub ShiftRows_avx2 {
+my @x=@_[0..7];
+my $mask=pop;
+$code.=<<___;
+	vpxor	0x00($key),@x[0],@x[0]
+	vpxor	0x20($key),@x[1],@x[1]
+	vpxor	0x40($key),@x[2],@x[2]
+	vpxor	0x60($key),@x[3],@x[3]
+	vpshufb	$mask,@x[0],@x[0]
+	vpshufb	$mask,@x[1],@x[1]
+	vpxor	0x80($key),@x[4],@x[4]
+	vpxor	0xa0($key),@x[5],@x[5]
+	vpshufb	$mask,@x[2],@x[2]
+	vpshufb	$mask,@x[3],@x[3]
+	vpxor	0xc0($key),@x[6],@x[6]
+	vpxor	0xe0($key),@x[7],@x[7]
+	vpshufb	$mask,@x[4],@x[4]
+	vpshufb	$mask,@x[5],@x[5]
+	vpshufb	$mask,@x[6],@x[6]
+	vpshufb	$mask,@x[7],@x[7]
+	lea	0x100($key),$key
+___
+}
+
+sub avx2ify {
+my $ret;
+
+    foreach (split("\n",shift)) {
+	if (/^(\s*)(pxor|pand|por|pshufb)\s+([^,]+),\s*(%ymm[0-9]+)(.*)/) {
+	    $_="$1v$2\t$3, $4, $4$5";
+	} elsif (/^(\s*)(psrlq|psllq)\s+(\$[0-9]+),\s*(%ymm[0-9]+)(.*)/) {
+	    $_="$1v$2\t$3, $4, $4$5";
+	} elsif (/^(\s*)pshufd\s+(\$\w+),\s*(%ymm[0-9]+),\s*(%ymm[0-9]+)(.*)/) {
+	    $_="$1vpshufd\t$2, $3, $4$5";
+	} elsif (/^(\s*)movdqa\s+(%ymm[0-9]+),\s*(%ymm[0-9]+)(.*)/) {
+	    $_="$1vmovdqa\t$2, $3$4";
+	} elsif (/^(\s*)movdqa\s+([^,%]*\(%\w+\)),\s*(%ymm[0-9]+)(.*)/) {
+	    # 128-bit constants are loaded to both lanes
+	    $_="$1vbroadcasti128\t$2, $3$4";
+	} elsif (/^\s*(p[a-z]+|movdq[au])\s/) {
+	    die "avx2ify: unexpected instruction: $_";
+	}
+	$ret.="$_\n";
+    }
+    $ret;
+}
+
+if ($avx>1) {
+my @YMM=map("%ymm$_",(15,0..14));	# same numbering as @XMM
+my $sse=$code;
+
+$code=<<___;
+.type	_bsaes_encrypt16_bitslice,\@abi-omnipotent
+.align	64
+_bsaes_encrypt16_bitslice:
+.cfi_startproc
+___
+	&bitslice	(@YMM[0..7, 8..11]);
+$code.=<<___;
+	dec	$rounds
+	jmp	.Lenc16_sbox
+.align	16
+.Lenc16_loop:
+___
+	&ShiftRows_avx2	(@YMM[0..7, 8]);
+$code.=".Lenc16_sbox:\n";
+	&Sbox		(@YMM[0..7, 8..15]);
+$code.=<<___;
+	dec	$rounds
+	jl	.Lenc16_done
+___
+	&MixColumns	(@YMM[0,1,4,6,3,7,2,5, 8..15]);
+$code.=<<___;
+	vbroadcasti128	0x30($const), @YMM[8]	# .LSR
+	jnz	.Lenc16_loop
+	vbroadcasti128	0x40($const), @YMM[8]	# .LSRM0
+	jmp	.Lenc16_loop
+.align	16
+.Lenc16_done:
+___
+	# output in lsb > [t0, t1, t4, t6, t3, t7, t2, t5] < msb
+	&bitslice	(@YMM[0,1,4,6,3,7,2,5, 8..11]);
+$code.=<<___;
+	vmovdqa	($key), @YMM[8]		# last round key
+	vpxor	@YMM[8], @YMM[4], @YMM[4]
+	vpxor	@YMM[8], @YMM[6], @YMM[6]
+	vpxor	@YMM[8], @YMM[3], @YMM[3]
+	vpxor	@YMM[8], @YMM[7], @YMM[7]
+	vpxor	@YMM[8], @YMM[2], @YMM[2]
+	vpxor	@YMM[8], @YMM[5], @YMM[5]
+	vpxor	@YMM[8], @YMM[0], @YMM[0]
+	vpxor	@YMM[8], @YMM[1], @YMM[1]
+	ret
+.cfi_endproc
+.size	_bsaes_encrypt16_bitslice,.-_bsaes_encrypt16_bitslice
+___
+$code=$sse.&avx2ify($code);
+}
 }
 {
 my ($out,$inp,$rounds,$const)=("%rax","%rcx","%r10d","%r11");
@@ -2169,6 +2308,249 @@ $code.=<<___;
 .size	ossl_bsaes_ctr32_encrypt_blocks,.-ossl_bsaes_ctr32_encrypt_blocks
 ___
 ######################################################################
+# void ossl_bsaes_ctr32_encrypt_blocks_avx2(const char *inp, char *out,
+#	size_t blocks, const AES_KEY *key, const unsigned char ivec[16]);
+#
+# Sixteen blocks per _bsaes_encrypt16_bitslice call, block #i of the
+# batch being in lower lane of register #(i%8) and block #(i+8) in
+# the upper one. Trailing 1..15 blocks are processed as a full batch
+# rather than with table-driven asm_AES_encrypt, which keeps the whole
+# subroutine free of data-dependent memory references.
+#
+{
+my @YMM=map("%ymm$_",(15,0..14));
+
+$code.=<<___;
+.globl	ossl_bsaes_ctr32_encrypt_blocks_avx2
+.type	ossl_bsaes_ctr32_encrypt_blocks_avx2,\@abi-omnipotent
+.align	16
+ossl_bsaes_ctr32_encrypt_blocks_avx2:
+.cfi_startproc
+___
+if ($avx>1) {
+$code.=<<___;
+	endbranch
+	mov	%rsp, %rax
+.Lctr_enc16_prologue:
+	push	%rbp
+.cfi_push	%rbp
+	push	%rbx
+.cfi_push	%rbx
+	push	%r12
+.cfi_push	%r12
+	push	%r13
+.cfi_push	%r13
+	push	%r14
+.cfi_push	%r14
+	push	%r15
+.cfi_push	%r15
+	lea	-0x48(%rsp), %rsp
+.cfi_adjust_cfa_offset	0x48
+___
+$code.=<<___ if ($win64);
+	mov	0xa0(%rsp),$arg5	# pull ivp
+	lea	-0xa0(%rsp), %rsp
+	movaps	%xmm6, 0x40(%rsp)
+	movaps	%xmm7, 0x50(%rsp)
+	movaps	%xmm8, 0x60(%rsp)
+	movaps	%xmm9, 0x70(%rsp)
+	movaps	%xmm10, 0x80(%rsp)
+	movaps	%xmm11, 0x90(%rsp)
+	movaps	%xmm12, 0xa0(%rsp)
+	movaps	%xmm13, 0xb0(%rsp)
+	movaps	%xmm14, 0xc0(%rsp)
+	movaps	%xmm15, 0xd0(%rsp)
+.Lctr_enc16_body:
+___
+$code.=<<___;
+	mov	%rsp, %rbp		# backup %rsp
+.cfi_def_cfa_register	%rbp
+	movdqu	($arg5), %xmm0		# load counter
+	mov	240($arg4), %eax	# rounds
+	mov	$arg1, $inp		# backup arguments
+	mov	$arg2, $out
+	mov	$arg3, $len
+	mov	$arg4, $key
+	movdqa	%xmm0, 0x20(%rbp)	# copy counter
+	test	$len, $len
+	jz	.Lctr_enc16_exit
+
+	mov	%eax, %ebx		# rounds
+	shl	\$7, %rax		# 128 bytes per inner round key
+	sub	\$`128-32`, %rax	# size of bit-sliced key schedule
+	mov	%rax, %r9
+	sub	%rax, %rsp		# room for the 128-bit schedule
+	sub	%rax, %rsp		# and twice as much for the
+	sub	%rax, %rsp		# 256-bit one
+	and	\$-32, %rsp
+
+	lea	(%rsp,%r9,2), %rax	# pass key schedule
+	mov	$key, %rcx		# pass key
+	mov	%ebx, %r10d		# pass rounds
+	call	_bsaes_key_convert
+	pxor	%xmm6,%xmm7		# fix up last round key
+	movdqa	%xmm7,(%rax)		# save last round key
+
+	lea	(%rsp,%r9,2), %rsi
+	mov	%rsp, %rdi
+	shr	\$4, %r9
+.Lctr_enc16_key:			# duplicate round keys in both lanes
+	vbroadcasti128	(%rsi), %ymm0
+	lea	0x10(%rsi), %rsi
+	vmovdqa	%ymm0, (%rdi)
+	lea	0x20(%rdi), %rdi
+	dec	%r9
+	jnz	.Lctr_enc16_key
+
+	vmovdqa	(%rsp), @YMM[9]		# load round0 key
+	vmovdqa	0x20(%rbp), @XMM[0]	# counter copy
+	vbroadcasti128	.LSWPUP(%rip), @YMM[8]
+	vpshufb	@YMM[8], @YMM[9], @YMM[9]	# byte swap upper part
+	vpshufb	@XMM[8], @XMM[0], @XMM[0]
+	vmovdqa	@YMM[9], (%rsp)		# save adjusted round0 key
+	vmovdqa	@XMM[0], 0x20(%rbp)
+	jmp	.Lctr_enc16_loop
+.align	32
+.Lctr_enc16_loop:
+	vbroadcasti128	0x20(%rbp), @YMM[8]	# counter in both lanes
+	lea	.LADD16(%rip), %r11
+	vpaddd	0x00(%r11), @YMM[8], @YMM[0]	# prepare 16 counter values
+	vpaddd	0x20(%r11), @YMM[8], @YMM[1]
+	vpaddd	0x40(%r11), @YMM[8], @YMM[2]
+	vpaddd	0x60(%r11), @YMM[8], @YMM[3]
+	vpaddd	0x80(%r11), @YMM[8], @YMM[4]
+	vpaddd	0xa0(%r11), @YMM[8], @YMM[5]
+	vpaddd	0xc0(%r11), @YMM[8], @YMM[6]
+	vpaddd	0xe0(%r11), @YMM[8], @YMM[7]
+	vpaddd	0x100(%r11), @YMM[8], @YMM[8]
+	vmovdqa	@XMM[8], 0x20(%rbp)	# save counter
+
+	vmovdqa	(%rsp), @YMM[9]		# round 0 key
+	lea	0x20(%rsp), %rax	# pass key schedule
+	vbroadcasti128	.LSWPUPM0SR(%rip), @YMM[8]
+	vpxor	@YMM[9], @YMM[0], @YMM[0]	# xor with round0 key
+	vpxor	@YMM[9], @YMM[1], @YMM[1]
+	vpxor	@YMM[9], @YMM[2], @YMM[2]
+	vpxor	@YMM[9], @YMM[3], @YMM[3]
+	 vpshufb	@YMM[8], @YMM[0], @YMM[0]
+	 vpshufb	@YMM[8], @YMM[1], @YMM[1]
+	vpxor	@YMM[9], @YMM[4], @YMM[4]
+	vpxor	@YMM[9], @YMM[5], @YMM[5]
+	 vpshufb	@YMM[8], @YMM[2], @YMM[2]
+	 vpshufb	@YMM[8], @YMM[3], @YMM[3]
+	vpxor	@YMM[9], @YMM[6], @YMM[6]
+	vpxor	@YMM[9], @YMM[7], @YMM[7]
+	 vpshufb	@YMM[8], @YMM[4], @YMM[4]
+	 vpshufb	@YMM[8], @YMM[5], @YMM[5]
+	 vpshufb	@YMM[8], @YMM[6], @YMM[6]
+	 vpshufb	@YMM[8], @YMM[7], @YMM[7]
+	lea	.LBS0(%rip), %r11	# constants table
+	mov	%ebx,%r10d		# pass rounds
+
+	call	_bsaes_encrypt16_bitslice
+
+	sub	\$16,$len
+	jc	.Lctr_enc16_loop_done
+___
+my @out=@YMM[0,1,4,6,3,7,2,5];
+for (my $i=0; $i<8; $i++) {
+my ($o,$t)=($out[$i],$YMM[8+$i]);
+(my $to=$t)=~s/y/x/;
+(my $oo=$o)=~s/y/x/;
+$code.=<<___;
+	vmovdqu	`0x10*$i`($inp), $to	# load input
+	vinserti128	\$1, `0x10*($i+8)`($inp), $t, $t
+	vpxor	$t, $o, $o
+	vmovdqu	$oo, `0x10*$i`($out)	# write output
+	vextracti128	\$1, $o, `0x10*($i+8)`($out)
+___
+}
+$code.=<<___;
+	lea	0x100($inp), $inp
+	lea	0x100($out), $out
+	jnz	.Lctr_enc16_loop
+	jmp	.Lctr_enc16_done
+
+.align	16
+.Lctr_enc16_loop_done:
+	add	\$16, $len
+___
+for (my $i=0; $i<16; $i++) {
+(my $o=$out[$i%8])=~s/y/x/;
+my $t=$XMM[8];
+$code.=<<___ if ($i>0);
+	cmp	\$$i, $len
+	je	.Lctr_enc16_done
+___
+$code.=<<___ if ($i<8);
+	vpxor	`0x10*$i`($inp), $o, $t
+	vmovdqu	$t, `0x10*$i`($out)
+___
+$code.=<<___ if ($i>=8);
+	vextracti128	\$1, $out[$i%8], $t
+	vpxor	`0x10*$i`($inp), $t, $t
+	vmovdqu	$t, `0x10*$i`($out)
+___
+}
+$code.=<<___;
+
+.Lctr_enc16_done:
+	vzeroall
+	lea	(%rsp), %rax
+.Lctr_enc16_bzero:			# wipe key schedules
+	vmovdqa	%ymm0, 0x00(%rax)
+	lea	0x20(%rax), %rax
+	cmp	%rax, %rbp
+	ja	.Lctr_enc16_bzero
+
+.Lctr_enc16_exit:
+	lea	0x78(%rbp),%rax
+.cfi_def_cfa	%rax,8
+___
+$code.=<<___ if ($win64);
+	movaps	0x40(%rbp), %xmm6
+	movaps	0x50(%rbp), %xmm7
+	movaps	0x60(%rbp), %xmm8
+	movaps	0x70(%rbp), %xmm9
+	movaps	0x80(%rbp), %xmm10
+	movaps	0x90(%rbp), %xmm11
+	movaps	0xa0(%rbp), %xmm12
+	movaps	0xb0(%rbp), %xmm13
+	movaps	0xc0(%rbp), %xmm14
+	movaps	0xd0(%rbp), %xmm15
+	lea	0xa0(%rax), %rax
+.Lctr_enc16_tail:
+___
+$code.=<<___;
+	mov	-48(%rax), %r15
+.cfi_restore	%r15
+	mov	-40(%rax), %r14
+.cfi_restore	%r14
+	mov	-32(%rax), %r13
+.cfi_restore	%r13
+	mov	-24(%rax), %r12
+.cfi_restore	%r12
+	mov	-16(%rax), %rbx
+.cfi_restore	%rbx
+	mov	-8(%rax), %rbp
+.cfi_restore	%rbp
+	lea	(%rax), %rsp		# restore %rsp
+.cfi_def_cfa_register	%rsp
+.Lctr_enc16_epilogue:
+	ret
+___
+} else {
+$code.=<<___;
+	endbranch
+	jmp	ossl_bsaes_ctr32_encrypt_blocks
+___
+}
+$code.=<<___;
+.cfi_endproc
+.size	ossl_bsaes_ctr32_encrypt_blocks_avx2,.-ossl_bsaes_ctr32_encrypt_blocks_avx2
+___
+}
+######################################################################
 # void bsaes_xts_[en|de]crypt(const char *inp,char *out,size_t len,
 #	const AES_KEY *key1, const AES_KEY *key2,
 #	const unsigned char iv[16]);
@@ -3054,6 +3436,16 @@ _bsaes_const:
 	.quad	0x02060a0e03070b0f, 0x0004080c0105090d
 .L63:
 	.quad	0x6363636363636363, 0x6363636363636363
+.LADD16:	# counter increment constants for 16 blocks
+	.long	0,0,0,0, 0,0,0,8
+	.long	0,0,0,1, 0,0,0,9
+	.long	0,0,0,2, 0,0,0,10
+	.long	0,0,0,3, 0,0,0,11
+	.long	0,0,0,4, 0,0,0,12
+	.long	0,0,0,5, 0,0,0,13
+	.long	0,0,0,6, 0,0,0,14
+	.long	0,0,0,7, 0,0,0,15
+	.long	0,0,0,16, 0,0,0,16
 .asciz	"Bit-sliced AES for x86_64/SSSE3, Emilia Käsper, Peter Schwabe, Andy Polyakov"
 .align	64
 .size	_bsaes_const,.-_bsaes_const
@@ -3182,6 +3574,13 @@ $code.=<<___;
 	.rva	.Lctr_enc_prologue
 	.rva	.Lctr_enc_epilogue
 	.rva	.Lctr_enc_info
+___
+$code.=<<___ if ($avx>1);
+	.rva	.Lctr_enc16_prologue
+	.rva	.Lctr_enc16_epilogue
+	.rva	.Lctr_enc16_info
+___
+$code.=<<___;
 
 	.rva	.Lxts_enc_prologue
 	.rva	.Lxts_enc_epilogue
@@ -3221,6 +3620,16 @@ $code.=<<___;
 	.rva	.Lctr_enc_body,.Lctr_enc_epilogue	# HandlerData[]
 	.rva	.Lctr_enc_tail
 	.long	0
+___
+$code.=<<___ if ($avx>1);
+.Lctr_enc16_info:
+	.byte	9,0,0,0
+	.rva	se_handler
+	.rva	.Lctr_enc16_body,.Lctr_enc16_epilogue	# HandlerData[]
+	.rva	.Lctr_enc16_tail
+	.long	0
+___
+$code.=<<___;
 .Lxts_enc_info:
 	.byte	9,0,0,0
 	.rva	se_handler
@@ -0,0 +1,30 @@
+/*
+ * Copyright 2021 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#include <string.h>
+#include <openssl/aes.h>
+#include "crypto/modes.h"
+#include "crypto/aes_platform.h"
+
+#ifdef BSAES_AVX2_CAPABLE
+/*
+ * Encrypt a single block with the bit-sliced code: it is the first block of
+ * the keystream with |in| as the counter.  This is a lot slower than
+ * AES_encrypt(), but has no data dependent memory references.
+ */
+void ossl_bsaes_encrypt_block_avx2(const unsigned char *in, unsigned char *out,
+                                   const AES_KEY *key)
+{
+    static const unsigned char zero[16] = { 0 };
+    unsigned char ivec[16];
+
+    memcpy(ivec, in, sizeof(ivec));
+    ossl_bsaes_ctr32_encrypt_blocks_avx2(zero, out, 1, key, ivec);
+}
+#endif
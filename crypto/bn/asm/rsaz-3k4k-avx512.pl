@@ -0,0 +1,669 @@
+# Copyright 2021 The OpenSSL Project Authors. All Rights Reserved.
+#
+# Licensed under the Apache License 2.0 (the "License").  You may not use
+# this file except in compliance with the License.  You can obtain a copy
+# in the file LICENSE in the source distribution or at
+# https://www.openssl.org/source/license.html
+#
+#
+# Almost Montgomery Multiplication in 2^52 radix for 1536- and 2048-bit
+# moduli, i.e. the CRT halves of RSA-3072 and RSA-4096, complementing the
+# 1024-bit code in rsaz-avx512.pl. The algorithm and the data layout are
+# the same, a number is an array of 30 or 40 52-bit digits held in 8 or 10
+# %ymm registers, the upper two lanes of the last register being unused
+# in the 30-digit case. Loads and stores of that register are masked, so
+# that the arrays don't have to be padded.
+#
+# With 16 of 32 vector registers clobbered by the 256-bit accumulators of
+# two 40-digit numbers plus temporaries, there are not enough registers
+# that Win64 treats as volatile to interleave two independent 40-digit
+# multiplications, so the dual 2048-bit function processes its inputs one
+# after the other. The 1536-bit one interleaves them as rsaz-avx512.pl
+# does.
+#
+# $output is the last argument if it looks like a file (it has an extension)
+# $flavour is the first argument if it doesn't look like a file
+$output = $#ARGV >= 0 && $ARGV[$#ARGV] =~ m|\.\w+$| ? pop : undef;
+$flavour = $#ARGV >= 0 && $ARGV[0] !~ m|\.| ? shift : undef;
+
+$win64=0; $win64=1 if ($flavour =~ /[nm]asm|mingw64/ || $output =~ /\.asm$/);
+$avx512ifma=0;
+
+$0 =~ m/(.*[\/\\])[^\/\\]+$/; $dir=$1;
+( $xlate="${dir}x86_64-xlate.pl" and -f $xlate ) or
+( $xlate="${dir}../../perlasm/x86_64-xlate.pl" and -f $xlate) or
+die "can't locate x86_64-xlate.pl";
+
+if (`$ENV{CC} -Wa,-v -c -o /dev/null -x assembler /dev/null 2>&1`
+        =~ /GNU assembler version ([2-9]\.[0-9]+)/) {
+    $avx512ifma = ($1>=2.26);
+}
+
+if (!$avx512ifma && $win64 && ($flavour =~ /nasm/ || $ENV{ASM} =~ /nasm/) &&
+       `nasm -v 2>&1` =~ /NASM version ([2-9]\.[0-9]+)(?:\.([0-9]+))?/) {
+    $avx512ifma = ($1==2.11 && $2>=8) + ($1>=2.12);
+}
+
+if (!$avx512ifma && `$ENV{CC} -v 2>&1` =~ /((?:clang|LLVM) version|.*based on LLVM) ([0-9]+\.[0-9]+)/) {
+    $avx512ifma = ($2>=7.0);
+}
+
+open OUT,"| \"$^X\" \"$xlate\" $flavour \"$output\""
+    or die "can't call $xlate: $!";
+*STDOUT=*OUT;
+
+@sizes = (30, 40);
+
+if ($avx512ifma>0) {{{
+@_6_args_universal_ABI = ("%rdi","%rsi","%rdx","%rcx","%r8","%r9");
+
+###############################################################################
+# Almost Montgomery Multiplication (AMM) for 30- and 40-digit numbers in
+# radix 2^52. See rsaz-avx512.pl for the description of the algorithm and
+# of the parameters, the only difference is the number of digits.
+#
+# void ossl_rsaz_amm52x30_x1_256(BN_ULONG *res,
+#                                const BN_ULONG *a,
+#                                const BN_ULONG *b,
+#                                const BN_ULONG *m,
+#                                BN_ULONG k0);
+# void ossl_rsaz_amm52x30_x2_256(BN_ULONG out[2][30],
+#                                const BN_ULONG a[2][30],
+#                                const BN_ULONG b[2][30],
+#                                const BN_ULONG m[2][30],
+#                                const BN_ULONG k0[2]);
+#
+# and the same for 40 digits.
+###############################################################################
+
+# input parameters ("%rdi","%rsi","%rdx","%rcx","%r8")
+my ($res,$a,$b,$m,$k0) = @_6_args_universal_ABI;
+
+my $mask52     = "%rax";
+my $acc0_0     = "%r9";
+my $acc0_0_low = "%r9d";
+my $acc0_1     = "%r15";
+my $acc0_1_low = "%r15d";
+my $b_ptr      = "%r11";
+
+my $iter = "%ebx";
+
+my $zero = "%ymm0";
+my $Bi = "%ymm3";
+my $Yi = "%ymm4";
+
+# Registers mapping for normalization.
+# We can reuse Bi, Yi registers here.
+my $TMP = $Bi;
+my $mask52x4 = $Yi;
+
+# Registers that are volatile in both ABIs and are not taken above. The
+# low digits live in %ymm1 and %ymm2, which are reachable by vpblendd.
+my @pool = map("%ymm$_", (16..31));
+
+# Number of %ymm registers per number and the number of qwords in the
+# last one, 0 if it is full.
+sub geometry {
+my $digits = shift;
+    (($digits + 3) >> 2, $digits & 3);
+}
+
+# %k7 selects the used lanes of the last register of a number
+sub last_mask {
+my ($digits,$i) = @_;
+my ($n,$partial) = geometry($digits);
+    ($partial && $i == $n - 1) ? "{%k7}" : "";
+}
+
+sub set_last_mask {
+my $digits = shift;
+my ($n,$partial) = geometry($digits);
+    return if (!$partial);
+$code.=<<___;
+    mov     \$`(1<<$partial)-1`, %r10d
+    kmovb   %r10d, %k7
+___
+}
+
+# One digit |b[i]| of the AMM loop, see amm52x20_x1 in rsaz-avx512.pl
+sub amm52_digit {
+my ($digits,$_data_offset,$_b_offset,$_acc,$_k0,@R) = @_;
+my ($n) = geometry($digits);
+my $R0_xmm = $R[0];
+$R0_xmm =~ s/%y/%x/;
+$code.=<<___;
+    movq    $_b_offset($b_ptr), %r13             # b[i]
+
+    vpbroadcastq    %r13, $Bi                    # broadcast b[i]
+    movq    $_data_offset($a), %rdx
+    mulx    %r13, %r13, %r12                     # a[0]*b[i] = (t0,t2)
+    addq    %r13, $_acc                          # acc += t0
+    movq    %r12, %r10
+    adcq    \$0, %r10                            # t2 += CF
+
+    movq    $_k0, %r13
+    imulq   $_acc, %r13                          # acc * k0
+    andq    $mask52, %r13                        # yi = (acc * k0) & mask52
+
+    vpbroadcastq    %r13, $Yi                    # broadcast y[i]
+    movq    $_data_offset($m), %rdx
+    mulx    %r13, %r13, %r12                     # yi * m[0] = (t0,t1)
+    addq    %r13, $_acc                          # acc += t0
+    adcq    %r12, %r10                           # t2 += (t1 + CF)
+
+    shrq    \$52, $_acc
+    salq    \$12, %r10
+    or      %r10, $_acc                          # acc = ((acc >> 52) | (t2 << 12))
+
+___
+    foreach my $op ("vpmadd52luq","vpmadd52huq") {
+        foreach my $p ([$a,$Bi], [$m,$Yi]) {
+            my ($ptr,$mul) = @$p;
+            foreach my $i (0..$n-1) {
+                $code.="    $op ".($_data_offset+32*$i)."($ptr), $mul, $R[$i]".&last_mask($digits,$i)."\n";
+            }
+        }
+        last if ($op eq "vpmadd52huq");
+        $code.="\n    # Shift accumulators right by 1 qword, zero extending the highest one\n";
+        foreach my $i (0..$n-2) {
+            $code.="    valignq     \$1, $R[$i], $R[$i+1], $R[$i]\n";
+        }
+        $code.="    valignq     \$1, $R[$n-1], $zero, $R[$n-1]\n\n";
+        $code.="    vmovq   $R0_xmm, %r13\n";
+        $code.="    addq    %r13, $_acc    # acc += R0[0]\n\n";
+    }
+}
+
+# Normalization, see amm52x20_x1_norm in rsaz-avx512.pl. Carries are
+# shifted up by one qword from the top down, so that only two temporary
+# registers are needed, and the masks of overflown and saturated digits
+# are gathered into 64-bit %r14 and %rbp.
+#
+# Uses %r12-14, %rbp
+sub amm52_norm {
+my ($digits,$_acc,$tA,$tB,@R) = @_;
+my ($n) = geometry($digits);
+$code.=<<___;
+    # Put accumulator to low qword in R0
+    vpbroadcastq    $_acc, $TMP
+    vpblendd \$3, $TMP, $R[0], $R[0]
+
+    # Extract "carries" (12 high bits) from each QW, "shift left" them by
+    # 1 QW and add to the digits with the carries dropped
+    vpsrlq    \$52, $R[$n-1], $tA
+___
+    for (my $i=$n-1; $i>=0; $i--) {
+        if ($i) {
+            $code.="    vpsrlq    \$52, $R[$i-1], $tB\n";
+            $code.="    valignq   \$3, $tB, $tA, $tA\n";
+        } else {
+            $code.="    valignq   \$3, $zero, $tA, $tA\n";
+        }
+        $code.="    vpandq    $mask52x4, $R[$i], $R[$i]\n";
+        $code.="    vpaddq    $tA, $R[$i], $R[$i]\n";
+        ($tA,$tB) = ($tB,$tA);
+    }
+$code.=<<___;
+
+    # Now handle carry bits from this addition
+    # Get mask of QWs which 52-bit parts overflow (%r14) or are
+    # saturated (%rbp)
+___
+    foreach my $i (0..$n-1) {
+        $code.="    vpcmpuq   \$1, $R[$i], $mask52x4, %k1 # OP=lt\n";
+        $code.="    vpcmpuq   \$0, $R[$i], $mask52x4, %k2 # OP=eq\n";
+        if ($i) {
+            $code.="    kmovb     %k1, %r13d\n";
+            $code.="    kmovb     %k2, %r12d\n";
+            $code.="    shl       \$".(4*$i).", %r13\n";
+            $code.="    shl       \$".(4*$i).", %r12\n";
+            $code.="    or        %r13, %r14\n";
+            $code.="    or        %r12, %rbp\n";
+        } else {
+            $code.="    kmovb     %k1, %r14d\n";
+            $code.="    kmovb     %k2, %ebp\n";
+        }
+    }
+$code.=<<___;
+
+    # Get mask of QWs where carries shall be propagated to
+    add     %r14, %r14
+    add     %rbp, %r14
+    xor     %rbp, %r14
+
+    # Add carries according to the obtained mask
+___
+    foreach my $i (0..$n-1) {
+        $code.="    mov       %r14, %r13\n";
+        $code.="    shr       \$".(4*$i).", %r13\n"	if ($i);
+        $code.="    kmovb     %r13d, %k1\n";
+        $code.="    vpsubq    $mask52x4, $R[$i], $R[$i]\{%k1}\n";
+        $code.="    vpandq    $mask52x4, $R[$i], $R[$i]\n";
+    }
+}
+
+sub amm52_store {
+my ($digits,$_offset,@R) = @_;
+my ($n) = geometry($digits);
+    foreach my $i (0..$n-1) {
+        $code.="    vmovdqu64   $R[$i], ".($_offset+32*$i)."($res)".&last_mask($digits,$i)."\n";
+    }
+}
+
+sub amm52_zero {
+my @R = @_;
+    foreach (@R) {
+        $code.="    vmovdqa64   $zero, $_\n";
+    }
+}
+
+sub prologue {
+my $func = shift;
+$code.=<<___;
+
+.globl  $func
+.type   $func,\@function,5
+.align 32
+$func:
+.cfi_startproc
+    endbranch
+    push    %rbx
+.cfi_push   %rbx
+    push    %rbp
+.cfi_push   %rbp
+    push    %r12
+.cfi_push   %r12
+    push    %r13
+.cfi_push   %r13
+    push    %r14
+.cfi_push   %r14
+    push    %r15
+.cfi_push   %r15
+.L${func}_body:
+___
+}
+
+sub epilogue {
+my $func = shift;
+$code.=<<___;
+
+    vzeroupper
+    mov  0(%rsp),%r15
+.cfi_restore    %r15
+    mov  8(%rsp),%r14
+.cfi_restore    %r14
+    mov  16(%rsp),%r13
+.cfi_restore    %r13
+    mov  24(%rsp),%r12
+.cfi_restore    %r12
+    mov  32(%rsp),%rbp
+.cfi_restore    %rbp
+    mov  40(%rsp),%rbx
+.cfi_restore    %rbx
+    lea  48(%rsp),%rsp
+.cfi_adjust_cfa_offset  -48
+.L${func}_epilogue:
+    ret
+.cfi_endproc
+.size   $func, .-$func
+___
+}
+
+$code.=".text\n";
+
+foreach my $digits (@sizes) {
+my ($n) = geometry($digits);
+my $interleave = 2*($n-1)+1 <= @pool;
+my @R0 = ("%ymm1", @pool[0..$n-2]);
+my @R1 = ("%ymm2", @pool[$n-1..2*$n-3]);
+my ($tA,$tB) = ("%ymm5", $interleave ? $pool[2*$n-2] : $pool[$n-1]);
+my $func;
+
+    $func = "ossl_rsaz_amm52x${digits}_x1_256";
+    &prologue($func);
+$code.=<<___;
+
+    # Zeroing accumulators
+    vpxord   $zero, $zero, $zero
+___
+    &amm52_zero(@R0);
+    &set_last_mask($digits);
+$code.=<<___;
+
+    xorl    $acc0_0_low, $acc0_0_low
+
+    movq    $b, $b_ptr                       # backup address of b
+    movq    \$0xfffffffffffff, $mask52       # 52-bit mask
+
+    mov     \$$digits, $iter
+
+.align 32
+.Lloop_x1_$digits:
+___
+    &amm52_digit($digits,0,0,$acc0_0,$k0,@R0);
+$code.=<<___;
+    lea    8($b_ptr), $b_ptr
+    dec    $iter
+    jne    .Lloop_x1_$digits
+
+    vmovdqa64   .Lmask52x4(%rip), $mask52x4
+___
+    &amm52_norm($digits,$acc0_0,$tA,$tB,@R0);
+    &amm52_store($digits,0,@R0);
+    &epilogue($func);
+
+    $func = "ossl_rsaz_amm52x${digits}_x2_256";
+    &prologue($func);
+$code.=<<___;
+
+    vpxord   $zero, $zero, $zero
+    movq    $b, $b_ptr                       # backup address of b
+    movq    \$0xfffffffffffff, $mask52       # 52-bit mask
+___
+    &set_last_mask($digits);
+    if ($interleave) {
+        &amm52_zero(@R0,@R1);
+$code.=<<___;
+
+    xorl    $acc0_0_low, $acc0_0_low
+    xorl    $acc0_1_low, $acc0_1_low
+
+    mov     \$$digits, $iter
+
+.align 32
+.Lloop_x2_$digits:
+___
+        &amm52_digit($digits,0,0,$acc0_0,"($k0)",@R0);
+        # $digits*8 = offset of the next dimension in two-dimension array
+        &amm52_digit($digits,$digits*8,$digits*8,$acc0_1,"8($k0)",@R1);
+$code.=<<___;
+    lea    8($b_ptr), $b_ptr
+    dec    $iter
+    jne    .Lloop_x2_$digits
+
+    vmovdqa64   .Lmask52x4(%rip), $mask52x4
+___
+        &amm52_norm($digits,$acc0_0,$tA,$tB,@R0);
+        &amm52_norm($digits,$acc0_1,$tA,$tB,@R1);
+        &amm52_store($digits,0,@R0);
+        &amm52_store($digits,$digits*8,@R1);
+    } else {
+        foreach my $k (0..1) {
+            # |b_ptr| arrives at b[1] by the end of the first pass
+            &amm52_zero(@R0);
+$code.=<<___;
+
+    xorl    $acc0_0_low, $acc0_0_low
+    mov     \$$digits, $iter
+
+.align 32
+.Lloop_x2_${digits}_$k:
+___
+            &amm52_digit($digits,$k*$digits*8,0,$acc0_0,(8*$k)."($k0)",@R0);
+$code.=<<___;
+    lea    8($b_ptr), $b_ptr
+    dec    $iter
+    jne    .Lloop_x2_${digits}_$k
+
+    vmovdqa64   .Lmask52x4(%rip), $mask52x4
+___
+            &amm52_norm($digits,$acc0_0,$tA,$tB,@R0);
+            &amm52_store($digits,$k*$digits*8,@R0);
+        }
+    }
+    &epilogue($func);
+}
+
+$code.=<<___;
+.data
+.align 32
+.Lmask52x4:
+    .quad   0xfffffffffffff
+    .quad   0xfffffffffffff
+    .quad   0xfffffffffffff
+    .quad   0xfffffffffffff
+___
+
+###############################################################################
+# Constant time extraction from the precomputed table of powers base^i, where
+#    i = 0..2^EXP_WIN_SIZE-1
+#
+# See ossl_extract_multiplier_2x20_win5 in rsaz-avx512.pl, the extracted
+# value is a 30- or 40-digit number in 2^52 radix.
+#
+# void ossl_extract_multiplier_2x30_win5(BN_ULONG *red_Y,
+#                                        const BN_ULONG red_table[1 << EXP_WIN_SIZE][2][30],
+#                                        int red_table_idx,
+#                                        int tbl_idx);           # 0 or 1
+#
+# and the same for 40 digits.
+#
+# EXP_WIN_SIZE = 5
+###############################################################################
+{
+# input parameters
+my ($out,$red_tbl,$red_tbl_idx,$tbl_idx) = @_6_args_universal_ABI;
+
+$code.=".text\n";
+
+foreach my $digits (@sizes) {
+my ($n) = geometry($digits);
+my @t = map("%ymm$_", (0..5,16..$n+9));
+my ($cur_idx,$idx,$ones) = map("%ymm$_", (29..31));
+my $func = "ossl_extract_multiplier_2x${digits}_win5";
+my $stride = 2*$digits*8;
+
+$code.=<<___;
+
+.align 32
+.globl  $func
+.type   $func,\@function,4
+$func:
+.cfi_startproc
+    endbranch
+    imulq   \$`$digits*8`, $tbl_idx, %rax
+    addq    %rax, $red_tbl
+
+    vmovdqa64   .Lones(%rip), $ones         # broadcast ones
+    vpbroadcastq    $red_tbl_idx, $idx
+    leaq   `(1<<5)*$stride`($red_tbl), %rax  # holds end of the tbl
+___
+    &set_last_mask($digits);
+$code.=<<___;
+
+    vpxor   %xmm0, %xmm0, %xmm0
+    vmovdqa64   %ymm0, $cur_idx             # zeroing t0..n, cur_idx
+___
+    foreach (@t[1..$n-1]) {
+        $code.="    vmovdqa64   %ymm0, $_\n";
+    }
+$code.=<<___;
+
+.align 32
+.Lloop_$digits:
+    vpcmpq  \$0, $cur_idx, $idx, %k1        # mask of (idx == cur_idx)
+___
+    $code.="    kandb   %k7, %k1, %k2\n"             if (&last_mask($digits,$n-1));
+    foreach my $i (0..$n-1) {
+        my $k = &last_mask($digits,$i) ? "%k2" : "%k1";
+        # extract data when mask is not zero
+        $code.="    vpblendmq  ".(32*$i)."($red_tbl), $t[$i], $t[$i]\{$k}\n";
+    }
+$code.=<<___;
+    vpaddq  $ones, $cur_idx, $cur_idx       # increment cur_idx
+    addq    \$$stride, $red_tbl             # $stride = 2 * $digits digits * 8 bytes
+    cmpq    $red_tbl, %rax
+    jne .Lloop_$digits
+
+___
+    foreach my $i (0..$n-1) {
+        $code.="    vmovdqu64   $t[$i], ".(32*$i)."($out)".&last_mask($digits,$i)."\n";
+    }
+$code.=<<___;
+
+    vzeroupper
+    ret
+.cfi_endproc
+.size   $func, .-$func
+___
+}
+
+$code.=<<___;
+.data
+.align 32
+.Lones:
+    .quad   1,1,1,1
+___
+}
+
+if ($win64) {
+$rec="%rcx";
+$frame="%rdx";
+$context="%r8";
+$disp="%r9";
+
+$code.=<<___;
+.extern     __imp_RtlVirtualUnwind
+.type   rsaz_3k4k_handler,\@abi-omnipotent
+.align  16
+rsaz_3k4k_handler:
+    push    %rsi
+    push    %rdi
+    push    %rbx
+    push    %rbp
+    push    %r12
+    push    %r13
+    push    %r14
+    push    %r15
+    pushfq
+    sub     \$64,%rsp
+
+    mov     120($context),%rax # pull context->Rax
+    mov     248($context),%rbx # pull context->Rip
+
+    mov     8($disp),%rsi      # disp->ImageBase
+    mov     56($disp),%r11     # disp->HandlerData
+
+    mov     0(%r11),%r10d      # HandlerData[0]
+    lea     (%rsi,%r10),%r10   # prologue label
+    cmp     %r10,%rbx          # context->Rip<.Lprologue
+    jb  .Lcommon_seh_tail
+
+    mov     152($context),%rax # pull context->Rsp
+
+    mov     4(%r11),%r10d      # HandlerData[1]
+    lea     (%rsi,%r10),%r10   # epilogue label
+    cmp     %r10,%rbx          # context->Rip>=.Lepilogue
+    jae     .Lcommon_seh_tail
+
+    lea     48(%rax),%rax
+
+    mov     -8(%rax),%rbx
+    mov     -16(%rax),%rbp
+    mov     -24(%rax),%r12
+    mov     -32(%rax),%r13
+    mov     -40(%rax),%r14
+    mov     -48(%rax),%r15
+    mov     %rbx,144($context) # restore context->Rbx
+    mov     %rbp,160($context) # restore context->Rbp
+    mov     %r12,216($context) # restore context->R12
+    mov     %r13,224($context) # restore context->R13
+    mov     %r14,232($context) # restore context->R14
+    mov     %r15,240($context) # restore context->R14
+
+.Lcommon_seh_tail:
+    mov     8(%rax),%rdi
+    mov     16(%rax),%rsi
+    mov     %rax,152($context) # restore context->Rsp
+    mov     %rsi,168($context) # restore context->Rsi
+    mov     %rdi,176($context) # restore context->Rdi
+
+    mov     40($disp),%rdi     # disp->ContextRecord
+    mov     $context,%rsi      # context
+    mov     \$154,%ecx         # sizeof(CONTEXT)
+    .long   0xa548f3fc         # cld; rep movsq
+
+    mov     $disp,%rsi
+    xor     %rcx,%rcx          # arg1, UNW_FLAG_NHANDLER
+    mov     8(%rsi),%rdx       # arg2, disp->ImageBase
+    mov     0(%rsi),%r8        # arg3, disp->ControlPc
+    mov     16(%rsi),%r9       # arg4, disp->FunctionEntry
+    mov     40(%rsi),%r10      # disp->ContextRecord
+    lea     56(%rsi),%r11      # &disp->HandlerData
+    lea     24(%rsi),%r12      # &disp->EstablisherFrame
+    mov     %r10,32(%rsp)      # arg5
+    mov     %r11,40(%rsp)      # arg6
+    mov     %r12,48(%rsp)      # arg7
+    mov     %rcx,56(%rsp)      # arg8, (NULL)
+    call    *__imp_RtlVirtualUnwind(%rip)
+
+    mov     \$1,%eax           # ExceptionContinueSearch
+    add     \$64,%rsp
+    popfq
+    pop     %r15
+    pop     %r14
+    pop     %r13
+    pop     %r12
+    pop     %rbp
+    pop     %rbx
+    pop     %rdi
+    pop     %rsi
+    ret
+.size   rsaz_3k4k_handler,.-rsaz_3k4k_handler
+___
+
+$code.=".section    .pdata\n.align  4\n";
+foreach my $digits (@sizes) {
+    foreach my $func ("ossl_rsaz_amm52x${digits}_x1_256",
+                      "ossl_rsaz_amm52x${digits}_x2_256",
+                      "ossl_extract_multiplier_2x${digits}_win5") {
+        $code.=<<___;
+    .rva    .LSEH_begin_$func
+    .rva    .LSEH_end_$func
+    .rva    .LSEH_info_$func
+
+___
+    }
+}
+$code.=".section    .xdata\n.align  8\n";
+foreach my $digits (@sizes) {
+    foreach my $func ("ossl_rsaz_amm52x${digits}_x1_256",
+                      "ossl_rsaz_amm52x${digits}_x2_256") {
+        $code.=<<___;
+.LSEH_info_$func:
+    .byte   9,0,0,0
+    .rva    rsaz_3k4k_handler
+    .rva    .L${func}_body,.L${func}_epilogue
+___
+    }
+    my $func = "ossl_extract_multiplier_2x${digits}_win5";
+    $code.=<<___;
+.LSEH_info_$func:
+    .byte   9,0,0,0
+    .rva    rsaz_3k4k_handler
+    .rva    .LSEH_begin_$func,.LSEH_begin_$func
+___
+}
+}
+}}} else {{{                # fallback for old assembler
+$code.=".text\n";
+foreach my $digits (@sizes) {
+$code.=<<___;
+
+.globl  ossl_rsaz_amm52x${digits}_x1_256
+.globl  ossl_rsaz_amm52x${digits}_x2_256
+.globl  ossl_extract_multiplier_2x${digits}_win5
+.type   ossl_rsaz_amm52x${digits}_x1_256,\@abi-omnipotent
+ossl_rsaz_amm52x${digits}_x1_256:
+ossl_rsaz_amm52x${digits}_x2_256:
+ossl_extract_multiplier_2x${digits}_win5:
+    .byte   0x0f,0x0b    # ud2
+    ret
+.size   ossl_rsaz_amm52x${digits}_x1_256, .-ossl_rsaz_amm52x${digits}_x1_256
+___
+}
+}}}
+
+$code =~ s/\`([^\`]*)\`/eval $1/gem;
+print $code;
+close STDOUT or die "error closing STDOUT: $!";
@@ -56,18 +56,22 @@ static ossl_inline int number_of_digits(int bitsize, int digit_size)
 
 typedef void (*AMM52)(BN_ULONG *res, const BN_ULONG *base,
                       const BN_ULONG *exp, const BN_ULONG *m, BN_ULONG k0);
-typedef void (*EXP52_x2)(BN_ULONG *res, const BN_ULONG *base,
-                         const BN_ULONG *exp[2], const BN_ULONG *m,
-                         const BN_ULONG *rr, const BN_ULONG k0[2]);
+typedef void (*DAMM52)(BN_ULONG *res, const BN_ULONG *a,
+                       const BN_ULONG *b, const BN_ULONG *m,
+                       const BN_ULONG k0[2]);
+typedef void (*EXTRACT52)(BN_ULONG *red_Y, const BN_ULONG *red_table,
+                          int red_table_idx, int tbl_idx);
 
 /*
  * For details of the methods declared below please refer to
  *    crypto/bn/asm/rsaz-avx512.pl
+ *    crypto/bn/asm/rsaz-3k4k-avx512.pl
  *
  * Naming notes:
  *  amm = Almost Montgomery Multiplication
  *  ams = Almost Montgomery Squaring
- *  52x20 - data represented as array of 20 digits in 52-bit radix
+ *  52xN - data represented as array of N (20, 30 or 40) digits in 52-bit
+ *         radix
  *  _x1_/_x2_ - 1 or 2 independent inputs/outputs
  *  _256 suffix - uses 256-bit (AVX512VL) registers
  */
@@ -76,9 +80,6 @@ typedef void (*EXP52_x2)(BN_ULONG *res, const BN_ULONG *base,
 void ossl_rsaz_amm52x20_x1_256(BN_ULONG *res, const BN_ULONG *base,
                                const BN_ULONG *exp, const BN_ULONG *m,
                                BN_ULONG k0);
-static void RSAZ_exp52x20_x2_256(BN_ULONG *res, const BN_ULONG *base,
-                                 const BN_ULONG *exp[2], const BN_ULONG *m,
-                                 const BN_ULONG *rr, const BN_ULONG k0[2]);
 void ossl_rsaz_amm52x20_x2_256(BN_ULONG *out, const BN_ULONG *a,
                                const BN_ULONG *b, const BN_ULONG *m,
                                const BN_ULONG k0[2]);
@@ -86,6 +87,45 @@ void ossl_extract_multiplier_2x20_win5(BN_ULONG *red_Y,
                                        const BN_ULONG *red_table,
                                        int red_table_idx, int tbl_idx);
 
+void ossl_rsaz_amm52x30_x1_256(BN_ULONG *res, const BN_ULONG *base,
+                               const BN_ULONG *exp, const BN_ULONG *m,
+                               BN_ULONG k0);
+void ossl_rsaz_amm52x30_x2_256(BN_ULONG *out, const BN_ULONG *a,
+                               const BN_ULONG *b, const BN_ULONG *m,
+                               const BN_ULONG k0[2]);
+void ossl_extract_multiplier_2x30_win5(BN_ULONG *red_Y,
+                                       const BN_ULONG *red_table,
+                                       int red_table_idx, int tbl_idx);
+
+void ossl_rsaz_amm52x40_x1_256(BN_ULONG *res, const BN_ULONG *base,
+                               const BN_ULONG *exp, const BN_ULONG *m,
+                               BN_ULONG k0);
+void ossl_rsaz_amm52x40_x2_256(BN_ULONG *out, const BN_ULONG *a,
+                               const BN_ULONG *b, const BN_ULONG *m,
+                               const BN_ULONG k0[2]);
+void ossl_extract_multiplier_2x40_win5(BN_ULONG *red_Y,
+                                       const BN_ULONG *red_table,
+                                       int red_table_idx, int tbl_idx);
+
+/* Window size of the exponentiation */
+# define EXP_WIN_SIZE (5)
+# define EXP_WIN_MASK ((1U << EXP_WIN_SIZE) - 1)
+
+/*
+ * Size in words of the scratch area used by RSAZ_exp52_x2_256() for
+ * |red_digits|-digit moduli: the table of powers, two values of 2x
+ * |red_digits| digits and two expanded exponents.
+ */
+# define EXP_X2_SCRATCH_LEN(red_digits, exp_digits) \
+    ((((1U << EXP_WIN_SIZE) + 2) * 2 * (red_digits)) + 2 * ((exp_digits) + 1))
+
+static void RSAZ_exp52_x2_256(BN_ULONG *res, const BN_ULONG *base,
+                              const BN_ULONG *exp[2], const BN_ULONG *m,
+                              const BN_ULONG *rr, const BN_ULONG k0[2],
+                              int modulus_bitsize, int red_digits,
+                              DAMM52 damm, EXTRACT52 extract,
+                              BN_ULONG *scratch);
+
 /*
  * Dual Montgomery modular exponentiation using prime moduli of the
  * same bit size, optimized with AVX512 ISA.
@@ -97,7 +137,7 @@ void ossl_extract_multiplier_2x20_win5(BN_ULONG *red_Y,
  *
  * Each moduli shall be |factor_size| bit size.
  *
- * NOTE: currently only 2x1024 case is supported.
+ * NOTE: 2x1024, 2x1536 and 2x2048 cases are supported.
  *
  *  [out] res|i|      - result of modular exponentiation: array of qword values
  *                      in regular (2^64) radix. Size of array shall be enough
@@ -137,28 +177,44 @@ int ossl_rsaz_mod_exp_avx512_x2(BN_ULONG *res1,
     BN_ULONG *base1_red, *m1_red, *rr1_red;
     BN_ULONG *base2_red, *m2_red, *rr2_red;
     BN_ULONG *coeff_red;
+    BN_ULONG *scratch;
     BN_ULONG *storage = NULL;
     BN_ULONG *storage_aligned = NULL;
-    BN_ULONG storage_len_bytes = 7 * exp_digits * sizeof(BN_ULONG);
+    size_t storage_len_bytes;
 
     /* AMM = Almost Montgomery Multiplication */
     AMM52 amm = NULL;
-    /* Dual (2-exps in parallel) exponentiation */
-    EXP52_x2 exp_x2 = NULL;
+    /* Dual (2-exps in parallel) AMM and table lookup */
+    DAMM52 damm = NULL;
+    EXTRACT52 extract = NULL;
 
     const BN_ULONG *exp[2] = {0};
     BN_ULONG k0[2] = {0};
 
-    /* Only 1024-bit factor size is supported now */
     switch (factor_size) {
     case 1024:
         amm = ossl_rsaz_amm52x20_x1_256;
-        exp_x2 = RSAZ_exp52x20_x2_256;
+        damm = ossl_rsaz_amm52x20_x2_256;
+        extract = ossl_extract_multiplier_2x20_win5;
+        break;
+    case 1536:
+        amm = ossl_rsaz_amm52x30_x1_256;
+        damm = ossl_rsaz_amm52x30_x2_256;
+        extract = ossl_extract_multiplier_2x30_win5;
+        break;
+    case 2048:
+        amm = ossl_rsaz_amm52x40_x1_256;
+        damm = ossl_rsaz_amm52x40_x2_256;
+        extract = ossl_extract_multiplier_2x40_win5;
         break;
     default:
         goto err;
     }
 
+    storage_len_bytes = (7 * exp_digits
+                         + EXP_X2_SCRATCH_LEN(exp_digits,
+                                              BITS2WORD64_SIZE(factor_size)))
+                        * sizeof(BN_ULONG);
     storage = (BN_ULONG *)OPENSSL_malloc(storage_len_bytes + 64);
     if (storage == NULL)
         goto err;
@@ -172,6 +228,7 @@ int ossl_rsaz_mod_exp_avx512_x2(BN_ULONG *res1,
     rr1_red   = storage_aligned + 4 * exp_digits;
     rr2_red   = storage_aligned + 5 * exp_digits;
     coeff_red = storage_aligned + 6 * exp_digits;
+    scratch   = storage_aligned + 7 * exp_digits;
 
     /* Convert base_i, m_i, rr_i, from regular to 52-bit radix */
     to_words52(base1_red, exp_digits, base1, factor_size);
@@ -196,6 +253,8 @@ int ossl_rsaz_mod_exp_avx512_x2(BN_ULONG *res1,
      *  R' = 2^(52 * ceil(modlen/52)) mod m
      *
      *  modlen = 1024: k = 64, RR = 2^2048 mod m, RR' = 2^2080 mod m
+     *  modlen = 1536: k = 96, RR = 2^3072 mod m, RR' = 2^3120 mod m
+     *  modlen = 2048: k = 128, RR = 2^4096 mod m, RR' = 2^4160 mod m
      */
     memset(coeff_red, 0, exp_digits * sizeof(BN_ULONG));
     /* (1) in reduced domain representation */
@@ -213,7 +272,8 @@ int ossl_rsaz_mod_exp_avx512_x2(BN_ULONG *res1,
     k0[0] = k0_1;
     k0[1] = k0_2;
 
-    exp_x2(rr1_red, base1_red, exp, m1_red, rr1_red, k0);
+    RSAZ_exp52_x2_256(rr1_red, base1_red, exp, m1_red, rr1_red, k0,
+                      factor_size, exp_digits, damm, extract, scratch);
 
     /* Convert rr_i back to regular radix */
     from_words52(res1, factor_size, rr1_red);
@@ -229,195 +289,166 @@ err:
 }
 
 /*
- * Dual 1024-bit w-ary modular exponentiation using prime moduli of the same
- * bit size using Almost Montgomery Multiplication, optimized with AVX512_IFMA
- * ISA.
+ * Dual w-ary modular exponentiation using prime moduli of the same bit size
+ * using Almost Montgomery Multiplication, optimized with AVX512_IFMA ISA.
  *
  * The parameter w (window size) = 5.
  *
- *  [out] res      - result of modular exponentiation: 2x20 qword
- *                   values in 2^52 radix.
- *  [in]  base     - base (2x20 qword values in 2^52 radix)
- *  [in]  exp      - array of 2 pointers to 16 qword values in 2^64 radix.
- *                   Exponent is not converted to redundant representation.
- *  [in]  m        - moduli (2x20 qword values in 2^52 radix)
- *  [in]  rr       - Montgomery parameter for 2 moduli: RR = 2^2080 mod m.
- *                   (2x20 qword values in 2^52 radix)
- *  [in]  k0       - Montgomery parameter for 2 moduli: k0 = -1/m mod 2^64
+ *  [out] res             - result of modular exponentiation: 2x|red_digits|
+ *                          qword values in 2^52 radix.
+ *  [in]  base            - base (2x|red_digits| qword values in 2^52 radix)
+ *  [in]  exp             - array of 2 pointers to |modulus_bitsize|/64 qword
+ *                          values in 2^64 radix. Exponent is not converted
+ *                          to redundant representation.
+ *  [in]  m               - moduli (2x|red_digits| qword values in 2^52 radix)
+ *  [in]  rr              - Montgomery parameter for 2 moduli:
+ *                          RR = 2^(2*52*|red_digits|) mod m.
+ *                          (2x|red_digits| qword values in 2^52 radix)
+ *  [in]  k0              - Montgomery parameter for 2 moduli:
+ *                          k0 = -1/m mod 2^64
+ *  [in]  modulus_bitsize - moduli bit size, a multiple of 64
+ *  [in]  red_digits      - number of 52-bit digits in the moduli
+ *  [in]  damm, extract   - dual AMM and table lookup for |red_digits|
+ *  [in]  scratch         - EXP_X2_SCRATCH_LEN() words of temporary storage,
+ *                          it is left for the caller to cleanse
  *
  * \return (void).
  */
-static void RSAZ_exp52x20_x2_256(BN_ULONG *out,          /* [2][20] */
-                                 const BN_ULONG *base,   /* [2][20] */
-                                 const BN_ULONG *exp[2], /* 2x16    */
-                                 const BN_ULONG *m,      /* [2][20] */
-                                 const BN_ULONG *rr,     /* [2][20] */
-                                 const BN_ULONG k0[2])
+static void RSAZ_exp52_x2_256(BN_ULONG *out,
+                              const BN_ULONG *base,
+                              const BN_ULONG *exp[2],
+                              const BN_ULONG *m,
+                              const BN_ULONG *rr,
+                              const BN_ULONG k0[2],
+                              int modulus_bitsize,
+                              int red_digits,
+                              DAMM52 damm,
+                              EXTRACT52 extract,
+                              BN_ULONG *scratch)
 {
-# define BITSIZE_MODULUS (1024)
-# define EXP_WIN_SIZE (5)
-# define EXP_WIN_MASK ((1U << EXP_WIN_SIZE) - 1)
-/*
- * Number of digits (64-bit words) in redundant representation to handle
- * modulus bits
- */
-# define RED_DIGITS (20)
-# define EXP_DIGITS (16)
-# define DAMM ossl_rsaz_amm52x20_x2_256
 /*
  * Squaring is done using multiplication now. That can be a subject of
  * optimization in future.
  */
-# define DAMS(r,a,m,k0) \
-              ossl_rsaz_amm52x20_x2_256((r),(a),(a),(m),(k0))
-
-    /* Allocate stack for red(undant) result Y and multiplier X */
-    ALIGN64 BN_ULONG red_Y[2][RED_DIGITS];
-    ALIGN64 BN_ULONG red_X[2][RED_DIGITS];
-
-    /* Allocate expanded exponent */
-    ALIGN64 BN_ULONG expz[2][EXP_DIGITS + 1];
-
-    /* Pre-computed table of base powers */
-    ALIGN64 BN_ULONG red_table[1U << EXP_WIN_SIZE][2][RED_DIGITS];
+# define DAMS(r,a,m,k0) damm((r),(a),(a),(m),(k0))
+
+    int exp_digits = modulus_bitsize / 64;
+    /* Pre-computed table of base powers, [1 << EXP_WIN_SIZE][2][red_digits] */
+    BN_ULONG *red_table = scratch;
+    /* Red(undant) result Y and multiplier X, [2][red_digits] each */
+    BN_ULONG *red_Y = red_table + (1U << EXP_WIN_SIZE) * 2 * red_digits;
+    BN_ULONG *red_X = red_Y + 2 * red_digits;
+    /* Expanded exponents, [2][exp_digits + 1] */
+    BN_ULONG *expz = red_X + 2 * red_digits;
+    /* Address of table entry |i| for modulus |j| */
+# define RED_TABLE(i, j) (red_table + ((i) * 2 + (j)) * red_digits)
 
     int idx;
 
-    memset(red_Y, 0, sizeof(red_Y));
-    memset(red_table, 0, sizeof(red_table));
-    memset(red_X, 0, sizeof(red_X));
+    memset(scratch, 0,
+           EXP_X2_SCRATCH_LEN(red_digits, exp_digits) * sizeof(BN_ULONG));
 
     /*
      * Compute table of powers base^i, i = 0, ..., (2^EXP_WIN_SIZE) - 1
      *   table[0] = mont(x^0) = mont(1)
      *   table[1] = mont(x^1) = mont(x)
      */
-    red_X[0][0] = 1;
-    red_X[1][0] = 1;
-    DAMM(red_table[0][0], (const BN_ULONG*)red_X, rr, m, k0);
-    DAMM(red_table[1][0], base,  rr, m, k0);
+    red_X[0] = 1;
+    red_X[red_digits] = 1;
+    damm(RED_TABLE(0, 0), red_X, rr, m, k0);
+    damm(RED_TABLE(1, 0), base, rr, m, k0);
 
     for (idx = 1; idx < (int)((1U << EXP_WIN_SIZE) / 2); idx++) {
-        DAMS(red_table[2 * idx + 0][0], red_table[1 * idx][0], m, k0);
-        DAMM(red_table[2 * idx + 1][0], red_table[2 * idx][0], red_table[1][0], m, k0);
+        DAMS(RED_TABLE(2 * idx + 0, 0), RED_TABLE(1 * idx, 0), m, k0);
+        damm(RED_TABLE(2 * idx + 1, 0), RED_TABLE(2 * idx, 0),
+             RED_TABLE(1, 0), m, k0);
     }
 
     /* Copy and expand exponents */
-    memcpy(expz[0], exp[0], EXP_DIGITS * sizeof(BN_ULONG));
-    expz[0][EXP_DIGITS] = 0;
-    memcpy(expz[1], exp[1], EXP_DIGITS * sizeof(BN_ULONG));
-    expz[1][EXP_DIGITS] = 0;
+    memcpy(expz, exp[0], exp_digits * sizeof(BN_ULONG));
+    expz[exp_digits] = 0;
+    memcpy(expz + exp_digits + 1, exp[1], exp_digits * sizeof(BN_ULONG));
+    expz[2 * exp_digits + 1] = 0;
 
     /* Exponentiation */
     {
-        int rem = BITSIZE_MODULUS % EXP_WIN_SIZE;
+        int rem = modulus_bitsize % EXP_WIN_SIZE;
         int delta = rem ? rem : EXP_WIN_SIZE;
         BN_ULONG table_idx_mask = EXP_WIN_MASK;
 
-        int exp_bit_no = BITSIZE_MODULUS - delta;
+        int exp_bit_no = modulus_bitsize - delta;
         int exp_chunk_no = exp_bit_no / 64;
         int exp_chunk_shift = exp_bit_no % 64;
+        int i;
 
-        /* Process 1-st exp window - just init result */
-        BN_ULONG red_table_idx_0 = expz[0][exp_chunk_no];
-        BN_ULONG red_table_idx_1 = expz[1][exp_chunk_no];
         /*
+         * Process 1-st exp window - just init result.
+         *
          * The function operates with fixed moduli sizes divisible by 64,
          * thus table index here is always in supported range [0, EXP_WIN_SIZE).
          */
-        red_table_idx_0 >>= exp_chunk_shift;
-        red_table_idx_1 >>= exp_chunk_shift;
+        for (i = 0; i < 2; i++) {
+            BN_ULONG red_table_idx = expz[i * (exp_digits + 1) + exp_chunk_no];
 
-        ossl_extract_multiplier_2x20_win5(red_Y[0], (const BN_ULONG*)red_table,
-                                          (int)red_table_idx_0, 0);
-        ossl_extract_multiplier_2x20_win5(red_Y[1], (const BN_ULONG*)red_table,
-                                          (int)red_table_idx_1, 1);
+            red_table_idx >>= exp_chunk_shift;
+            extract(red_Y + i * red_digits, red_table, (int)red_table_idx, i);
+        }
 
         /* Process other exp windows */
         for (exp_bit_no -= EXP_WIN_SIZE; exp_bit_no >= 0; exp_bit_no -= EXP_WIN_SIZE) {
+            exp_chunk_no = exp_bit_no / 64;
+            exp_chunk_shift = exp_bit_no % 64;
+
             /* Extract pre-computed multiplier from the table */
-            {
-                BN_ULONG T;
-
-                exp_chunk_no = exp_bit_no / 64;
-                exp_chunk_shift = exp_bit_no % 64;
-                {
-                    red_table_idx_0 = expz[0][exp_chunk_no];
-                    T = expz[0][exp_chunk_no + 1];
-
-                    red_table_idx_0 >>= exp_chunk_shift;
-                    /*
-                     * Get additional bits from then next quadword
-                     * when 64-bit boundaries are crossed.
-                     */
-                    if (exp_chunk_shift > 64 - EXP_WIN_SIZE) {
-                        T <<= (64 - exp_chunk_shift);
-                        red_table_idx_0 ^= T;
-                    }
-                    red_table_idx_0 &= table_idx_mask;
-
-                    ossl_extract_multiplier_2x20_win5(red_X[0],
-                                                      (const BN_ULONG*)red_table,
-                                                      (int)red_table_idx_0, 0);
-                }
-                {
-                    red_table_idx_1 = expz[1][exp_chunk_no];
-                    T = expz[1][exp_chunk_no + 1];
-
-                    red_table_idx_1 >>= exp_chunk_shift;
-                    /*
-                     * Get additional bits from then next quadword
-                     * when 64-bit boundaries are crossed.
-                     */
-                    if (exp_chunk_shift > 64 - EXP_WIN_SIZE) {
-                        T <<= (64 - exp_chunk_shift);
-                        red_table_idx_1 ^= T;
-                    }
-                    red_table_idx_1 &= table_idx_mask;
-
-                    ossl_extract_multiplier_2x20_win5(red_X[1],
-                                                      (const BN_ULONG*)red_table,
-                                                      (int)red_table_idx_1, 1);
+            for (i = 0; i < 2; i++) {
+                const BN_ULONG *e = expz + i * (exp_digits + 1);
+                BN_ULONG red_table_idx = e[exp_chunk_no];
+                BN_ULONG T = e[exp_chunk_no + 1];
+
+                red_table_idx >>= exp_chunk_shift;
+                /*
+                 * Get additional bits from then next quadword
+                 * when 64-bit boundaries are crossed.
+                 */
+                if (exp_chunk_shift > 64 - EXP_WIN_SIZE) {
+                    T <<= (64 - exp_chunk_shift);
+                    red_table_idx ^= T;
                 }
+                red_table_idx &= table_idx_mask;
+
+                extract(red_X + i * red_digits, red_table,
+                        (int)red_table_idx, i);
             }
 
             /* Series of squaring */
-            DAMS((BN_ULONG*)red_Y, (const BN_ULONG*)red_Y, m, k0);
-            DAMS((BN_ULONG*)red_Y, (const BN_ULONG*)red_Y, m, k0);
-            DAMS((BN_ULONG*)red_Y, (const BN_ULONG*)red_Y, m, k0);
-            DAMS((BN_ULONG*)red_Y, (const BN_ULONG*)red_Y, m, k0);
-            DAMS((BN_ULONG*)red_Y, (const BN_ULONG*)red_Y, m, k0);
+            DAMS(red_Y, red_Y, m, k0);
+            DAMS(red_Y, red_Y, m, k0);
+            DAMS(red_Y, red_Y, m, k0);
+            DAMS(red_Y, red_Y, m, k0);
+            DAMS(red_Y, red_Y, m, k0);
 
-            DAMM((BN_ULONG*)red_Y, (const BN_ULONG*)red_Y, (const BN_ULONG*)red_X, m, k0);
+            damm(red_Y, red_Y, red_X, m, k0);
         }
     }
 
     /*
      *
      * NB: After the last AMM of exponentiation in Montgomery domain, the result
-     * may be 1025-bit, but the conversion out of Montgomery domain performs an
-     * AMM(x,1) which guarantees that the final result is less than |m|, so no
-     * conditional subtraction is needed here. See "Efficient Software
-     * Implementations of Modular Exponentiation" (by Shay Gueron) paper for details.
+     * may be one bit longer than the modulus, but the conversion out of
+     * Montgomery domain performs an AMM(x,1) which guarantees that the final
+     * result is less than |m|, so no conditional subtraction is needed here.
+     * See "Efficient Software Implementations of Modular Exponentiation" (by
+     * Shay Gueron) paper for details.
      */
 
     /* Convert result back in regular 2^52 domain */
-    memset(red_X, 0, sizeof(red_X));
-    red_X[0][0] = 1;
-    red_X[1][0] = 1;
-    DAMM(out, (const BN_ULONG*)red_Y, (const BN_ULONG*)red_X, m, k0);
-
-    /* Clear exponents */
-    OPENSSL_cleanse(expz, sizeof(expz));
-    OPENSSL_cleanse(red_Y, sizeof(red_Y));
+    memset(red_X, 0, 2 * red_digits * sizeof(BN_ULONG));
+    red_X[0] = 1;
+    red_X[red_digits] = 1;
+    damm(out, red_Y, red_X, m, k0);
 
+# undef RED_TABLE
 # undef DAMS
-# undef DAMM
-# undef EXP_DIGITS
-# undef RED_DIGITS
-# undef EXP_WIN_MASK
-# undef EXP_WIN_SIZE
-# undef BITSIZE_MODULUS
 }
 
 static ossl_inline uint64_t get_digit52(const uint8_t *in, int in_len)
@@ -14,6 +14,7 @@
 #include "internal/core.h"
 #include "internal/bio.h"
 #include "internal/provider.h"
+#include "internal/tsan_assist.h"
 
 struct ossl_lib_ctx_onfree_list_st {
     ossl_lib_ctx_onfree_fn *fn;
@@ -36,6 +37,14 @@ struct ossl_lib_ctx_st {
     /* Keep a separate lock for each index */
     CRYPTO_RWLOCK *index_locks[OSSL_LIB_CTX_MAX_INDEXES];
 
+#ifdef tsan_ld_acq
+    /*
+     * The data of an index never changes once it has been created, so it is
+     * published here for ossl_lib_ctx_get_data() to find without any lock.
+     */
+    void *TSAN_QUALIFIER index_data[OSSL_LIB_CTX_MAX_INDEXES];
+#endif
+
     CRYPTO_RWLOCK *oncelock;
     int run_once_done[OSSL_LIB_CTX_MAX_RUN_ONCE];
     int run_once_ret[OSSL_LIB_CTX_MAX_RUN_ONCE];
@@ -131,8 +140,12 @@ static int context_deinit(OSSL_LIB_CTX *ctx)
     }
     CRYPTO_free_ex_data(CRYPTO_EX_INDEX_OSSL_LIB_CTX, NULL, &ctx->data);
     ossl_crypto_cleanup_all_ex_data_int(ctx);
-    for (i = 0; i < OSSL_LIB_CTX_MAX_INDEXES; i++)
+    for (i = 0; i < OSSL_LIB_CTX_MAX_INDEXES; i++) {
+#ifdef tsan_ld_acq
+        tsan_store(&ctx->index_data[i], NULL);
+#endif
         CRYPTO_THREAD_lock_free(ctx->index_locks[i]);
+    }
 
     CRYPTO_THREAD_lock_free(ctx->oncelock);
     CRYPTO_THREAD_lock_free(ctx->lock);
@@ -353,6 +366,11 @@ void *ossl_lib_ctx_get_data(OSSL_LIB_CTX *ctx, int index,
     if (ctx == NULL)
         return NULL;
 
+#ifdef tsan_ld_acq
+    if ((data = tsan_ld_acq(&ctx->index_data[index])) != NULL)
+        return data;
+#endif
+
     if (!CRYPTO_THREAD_read_lock(ctx->lock))
         return NULL;
     dynidx = ctx->dyn_indexes[index];
@@ -410,6 +428,10 @@ void *ossl_lib_ctx_get_data(OSSL_LIB_CTX *ctx, int index,
             goto end;
         data = CRYPTO_get_ex_data(&ctx->data, ctx->dyn_indexes[index]);
         CRYPTO_THREAD_unlock(ctx->lock);
+#ifdef tsan_ld_acq
+        if (data != NULL)
+            tsan_st_rel(&ctx->index_data[index], data);
+#endif
     }
 
 end:
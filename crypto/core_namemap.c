@@ -7,23 +7,70 @@
  * https://www.openssl.org/source/license.html
  */
 
-#include "e_os.h"                /* strcasecmp */
+#include "e_os.h"                /* strncasecmp */
 #include "internal/namemap.h"
-#include <openssl/lhash.h>
-#include "crypto/lhash.h"      /* ossl_lh_strcasehash */
+#include "crypto/ctype.h"        /* ossl_tolower */
 #include "internal/tsan_assist.h"
 #include "internal/sizes.h"
 
+/*
+ * Names are never removed from a namemap, which allows name to number
+ * lookups to be done without taking any lock when the platform gives us
+ * acquire / release semantics.  The name table is an open addressing hash
+ * table that is only ever added to.  A new entry is fully initialised before
+ * it's published in its slot, and when the table needs to grow, a new table
+ * is built on the side and published as a whole.  Replaced tables are kept
+ * until the namemap is freed, so a reader that still looks at an older table
+ * just doesn't see the most recently added names.  Since the table size is
+ * doubled every time, the replaced tables never take up more space than the
+ * current one.
+ *
+ * The number to names mapping works the same way.  Each name is linked into
+ * the alias chain of its number after it has been initialised, and the table
+ * of the first alias of every number is replaced as a whole when it grows.
+ * Number to name lookups and walks over all names of a number are therefore
+ * lock free as well.
+ *
+ * Writers are serialised with the namemap lock.
+ */
+#ifdef tsan_ld_acq
+# define namemap_ld_acq(ptr) tsan_ld_acq(ptr)
+# define namemap_st_rel(ptr, val) tsan_st_rel(ptr, val)
+#else
+# define namemap_ld_acq(ptr) (*(ptr))
+# define namemap_st_rel(ptr, val) (*(ptr) = (val))
+#endif
+
+/* The initial number of slots in the name table, must be a power of two */
+#define NAMENUM_TABLE_MIN_SIZE  256
+
 /*-
  * The namenum entry
  * =================
  */
-typedef struct {
-    char *name;
+typedef struct namenum_entry_st NAMENUM_ENTRY;
+struct namenum_entry_st {
+    unsigned long hash;         /* Case insensitive hash of the name */
     int number;
-} NAMENUM_ENTRY;
+    /* The next name with the same number */
+    NAMENUM_ENTRY *TSAN_QUALIFIER next_alias;
+    size_t name_len;
+    char name[1];
+};
 
-DEFINE_LHASH_OF(NAMENUM_ENTRY);
+typedef struct namenum_table_st NAMENUM_TABLE;
+struct namenum_table_st {
+    NAMENUM_TABLE *replaced;    /* The table this one replaced */
+    size_t mask;                /* The number of slots minus one */
+    NAMENUM_ENTRY *TSAN_QUALIFIER slots[1];
+};
+
+typedef struct namenum_aliases_st NAMENUM_ALIASES;
+struct namenum_aliases_st {
+    NAMENUM_ALIASES *replaced;  /* The table this one replaced */
+    size_t size;                /* The number of slots */
+    NAMENUM_ENTRY *TSAN_QUALIFIER first[1]; /* Indexed by number */
+};
 
 /*-
  * The namemap itself
@@ -35,7 +82,11 @@ struct ossl_namemap_st {
     unsigned int stored:1; /* If 1, it's stored in a library context */
 
     CRYPTO_RWLOCK *lock;
-    LHASH_OF(NAMENUM_ENTRY) *namenum;  /* Name->number mapping */
+    NAMENUM_TABLE *TSAN_QUALIFIER table;  /* Name->number mapping */
+    size_t num_names;
+
+    /* Number->names mapping */
+    NAMENUM_ALIASES *TSAN_QUALIFIER aliases;
 
 #ifdef tsan_ld_acq
     TSAN_QUALIFIER int max_number;     /* Current max number TSAN version */
@@ -44,23 +95,66 @@ struct ossl_namemap_st {
 #endif
 };
 
-/* LHASH callbacks */
+/* Name table helpers */
 
-static unsigned long namenum_hash(const NAMENUM_ENTRY *n)
+static unsigned long namenum_hash(const char *name, size_t name_len)
 {
-    return ossl_lh_strcasehash(n->name);
+    unsigned long ret = 0;
+    long n;
+    unsigned long v;
+    int r;
+    size_t i;
+
+    /* Same as ossl_lh_strcasehash(), for a name that isn't NUL terminated */
+    for (i = 0, n = 0x100; i < name_len; i++, n += 0x100) {
+        v = n | ossl_tolower(name[i]);
+        r = (int)((v >> 2) ^ v) & 0x0f;
+        ret = (ret << r) | (ret >> (32 - r));
+        ret &= 0xFFFFFFFFL;
+        ret ^= v * v;
+    }
+    return (ret >> 16) ^ ret;
 }
 
-static int namenum_cmp(const NAMENUM_ENTRY *a, const NAMENUM_ENTRY *b)
+static NAMENUM_TABLE *namenum_table_new(size_t size)
 {
-    return strcasecmp(a->name, b->name);
+    NAMENUM_TABLE *table;
+
+    table = OPENSSL_zalloc(sizeof(*table)
+                           + (size - 1) * sizeof(table->slots[0]));
+    if (table != NULL)
+        table->mask = size - 1;
+    return table;
 }
 
-static void namenum_free(NAMENUM_ENTRY *n)
+static void namenum_table_insert(NAMENUM_TABLE *table, NAMENUM_ENTRY *entry)
 {
-    if (n != NULL)
-        OPENSSL_free(n->name);
-    OPENSSL_free(n);
+    size_t i;
+
+    for (i = entry->hash & table->mask;
+         table->slots[i] != NULL;
+         i = (i + 1) & table->mask)
+        continue;
+    namemap_st_rel(&table->slots[i], entry);
+}
+
+/* Safe to use without holding the lock when we have TSAN support */
+static NAMENUM_ENTRY *namenum_lookup(const OSSL_NAMEMAP *namemap,
+                                     const char *name, size_t name_len)
+{
+    const NAMENUM_TABLE *table = namemap_ld_acq(&namemap->table);
+    unsigned long hash = namenum_hash(name, name_len);
+    NAMENUM_ENTRY *entry;
+    size_t i;
+
+    for (i = hash & table->mask; ; i = (i + 1) & table->mask) {
+        entry = namemap_ld_acq(&table->slots[i]);
+        if (entry == NULL)
+            return NULL;
+        if (entry->hash == hash && entry->name_len == name_len
+            && strncasecmp(entry->name, name, name_len) == 0)
+            return entry;
+    }
 }
 
 /* OSSL_LIB_CTX_METHOD functions for a namemap stored in a library context */
@@ -117,19 +211,21 @@ int ossl_namemap_empty(OSSL_NAMEMAP *namemap)
 #endif
 }
 
-typedef struct doall_names_data_st {
-    int number;
-    const char **names;
-    int found;
-} DOALL_NAMES_DATA;
-
-static void do_name(const NAMENUM_ENTRY *namenum, DOALL_NAMES_DATA *data)
+/* Safe to use without holding the lock when we have TSAN support */
+static NAMENUM_ENTRY *namemap_first_alias(const OSSL_NAMEMAP *namemap,
+                                          int number)
 {
-    if (namenum->number == data->number)
-        data->names[data->found++] = namenum->name;
+    NAMENUM_ALIASES *aliases = namemap_ld_acq(&namemap->aliases);
+
+    if (number <= 0 || aliases == NULL || (size_t)number >= aliases->size)
+        return NULL;
+    return namemap_ld_acq(&aliases->first[number]);
 }
 
-IMPLEMENT_LHASH_DOALL_ARG_CONST(NAMENUM_ENTRY, DOALL_NAMES_DATA);
+static NAMENUM_ENTRY *namemap_next_alias(NAMENUM_ENTRY *entry)
+{
+    return namemap_ld_acq(&entry->next_alias);
+}
 
 /*
  * Call the callback for all names in the namemap with the given number.
@@ -140,12 +236,21 @@ int ossl_namemap_doall_names(const OSSL_NAMEMAP *namemap, int number,
                              void (*fn)(const char *name, void *data),
                              void *data)
 {
-    DOALL_NAMES_DATA cbdata;
-    size_t num_names;
-    int i;
-
-    cbdata.number = number;
-    cbdata.found = 0;
+    NAMENUM_ENTRY *entry;
+#ifdef tsan_ld_acq
+    /*
+     * No lock is held, so the user function is free to do anything, even
+     * add names to this namemap.  A name added to this number while we walk
+     * the aliases may or may not be passed to it.
+     */
+    if ((entry = namemap_first_alias(namemap, number)) == NULL)
+        return 0;
+    for (; entry != NULL; entry = namemap_next_alias(entry))
+        fn(entry->name, data);
+    return 1;
+#else
+    const char **names;
+    size_t num_names = 0, i;
 
     /*
      * We collect all the names first under a read lock. Subsequently we call
@@ -155,38 +260,36 @@ int ossl_namemap_doall_names(const OSSL_NAMEMAP *namemap, int number,
     if (!CRYPTO_THREAD_read_lock(namemap->lock))
         return 0;
 
-    num_names = lh_NAMENUM_ENTRY_num_items(namemap->namenum);
+    for (entry = namemap_first_alias(namemap, number); entry != NULL;
+         entry = namemap_next_alias(entry))
+        num_names++;
     if (num_names == 0) {
         CRYPTO_THREAD_unlock(namemap->lock);
         return 0;
     }
-    cbdata.names = OPENSSL_malloc(sizeof(*cbdata.names) * num_names);
-    if (cbdata.names == NULL) {
+    names = OPENSSL_malloc(sizeof(*names) * num_names);
+    if (names == NULL) {
         CRYPTO_THREAD_unlock(namemap->lock);
         return 0;
     }
-    lh_NAMENUM_ENTRY_doall_DOALL_NAMES_DATA(namemap->namenum, do_name,
-                                            &cbdata);
+    for (i = 0, entry = namemap_first_alias(namemap, number); entry != NULL;
+         entry = namemap_next_alias(entry))
+        names[i++] = entry->name;
     CRYPTO_THREAD_unlock(namemap->lock);
 
-    for (i = 0; i < cbdata.found; i++)
-        fn(cbdata.names[i], data);
+    for (i = 0; i < num_names; i++)
+        fn(names[i], data);
 
-    OPENSSL_free(cbdata.names);
+    OPENSSL_free(names);
     return 1;
+#endif
 }
 
 static int namemap_name2num_n(const OSSL_NAMEMAP *namemap,
                               const char *name, size_t name_len)
 {
-    NAMENUM_ENTRY *namenum_entry, namenum_tmpl;
+    NAMENUM_ENTRY *namenum_entry = namenum_lookup(namemap, name, name_len);
 
-    if ((namenum_tmpl.name = OPENSSL_strndup(name, name_len)) == NULL)
-        return 0;
-    namenum_tmpl.number = 0;
-    namenum_entry =
-        lh_NAMENUM_ENTRY_retrieve(namemap->namenum, &namenum_tmpl);
-    OPENSSL_free(namenum_tmpl.name);
     return namenum_entry != NULL ? namenum_entry->number : 0;
 }
 
@@ -203,10 +306,14 @@ int ossl_namemap_name2num_n(const OSSL_NAMEMAP *namemap,
     if (namemap == NULL)
         return 0;
 
+#ifdef tsan_ld_acq
+    number = namemap_name2num_n(namemap, name, name_len);
+#else
     if (!CRYPTO_THREAD_read_lock(namemap->lock))
         return 0;
     number = namemap_name2num_n(namemap, name, name_len);
     CRYPTO_THREAD_unlock(namemap->lock);
+#endif
 
     return number;
 }
@@ -219,58 +326,102 @@ int ossl_namemap_name2num(const OSSL_NAMEMAP *namemap, const char *name)
     return ossl_namemap_name2num_n(namemap, name, strlen(name));
 }
 
-struct num2name_data_st {
-    size_t idx;                  /* Countdown */
-    const char *name;            /* Result */
-};
-
-static void do_num2name(const char *name, void *vdata)
+static const char *namemap_num2name(const OSSL_NAMEMAP *namemap, int number,
+                                    size_t idx)
 {
-    struct num2name_data_st *data = vdata;
+    NAMENUM_ENTRY *entry;
 
-    if (data->idx > 0)
-        data->idx--;
-    else if (data->name == NULL)
-        data->name = name;
+    for (entry = namemap_first_alias(namemap, number);
+         entry != NULL && idx > 0;
+         entry = namemap_next_alias(entry))
+        idx--;
+    return entry != NULL ? entry->name : NULL;
 }
 
 const char *ossl_namemap_num2name(const OSSL_NAMEMAP *namemap, int number,
                                   size_t idx)
 {
-    struct num2name_data_st data;
+    const char *name;
 
-    data.idx = idx;
-    data.name = NULL;
-    if (!ossl_namemap_doall_names(namemap, number, do_num2name, &data))
+#ifdef tsan_ld_acq
+    name = namemap_num2name(namemap, number, idx);
+#else
+    /* Names are never freed, so it's safe to return one after unlocking */
+    if (!CRYPTO_THREAD_read_lock(namemap->lock))
         return NULL;
-    return data.name;
+    name = namemap_num2name(namemap, number, idx);
+    CRYPTO_THREAD_unlock(namemap->lock);
+#endif
+    return name;
+}
+
+/* The caller must hold the namemap write lock */
+static int namemap_grow(OSSL_NAMEMAP *namemap, int number)
+{
+    NAMENUM_TABLE *table = namemap->table, *newtable;
+    NAMENUM_ALIASES *aliases = namemap->aliases, *newaliases;
+    size_t i, size, oldsize = aliases != NULL ? aliases->size : 0;
+
+    /* Keep the load factor of the name table at most 1/2 */
+    if (2 * (namemap->num_names + 1) > table->mask + 1) {
+        if ((newtable = namenum_table_new(2 * (table->mask + 1))) == NULL)
+            return 0;
+        for (i = 0; i <= table->mask; i++)
+            if (table->slots[i] != NULL)
+                namenum_table_insert(newtable, table->slots[i]);
+        newtable->replaced = table;
+        namemap_st_rel(&namemap->table, newtable);
+    }
+
+    if ((size_t)number >= oldsize) {
+        size = oldsize == 0 ? 64 : oldsize;
+        while (size <= (size_t)number)
+            size *= 2;
+        newaliases = OPENSSL_zalloc(sizeof(*newaliases)
+                                    + (size - 1) * sizeof(newaliases->first[0]));
+        if (newaliases == NULL)
+            return 0;
+        newaliases->size = size;
+        for (i = 0; i < oldsize; i++)
+            newaliases->first[i] = aliases->first[i];
+        newaliases->replaced = aliases;
+        namemap_st_rel(&namemap->aliases, newaliases);
+    }
+    return 1;
 }
 
 static int namemap_add_name_n(OSSL_NAMEMAP *namemap, int number,
                               const char *name, size_t name_len)
 {
-    NAMENUM_ENTRY *namenum = NULL;
+    NAMENUM_ENTRY *namenum = NULL, *alias;
     int tmp_number;
 
     /* If it already exists, we don't add it */
     if ((tmp_number = namemap_name2num_n(namemap, name, name_len)) != 0)
         return tmp_number;
 
-    if ((namenum = OPENSSL_zalloc(sizeof(*namenum))) == NULL
-        || (namenum->name = OPENSSL_strndup(name, name_len)) == NULL)
-        goto err;
-
+    if ((namenum = OPENSSL_zalloc(sizeof(*namenum) + name_len)) == NULL)
+        return 0;
+    memcpy(namenum->name, name, name_len);
+    namenum->name_len = name_len;
+    namenum->hash = namenum_hash(name, name_len);
     namenum->number =
         number != 0 ? number : 1 + tsan_counter(&namemap->max_number);
-    (void)lh_NAMENUM_ENTRY_insert(namemap->namenum, namenum);
 
-    if (lh_NAMENUM_ENTRY_error(namemap->namenum))
-        goto err;
+    if (!namemap_grow(namemap, namenum->number)) {
+        OPENSSL_free(namenum);
+        return 0;
+    }
+    if ((alias = namemap->aliases->first[namenum->number]) == NULL) {
+        namemap_st_rel(&namemap->aliases->first[namenum->number], namenum);
+    } else {
+        while (alias->next_alias != NULL)
+            alias = alias->next_alias;
+        namemap_st_rel(&alias->next_alias, namenum);
+    }
+    namenum_table_insert(namemap->table, namenum);
+    namemap->num_names++;
     return namenum->number;
-
- err:
-    namenum_free(namenum);
-    return 0;
 }
 
 int ossl_namemap_add_name_n(OSSL_NAMEMAP *namemap, int number,
@@ -512,8 +663,8 @@ OSSL_NAMEMAP *ossl_namemap_new(void)
 
     if ((namemap = OPENSSL_zalloc(sizeof(*namemap))) != NULL
         && (namemap->lock = CRYPTO_THREAD_lock_new()) != NULL
-        && (namemap->namenum =
-            lh_NAMENUM_ENTRY_new(namenum_hash, namenum_cmp)) != NULL)
+        && (namemap->table =
+            namenum_table_new(NAMENUM_TABLE_MIN_SIZE)) != NULL)
         return namemap;
 
     ossl_namemap_free(namemap);
@@ -522,11 +673,25 @@ OSSL_NAMEMAP *ossl_namemap_new(void)
 
 void ossl_namemap_free(OSSL_NAMEMAP *namemap)
 {
+    NAMENUM_TABLE *table, *replaced;
+    NAMENUM_ALIASES *aliases, *replaced_aliases;
+    size_t i;
+
     if (namemap == NULL || namemap->stored)
         return;
 
-    lh_NAMENUM_ENTRY_doall(namemap->namenum, namenum_free);
-    lh_NAMENUM_ENTRY_free(namemap->namenum);
+    if ((table = namemap->table) != NULL)
+        for (i = 0; i <= table->mask; i++)
+            OPENSSL_free(table->slots[i]);
+    for (; table != NULL; table = replaced) {
+        replaced = table->replaced;
+        OPENSSL_free(table);
+    }
+    for (aliases = namemap->aliases; aliases != NULL;
+         aliases = replaced_aliases) {
+        replaced_aliases = aliases->replaced;
+        OPENSSL_free(aliases);
+    }
 
     CRYPTO_THREAD_lock_free(namemap->lock);
     OPENSSL_free(namemap);
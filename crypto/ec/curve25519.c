@@ -17,6 +17,7 @@
 #include "crypto/ecx.h"
 #include "ec_local.h"
 #include <openssl/evp.h>
+#include <openssl/rand.h>
 #include <openssl/sha.h>
 
 #include "internal/numbers.h"
@@ -4286,6 +4287,188 @@ static void ge_scalarmult_base(ge_p3 *h, const uint8_t *a)
     OPENSSL_cleanse(e, sizeof(e));
 }
 
+#ifdef BASE_2_51_IMPLEMENTED
+/*
+ * Duplicate of ge_scalarmult_base and the point operations it uses, but
+ * using fe51_* subroutines.  The precomputed table stays in base 2^25.5
+ * and each entry is converted after the constant-time selection.
+ */
+typedef struct {
+    fe51 X;
+    fe51 Y;
+    fe51 Z;
+} ge51_p2;
+
+typedef struct {
+    fe51 X;
+    fe51 Y;
+    fe51 Z;
+    fe51 T;
+} ge51_p3;
+
+typedef struct {
+    fe51 X;
+    fe51 Y;
+    fe51 Z;
+    fe51 T;
+} ge51_p1p1;
+
+typedef struct {
+    fe51 yplusx;
+    fe51 yminusx;
+    fe51 xy2d;
+} ge51_precomp;
+
+/*
+ * h = f - g, with 8 * modulus added rather than 2 * modulus, as the
+ * subtrahend may be the sum of two unreduced products here.
+ */
+static void fe51_sub_lax(fe51 h, const fe51 f, const fe51 g)
+{
+    h[0] = (f[0] + 0x3fffffffffff68) - g[0];
+    h[1] = (f[1] + 0x3ffffffffffff8) - g[1];
+    h[2] = (f[2] + 0x3ffffffffffff8) - g[2];
+    h[3] = (f[3] + 0x3ffffffffffff8) - g[3];
+    h[4] = (f[4] + 0x3ffffffffffff8) - g[4];
+}
+
+/*
+ * Preconditions:
+ *    |f| bounded by 1.1*2^26,1.1*2^25,1.1*2^26,1.1*2^25,etc.
+ */
+static void fe51_from_fe(fe51 h, const fe f)
+{
+    h[0] = (uint64_t)(f[0] + (int64_t)f[1] * (1 << 26) + 0x3fffffffffff68);
+    h[1] = (uint64_t)(f[2] + (int64_t)f[3] * (1 << 26) + 0x3ffffffffffff8);
+    h[2] = (uint64_t)(f[4] + (int64_t)f[5] * (1 << 26) + 0x3ffffffffffff8);
+    h[3] = (uint64_t)(f[6] + (int64_t)f[7] * (1 << 26) + 0x3ffffffffffff8);
+    h[4] = (uint64_t)(f[8] + (int64_t)f[9] * (1 << 26) + 0x3ffffffffffff8);
+}
+
+static void ge51_table_select(ge51_precomp *t, int pos, signed char b)
+{
+    ge_precomp s;
+
+    table_select(&s, pos, b);
+    fe51_from_fe(t->yplusx, s.yplusx);
+    fe51_from_fe(t->yminusx, s.yminusx);
+    fe51_from_fe(t->xy2d, s.xy2d);
+}
+
+/* r = p */
+static void ge51_p1p1_to_p2(ge51_p2 *r, const ge51_p1p1 *p)
+{
+    fe51_mul(r->X, p->X, p->T);
+    fe51_mul(r->Y, p->Y, p->Z);
+    fe51_mul(r->Z, p->Z, p->T);
+}
+
+/* r = p */
+static void ge51_p1p1_to_p3(ge51_p3 *r, const ge51_p1p1 *p)
+{
+    fe51_mul(r->X, p->X, p->T);
+    fe51_mul(r->Y, p->Y, p->Z);
+    fe51_mul(r->Z, p->Z, p->T);
+    fe51_mul(r->T, p->X, p->Y);
+}
+
+/* r = 2 * p */
+static void ge51_p2_dbl(ge51_p1p1 *r, const ge51_p2 *p)
+{
+    fe51 t0;
+
+    fe51_sq(r->X, p->X);
+    fe51_sq(r->Z, p->Y);
+    fe51_sq(t0, p->Z);
+    fe51_add(r->T, t0, t0);
+    fe51_add(r->Y, p->X, p->Y);
+    fe51_sq(t0, r->Y);
+    fe51_add(r->Y, r->Z, r->X);
+    fe51_add(r->T, r->T, r->X);
+    fe51_sub_lax(r->T, r->T, r->Z);
+    fe51_sub_lax(r->Z, r->Z, r->X);
+    fe51_sub_lax(r->X, t0, r->Y);
+}
+
+/* r = p + q */
+static void ge51_madd(ge51_p1p1 *r, const ge51_p3 *p, const ge51_precomp *q)
+{
+    fe51 t0;
+
+    fe51_add(r->X, p->Y, p->X);
+    fe51_sub_lax(r->Y, p->Y, p->X);
+    fe51_mul(r->Z, r->X, q->yplusx);
+    fe51_mul(r->Y, r->Y, q->yminusx);
+    fe51_mul(r->T, q->xy2d, p->T);
+    fe51_add(t0, p->Z, p->Z);
+    fe51_sub_lax(r->X, r->Z, r->Y);
+    fe51_add(r->Y, r->Z, r->Y);
+    fe51_add(r->Z, t0, r->T);
+    fe51_sub_lax(r->T, t0, r->T);
+}
+
+/*
+ * h = a * B, as ge_scalarmult_base
+ *
+ * Preconditions:
+ *   a[31] <= 127
+ */
+static void ge51_scalarmult_base(ge51_p3 *h, const uint8_t *a)
+{
+    signed char e[64];
+    signed char carry;
+    ge51_p1p1 r;
+    ge51_p2 s;
+    ge51_precomp t;
+    int i;
+
+    for (i = 0; i < 32; ++i) {
+        e[2 * i + 0] = (a[i] >> 0) & 15;
+        e[2 * i + 1] = (a[i] >> 4) & 15;
+    }
+
+    carry = 0;
+    for (i = 0; i < 63; ++i) {
+        e[i] += carry;
+        carry = e[i] + 8;
+        carry >>= 4;
+        e[i] -= carry << 4;
+    }
+    e[63] += carry;
+
+    fe51_0(h->X);
+    fe51_1(h->Y);
+    fe51_1(h->Z);
+    fe51_0(h->T);
+    for (i = 1; i < 64; i += 2) {
+        ge51_table_select(&t, i / 2, e[i]);
+        ge51_madd(&r, h, &t);
+        ge51_p1p1_to_p3(h, &r);
+    }
+
+    fe51_copy(s.X, h->X);
+    fe51_copy(s.Y, h->Y);
+    fe51_copy(s.Z, h->Z);
+    ge51_p2_dbl(&r, &s);
+    ge51_p1p1_to_p2(&s, &r);
+    ge51_p2_dbl(&r, &s);
+    ge51_p1p1_to_p2(&s, &r);
+    ge51_p2_dbl(&r, &s);
+    ge51_p1p1_to_p2(&s, &r);
+    ge51_p2_dbl(&r, &s);
+    ge51_p1p1_to_p3(h, &r);
+
+    for (i = 0; i < 64; i += 2) {
+        ge51_table_select(&t, i / 2, e[i]);
+        ge51_madd(&r, h, &t);
+        ge51_p1p1_to_p3(h, &r);
+    }
+
+    OPENSSL_cleanse(e, sizeof(e));
+    OPENSSL_cleanse(&t, sizeof(t));
+}
+#endif
+
 #if !defined(BASE_2_51_IMPLEMENTED)
 /*
  * Replace (f,g) with (g,f) if b == 1;
@@ -4540,19 +4723,12 @@ static const ge_precomp Bi[8] = {
  * and b = b[0]+256*b[1]+...+256^31 b[31].
  * B is the Ed25519 base point (x,4/5) with x positive.
  */
-static void ge_double_scalarmult_vartime(ge_p2 *r, const uint8_t *a,
-                                         const ge_p3 *A, const uint8_t *b)
+/* Ai = A,3A,5A,7A,9A,11A,13A,15A */
+static void ge_odd_multiples(ge_cached Ai[8], const ge_p3 *A)
 {
-    signed char aslide[256];
-    signed char bslide[256];
-    ge_cached Ai[8]; /* A,3A,5A,7A,9A,11A,13A,15A */
     ge_p1p1 t;
     ge_p3 u;
     ge_p3 A2;
-    int i;
-
-    slide(aslide, a);
-    slide(bslide, b);
 
     ge_p3_to_cached(&Ai[0], A);
     ge_p3_dbl(&t, A);
@@ -4578,6 +4754,21 @@ static void ge_double_scalarmult_vartime(ge_p2 *r, const uint8_t *a,
     ge_add(&t, &A2, &Ai[6]);
     ge_p1p1_to_p3(&u, &t);
     ge_p3_to_cached(&Ai[7], &u);
+}
+
+static void ge_double_scalarmult_vartime(ge_p2 *r, const uint8_t *a,
+                                         const ge_p3 *A, const uint8_t *b)
+{
+    signed char aslide[256];
+    signed char bslide[256];
+    ge_cached Ai[8]; /* A,3A,5A,7A,9A,11A,13A,15A */
+    ge_p1p1 t;
+    ge_p3 u;
+    int i;
+
+    slide(aslide, a);
+    slide(bslide, b);
+    ge_odd_multiples(Ai, A);
 
     ge_p2_0(r);
 
@@ -4610,6 +4801,73 @@ static void ge_double_scalarmult_vartime(ge_p2 *r, const uint8_t *a,
     }
 }
 
+/* A point with its odd multiples and the sliding window form of its scalar */
+typedef struct {
+    ge_cached Ai[8];
+    signed char slide[256];
+} ge_msm_term;
+
+static void ge_msm_term_init(ge_msm_term *term, const ge_p3 *A,
+                             const uint8_t *a)
+{
+    ge_odd_multiples(term->Ai, A);
+    slide(term->slide, a);
+}
+
+/*
+ * r = b * B + a_0 * A_0 + ... + a_{num-1} * A_{num-1}
+ *
+ * This is Straus' method: all the points share the same doublings, so each
+ * additional point costs about a sixth of a double scalar multiplication.
+ */
+static void ge_multi_scalarmult_vartime(ge_p2 *r, const uint8_t *b,
+                                        const ge_msm_term *terms, size_t num)
+{
+    signed char bslide[256];
+    ge_p1p1 t;
+    ge_p3 u;
+    size_t j;
+    int i, digit;
+
+    slide(bslide, b);
+
+    ge_p2_0(r);
+
+    for (i = 255; i >= 0; --i) {
+        if (bslide[i])
+            break;
+        for (j = 0; j < num && terms[j].slide[i] == 0; j++)
+            continue;
+        if (j < num)
+            break;
+    }
+
+    for (; i >= 0; --i) {
+        ge_p2_dbl(&t, r);
+
+        for (j = 0; j < num; j++) {
+            digit = terms[j].slide[i];
+            if (digit > 0) {
+                ge_p1p1_to_p3(&u, &t);
+                ge_add(&t, &u, &terms[j].Ai[digit / 2]);
+            } else if (digit < 0) {
+                ge_p1p1_to_p3(&u, &t);
+                ge_sub(&t, &u, &terms[j].Ai[(-digit) / 2]);
+            }
+        }
+
+        if (bslide[i] > 0) {
+            ge_p1p1_to_p3(&u, &t);
+            ge_madd(&t, &u, &Bi[bslide[i] / 2]);
+        } else if (bslide[i] < 0) {
+            ge_p1p1_to_p3(&u, &t);
+            ge_msub(&t, &u, &Bi[(-bslide[i]) / 2]);
+        }
+
+        ge_p1p1_to_p2(r, &t);
+    }
+}
+
 /*
  * The set of scalars is \Z/l
  * where l = 2^252 + 27742317777372353535851937790883648493.
@@ -5496,38 +5754,22 @@ err:
 
 static const char allzeroes[15];
 
-int
-ossl_ed25519_verify(const uint8_t *message, size_t message_len,
-                    const uint8_t signature[64], const uint8_t public_key[32],
-                    OSSL_LIB_CTX *libctx, const char *propq)
+/*
+ * Check 0 <= s < L where L = 2^252 + 27742317777372353535851937790883648493
+ *
+ * If not the signature is publicly invalid. Since it's public we can do the
+ * check in variable time.
+ */
+static int sc_is_canonical(const uint8_t *s)
 {
     int i;
-    ge_p3 A;
-    const uint8_t *r, *s;
-    EVP_MD *sha512;
-    EVP_MD_CTX *hash_ctx = NULL;
-    unsigned int sz;
-    int res = 0;
-    ge_p2 R;
-    uint8_t rcheck[32];
-    uint8_t h[SHA512_DIGEST_LENGTH];
     /* 27742317777372353535851937790883648493 in little endian format */
     const uint8_t l_low[16] = {
         0xED, 0xD3, 0xF5, 0x5C, 0x1A, 0x63, 0x12, 0x58, 0xD6, 0x9C, 0xF7, 0xA2,
         0xDE, 0xF9, 0xDE, 0x14
     };
 
-    r = signature;
-    s = signature + 32;
-
-    /*
-     * Check 0 <= s < L where L = 2^252 + 27742317777372353535851937790883648493
-     *
-     * If not the signature is publicly invalid. Since it's public we can do the
-     * check in variable time.
-     *
-     * First check the most significant byte
-     */
+    /* First check the most significant byte */
     if (s[31] > 0x10)
         return 0;
     if (s[31] == 0x10) {
@@ -5546,6 +5788,29 @@ ossl_ed25519_verify(const uint8_t *message, size_t message_len,
         if (i < 0)
             return 0;
     }
+    return 1;
+}
+
+int
+ossl_ed25519_verify(const uint8_t *message, size_t message_len,
+                    const uint8_t signature[64], const uint8_t public_key[32],
+                    OSSL_LIB_CTX *libctx, const char *propq)
+{
+    ge_p3 A;
+    const uint8_t *r, *s;
+    EVP_MD *sha512;
+    EVP_MD_CTX *hash_ctx = NULL;
+    unsigned int sz;
+    int res = 0;
+    ge_p2 R;
+    uint8_t rcheck[32];
+    uint8_t h[SHA512_DIGEST_LENGTH];
+
+    r = signature;
+    s = signature + 32;
+
+    if (!sc_is_canonical(s))
+        return 0;
 
     if (ge_frombytes_vartime(&A, public_key) != 0) {
         return 0;
@@ -5581,6 +5846,199 @@ err:
     return res;
 }
 
+/*
+ * Returns 1 if |r| is the encoding that ossl_ed25519_verify() would compute
+ * for the point it decodes to, i.e. y < p and no sign bit for x = 0.
+ */
+static int ge_decode_canonical_vartime(ge_p3 *R, const uint8_t r[32])
+{
+    int i;
+
+    if ((r[31] & 0x7f) == 0x7f && r[0] >= 0xed) {
+        for (i = 1; i < 31 && r[i] == 0xff; i++)
+            continue;
+        if (i == 31)
+            return 0;
+    }
+    if (ge_frombytes_vartime(R, r) != 0)
+        return 0;
+    if ((r[31] >> 7) != 0 && !fe_isnonzero(R->X))
+        return 0;
+    return 1;
+}
+
+/* Number of signatures combined into one multi-scalar multiplication */
+#define ED25519_BATCH_MAX 64
+
+/* Returns 1 if [8]P is the identity, i.e. P has small order.  Clobbers P. */
+static int ge_p2_has_small_order(ge_p2 *P)
+{
+    ge_p1p1 t;
+    fe check;
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        ge_p2_dbl(&t, P);
+        ge_p1p1_to_p2(P, &t);
+    }
+    fe_sub(check, P->Y, P->Z);
+    return !fe_isnonzero(P->X) && !fe_isnonzero(check);
+}
+
+/*
+ * Decodes R and A of a signature for batch verification, rejecting them if
+ * they have small order, and computes h = SHA512(R || A || M).  R and A are
+ * returned negated.  Returns 1 on success, 0 if the signature is invalid and
+ * -1 on error.
+ */
+static int ed25519_batch_prepare(EVP_MD_CTX *hash_ctx, const EVP_MD *sha512,
+                                 const uint8_t *message, size_t message_len,
+                                 const uint8_t signature[64],
+                                 const uint8_t public_key[32],
+                                 ge_p3 *R, ge_p3 *A,
+                                 uint8_t h[SHA512_DIGEST_LENGTH])
+{
+    const uint8_t *r = signature, *s = signature + 32;
+    unsigned int sz;
+    ge_p2 P;
+
+    /* These are the checks ossl_ed25519_verify() does first */
+    if (!sc_is_canonical(s)
+            || ge_frombytes_vartime(A, public_key) != 0
+            || !ge_decode_canonical_vartime(R, r))
+        return 0;
+
+    ge_p3_to_p2(&P, R);
+    if (ge_p2_has_small_order(&P))
+        return 0;
+    ge_p3_to_p2(&P, A);
+    if (ge_p2_has_small_order(&P))
+        return 0;
+
+    if (!EVP_DigestInit_ex(hash_ctx, sha512, NULL)
+        || !EVP_DigestUpdate(hash_ctx, r, 32)
+        || !EVP_DigestUpdate(hash_ctx, public_key, 32)
+        || !EVP_DigestUpdate(hash_ctx, message, message_len)
+        || !EVP_DigestFinal_ex(hash_ctx, h, &sz))
+        return -1;
+    x25519_sc_reduce(h);
+
+    /* The R and A terms move to the other side of the equation */
+    fe_neg(R->X, R->X);
+    fe_neg(R->T, R->T);
+    fe_neg(A->X, A->X);
+    fe_neg(A->T, A->T);
+    return 1;
+}
+
+/*
+ * Verify a batch of signatures at once by checking that a random linear
+ * combination of the verification equations holds, multiplied by the
+ * cofactor:
+ *
+ *   [8]([-sum(z_i * s_i)]B + sum([z_i]R_i) + sum([z_i * h_i]A_i)) = 0
+ *
+ * with random 128 bit z_i.  If the combination does not hold, the
+ * signatures are verified one by one with the cofactored equation
+ *
+ *   [8]([-s_i]B + R_i + [h_i]A_i) = 0
+ *
+ * to find the invalid ones, so that the result for every signature only
+ * depends on the signature itself and not on the others in the batch.
+ * Signatures whose R or A has small order are rejected up front.
+ *
+ * On entry |results| must be 1 for the items to verify and 0 for those to
+ * skip.  On success the function returns 1 and |results| holds 1 for every
+ * valid signature and 0 otherwise.  It returns 0 on error.
+ */
+int
+ossl_ed25519_verify_batch(const uint8_t *const messages[],
+                          const size_t message_lens[],
+                          const uint8_t *const signatures[],
+                          const uint8_t *const public_keys[], size_t num,
+                          int results[], OSSL_LIB_CTX *libctx,
+                          const char *propq)
+{
+    static const uint8_t zero[32] = { 0 }, one[32] = { 1 };
+    EVP_MD *sha512 = NULL;
+    EVP_MD_CTX *hash_ctx = NULL;
+    ge_msm_term *terms = NULL;
+    size_t idx[ED25519_BATCH_MAX];
+    uint8_t z[ED25519_BATCH_MAX][16];
+    uint8_t zs[32], zi[32], zh[32];
+    uint8_t h[SHA512_DIGEST_LENGTH];
+    ge_p3 A, R;
+    ge_p2 P;
+    size_t i = 0, j, k, n;
+    int res = 0, ok;
+
+    sha512 = EVP_MD_fetch(libctx, SN_sha512, propq);
+    hash_ctx = EVP_MD_CTX_new();
+    terms = OPENSSL_malloc(2 * ED25519_BATCH_MAX * sizeof(*terms));
+    if (sha512 == NULL || hash_ctx == NULL || terms == NULL)
+        goto err;
+
+    while (i < num) {
+        memset(zs, 0, sizeof(zs));
+        if (RAND_bytes_ex(libctx, &z[0][0], sizeof(z), 0) <= 0)
+            goto err;
+
+        for (n = 0; i < num && n < ED25519_BATCH_MAX; i++) {
+            if (!results[i])
+                continue;
+            ok = ed25519_batch_prepare(hash_ctx, sha512, messages[i],
+                                       message_lens[i], signatures[i],
+                                       public_keys[i], &R, &A, h);
+            if (ok < 0)
+                goto err;
+            if (ok == 0) {
+                results[i] = 0;
+                continue;
+            }
+
+            memset(zi, 0, sizeof(zi));
+            memcpy(zi, z[n], sizeof(z[n]));
+            sc_muladd(zs, zi, signatures[i] + 32, zs);
+            sc_muladd(zh, zi, h, zero);
+
+            ge_msm_term_init(&terms[2 * n], &R, zi);
+            ge_msm_term_init(&terms[2 * n + 1], &A, zh);
+            idx[n++] = i;
+        }
+        if (n == 0)
+            continue;
+
+        ge_multi_scalarmult_vartime(&P, zs, terms, 2 * n);
+        if (ge_p2_has_small_order(&P))
+            continue;
+
+        /* At least one signature is invalid, find out which */
+        for (j = 0; j < n; j++) {
+            k = idx[j];
+            ok = ed25519_batch_prepare(hash_ctx, sha512, messages[k],
+                                       message_lens[k], signatures[k],
+                                       public_keys[k], &R, &A, h);
+            if (ok < 0)
+                goto err;
+            if (ok == 0) {
+                results[k] = 0;
+                continue;
+            }
+            ge_msm_term_init(&terms[0], &R, one);
+            ge_msm_term_init(&terms[1], &A, h);
+            ge_multi_scalarmult_vartime(&P, signatures[k] + 32, terms, 2);
+            results[k] = ge_p2_has_small_order(&P);
+        }
+    }
+
+    res = 1;
+err:
+    OPENSSL_free(terms);
+    EVP_MD_free(sha512);
+    EVP_MD_CTX_free(hash_ctx);
+    return res;
+}
+
 int
 ossl_ed25519_public_from_private(OSSL_LIB_CTX *ctx, uint8_t out_public_key[32],
                                  const uint8_t private_key[32],
@@ -5627,26 +6085,40 @@ ossl_x25519_public_from_private(uint8_t out_public_value[32],
                                 const uint8_t private_key[32])
 {
     uint8_t e[32];
+#ifdef BASE_2_51_IMPLEMENTED
+    ge51_p3 A;
+    fe51 zplusy, zminusy;
+#else
     ge_p3 A;
     fe zplusy, zminusy, zminusy_inv;
+#endif
 
     memcpy(e, private_key, 32);
     e[0] &= 248;
     e[31] &= 127;
     e[31] |= 64;
 
-    ge_scalarmult_base(&A, e);
-
     /*
      * We only need the u-coordinate of the curve25519 point.
      * The map is u=(y+1)/(1-y). Since y=Y/Z, this gives
      * u=(Z+Y)/(Z-Y).
      */
+#ifdef BASE_2_51_IMPLEMENTED
+    ge51_scalarmult_base(&A, e);
+    fe51_add(zplusy, A.Z, A.Y);
+    fe51_sub_lax(zminusy, A.Z, A.Y);
+    fe51_invert(zminusy, zminusy);
+    fe51_mul(zplusy, zplusy, zminusy);
+    fe51_tobytes(out_public_value, zplusy);
+#else
+    ge_scalarmult_base(&A, e);
     fe_add(zplusy, A.Z, A.Y);
     fe_sub(zminusy, A.Z, A.Y);
     fe_invert(zminusy_inv, zminusy);
     fe_mul(zplusy, zplusy, zminusy_inv);
     fe_tobytes(out_public_value, zplusy);
+#endif
 
+    OPENSSL_cleanse(&A, sizeof(A));
     OPENSSL_cleanse(e, sizeof(e));
 }
@@ -572,6 +572,15 @@ int ossl_ec_key_otherparams_fromdata(EC_KEY *ec, const OSSL_PARAM params[])
             || !ec_set_include_public(ec, include))
             return 0;
     }
+
+    p = OSSL_PARAM_locate_const(params, OSSL_PKEY_PARAM_EC_PUB_PRECOMP);
+    if (p != NULL) {
+        int enable = 1;
+
+        if (!OSSL_PARAM_get_int(p, &enable)
+            || !ossl_ec_key_set_pub_pre_comp(ec, enable))
+            return 0;
+    }
     if (!ec_key_point_format_fromdata(ec, params))
         return 0;
     if (!ec_key_group_check_fromdata(ec, params))
@@ -94,6 +94,7 @@ void EC_KEY_free(EC_KEY *r)
     CRYPTO_free_ex_data(CRYPTO_EX_INDEX_EC_KEY, r, &r->ex_data);
 #endif
     CRYPTO_THREAD_lock_free(r->lock);
+    ossl_ec_pub_pre_comp_free(r->pub_pre_comp);
     EC_GROUP_free(r->group);
     EC_POINT_free(r->pub_key);
     BN_clear_free(r->priv_key);
@@ -122,7 +123,8 @@ EC_KEY *EC_KEY_copy(EC_KEY *dest, const EC_KEY *src)
     dest->libctx = src->libctx;
     /* copy the parameters */
     if (src->group != NULL) {
-        /* clear the old group */
+        /* clear the old group and anything computed for it */
+        ossl_ec_key_pub_pre_comp_reset(dest);
         EC_GROUP_free(dest->group);
         dest->group = ossl_ec_group_new_ex(src->libctx, src->propq,
                                            src->group->meth);
@@ -678,6 +680,7 @@ int EC_KEY_set_group(EC_KEY *key, const EC_GROUP *group)
 {
     if (key->meth->set_group != NULL && key->meth->set_group(key, group) == 0)
         return 0;
+    ossl_ec_key_pub_pre_comp_reset(key);
     EC_GROUP_free(key->group);
     key->group = EC_GROUP_dup(group);
     if (key->group != NULL && EC_GROUP_get_curve_name(key->group) == NID_sm2)
@@ -787,6 +790,7 @@ int EC_KEY_set_public_key(EC_KEY *key, const EC_POINT *pub_key)
     if (key->meth->set_public != NULL
         && key->meth->set_public(key, pub_key) == 0)
         return 0;
+    ossl_ec_key_pub_pre_comp_reset(key);
     EC_POINT_free(key->pub_key);
     key->pub_key = EC_POINT_dup(pub_key, key->group);
     key->dirty_cnt++;
@@ -1026,3 +1030,82 @@ err:
     ECDSA_SIG_free(sig);
     return ret;
 }
+
+/*
+ * Number of verifications with a public key after which multiples of it
+ * are precomputed to speed up the following ones.  Keys that only verify
+ * one signature, as in most handshakes, never pay for the table.
+ */
+#define EC_KEY_PUB_PRE_COMP_THRESHOLD 2
+
+/* Drops the precomputation for the public key, if any */
+void ossl_ec_key_pub_pre_comp_reset(EC_KEY *key)
+{
+    ossl_ec_pub_pre_comp_free(key->pub_pre_comp);
+    key->pub_pre_comp = NULL;
+    key->verify_count = 0;
+}
+
+int ossl_ec_key_set_pub_pre_comp(EC_KEY *key, int enable)
+{
+    if (enable) {
+        key->flags &= ~EC_FLAG_NO_PUBKEY_PRECOMP;
+    } else {
+        key->flags |= EC_FLAG_NO_PUBKEY_PRECOMP;
+        ossl_ec_key_pub_pre_comp_reset(key);
+    }
+    return 1;
+}
+
+size_t ossl_ec_key_pub_pre_comp_size(const EC_KEY *key)
+{
+    return ossl_ec_pub_pre_comp_size(key->pub_pre_comp);
+}
+
+/*
+ * Computes r = u1 * generator + u2 * pub_key for ECDSA verification.
+ *
+ * Once a key has been used for EC_KEY_PUB_PRE_COMP_THRESHOLD verifications,
+ * multiples of its public key are kept with it, unless the key has the
+ * EC_FLAG_NO_PUBKEY_PRECOMP flag.  This is only done for groups that use
+ * the generic wNAF multiplication, the methods with their own mul() are
+ * left alone.
+ */
+int ossl_ec_key_verify_mul(EC_KEY *key, EC_POINT *r, const BIGNUM *u1,
+                           const BIGNUM *u2, BN_CTX *ctx)
+{
+    const EC_GROUP *group = key->group;
+    EC_PUB_PRE_COMP *pre;
+    int count;
+
+    if (group->meth->mul != NULL
+        || (key->flags & EC_FLAG_NO_PUBKEY_PRECOMP) != 0)
+        return EC_POINT_mul(group, r, u1, key->pub_key, u2, ctx);
+
+    if (!CRYPTO_THREAD_read_lock(key->lock))
+        return 0;
+    pre = key->pub_pre_comp;
+    CRYPTO_THREAD_unlock(key->lock);
+
+    if (pre == NULL
+        && CRYPTO_atomic_add(&key->verify_count, 1, &count, key->lock)
+        && count >= EC_KEY_PUB_PRE_COMP_THRESHOLD) {
+        if (!CRYPTO_THREAD_write_lock(key->lock))
+            return 0;
+        if (key->pub_pre_comp == NULL) {
+            /* Failing to build the table is not an error of the caller */
+            ERR_set_mark();
+            key->pub_pre_comp = ossl_ec_pub_pre_comp_new(group, key->pub_key,
+                                                         ctx);
+            ERR_pop_to_mark();
+        }
+        pre = key->pub_pre_comp;
+        CRYPTO_THREAD_unlock(key->lock);
+    }
+
+    if (pre != NULL
+        && EC_POINT_cmp(group, key->pub_key, ossl_ec_pub_pre_comp_point(pre),
+                        ctx) == 0)
+        return ossl_ec_wNAF_mul_pub(group, r, u1, u2, pre, ctx);
+    return EC_POINT_mul(group, r, u1, key->pub_key, u2, ctx);
+}
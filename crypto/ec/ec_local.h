@@ -203,9 +203,11 @@ struct ec_method_st {
  */
 typedef struct nistp224_pre_comp_st NISTP224_PRE_COMP;
 typedef struct nistp256_pre_comp_st NISTP256_PRE_COMP;
+typedef struct nistp384_pre_comp_st NISTP384_PRE_COMP;
 typedef struct nistp521_pre_comp_st NISTP521_PRE_COMP;
 typedef struct nistz256_pre_comp_st NISTZ256_PRE_COMP;
 typedef struct ec_pre_comp_st EC_PRE_COMP;
+typedef struct ec_pub_pre_comp_st EC_PUB_PRE_COMP;
 
 struct ec_group_st {
     const EC_METHOD *meth;
@@ -264,12 +266,14 @@ struct ec_group_st {
      */
     enum {
         PCT_none,
-        PCT_nistp224, PCT_nistp256, PCT_nistp521, PCT_nistz256,
+        PCT_nistp224, PCT_nistp256, PCT_nistp384, PCT_nistp521,
+        PCT_nistz256,
         PCT_ec
     } pre_comp_type;
     union {
         NISTP224_PRE_COMP *nistp224;
         NISTP256_PRE_COMP *nistp256;
+        NISTP384_PRE_COMP *nistp384;
         NISTP521_PRE_COMP *nistp521;
         NISTZ256_PRE_COMP *nistz256;
         EC_PRE_COMP *ec;
@@ -304,6 +308,10 @@ struct ec_key_st {
 
     /* Provider data */
     size_t dirty_cnt; /* If any key material changes, increment this */
+
+    /* Multiples of pub_key for repeated verification, see ec_key.c */
+    EC_PUB_PRE_COMP *pub_pre_comp;
+    int verify_count;
 };
 
 struct ec_point_st {
@@ -333,6 +341,7 @@ static ossl_inline int ec_point_is_compat(const EC_POINT *point,
 
 NISTP224_PRE_COMP *EC_nistp224_pre_comp_dup(NISTP224_PRE_COMP *);
 NISTP256_PRE_COMP *EC_nistp256_pre_comp_dup(NISTP256_PRE_COMP *);
+NISTP384_PRE_COMP *EC_nistp384_pre_comp_dup(NISTP384_PRE_COMP *);
 NISTP521_PRE_COMP *EC_nistp521_pre_comp_dup(NISTP521_PRE_COMP *);
 NISTZ256_PRE_COMP *EC_nistz256_pre_comp_dup(NISTZ256_PRE_COMP *);
 NISTP256_PRE_COMP *EC_nistp256_pre_comp_dup(NISTP256_PRE_COMP *);
@@ -341,6 +350,7 @@ EC_PRE_COMP *EC_ec_pre_comp_dup(EC_PRE_COMP *);
 void EC_pre_comp_free(EC_GROUP *group);
 void EC_nistp224_pre_comp_free(NISTP224_PRE_COMP *);
 void EC_nistp256_pre_comp_free(NISTP256_PRE_COMP *);
+void EC_nistp384_pre_comp_free(NISTP384_PRE_COMP *);
 void EC_nistp521_pre_comp_free(NISTP521_PRE_COMP *);
 void EC_nistz256_pre_comp_free(NISTZ256_PRE_COMP *);
 void EC_ec_pre_comp_free(EC_PRE_COMP *);
@@ -355,6 +365,19 @@ int ossl_ec_wNAF_mul(const EC_GROUP *group, EC_POINT *r, const BIGNUM *scalar,
 int ossl_ec_wNAF_precompute_mult(EC_GROUP *group, BN_CTX *);
 int ossl_ec_wNAF_have_precompute_mult(const EC_GROUP *group);
 
+/* precomputation for a fixed public point in ec_mult.c */
+EC_PUB_PRE_COMP *ossl_ec_pub_pre_comp_new(const EC_GROUP *group,
+                                          const EC_POINT *point, BN_CTX *ctx);
+void ossl_ec_pub_pre_comp_free(EC_PUB_PRE_COMP *pre);
+size_t ossl_ec_pub_pre_comp_size(const EC_PUB_PRE_COMP *pre);
+const EC_POINT *ossl_ec_pub_pre_comp_point(const EC_PUB_PRE_COMP *pre);
+int ossl_ec_wNAF_mul_pub(const EC_GROUP *group, EC_POINT *r,
+                         const BIGNUM *g_scalar, const BIGNUM *p_scalar,
+                         const EC_PUB_PRE_COMP *pre, BN_CTX *ctx);
+void ossl_ec_key_pub_pre_comp_reset(EC_KEY *key);
+int ossl_ec_key_verify_mul(EC_KEY *key, EC_POINT *r, const BIGNUM *u1,
+                           const BIGNUM *u2, BN_CTX *ctx);
+
 /* method functions in ecp_smpl.c */
 int ossl_ec_GFp_simple_group_init(EC_GROUP *);
 void ossl_ec_GFp_simple_group_finish(EC_GROUP *);
@@ -552,6 +575,23 @@ int ossl_ec_GFp_nistp256_points_mul(const EC_GROUP *group, EC_POINT *r,
 int ossl_ec_GFp_nistp256_precompute_mult(EC_GROUP *group, BN_CTX *ctx);
 int ossl_ec_GFp_nistp256_have_precompute_mult(const EC_GROUP *group);
 
+/* method functions in ecp_nistp384.c */
+const EC_METHOD *ossl_ec_GFp_nistp384_method(void);
+int ossl_ec_GFp_nistp384_group_init(EC_GROUP *group);
+int ossl_ec_GFp_nistp384_group_set_curve(EC_GROUP *group, const BIGNUM *p,
+                                         const BIGNUM *a, const BIGNUM *n,
+                                         BN_CTX *);
+int ossl_ec_GFp_nistp384_point_get_affine_coordinates(const EC_GROUP *group,
+                                                      const EC_POINT *point,
+                                                      BIGNUM *x, BIGNUM *y,
+                                                      BN_CTX *ctx);
+int ossl_ec_GFp_nistp384_points_mul(const EC_GROUP *group, EC_POINT *r,
+                                    const BIGNUM *scalar, size_t num,
+                                    const EC_POINT *points[],
+                                    const BIGNUM *scalars[], BN_CTX *ctx);
+int ossl_ec_GFp_nistp384_precompute_mult(EC_GROUP *group, BN_CTX *ctx);
+int ossl_ec_GFp_nistp384_have_precompute_mult(const EC_GROUP *group);
+
 /* method functions in ecp_nistp521.c */
 int ossl_ec_GFp_nistp521_group_init(EC_GROUP *group);
 int ossl_ec_GFp_nistp521_group_set_curve(EC_GROUP *group, const BIGNUM *p,
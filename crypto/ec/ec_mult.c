@@ -400,6 +400,88 @@ int ossl_ec_scalar_mul_ladder(const EC_GROUP *group, EC_POINT *r,
                   (b) >=   20 ? 2 : \
                   1))
 
+/*-
+ * Compute the sum of the |totalnum| wNAF expansions wNAF[i] of length
+ * wNAF_len[i], each digit d of wNAF[i] selecting the multiple
+ * val_sub[i][|d| >> 1] (negated if d < 0), with shared doublings.
+ * All the multiples are expected to be affine.
+ */
+static int ec_wNAF_sum(const EC_GROUP *group, EC_POINT *r, size_t totalnum,
+                       signed char **wNAF, const size_t *wNAF_len,
+                       size_t max_len, EC_POINT ***val_sub, BN_CTX *ctx)
+{
+    size_t i;
+    int k;
+    int r_is_inverted = 0;
+    int r_is_at_infinity = 1;
+
+    for (k = max_len - 1; k >= 0; k--) {
+        if (!r_is_at_infinity) {
+            if (!EC_POINT_dbl(group, r, r, ctx))
+                return 0;
+        }
+
+        for (i = 0; i < totalnum; i++) {
+            if (wNAF_len[i] > (size_t)k) {
+                int digit = wNAF[i][k];
+                int is_neg;
+
+                if (digit) {
+                    is_neg = digit < 0;
+
+                    if (is_neg)
+                        digit = -digit;
+
+                    if (is_neg != r_is_inverted) {
+                        if (!r_is_at_infinity) {
+                            if (!EC_POINT_invert(group, r, ctx))
+                                return 0;
+                        }
+                        r_is_inverted = !r_is_inverted;
+                    }
+
+                    /* digit > 0 */
+
+                    if (r_is_at_infinity) {
+                        if (!EC_POINT_copy(r, val_sub[i][digit >> 1]))
+                            return 0;
+
+                        /*-
+                         * Apply coordinate blinding for EC_POINT.
+                         *
+                         * The underlying EC_METHOD can optionally implement this function:
+                         * ossl_ec_point_blind_coordinates() returns 0 in case of errors or 1 on
+                         * success or if coordinate blinding is not implemented for this
+                         * group.
+                         */
+                        if (!ossl_ec_point_blind_coordinates(group, r, ctx)) {
+                            ERR_raise(ERR_LIB_EC, EC_R_POINT_COORDINATES_BLIND_FAILURE);
+                            return 0;
+                        }
+
+                        r_is_at_infinity = 0;
+                    } else {
+                        if (!EC_POINT_add
+                            (group, r, r, val_sub[i][digit >> 1], ctx))
+                            return 0;
+                    }
+                }
+            }
+        }
+    }
+
+    if (r_is_at_infinity) {
+        if (!EC_POINT_set_to_infinity(group, r))
+            return 0;
+    } else {
+        if (r_is_inverted)
+            if (!EC_POINT_invert(group, r, ctx))
+                return 0;
+    }
+
+    return 1;
+}
+
 /*-
  * Compute
  *      \sum scalars[i]*points[i],
@@ -417,9 +499,6 @@ int ossl_ec_wNAF_mul(const EC_GROUP *group, EC_POINT *r, const BIGNUM *scalar,
     size_t blocksize = 0, numblocks = 0; /* for wNAF splitting */
     size_t pre_points_per_block = 0;
     size_t i, j;
-    int k;
-    int r_is_inverted = 0;
-    int r_is_at_infinity = 1;
     size_t *wsize = NULL;       /* individual window sizes */
     signed char **wNAF = NULL;  /* individual wNAFs */
     size_t *wNAF_len = NULL;
@@ -717,71 +796,9 @@ int ossl_ec_wNAF_mul(const EC_GROUP *group, EC_POINT *r, const BIGNUM *scalar,
         || !group->meth->points_make_affine(group, num_val, val, ctx))
         goto err;
 
-    r_is_at_infinity = 1;
-
-    for (k = max_len - 1; k >= 0; k--) {
-        if (!r_is_at_infinity) {
-            if (!EC_POINT_dbl(group, r, r, ctx))
-                goto err;
-        }
-
-        for (i = 0; i < totalnum; i++) {
-            if (wNAF_len[i] > (size_t)k) {
-                int digit = wNAF[i][k];
-                int is_neg;
-
-                if (digit) {
-                    is_neg = digit < 0;
-
-                    if (is_neg)
-                        digit = -digit;
-
-                    if (is_neg != r_is_inverted) {
-                        if (!r_is_at_infinity) {
-                            if (!EC_POINT_invert(group, r, ctx))
-                                goto err;
-                        }
-                        r_is_inverted = !r_is_inverted;
-                    }
-
-                    /* digit > 0 */
-
-                    if (r_is_at_infinity) {
-                        if (!EC_POINT_copy(r, val_sub[i][digit >> 1]))
-                            goto err;
-
-                        /*-
-                         * Apply coordinate blinding for EC_POINT.
-                         *
-                         * The underlying EC_METHOD can optionally implement this function:
-                         * ossl_ec_point_blind_coordinates() returns 0 in case of errors or 1 on
-                         * success or if coordinate blinding is not implemented for this
-                         * group.
-                         */
-                        if (!ossl_ec_point_blind_coordinates(group, r, ctx)) {
-                            ERR_raise(ERR_LIB_EC, EC_R_POINT_COORDINATES_BLIND_FAILURE);
-                            goto err;
-                        }
-
-                        r_is_at_infinity = 0;
-                    } else {
-                        if (!EC_POINT_add
-                            (group, r, r, val_sub[i][digit >> 1], ctx))
-                            goto err;
-                    }
-                }
-            }
-        }
-    }
-
-    if (r_is_at_infinity) {
-        if (!EC_POINT_set_to_infinity(group, r))
-            goto err;
-    } else {
-        if (r_is_inverted)
-            if (!EC_POINT_invert(group, r, ctx))
-                goto err;
-    }
+    if (!ec_wNAF_sum(group, r, totalnum, wNAF, wNAF_len, max_len, val_sub,
+                     ctx))
+        goto err;
 
     ret = 1;
 
@@ -807,82 +824,20 @@ int ossl_ec_wNAF_mul(const EC_GROUP *group, EC_POINT *r, const BIGNUM *scalar,
     return ret;
 }
 
-/*-
- * ossl_ec_wNAF_precompute_mult()
- * creates an EC_PRE_COMP object with preprecomputed multiples of the generator
- * for use with wNAF splitting as implemented in ossl_ec_wNAF_mul().
- *
- * 'pre_comp->points' is an array of multiples of the generator
- * of the following form:
- * points[0] =     generator;
- * points[1] = 3 * generator;
- * ...
- * points[2^(w-1)-1] =     (2^(w-1)-1) * generator;
- * points[2^(w-1)]   =     2^blocksize * generator;
- * points[2^(w-1)+1] = 3 * 2^blocksize * generator;
- * ...
- * points[2^(w-1)*(numblocks-1)-1] = (2^(w-1)) *  2^(blocksize*(numblocks-2)) * generator
- * points[2^(w-1)*(numblocks-1)]   =              2^(blocksize*(numblocks-1)) * generator
- * ...
- * points[2^(w-1)*numblocks-1]     = (2^(w-1)) *  2^(blocksize*(numblocks-1)) * generator
- * points[2^(w-1)*numblocks]       = NULL
+/*
+ * Fills |pre_comp| with multiples of |point| for wNAF splitting of scalars
+ * of up to |bits| bits in blocks of |blocksize| digits with window size |w|.
+ * See ossl_ec_wNAF_precompute_mult() for the layout of the table.
  */
-int ossl_ec_wNAF_precompute_mult(EC_GROUP *group, BN_CTX *ctx)
+static int ec_wNAF_precompute(EC_PRE_COMP *pre_comp, const EC_POINT *point,
+                              size_t bits, size_t blocksize, size_t w,
+                              BN_CTX *ctx)
 {
-    const EC_POINT *generator;
+    const EC_GROUP *group = pre_comp->group;
     EC_POINT *tmp_point = NULL, *base = NULL, **var;
-    const BIGNUM *order;
-    size_t i, bits, w, pre_points_per_block, blocksize, numblocks, num;
+    size_t i, pre_points_per_block, numblocks, num;
     EC_POINT **points = NULL;
-    EC_PRE_COMP *pre_comp;
     int ret = 0;
-    int used_ctx = 0;
-#ifndef FIPS_MODULE
-    BN_CTX *new_ctx = NULL;
-#endif
-
-    /* if there is an old EC_PRE_COMP object, throw it away */
-    EC_pre_comp_free(group);
-    if ((pre_comp = ec_pre_comp_new(group)) == NULL)
-        return 0;
-
-    generator = EC_GROUP_get0_generator(group);
-    if (generator == NULL) {
-        ERR_raise(ERR_LIB_EC, EC_R_UNDEFINED_GENERATOR);
-        goto err;
-    }
-
-#ifndef FIPS_MODULE
-    if (ctx == NULL)
-        ctx = new_ctx = BN_CTX_new();
-#endif
-    if (ctx == NULL)
-        goto err;
-
-    BN_CTX_start(ctx);
-    used_ctx = 1;
-
-    order = EC_GROUP_get0_order(group);
-    if (order == NULL)
-        goto err;
-    if (BN_is_zero(order)) {
-        ERR_raise(ERR_LIB_EC, EC_R_UNKNOWN_ORDER);
-        goto err;
-    }
-
-    bits = BN_num_bits(order);
-    /*
-     * The following parameters mean we precompute (approximately) one point
-     * per bit. TBD: The combination 8, 4 is perfect for 160 bits; for other
-     * bit lengths, other parameter combinations might provide better
-     * efficiency.
-     */
-    blocksize = 8;
-    w = 4;
-    if (EC_window_bits_for_scalar_size(bits) > w) {
-        /* let's not make the window too small ... */
-        w = EC_window_bits_for_scalar_size(bits);
-    }
 
     numblocks = (bits + blocksize - 1) / blocksize; /* max. number of blocks
                                                      * to use for wNAF
@@ -913,7 +868,7 @@ int ossl_ec_wNAF_precompute_mult(EC_GROUP *group, BN_CTX *ctx)
         goto err;
     }
 
-    if (!EC_POINT_copy(base, generator))
+    if (!EC_POINT_copy(base, point))
         goto err;
 
     /* do the precomputation */
@@ -958,24 +913,15 @@ int ossl_ec_wNAF_precompute_mult(EC_GROUP *group, BN_CTX *ctx)
         || !group->meth->points_make_affine(group, num, points, ctx))
         goto err;
 
-    pre_comp->group = group;
     pre_comp->blocksize = blocksize;
     pre_comp->numblocks = numblocks;
     pre_comp->w = w;
     pre_comp->points = points;
     points = NULL;
     pre_comp->num = num;
-    SETPRECOMP(group, ec, pre_comp);
-    pre_comp = NULL;
     ret = 1;
 
  err:
-    if (used_ctx)
-        BN_CTX_end(ctx);
-#ifndef FIPS_MODULE
-    BN_CTX_free(new_ctx);
-#endif
-    EC_ec_pre_comp_free(pre_comp);
     if (points) {
         EC_POINT **p;
 
@@ -988,7 +934,291 @@ int ossl_ec_wNAF_precompute_mult(EC_GROUP *group, BN_CTX *ctx)
     return ret;
 }
 
+/*-
+ * ossl_ec_wNAF_precompute_mult()
+ * creates an EC_PRE_COMP object with preprecomputed multiples of the generator
+ * for use with wNAF splitting as implemented in ossl_ec_wNAF_mul().
+ *
+ * 'pre_comp->points' is an array of multiples of the generator
+ * of the following form:
+ * points[0] =     generator;
+ * points[1] = 3 * generator;
+ * ...
+ * points[2^(w-1)-1] =     (2^(w-1)-1) * generator;
+ * points[2^(w-1)]   =     2^blocksize * generator;
+ * points[2^(w-1)+1] = 3 * 2^blocksize * generator;
+ * ...
+ * points[2^(w-1)*(numblocks-1)-1] = (2^(w-1)) *  2^(blocksize*(numblocks-2)) * generator
+ * points[2^(w-1)*(numblocks-1)]   =              2^(blocksize*(numblocks-1)) * generator
+ * ...
+ * points[2^(w-1)*numblocks-1]     = (2^(w-1)) *  2^(blocksize*(numblocks-1)) * generator
+ * points[2^(w-1)*numblocks]       = NULL
+ */
+int ossl_ec_wNAF_precompute_mult(EC_GROUP *group, BN_CTX *ctx)
+{
+    const EC_POINT *generator;
+    const BIGNUM *order;
+    size_t bits, w, blocksize;
+    EC_PRE_COMP *pre_comp;
+    int ret = 0;
+    int used_ctx = 0;
+#ifndef FIPS_MODULE
+    BN_CTX *new_ctx = NULL;
+#endif
+
+    /* if there is an old EC_PRE_COMP object, throw it away */
+    EC_pre_comp_free(group);
+    if ((pre_comp = ec_pre_comp_new(group)) == NULL)
+        return 0;
+
+    generator = EC_GROUP_get0_generator(group);
+    if (generator == NULL) {
+        ERR_raise(ERR_LIB_EC, EC_R_UNDEFINED_GENERATOR);
+        goto err;
+    }
+
+#ifndef FIPS_MODULE
+    if (ctx == NULL)
+        ctx = new_ctx = BN_CTX_new();
+#endif
+    if (ctx == NULL)
+        goto err;
+
+    BN_CTX_start(ctx);
+    used_ctx = 1;
+
+    order = EC_GROUP_get0_order(group);
+    if (order == NULL)
+        goto err;
+    if (BN_is_zero(order)) {
+        ERR_raise(ERR_LIB_EC, EC_R_UNKNOWN_ORDER);
+        goto err;
+    }
+
+    bits = BN_num_bits(order);
+    /*
+     * The following parameters mean we precompute (approximately) one point
+     * per bit. TBD: The combination 8, 4 is perfect for 160 bits; for other
+     * bit lengths, other parameter combinations might provide better
+     * efficiency.
+     */
+    blocksize = 8;
+    w = 4;
+    if (EC_window_bits_for_scalar_size(bits) > w) {
+        /* let's not make the window too small ... */
+        w = EC_window_bits_for_scalar_size(bits);
+    }
+
+    if (!ec_wNAF_precompute(pre_comp, generator, bits, blocksize, w, ctx))
+        goto err;
+
+    SETPRECOMP(group, ec, pre_comp);
+    pre_comp = NULL;
+    ret = 1;
+
+ err:
+    if (used_ctx)
+        BN_CTX_end(ctx);
+#ifndef FIPS_MODULE
+    BN_CTX_free(new_ctx);
+#endif
+    EC_ec_pre_comp_free(pre_comp);
+    return ret;
+}
+
 int ossl_ec_wNAF_have_precompute_mult(const EC_GROUP *group)
 {
     return HAVEPRECOMP(group, ec);
 }
+
+/*
+ * Precomputation for verifying with a fixed public key: wNAF splitting
+ * tables for the public point and for the generator, so that computing
+ * u1 * generator + u2 * point needs only a few doublings.  The generator
+ * table of the group is shared if there is one.
+ */
+struct ec_pub_pre_comp_st {
+    EC_POINT *point;            /* the point |pub| was computed for */
+    EC_PRE_COMP *gen;           /* multiples of the generator */
+    EC_PRE_COMP *pub;           /* multiples of |point| */
+    size_t size;                /* bytes held by the tables we own */
+};
+
+/*
+ * Eight blocks of eight odd multiples: 64 points per table and an eighth of
+ * the doublings of a plain wNAF multiplication.
+ */
+#define EC_PUB_PRE_COMP_BLOCKS  8
+#define EC_PUB_PRE_COMP_WINDOW  4
+
+/* Approximate number of bytes allocated for |pre| and its points */
+static size_t ec_pre_comp_size(const EC_PRE_COMP *pre)
+{
+    size_t size = sizeof(*pre) + (pre->num + 1) * sizeof(pre->points[0]);
+    EC_POINT **p;
+
+    for (p = pre->points; *p != NULL; p++)
+        size += sizeof(**p)
+                + (bn_get_dmax((*p)->X) + bn_get_dmax((*p)->Y)
+                   + bn_get_dmax((*p)->Z)) * sizeof(BN_ULONG);
+    return size;
+}
+
+EC_PUB_PRE_COMP *ossl_ec_pub_pre_comp_new(const EC_GROUP *group,
+                                          const EC_POINT *point, BN_CTX *ctx)
+{
+    EC_PUB_PRE_COMP *ret;
+    const EC_POINT *generator;
+    const BIGNUM *order;
+    size_t bits, blocksize;
+
+    if ((generator = EC_GROUP_get0_generator(group)) == NULL) {
+        ERR_raise(ERR_LIB_EC, EC_R_UNDEFINED_GENERATOR);
+        return NULL;
+    }
+    order = EC_GROUP_get0_order(group);
+    if (order == NULL || BN_is_zero(order)) {
+        ERR_raise(ERR_LIB_EC, EC_R_UNKNOWN_ORDER);
+        return NULL;
+    }
+    bits = BN_num_bits(order);
+    blocksize = (bits + EC_PUB_PRE_COMP_BLOCKS - 1) / EC_PUB_PRE_COMP_BLOCKS;
+    if (blocksize <= 2)
+        return NULL;
+
+    if ((ret = OPENSSL_zalloc(sizeof(*ret))) == NULL) {
+        ERR_raise(ERR_LIB_EC, ERR_R_MALLOC_FAILURE);
+        return NULL;
+    }
+    ret->size = sizeof(*ret);
+
+    if ((ret->point = EC_POINT_dup(point, group)) == NULL)
+        goto err;
+
+    if (HAVEPRECOMP(group, ec) && group->pre_comp.ec->numblocks != 0
+        && EC_POINT_cmp(group, generator, group->pre_comp.ec->points[0],
+                        ctx) == 0) {
+        ret->gen = EC_ec_pre_comp_dup(group->pre_comp.ec);
+    } else {
+        if ((ret->gen = ec_pre_comp_new(group)) == NULL
+            || !ec_wNAF_precompute(ret->gen, generator, bits, blocksize,
+                                   EC_PUB_PRE_COMP_WINDOW, ctx))
+            goto err;
+        ret->size += ec_pre_comp_size(ret->gen);
+    }
+
+    if ((ret->pub = ec_pre_comp_new(group)) == NULL
+        || !ec_wNAF_precompute(ret->pub, point, bits, blocksize,
+                               EC_PUB_PRE_COMP_WINDOW, ctx))
+        goto err;
+    ret->size += ec_pre_comp_size(ret->pub);
+    return ret;
+
+ err:
+    ossl_ec_pub_pre_comp_free(ret);
+    return NULL;
+}
+
+void ossl_ec_pub_pre_comp_free(EC_PUB_PRE_COMP *pre)
+{
+    if (pre == NULL)
+        return;
+    EC_POINT_free(pre->point);
+    EC_ec_pre_comp_free(pre->gen);
+    EC_ec_pre_comp_free(pre->pub);
+    OPENSSL_free(pre);
+}
+
+size_t ossl_ec_pub_pre_comp_size(const EC_PUB_PRE_COMP *pre)
+{
+    return pre == NULL ? 0 : pre->size;
+}
+
+const EC_POINT *ossl_ec_pub_pre_comp_point(const EC_PUB_PRE_COMP *pre)
+{
+    return pre->point;
+}
+
+/*
+ * Appends the wNAF of |scalar| split into the blocks of |pre_comp| to the
+ * |*n| entries of |wNAF|, |wNAF_len| and |val_sub|.
+ */
+static int ec_wNAF_split(const BIGNUM *scalar, const EC_PRE_COMP *pre_comp,
+                         signed char **wNAF, size_t *wNAF_len,
+                         EC_POINT ***val_sub, size_t *n, size_t *max_len)
+{
+    size_t pre_points_per_block = (size_t)1 << (pre_comp->w - 1);
+    size_t tmp_len = 0, numblocks, i;
+    signed char *tmp_wNAF, *pp;
+
+    if ((tmp_wNAF = bn_compute_wNAF(scalar, pre_comp->w, &tmp_len)) == NULL)
+        return 0;
+
+    numblocks = (tmp_len + pre_comp->blocksize - 1) / pre_comp->blocksize;
+    if (numblocks > pre_comp->numblocks)
+        numblocks = pre_comp->numblocks;
+
+    for (i = 0, pp = tmp_wNAF; i < numblocks; i++, (*n)++) {
+        /* the last block gets whatever is left */
+        size_t len = i < numblocks - 1 ? pre_comp->blocksize : tmp_len;
+
+        if ((wNAF[*n] = OPENSSL_malloc(len)) == NULL) {
+            ERR_raise(ERR_LIB_EC, ERR_R_MALLOC_FAILURE);
+            OPENSSL_free(tmp_wNAF);
+            return 0;
+        }
+        memcpy(wNAF[*n], pp, len);
+        wNAF_len[*n] = len;
+        val_sub[*n] = pre_comp->points + i * pre_points_per_block;
+        if (len > *max_len)
+            *max_len = len;
+        pp += len;
+        tmp_len -= len;
+    }
+    OPENSSL_free(tmp_wNAF);
+    return 1;
+}
+
+/*-
+ * Compute
+ *      g_scalar * generator + p_scalar * point
+ * for the point |pre| was created for. Both scalars are public.
+ */
+int ossl_ec_wNAF_mul_pub(const EC_GROUP *group, EC_POINT *r,
+                         const BIGNUM *g_scalar, const BIGNUM *p_scalar,
+                         const EC_PUB_PRE_COMP *pre, BN_CTX *ctx)
+{
+    size_t totalnum = pre->gen->numblocks + pre->pub->numblocks;
+    size_t n = 0, max_len = 0;
+    signed char **wNAF, **w;
+    size_t *wNAF_len;
+    EC_POINT ***val_sub;
+    int ret = 0;
+
+    /* include space for pivot */
+    wNAF = OPENSSL_zalloc((totalnum + 1) * sizeof(wNAF[0]));
+    wNAF_len = OPENSSL_malloc(totalnum * sizeof(wNAF_len[0]));
+    val_sub = OPENSSL_malloc(totalnum * sizeof(val_sub[0]));
+    if (wNAF == NULL || wNAF_len == NULL || val_sub == NULL) {
+        ERR_raise(ERR_LIB_EC, ERR_R_MALLOC_FAILURE);
+        goto err;
+    }
+
+    if (!ec_wNAF_split(g_scalar, pre->gen, wNAF, wNAF_len, val_sub, &n,
+                       &max_len)
+        || !ec_wNAF_split(p_scalar, pre->pub, wNAF, wNAF_len, val_sub, &n,
+                          &max_len))
+        goto err;
+
+    ret = ec_wNAF_sum(group, r, n, wNAF, wNAF_len, max_len, val_sub, ctx);
+
+ err:
+    if (wNAF != NULL) {
+        for (w = wNAF; *w != NULL; w++)
+            OPENSSL_free(*w);
+        OPENSSL_free(wNAF);
+    }
+    OPENSSL_free(wNAF_len);
+    OPENSSL_free(val_sub);
+    return ret;
+}
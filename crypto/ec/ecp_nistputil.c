@@ -32,7 +32,8 @@
 #include <openssl/opensslconf.h>
 
 /*
- * Common utility functions for ecp_nistp224.c, ecp_nistp256.c, ecp_nistp521.c.
+ * Common utility functions for ecp_nistp224.c, ecp_nistp256.c,
+ * ecp_nistp384.c and ecp_nistp521.c.
  */
 
 #include <stddef.h>
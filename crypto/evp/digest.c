@@ -631,6 +631,100 @@ int EVP_Digest(const void *data, size_t count,
     return ret;
 }
 
+/* |outlen| is 0 for a fixed size digest */
+static int digest_batch(const void *const data[], const size_t counts[],
+                        size_t num, unsigned char *const mds[], size_t outlen,
+                        const EVP_MD *type)
+{
+    EVP_MD *fetched = NULL;
+    EVP_MD_CTX *ctx;
+    size_t i;
+    int ret = 0;
+
+    if (num == 0)
+        return 1;
+    if (data == NULL || counts == NULL || mds == NULL || type == NULL) {
+        ERR_raise(ERR_LIB_EVP, ERR_R_PASSED_NULL_PARAMETER);
+        return 0;
+    }
+    if (outlen != 0 && (EVP_MD_get_flags(type) & EVP_MD_FLAG_XOF) == 0) {
+        ERR_raise(ERR_LIB_EVP, EVP_R_NOT_XOF_OR_INVALID_LENGTH);
+        return 0;
+    }
+
+#ifndef FIPS_MODULE
+    /*
+     * Like evp_md_init_internal(), use an implicitly fetched implementation
+     * for legacy digests unless an ENGINE provides them.
+     */
+    if (type->prov == NULL) {
+# ifndef OPENSSL_NO_ENGINE
+        ENGINE *e = ENGINE_get_digest_engine(type->type);
+
+        if (e != NULL)
+            ENGINE_finish(e);
+        else
+# endif
+        {
+            ERR_set_mark();
+            fetched = EVP_MD_fetch(NULL, OBJ_nid2sn(type->type), "");
+            ERR_pop_to_mark();
+            if (fetched != NULL)
+                type = fetched;
+        }
+    }
+#endif
+
+    if (type->prov != NULL && type->digest_batch != NULL) {
+        if (outlen == 0)
+            outlen = (size_t)EVP_MD_get_size(type);
+        ret = type->digest_batch(ossl_provider_ctx(type->prov),
+                                 (const unsigned char *const *)data, counts,
+                                 num, mds, outlen);
+        goto end;
+    }
+
+    /* No batch support, hash the messages one at a time */
+    if ((ctx = EVP_MD_CTX_new()) == NULL)
+        goto end;
+    EVP_MD_CTX_set_flags(ctx, EVP_MD_CTX_FLAG_ONESHOT);
+    for (i = 0; i < num; i++)
+        if (!EVP_DigestInit_ex(ctx, type, NULL)
+                || !EVP_DigestUpdate(ctx, data[i], counts[i])
+                || !(outlen != 0 ? EVP_DigestFinalXOF(ctx, mds[i], outlen)
+                                 : EVP_DigestFinal_ex(ctx, mds[i], NULL)))
+            break;
+    ret = i == num;
+    EVP_MD_CTX_free(ctx);
+ end:
+    EVP_MD_free(fetched);
+    return ret;
+}
+
+int EVP_Digest_batch(const void *const data[], const size_t counts[],
+                     size_t num, unsigned char *const mds[],
+                     const EVP_MD *type)
+{
+    return digest_batch(data, counts, num, mds, 0, type);
+}
+
+int EVP_DigestXOF_batch(const void *const data[], const size_t counts[],
+                        size_t num, unsigned char *const mds[], size_t outlen,
+                        const EVP_MD *type)
+{
+    if (type == NULL) {
+        ERR_raise(ERR_LIB_EVP, ERR_R_PASSED_NULL_PARAMETER);
+        return 0;
+    }
+    if ((EVP_MD_get_flags(type) & EVP_MD_FLAG_XOF) == 0) {
+        ERR_raise(ERR_LIB_EVP, EVP_R_NOT_XOF_OR_INVALID_LENGTH);
+        return 0;
+    }
+    if (outlen == 0)
+        return 1;
+    return digest_batch(data, counts, num, mds, outlen, type);
+}
+
 int EVP_Q_digest(OSSL_LIB_CTX *libctx, const char *name, const char *propq,
                  const void *data, size_t datalen,
                  unsigned char *md, size_t *mdlen)
@@ -963,6 +1057,11 @@ static void *evp_md_from_algorithm(int name_id,
                 md->digest = OSSL_FUNC_digest_digest(fns);
             /* We don't increment fnct for this as it is stand alone */
             break;
+        case OSSL_FUNC_DIGEST_DIGEST_BATCH:
+            if (md->digest_batch == NULL)
+                md->digest_batch = OSSL_FUNC_digest_digest_batch(fns);
+            /* We don't increment fnct for this as it is stand alone */
+            break;
         case OSSL_FUNC_DIGEST_FREECTX:
             if (md->freectx == NULL) {
                 md->freectx = OSSL_FUNC_digest_freectx(fns);
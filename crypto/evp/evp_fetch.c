@@ -18,6 +18,8 @@
 #include "internal/provider.h"
 #include "internal/namemap.h"
 #include "internal/property.h"
+#include "internal/tsan_assist.h"
+#include "crypto/cryptlib.h"
 #include "crypto/evp.h"    /* evp_local.h needs it */
 #include "evp_local.h"
 
@@ -83,6 +85,278 @@ static OSSL_METHOD_STORE *get_evp_method_store(OSSL_LIB_CTX *libctx)
                                  &evp_method_store_method);
 }
 
+#ifndef FIPS_MODULE
+/*
+ * Optional per thread cache of fetched methods
+ *
+ * When enabled with EVP_thread_fetch_cache_enable(), every thread keeps a
+ * small direct mapped table of the methods it fetched, keyed on the operation,
+ * the name (or name id) and the property query exactly as passed by the
+ * caller.  A hit hands back the cached method after taking a reference, and
+ * thereby skips the namemap lookup, the property query handling and all the
+ * method store locks.
+ *
+ * Every cache flush of the EVP method store (provider activation or
+ * deactivation, changes to the default properties) increments a generation
+ * counter, and a thread discards its cached methods as soon as it notices
+ * that the generation has moved on.
+ *
+ * We need acquire / release semantics on the generation counter, so the
+ * cache is simply never enabled on platforms where we can't have that.
+ */
+# define EVP_FETCH_CACHE_SIZE     64     /* Must be a power of two */
+
+typedef struct {
+    int operation_id;
+    int name_id;
+    char *name;
+    char *propq;
+    void *method;
+    void (*free_method)(void *);
+} EVP_FETCH_CACHE_ENTRY;
+
+typedef struct {
+    int generation;
+    EVP_FETCH_CACHE_ENTRY entries[EVP_FETCH_CACHE_SIZE];
+} EVP_THREAD_FETCH_CACHE;
+
+typedef struct {
+    CRYPTO_RWLOCK *lock;
+    CRYPTO_THREAD_LOCAL thread_cache;
+    TSAN_QUALIFIER int enabled;
+    TSAN_QUALIFIER int generation;
+} EVP_FETCH_CACHE_GLOBAL;
+
+/*
+ * The number of library contexts that have the cache enabled.  As long as it
+ * is zero, fetches don't look for the cache of their library context at all.
+ */
+static TSAN_QUALIFIER int evp_fetch_caches_enabled;
+
+static void *evp_fetch_cache_global_new(OSSL_LIB_CTX *ctx)
+{
+    EVP_FETCH_CACHE_GLOBAL *global = OPENSSL_zalloc(sizeof(*global));
+
+    if (global == NULL)
+        return NULL;
+    if ((global->lock = CRYPTO_THREAD_lock_new()) == NULL
+            || !CRYPTO_THREAD_init_local(&global->thread_cache, NULL)) {
+        CRYPTO_THREAD_lock_free(global->lock);
+        OPENSSL_free(global);
+        return NULL;
+    }
+    return global;
+}
+
+static void evp_fetch_cache_global_free(void *vglobal)
+{
+    EVP_FETCH_CACHE_GLOBAL *global = vglobal;
+
+    if (global != NULL) {
+        if (tsan_load(&global->enabled))
+            tsan_decr(&evp_fetch_caches_enabled);
+        CRYPTO_THREAD_cleanup_local(&global->thread_cache);
+        CRYPTO_THREAD_lock_free(global->lock);
+        OPENSSL_free(global);
+    }
+}
+
+static const OSSL_LIB_CTX_METHOD evp_fetch_cache_global_method = {
+    OSSL_LIB_CTX_METHOD_DEFAULT_PRIORITY,
+    evp_fetch_cache_global_new,
+    evp_fetch_cache_global_free,
+};
+
+static EVP_FETCH_CACHE_GLOBAL *get_evp_fetch_cache_global(OSSL_LIB_CTX *libctx)
+{
+    return ossl_lib_ctx_get_data(libctx, OSSL_LIB_CTX_EVP_FETCH_CACHE_INDEX,
+                                 &evp_fetch_cache_global_method);
+}
+
+static void evp_fetch_cache_entry_clear(EVP_FETCH_CACHE_ENTRY *entry)
+{
+    if (entry->method != NULL)
+        entry->free_method(entry->method);
+    OPENSSL_free(entry->name);
+    OPENSSL_free(entry->propq);
+    memset(entry, 0, sizeof(*entry));
+}
+
+static void evp_thread_fetch_cache_flush(EVP_THREAD_FETCH_CACHE *cache)
+{
+    size_t i;
+
+    for (i = 0; i < OSSL_NELEM(cache->entries); i++)
+        evp_fetch_cache_entry_clear(&cache->entries[i]);
+}
+
+static void evp_fetch_cache_thread_stop(void *arg)
+{
+    OSSL_LIB_CTX *ctx = arg;
+    EVP_FETCH_CACHE_GLOBAL *global = get_evp_fetch_cache_global(ctx);
+    EVP_THREAD_FETCH_CACHE *cache;
+
+    if (global == NULL)
+        return;
+
+    cache = CRYPTO_THREAD_get_local(&global->thread_cache);
+    CRYPTO_THREAD_set_local(&global->thread_cache, NULL);
+    if (cache != NULL) {
+        evp_thread_fetch_cache_flush(cache);
+        OPENSSL_free(cache);
+    }
+}
+
+/*
+ * Invalidate the caches of all threads.  The calling thread releases its
+ * cached methods right away, all others do it on their next fetch from
+ * |libctx|, or when they stop.
+ */
+static void evp_fetch_cache_new_generation(OSSL_LIB_CTX *libctx)
+{
+    EVP_FETCH_CACHE_GLOBAL *global = get_evp_fetch_cache_global(libctx);
+    EVP_THREAD_FETCH_CACHE *cache;
+
+    if (global == NULL)
+        return;
+    tsan_counter(&global->generation);
+    if ((cache = CRYPTO_THREAD_get_local(&global->thread_cache)) != NULL)
+        evp_thread_fetch_cache_flush(cache);
+}
+
+/*
+ * Get the fetch cache of the calling thread for |libctx|, creating it if
+ * |create| is set.  Returns NULL if the cache isn't enabled.
+ */
+static EVP_THREAD_FETCH_CACHE *get_evp_thread_fetch_cache(OSSL_LIB_CTX *libctx,
+                                                          int create)
+{
+# ifdef tsan_ld_acq
+    EVP_FETCH_CACHE_GLOBAL *global;
+    EVP_THREAD_FETCH_CACHE *cache;
+    int generation;
+
+    if (tsan_load(&evp_fetch_caches_enabled) == 0)
+        return NULL;
+    global = get_evp_fetch_cache_global(libctx);
+    if (global == NULL || !tsan_load(&global->enabled))
+        return NULL;
+
+    generation = tsan_ld_acq(&global->generation);
+    cache = CRYPTO_THREAD_get_local(&global->thread_cache);
+    if (cache == NULL) {
+        if (!create)
+            return NULL;
+        if ((cache = OPENSSL_zalloc(sizeof(*cache))) == NULL)
+            return NULL;
+        libctx = ossl_lib_ctx_get_concrete(libctx);
+        if (!ossl_init_thread_start(NULL, libctx,
+                                    evp_fetch_cache_thread_stop)
+                || !CRYPTO_THREAD_set_local(&global->thread_cache, cache)) {
+            OPENSSL_free(cache);
+            return NULL;
+        }
+        cache->generation = generation;
+    } else if (cache->generation != generation) {
+        evp_thread_fetch_cache_flush(cache);
+        cache->generation = generation;
+    }
+    return cache;
+# else
+    return NULL;
+# endif
+}
+
+static EVP_FETCH_CACHE_ENTRY *
+evp_thread_fetch_cache_slot(EVP_THREAD_FETCH_CACHE *cache, int operation_id,
+                            int name_id, const char *name, const char *propq)
+{
+    unsigned long h = (unsigned long)operation_id * 31;
+
+    h += name != NULL ? OPENSSL_LH_strhash(name) : (unsigned long)name_id;
+    if (propq != NULL)
+        h ^= OPENSSL_LH_strhash(propq) << 1;
+    return &cache->entries[h & (EVP_FETCH_CACHE_SIZE - 1)];
+}
+
+static void *evp_thread_fetch_cache_get(OSSL_LIB_CTX *libctx, int operation_id,
+                                        int name_id, const char *name,
+                                        const char *propq,
+                                        int (*up_ref_method)(void *))
+{
+    EVP_THREAD_FETCH_CACHE *cache = get_evp_thread_fetch_cache(libctx, 0);
+    EVP_FETCH_CACHE_ENTRY *e;
+
+    if (cache == NULL)
+        return NULL;
+
+    e = evp_thread_fetch_cache_slot(cache, operation_id, name_id, name, propq);
+    if (e->method == NULL
+            || e->operation_id != operation_id
+            || (name != NULL ? e->name == NULL || strcmp(e->name, name) != 0
+                             : e->name != NULL || e->name_id != name_id)
+            || (propq != NULL ? e->propq == NULL || strcmp(e->propq, propq) != 0
+                              : e->propq != NULL)
+            || !up_ref_method(e->method))
+        return NULL;
+    return e->method;
+}
+
+static void evp_thread_fetch_cache_set(OSSL_LIB_CTX *libctx, int operation_id,
+                                       int name_id, const char *name,
+                                       const char *propq, void *method,
+                                       int (*up_ref_method)(void *),
+                                       void (*free_method)(void *))
+{
+    EVP_THREAD_FETCH_CACHE *cache = get_evp_thread_fetch_cache(libctx, 1);
+    EVP_FETCH_CACHE_ENTRY *e;
+
+    if (cache == NULL)
+        return;
+
+    e = evp_thread_fetch_cache_slot(cache, operation_id, name_id, name, propq);
+    evp_fetch_cache_entry_clear(e);
+    if ((name != NULL && (e->name = OPENSSL_strdup(name)) == NULL)
+            || (propq != NULL && (e->propq = OPENSSL_strdup(propq)) == NULL)
+            || !up_ref_method(method)) {
+        evp_fetch_cache_entry_clear(e);
+        return;
+    }
+    e->operation_id = operation_id;
+    e->name_id = name_id;
+    e->method = method;
+    e->free_method = free_method;
+}
+
+int EVP_thread_fetch_cache_enable(OSSL_LIB_CTX *libctx, int enable)
+{
+    EVP_FETCH_CACHE_GLOBAL *global = get_evp_fetch_cache_global(libctx);
+
+    if (global == NULL || !CRYPTO_THREAD_write_lock(global->lock))
+        return 0;
+    enable = enable != 0;
+    if (enable != tsan_load(&global->enabled)) {
+        if (enable)
+            tsan_counter(&evp_fetch_caches_enabled);
+        else
+            tsan_decr(&evp_fetch_caches_enabled);
+        tsan_store(&global->enabled, enable);
+    }
+    CRYPTO_THREAD_unlock(global->lock);
+    /* Make sure that no thread keeps using what it cached earlier */
+    if (!enable)
+        evp_fetch_cache_new_generation(libctx);
+    return 1;
+}
+
+int EVP_thread_fetch_cache_is_enabled(OSSL_LIB_CTX *libctx)
+{
+    EVP_FETCH_CACHE_GLOBAL *global = get_evp_fetch_cache_global(libctx);
+
+    return global != NULL && tsan_load(&global->enabled);
+}
+#endif /* FIPS_MODULE */
+
 /*
  * To identify the method in the EVP method store, we mix the name identity
  * with the operation identity, under the assumption that we don't have more
@@ -364,12 +638,23 @@ void *evp_generic_fetch(OSSL_LIB_CTX *libctx, int operation_id,
     struct evp_method_data_st methdata;
     void *method;
 
+#ifndef FIPS_MODULE
+    if ((method = evp_thread_fetch_cache_get(libctx, operation_id, 0, name,
+                                             properties,
+                                             up_ref_method)) != NULL)
+        return method;
+#endif
     methdata.libctx = libctx;
     methdata.tmp_store = NULL;
     method = inner_evp_generic_fetch(&methdata,
                                      operation_id, 0, name, properties,
                                      new_method, up_ref_method, free_method);
     dealloc_tmp_evp_method_store(methdata.tmp_store);
+#ifndef FIPS_MODULE
+    if (method != NULL && name != NULL)
+        evp_thread_fetch_cache_set(libctx, operation_id, 0, name, properties,
+                                   method, up_ref_method, free_method);
+#endif
     return method;
 }
 
@@ -391,12 +676,24 @@ void *evp_generic_fetch_by_number(OSSL_LIB_CTX *libctx, int operation_id,
     struct evp_method_data_st methdata;
     void *method;
 
+#ifndef FIPS_MODULE
+    if ((method = evp_thread_fetch_cache_get(libctx, operation_id, name_id,
+                                             NULL, properties,
+                                             up_ref_method)) != NULL)
+        return method;
+#endif
     methdata.libctx = libctx;
     methdata.tmp_store = NULL;
     method = inner_evp_generic_fetch(&methdata,
                                      operation_id, name_id, NULL, properties,
                                      new_method, up_ref_method, free_method);
     dealloc_tmp_evp_method_store(methdata.tmp_store);
+#ifndef FIPS_MODULE
+    if (method != NULL && name_id != 0)
+        evp_thread_fetch_cache_set(libctx, operation_id, name_id, NULL,
+                                   properties, method, up_ref_method,
+                                   free_method);
+#endif
     return method;
 }
 
@@ -404,6 +701,9 @@ int evp_method_store_flush(OSSL_LIB_CTX *libctx)
 {
     OSSL_METHOD_STORE *store = get_evp_method_store(libctx);
 
+#ifndef FIPS_MODULE
+    evp_fetch_cache_new_generation(libctx);
+#endif
     if (store != NULL)
         return ossl_method_store_flush_cache(store, 1);
     return 1;
@@ -448,9 +748,13 @@ static int evp_set_parsed_default_properties(OSSL_LIB_CTX *libctx,
         }
         ossl_provider_default_props_update(libctx, propstr);
         OPENSSL_free(propstr);
-#endif
         ossl_property_free(*plp);
         *plp = def_prop;
+        evp_fetch_cache_new_generation(libctx);
+#else
+        ossl_property_free(*plp);
+        *plp = def_prop;
+#endif
         if (store != NULL)
             return ossl_method_store_flush_cache(store, 0);
     }
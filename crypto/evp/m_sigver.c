@@ -590,4 +590,107 @@ int EVP_DigestVerify(EVP_MD_CTX *ctx, const unsigned char *sigret,
         return -1;
     return EVP_DigestVerifyFinal(ctx, sigret, siglen);
 }
+
+/*
+ * Hand all signatures to the provider at once if it can verify them as a
+ * batch, which requires that all keys can be exported to the keymgmt of the
+ * first one.  Returns 1 if that succeeded, 0 if the caller should verify the
+ * signatures one by one and -1 on error.
+ */
+static int digest_verify_batch_prov(EVP_MD_CTX *mctx,
+                                    EVP_PKEY *const pkeys[],
+                                    const unsigned char *const sigs[],
+                                    const size_t siglens[],
+                                    const unsigned char *const tbs[],
+                                    const size_t tbslens[], size_t num,
+                                    int results[])
+{
+    EVP_PKEY_CTX *pctx = mctx->pctx;
+    EVP_SIGNATURE *signature;
+    EVP_KEYMGMT *keymgmt;
+    void **keydata;
+    size_t i;
+    int ret = 0;
+
+    if (pctx == NULL
+            || pctx->operation != EVP_PKEY_OP_VERIFYCTX
+            || pctx->op.sig.algctx == NULL
+            || (signature = pctx->op.sig.signature) == NULL
+            || signature->digest_verify_batch == NULL
+            || pctx->keymgmt == NULL)
+        return 0;
+
+    if ((keydata = OPENSSL_malloc(num * sizeof(*keydata))) == NULL) {
+        ERR_raise(ERR_LIB_EVP, ERR_R_MALLOC_FAILURE);
+        return -1;
+    }
+    ERR_set_mark();
+    for (i = 0; i < num; i++) {
+        keymgmt = pctx->keymgmt;
+        keydata[i] = evp_pkey_export_to_provider(pkeys[i], pctx->libctx,
+                                                 &keymgmt, pctx->propquery);
+        if (keydata[i] == NULL || keymgmt != pctx->keymgmt)
+            break;
+    }
+    ERR_pop_to_mark();
+    if (i == num)
+        ret = signature->digest_verify_batch(pctx->op.sig.algctx, keydata,
+                                             sigs, siglens, tbs, tbslens,
+                                             num, results) ? 1 : -1;
+    OPENSSL_free(keydata);
+    return ret;
+}
+
+int EVP_DigestVerify_batch(EVP_PKEY *const pkeys[],
+                           const unsigned char *const sigs[],
+                           const size_t siglens[],
+                           const unsigned char *const tbs[],
+                           const size_t tbslens[], size_t num, int results[],
+                           OSSL_LIB_CTX *libctx, const char *propq)
+{
+    EVP_MD_CTX *mctx;
+    size_t i;
+    int ret = -1, r;
+
+    if (num == 0)
+        return 1;
+    if (pkeys == NULL || sigs == NULL || siglens == NULL || tbs == NULL
+            || tbslens == NULL || results == NULL) {
+        ERR_raise(ERR_LIB_EVP, ERR_R_PASSED_NULL_PARAMETER);
+        return -1;
+    }
+    if ((mctx = EVP_MD_CTX_new()) == NULL) {
+        ERR_raise(ERR_LIB_EVP, ERR_R_MALLOC_FAILURE);
+        return -1;
+    }
+
+    if (EVP_DigestVerifyInit_ex(mctx, NULL, NULL, libctx, propq, pkeys[0],
+                                NULL) <= 0)
+        goto end;
+    r = digest_verify_batch_prov(mctx, pkeys, sigs, siglens, tbs, tbslens,
+                                 num, results);
+    if (r < 0)
+        goto end;
+
+    if (r == 0) {
+        for (i = 0; i < num; i++) {
+            ERR_set_mark();
+            r = EVP_MD_CTX_reset(mctx)
+                && EVP_DigestVerifyInit_ex(mctx, NULL, NULL, libctx, propq,
+                                           pkeys[i], NULL) > 0
+                && EVP_DigestVerify(mctx, sigs[i], siglens[i],
+                                    tbs[i], tbslens[i]) == 1;
+            ERR_pop_to_mark();
+            results[i] = r;
+        }
+    }
+
+    ret = 1;
+    for (i = 0; i < num; i++)
+        if (results[i] != 1)
+            ret = 0;
+ end:
+    EVP_MD_CTX_free(mctx);
+    return ret;
+}
 #endif /* FIPS_MODULE */
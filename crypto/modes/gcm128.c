@@ -218,19 +218,27 @@ static void gcm_gmult_8bit(u64 Xi[2], const u128 Htable[256])
 
 #elif   TABLE_BITS==4
 
+/* x86_64 without PCLMULQDQ uses gcm_ghash_ct instead of the 4-bit tables */
+# if    (defined(GHASH_ASM) || defined(OPENSSL_CPUID_OBJ)) && \
+        (defined(__x86_64) || defined(__x86_64__) || \
+         defined(_M_AMD64) || defined(_M_X64))
+#  define GHASH_CT_X86_64
+# endif
+
+# ifndef GHASH_CT_X86_64
 static void gcm_init_4bit(u128 Htable[16], u64 H[2])
 {
     u128 V;
-# if defined(OPENSSL_SMALL_FOOTPRINT)
+#  if defined(OPENSSL_SMALL_FOOTPRINT)
     int i;
-# endif
+#  endif
 
     Htable[0].hi = 0;
     Htable[0].lo = 0;
     V.hi = H[0];
     V.lo = H[1];
 
-# if defined(OPENSSL_SMALL_FOOTPRINT)
+#  if defined(OPENSSL_SMALL_FOOTPRINT)
     for (Htable[8] = V, i = 4; i > 0; i >>= 1) {
         REDUCE1BIT(V);
         Htable[i] = V;
@@ -244,7 +252,7 @@ static void gcm_init_4bit(u128 Htable[16], u64 H[2])
             Hi[j].lo = V.lo ^ Htable[j].lo;
         }
     }
-# else
+#  else
     Htable[8] = V;
     REDUCE1BIT(V);
     Htable[4] = V;
@@ -265,8 +273,8 @@ static void gcm_init_4bit(u128 Htable[16], u64 H[2])
     Htable[13].hi = V.hi ^ Htable[5].hi, Htable[13].lo = V.lo ^ Htable[5].lo;
     Htable[14].hi = V.hi ^ Htable[6].hi, Htable[14].lo = V.lo ^ Htable[6].lo;
     Htable[15].hi = V.hi ^ Htable[7].hi, Htable[15].lo = V.lo ^ Htable[7].lo;
-# endif
-# if defined(GHASH_ASM) && (defined(__arm__) || defined(__arm))
+#  endif
+#  if defined(GHASH_ASM) && (defined(__arm__) || defined(__arm))
     /*
      * ARM assembler expects specific dword order in Htable.
      */
@@ -286,8 +294,9 @@ static void gcm_init_4bit(u128 Htable[16], u64 H[2])
                 Htable[j].lo = V.hi << 32 | V.hi >> 32;
             }
     }
-# endif
+#  endif
 }
+# endif
 
 # ifndef GHASH_ASM
 static const size_t rem_4bit[16] = {
@@ -692,6 +701,146 @@ void gcm_ghash_p8(u64 Xi[2], const u128 Htable[16], const u8 *inp,
 # endif
 #endif
 
+#ifdef GHASH_CT_X86_64
+/*
+ * Constant-time GHASH for x86_64 processors without PCLMULQDQ. The 4-bit
+ * table code indexes Htable with nibbles of the hash value, which leaves
+ * a cache-timing trace of the secret H. Here carry-less multiplication is
+ * instead emulated with ordinary integer multiplication of operands that
+ * are split into four interleaved sets of bits, the "holes" between the
+ * bits absorb the carries. Only the low 64 bits of each product are exact,
+ * so the high halves are obtained by multiplying bit-reversed operands.
+ * The approach is the one of Thomas Pornin's BearSSL "ctmul64".
+ */
+static u64 gcm_bmul64(u64 x, u64 y)
+{
+    u64 x0, x1, x2, x3, y0, y1, y2, y3, z0, z1, z2, z3;
+
+    x0 = x & U64(0x1111111111111111);
+    x1 = x & U64(0x2222222222222222);
+    x2 = x & U64(0x4444444444444444);
+    x3 = x & U64(0x8888888888888888);
+    y0 = y & U64(0x1111111111111111);
+    y1 = y & U64(0x2222222222222222);
+    y2 = y & U64(0x4444444444444444);
+    y3 = y & U64(0x8888888888888888);
+    z0 = (x0 * y0) ^ (x1 * y3) ^ (x2 * y2) ^ (x3 * y1);
+    z1 = (x0 * y1) ^ (x1 * y0) ^ (x2 * y3) ^ (x3 * y2);
+    z2 = (x0 * y2) ^ (x1 * y1) ^ (x2 * y0) ^ (x3 * y3);
+    z3 = (x0 * y3) ^ (x1 * y2) ^ (x2 * y1) ^ (x3 * y0);
+    z0 &= U64(0x1111111111111111);
+    z1 &= U64(0x2222222222222222);
+    z2 &= U64(0x4444444444444444);
+    z3 &= U64(0x8888888888888888);
+    return z0 | z1 | z2 | z3;
+}
+
+static u64 gcm_rev64(u64 x)
+{
+    x = ((x & U64(0x5555555555555555)) << 1)
+        | ((x >> 1) & U64(0x5555555555555555));
+    x = ((x & U64(0x3333333333333333)) << 2)
+        | ((x >> 2) & U64(0x3333333333333333));
+    x = ((x & U64(0x0f0f0f0f0f0f0f0f)) << 4)
+        | ((x >> 4) & U64(0x0f0f0f0f0f0f0f0f));
+    x = ((x & U64(0x00ff00ff00ff00ff)) << 8)
+        | ((x >> 8) & U64(0x00ff00ff00ff00ff));
+    x = ((x & U64(0x0000ffff0000ffff)) << 16)
+        | ((x >> 16) & U64(0x0000ffff0000ffff));
+    return (x << 32) | (x >> 32);
+}
+
+/*
+ * Htable[0] holds H, Htable[1] its bit-reversed halves and Htable[2] the
+ * Karatsuba middle terms, both plain and reversed.
+ */
+static void gcm_init_ct(u128 Htable[16], const u64 H[2])
+{
+    Htable[0].hi = H[0];
+    Htable[0].lo = H[1];
+    Htable[1].hi = gcm_rev64(H[0]);
+    Htable[1].lo = gcm_rev64(H[1]);
+    Htable[2].hi = H[0] ^ H[1];
+    Htable[2].lo = Htable[1].hi ^ Htable[1].lo;
+}
+
+/* Multiply {y1,y0} by H in GF(2^128), in place */
+static void gcm_mul_ct(u64 *py1, u64 *py0, const u128 Htable[16])
+{
+    u64 y0 = *py0, y1 = *py1, y0r, y1r, y2, y2r;
+    u64 z0, z1, z2, z0h, z1h, z2h, v0, v1, v2, v3;
+
+    y0r = gcm_rev64(y0);
+    y1r = gcm_rev64(y1);
+    y2 = y0 ^ y1;
+    y2r = y0r ^ y1r;
+
+    z0 = gcm_bmul64(y0, Htable[0].lo);
+    z1 = gcm_bmul64(y1, Htable[0].hi);
+    z2 = gcm_bmul64(y2, Htable[2].hi);
+    z0h = gcm_bmul64(y0r, Htable[1].lo);
+    z1h = gcm_bmul64(y1r, Htable[1].hi);
+    z2h = gcm_bmul64(y2r, Htable[2].lo);
+    z2 ^= z0 ^ z1;
+    z2h ^= z0h ^ z1h;
+    z0h = gcm_rev64(z0h) >> 1;
+    z1h = gcm_rev64(z1h) >> 1;
+    z2h = gcm_rev64(z2h) >> 1;
+
+    v0 = z0;
+    v1 = z0h ^ z2;
+    v2 = z1 ^ z2h;
+    v3 = z1h;
+
+    /* the product is bit-reflected, shift it by one and reduce */
+    v3 = (v3 << 1) | (v2 >> 63);
+    v2 = (v2 << 1) | (v1 >> 63);
+    v1 = (v1 << 1) | (v0 >> 63);
+    v0 = (v0 << 1);
+
+    v2 ^= v0 ^ (v0 >> 1) ^ (v0 >> 2) ^ (v0 >> 7);
+    v1 ^= (v0 << 63) ^ (v0 << 62) ^ (v0 << 57);
+    v3 ^= v1 ^ (v1 >> 1) ^ (v1 >> 2) ^ (v1 >> 7);
+    v2 ^= (v1 << 63) ^ (v1 << 62) ^ (v1 << 57);
+
+    *py0 = v2;
+    *py1 = v3;
+}
+
+static void gcm_gmult_ct(u64 Xi[2], const u128 Htable[16])
+{
+    u8 *p = (u8 *)Xi;
+    u64 y1, y0;
+
+    y1 = (u64)GETU32(p) << 32 | GETU32(p + 4);
+    y0 = (u64)GETU32(p + 8) << 32 | GETU32(p + 12);
+    gcm_mul_ct(&y1, &y0, Htable);
+    PUTU32(p, (u32)(y1 >> 32));
+    PUTU32(p + 4, (u32)y1);
+    PUTU32(p + 8, (u32)(y0 >> 32));
+    PUTU32(p + 12, (u32)y0);
+}
+
+static void gcm_ghash_ct(u64 Xi[2], const u128 Htable[16], const u8 *inp,
+                         size_t len)
+{
+    u8 *p = (u8 *)Xi;
+    u64 y1, y0;
+
+    y1 = (u64)GETU32(p) << 32 | GETU32(p + 4);
+    y0 = (u64)GETU32(p + 8) << 32 | GETU32(p + 12);
+    for (; len >= 16; inp += 16, len -= 16) {
+        y1 ^= (u64)GETU32(inp) << 32 | GETU32(inp + 4);
+        y0 ^= (u64)GETU32(inp + 8) << 32 | GETU32(inp + 12);
+        gcm_mul_ct(&y1, &y0, Htable);
+    }
+    PUTU32(p, (u32)(y1 >> 32));
+    PUTU32(p + 4, (u32)y1);
+    PUTU32(p + 8, (u32)(y0 >> 32));
+    PUTU32(p + 12, (u32)y0);
+}
+#endif
+
 #ifdef GCM_FUNCREF_4BIT
 # undef  GCM_MUL
 # define GCM_MUL(ctx)           (*gcm_gmult_p)(ctx->Xi.u,ctx->Htable)
@@ -748,8 +897,8 @@ void CRYPTO_gcm128_init(GCM128_CONTEXT *ctx, void *key, block128_f block)
         return;
     }
 #  endif
-    gcm_init_4bit(ctx->Htable, ctx->H.u);
 #  if   defined(GHASH_ASM_X86)  /* x86 only */
+    gcm_init_4bit(ctx->Htable, ctx->H.u);
 #   if  defined(OPENSSL_IA32_SSE2)
     if (OPENSSL_ia32cap_P[0] & (1 << 25)) { /* check SSE bit */
 #   else
@@ -762,8 +911,9 @@ void CRYPTO_gcm128_init(GCM128_CONTEXT *ctx, void *key, block128_f block)
         CTX__GHASH(gcm_ghash_4bit_x86);
     }
 #  else
-    ctx->gmult = gcm_gmult_4bit;
-    CTX__GHASH(gcm_ghash_4bit);
+    gcm_init_ct(ctx->Htable, ctx->H.u);
+    ctx->gmult = gcm_gmult_ct;
+    CTX__GHASH(gcm_ghash_ct);
 #  endif
 # elif  defined(GHASH_ASM_ARM)
 #  ifdef PMULL_CAPABLE
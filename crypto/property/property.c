@@ -19,6 +19,7 @@
 #include <openssl/lhash.h>
 #include <openssl/rand.h>
 #include "internal/thread_once.h"
+#include "internal/tsan_assist.h"
 #include "crypto/lhash.h"
 #include "crypto/sparse_array.h"
 #include "property_local.h"
@@ -30,6 +31,42 @@
  */
 #define IMPL_CACHE_FLUSH_THRESHOLD  500
 
+/*
+ * The number of replaced query caches that are kept before waiting for the
+ * readers that might still look at them, and freeing them.
+ */
+#define IMPL_CACHE_MAX_RETIRED      64
+
+/* The number of reader counters, must be a power of two */
+#define IMPL_CACHE_READER_SLOTS     16
+
+/*
+ * The query cache is read without taking any lock when the platform gives
+ * us acquire / release semantics.  Each algorithm has a QUERY_CACHE of its
+ * own that is never modified once it has been published in the table of
+ * caches, which is indexed by the method nid.  Writers, which hold the store
+ * lock, build a new cache on the side and publish it in place of the old
+ * one, and the table itself is replaced the same way when it has to grow.
+ *
+ * Replaced caches and tables are put on a retired list and freed once no
+ * reader can still be looking at them.  Readers announce themselves in one
+ * of a number of counters, picked by thread so that different threads
+ * mostly use different cache lines, and in one of two epochs.  Before
+ * freeing anything, a writer switches the readers to the other epoch and
+ * waits for the counters of the previous one to drop to zero, twice.
+ * That is only done when the retired list gets long, when the cache is
+ * flushed and when the store is freed, so it's rare.
+ *
+ * Without acquire / release semantics, readers take the store lock instead.
+ */
+#ifdef tsan_ld_acq
+# define cache_ld_acq(ptr) tsan_ld_acq(ptr)
+# define cache_st_rel(ptr, val) tsan_st_rel(ptr, val)
+#else
+# define cache_ld_acq(ptr) (*(ptr))
+# define cache_st_rel(ptr, val) (*(ptr) = (val))
+#endif
+
 typedef struct {
     void *method;
     int (*up_ref)(void *);
@@ -47,28 +84,54 @@ DEFINE_STACK_OF(IMPLEMENTATION)
 typedef struct {
     const char *query;
     METHOD method;
-    char body[1];
 } QUERY;
 
-DEFINE_LHASH_OF(QUERY);
+/* The cached queries of one algorithm, followed by the query strings */
+typedef struct query_cache_st QUERY_CACHE;
+struct query_cache_st {
+    QUERY_CACHE *next_retired;
+    size_t num;
+    QUERY queries[1];
+};
+
+typedef struct query_cache_table_st QUERY_CACHE_TABLE;
+struct query_cache_table_st {
+    QUERY_CACHE_TABLE *next_retired;
+    size_t size;
+    QUERY_CACHE *TSAN_QUALIFIER caches[1];  /* Indexed by nid */
+};
+
+/* Only the counters are used, the padding keeps them in separate lines */
+typedef union {
+    int count[2];
+    unsigned char pad[64];
+} CACHE_READERS;
 
 typedef struct {
     int nid;
     STACK_OF(IMPLEMENTATION) *impls;
-    LHASH_OF(QUERY) *cache;
 } ALGORITHM;
 
 struct ossl_method_store_st {
     OSSL_LIB_CTX *ctx;
-    size_t nelem;
     SPARSE_ARRAY_OF(ALGORITHM) *algs;
-    int need_flush;
     CRYPTO_RWLOCK *lock;
+
+    /* The query cache, see above */
+    QUERY_CACHE_TABLE *TSAN_QUALIFIER cache;
+    size_t cache_nelem;
+    QUERY_CACHE *retired;
+    QUERY_CACHE_TABLE *retired_tables;
+    size_t num_retired;
+#ifdef tsan_ld_acq
+    TSAN_QUALIFIER int epoch;
+    CACHE_READERS readers[IMPL_CACHE_READER_SLOTS];
+    /* Only used by CRYPTO_atomic_add() where it isn't lock free */
+    CRYPTO_RWLOCK *readers_lock;
+#endif
 };
 
 typedef struct {
-    LHASH_OF(QUERY) *cache;
-    size_t nelem;
     uint32_t seed;
 } IMPL_CACHE_FLUSH;
 
@@ -165,38 +228,57 @@ static int ossl_property_unlock(OSSL_METHOD_STORE *p)
     return p != 0 ? CRYPTO_THREAD_unlock(p->lock) : 0;
 }
 
-static unsigned long query_hash(const QUERY *a)
+static void impl_free(IMPLEMENTATION *impl)
 {
-    return OPENSSL_LH_strhash(a->query);
+    if (impl != NULL) {
+        ossl_method_free(&impl->method);
+        OPENSSL_free(impl);
+    }
 }
 
-static int query_cmp(const QUERY *a, const QUERY *b)
+static void query_cache_free(QUERY_CACHE *cache)
 {
-    return strcmp(a->query, b->query);
+    size_t i;
+
+    if (cache != NULL) {
+        for (i = 0; i < cache->num; i++)
+            ossl_method_free(&cache->queries[i].method);
+        OPENSSL_free(cache);
+    }
 }
 
-static void impl_free(IMPLEMENTATION *impl)
+static void query_cache_table_free(QUERY_CACHE_TABLE *table)
 {
-    if (impl != NULL) {
-        ossl_method_free(&impl->method);
-        OPENSSL_free(impl);
+    size_t i;
+
+    if (table != NULL) {
+        for (i = 0; i < table->size; i++)
+            query_cache_free(table->caches[i]);
+        OPENSSL_free(table);
     }
 }
 
-static void impl_cache_free(QUERY *elem)
+static void query_cache_free_retired(OSSL_METHOD_STORE *store)
 {
-    if (elem != NULL) {
-        ossl_method_free(&elem->method);
-        OPENSSL_free(elem);
+    QUERY_CACHE *cache;
+    QUERY_CACHE_TABLE *table;
+
+    while ((cache = store->retired) != NULL) {
+        store->retired = cache->next_retired;
+        query_cache_free(cache);
     }
+    while ((table = store->retired_tables) != NULL) {
+        store->retired_tables = table->next_retired;
+        /* The caches have been moved to the table that replaced this one */
+        OPENSSL_free(table);
+    }
+    store->num_retired = 0;
 }
 
 static void alg_cleanup(ossl_uintmax_t idx, ALGORITHM *a)
 {
     if (a != NULL) {
         sk_IMPLEMENTATION_pop_free(a->impls, &impl_free);
-        lh_QUERY_doall(a->cache, &impl_cache_free);
-        lh_QUERY_free(a->cache);
         OPENSSL_free(a);
     }
 }
@@ -212,13 +294,12 @@ OSSL_METHOD_STORE *ossl_method_store_new(OSSL_LIB_CTX *ctx)
     res = OPENSSL_zalloc(sizeof(*res));
     if (res != NULL) {
         res->ctx = ctx;
-        if ((res->algs = ossl_sa_ALGORITHM_new()) == NULL) {
-            OPENSSL_free(res);
-            return NULL;
-        }
-        if ((res->lock = CRYPTO_THREAD_lock_new()) == NULL) {
-            ossl_sa_ALGORITHM_free(res->algs);
-            OPENSSL_free(res);
+        if ((res->algs = ossl_sa_ALGORITHM_new()) == NULL
+#ifdef tsan_ld_acq
+                || (res->readers_lock = CRYPTO_THREAD_lock_new()) == NULL
+#endif
+                || (res->lock = CRYPTO_THREAD_lock_new()) == NULL) {
+            ossl_method_store_free(res);
             return NULL;
         }
     }
@@ -230,6 +311,11 @@ void ossl_method_store_free(OSSL_METHOD_STORE *store)
     if (store != NULL) {
         ossl_sa_ALGORITHM_doall(store->algs, &alg_cleanup);
         ossl_sa_ALGORITHM_free(store->algs);
+        query_cache_table_free(store->cache);
+        query_cache_free_retired(store);
+#ifdef tsan_ld_acq
+        CRYPTO_THREAD_lock_free(store->readers_lock);
+#endif
         CRYPTO_THREAD_lock_free(store->lock);
         OPENSSL_free(store);
     }
@@ -289,8 +375,7 @@ int ossl_method_store_add(OSSL_METHOD_STORE *store, const OSSL_PROVIDER *prov,
     alg = ossl_method_store_retrieve(store, nid);
     if (alg == NULL) {
         if ((alg = OPENSSL_zalloc(sizeof(*alg))) == NULL
-                || (alg->impls = sk_IMPLEMENTATION_new_null()) == NULL
-                || (alg->cache = lh_QUERY_new(&query_hash, &query_cmp)) == NULL)
+                || (alg->impls = sk_IMPLEMENTATION_new_null()) == NULL)
             goto err;
         alg->nid = nid;
         if (!ossl_method_store_insert(store, alg))
@@ -466,54 +551,268 @@ fin:
     return ret;
 }
 
-static void impl_cache_flush_alg(ossl_uintmax_t idx, ALGORITHM *alg, void *arg)
+static void alg_flush(ossl_uintmax_t idx, ALGORITHM *alg, void *arg)
 {
     SPARSE_ARRAY_OF(ALGORITHM) *algs = arg;
 
-    lh_QUERY_doall(alg->cache, &impl_cache_free);
-    if (algs != NULL) {
-        sk_IMPLEMENTATION_pop_free(alg->impls, &impl_free);
-        lh_QUERY_free(alg->cache);
-        OPENSSL_free(alg);
-        ossl_sa_ALGORITHM_set(algs, idx, NULL);
-    } else {
-        lh_QUERY_flush(alg->cache);
+    sk_IMPLEMENTATION_pop_free(alg->impls, &impl_free);
+    OPENSSL_free(alg);
+    ossl_sa_ALGORITHM_set(algs, idx, NULL);
+}
+
+#ifdef tsan_ld_acq
+/*
+ * A reader enters the counter of the current epoch in its slot before it
+ * loads any pointer to the query cache, and leaves it when it's done with
+ * what it found there.  The counters are only ever changed with atomic read-
+ * modify-write operations, so a writer that doesn't see a reader in them yet
+ * has published its changes before that reader looks.
+ */
+static CACHE_READERS *cache_read_begin(OSSL_METHOD_STORE *store, int *epoch)
+{
+    CACHE_READERS *readers;
+    size_t h = (size_t)&readers;
+    int tmp;
+
+    /* Each thread has its own stack, use that to spread them out */
+    h ^= h >> 21;
+    h ^= h >> 13;
+    readers = &store->readers[h & (IMPL_CACHE_READER_SLOTS - 1)];
+    *epoch = tsan_ld_acq(&store->epoch);
+    if (!CRYPTO_atomic_add(&readers->count[*epoch], 1, &tmp,
+                           store->readers_lock))
+        return NULL;
+    return readers;
+}
+
+static void cache_read_end(OSSL_METHOD_STORE *store, CACHE_READERS *readers,
+                           int epoch)
+{
+    int tmp;
+
+    (void)CRYPTO_atomic_add(&readers->count[epoch], -1, &tmp,
+                            store->readers_lock);
+}
+#endif
+
+/*
+ * Wait until no reader can still be looking at a cache or table that has
+ * been replaced.  The caller must hold the store write lock.
+ */
+static int cache_synchronize(OSSL_METHOD_STORE *store)
+{
+#ifdef tsan_ld_acq
+    int epoch = tsan_load(&store->epoch), i, n;
+    size_t j;
+
+    /*
+     * Readers that picked up the previous epoch just before it changed can
+     * still enter its counters, so both epochs are waited for.
+     */
+    for (i = 0; i < 2; i++) {
+        tsan_st_rel(&store->epoch, epoch ^ 1);
+        for (j = 0; j < OSSL_NELEM(store->readers); j++)
+            do {
+                if (!CRYPTO_atomic_add(&store->readers[j].count[epoch], 0, &n,
+                                       store->readers_lock))
+                    return 0;
+            } while (n != 0);
+        epoch ^= 1;
     }
+#endif
+    return 1;
 }
 
-static void ossl_method_cache_flush(OSSL_METHOD_STORE *store, int nid)
+/*
+ * Free the retired caches and tables if there are many of them, or if
+ * |force| is set.  The caller must hold the store write lock.
+ */
+static void ossl_method_cache_reclaim(OSSL_METHOD_STORE *store, int force)
 {
-    ALGORITHM *alg = ossl_method_store_retrieve(store, nid);
+    if (store->num_retired == 0
+            || (!force && store->num_retired < IMPL_CACHE_MAX_RETIRED))
+        return;
+    if (cache_synchronize(store))
+        query_cache_free_retired(store);
+}
 
-    if (alg != NULL) {
-        ossl_provider_clear_all_operation_bits(store->ctx);
-        store->nelem -= lh_QUERY_num_items(alg->cache);
-        impl_cache_flush_alg(0, alg, NULL);
+/* The caller must hold the store write lock */
+static int query_cache_table_reserve(OSSL_METHOD_STORE *store, int nid)
+{
+    QUERY_CACHE_TABLE *table = store->cache, *newtable;
+    size_t i, size = table != NULL ? table->size : 0, newsize;
+
+    if ((size_t)nid < size)
+        return 1;
+    for (newsize = size == 0 ? 64 : size; newsize <= (size_t)nid; newsize *= 2)
+        continue;
+    newtable = OPENSSL_zalloc(sizeof(*newtable)
+                              + (newsize - 1) * sizeof(newtable->caches[0]));
+    if (newtable == NULL)
+        return 0;
+    newtable->size = newsize;
+    if (table != NULL) {
+        for (i = 0; i < size; i++)
+            newtable->caches[i] = table->caches[i];
+        table->next_retired = store->retired_tables;
+        store->retired_tables = table;
+        store->num_retired++;
     }
+    cache_st_rel(&store->cache, newtable);
+    return 1;
 }
 
-int ossl_method_store_flush_cache(OSSL_METHOD_STORE *store, int all)
+/*
+ * Replace the cache of |nid|, which must be covered by the table, with
+ * |cache| and retire the old one.  The caller must hold the store write lock.
+ */
+static void query_cache_publish(OSSL_METHOD_STORE *store, int nid,
+                                QUERY_CACHE *cache)
+{
+    QUERY_CACHE_TABLE *table = store->cache;
+    QUERY_CACHE *old = table->caches[nid];
+
+    if (old == NULL && cache == NULL)
+        return;
+    cache_st_rel(&table->caches[nid], cache);
+    if (cache != NULL)
+        store->cache_nelem += cache->num;
+    if (old != NULL) {
+        store->cache_nelem -= old->num;
+        old->next_retired = store->retired;
+        store->retired = old;
+        store->num_retired++;
+    }
+}
+
+/* Copy |q| to the end of |cache|, with the query string at |*p| */
+static int query_cache_add(QUERY_CACHE *cache, const QUERY *q, char **p)
 {
-    void *arg = (all != 0 ? store->algs : NULL);
+    QUERY *new = &cache->queries[cache->num];
+    size_t len = strlen(q->query) + 1;
 
+    new->method = q->method;
+    if (!ossl_method_up_ref(&new->method))
+        return 0;
+    memcpy(*p, q->query, len);
+    new->query = *p;
+    *p += len;
+    cache->num++;
+    return 1;
+}
+
+/*
+ * Build a new cache for an algorithm from its |old| one, which may be NULL,
+ * leaving out the query |drop|, about half of the other queries if |state|
+ * isn't NULL, and adding |add| if it isn't NULL.  |*pcache| is set to NULL
+ * if no queries are left.
+ */
+static int query_cache_new(const QUERY_CACHE *old, const char *drop,
+                           const QUERY *add, IMPL_CACHE_FLUSH *state,
+                           QUERY_CACHE **pcache)
+{
+    QUERY_CACHE *cache;
+    size_t i, n = 0, size = 0;
+    uint32_t r;
+    char *p;
+
+    *pcache = NULL;
+    if (old != NULL)
+        for (n = 0; n < old->num; n++)
+            size += strlen(old->queries[n].query) + 1;
+    if (add != NULL) {
+        size += strlen(add->query) + 1;
+        n++;
+    }
+    if (n == 0)
+        return 1;
+
+    cache = OPENSSL_malloc(sizeof(*cache) + (n - 1) * sizeof(cache->queries[0])
+                           + size);
+    if (cache == NULL)
+        return 0;
+    cache->next_retired = NULL;
+    cache->num = 0;
+    p = (char *)&cache->queries[n];
+
+    for (i = 0; old != NULL && i < old->num; i++) {
+        if (drop != NULL && strcmp(old->queries[i].query, drop) == 0)
+            continue;
+        if (state != NULL) {
+            /*
+             * Implement the 32 bit xorshift as suggested by George Marsaglia
+             * in:
+             *      https://doi.org/10.18637/jss.v008.i14
+             *
+             * This is a very fast PRNG so there is no need to extract bits
+             * one at a time and use the entire value each time.
+             */
+            r = state->seed;
+            r ^= r << 13;
+            r ^= r >> 17;
+            r ^= r << 5;
+            state->seed = r;
+            if ((r & 1) != 0)
+                continue;
+        }
+        if (!query_cache_add(cache, &old->queries[i], &p))
+            goto err;
+    }
+    if (add != NULL && !query_cache_add(cache, add, &p))
+        goto err;
+
+    if (cache->num == 0)
+        OPENSSL_free(cache);
+    else
+        *pcache = cache;
+    return 1;
+ err:
+    query_cache_free(cache);
+    return 0;
+}
+
+/* The caller must hold the store write lock */
+static void ossl_method_cache_flush(OSSL_METHOD_STORE *store, int nid)
+{
+    if (ossl_method_store_retrieve(store, nid) == NULL)
+        return;
+    ossl_provider_clear_all_operation_bits(store->ctx);
+
+    if (store->cache != NULL && (size_t)nid < store->cache->size)
+        query_cache_publish(store, nid, NULL);
+    ossl_method_cache_reclaim(store, 0);
+}
+
+/* The caller must hold the store write lock */
+static void ossl_method_cache_flush_all(OSSL_METHOD_STORE *store)
+{
+    size_t i;
+
+    if (store->cache != NULL)
+        for (i = 0; i < store->cache->size; i++)
+            query_cache_publish(store, (int)i, NULL);
+    ossl_method_cache_reclaim(store, 1);
+}
+
+int ossl_method_store_flush_cache(OSSL_METHOD_STORE *store, int all)
+{
     if (!ossl_property_write_lock(store))
         return 0;
     ossl_provider_clear_all_operation_bits(store->ctx);
-    ossl_sa_ALGORITHM_doall_arg(store->algs, &impl_cache_flush_alg, arg);
-    store->nelem = 0;
+    ossl_method_cache_flush_all(store);
+    if (all != 0)
+        ossl_sa_ALGORITHM_doall_arg(store->algs, &alg_flush, store->algs);
     ossl_property_unlock(store);
     return 1;
 }
 
-IMPLEMENT_LHASH_DOALL_ARG(QUERY, IMPL_CACHE_FLUSH);
-
 /*
- * Flush an element from the query cache (perhaps).
+ * Flush elements from the query cache (perhaps).
  *
- * In order to avoid taking a write lock or using atomic operations
- * to keep accurate least recently used (LRU) or least frequently used
- * (LFU) information, the procedure used here is to stochastically
- * flush approximately half the cache.
+ * In order to avoid keeping accurate least recently used (LRU) or least
+ * frequently used (LFU) information, which would mean writes on the read
+ * path, the procedure used here is to stochastically flush approximately
+ * half the cache.
  *
  * This procedure isn't ideal, LRU or LFU would be better.  However,
  * in normal operation, reaching a full cache would be unexpected.
@@ -522,79 +821,72 @@ IMPLEMENT_LHASH_DOALL_ARG(QUERY, IMPL_CACHE_FLUSH);
  * strategy that doesn't degrade performance of the normal case is
  * preferable to a more refined approach that imposes a performance
  * impact.
+ *
+ * The caller must hold the store write lock.
  */
-static void impl_cache_flush_cache(QUERY *c, IMPL_CACHE_FLUSH *state)
-{
-    uint32_t n;
-
-    /*
-     * Implement the 32 bit xorshift as suggested by George Marsaglia in:
-     *      https://doi.org/10.18637/jss.v008.i14
-     *
-     * This is a very fast PRNG so there is no need to extract bits one at a
-     * time and use the entire value each time.
-     */
-    n = state->seed;
-    n ^= n << 13;
-    n ^= n >> 17;
-    n ^= n << 5;
-    state->seed = n;
-
-    if ((n & 1) != 0)
-        impl_cache_free(lh_QUERY_delete(state->cache, c));
-    else
-        state->nelem++;
-}
-
-static void impl_cache_flush_one_alg(ossl_uintmax_t idx, ALGORITHM *alg,
-                                     void *v)
-{
-    IMPL_CACHE_FLUSH *state = (IMPL_CACHE_FLUSH *)v;
-
-    state->cache = alg->cache;
-    lh_QUERY_doall_IMPL_CACHE_FLUSH(state->cache, &impl_cache_flush_cache,
-                                    state);
-}
-
 static void ossl_method_cache_flush_some(OSSL_METHOD_STORE *store)
 {
+    QUERY_CACHE_TABLE *table = store->cache;
+    QUERY_CACHE *cache;
     IMPL_CACHE_FLUSH state;
+    size_t i;
 
-    state.nelem = 0;
     if ((state.seed = OPENSSL_rdtsc()) == 0)
         state.seed = 1;
     ossl_provider_clear_all_operation_bits(store->ctx);
-    store->need_flush = 0;
-    ossl_sa_ALGORITHM_doall_arg(store->algs, &impl_cache_flush_one_alg, &state);
-    store->nelem = state.nelem;
+    for (i = 0; i < table->size; i++)
+        if (table->caches[i] != NULL
+                && query_cache_new(table->caches[i], NULL, NULL, &state,
+                                   &cache))
+            query_cache_publish(store, (int)i, cache);
 }
 
 int ossl_method_store_cache_get(OSSL_METHOD_STORE *store, int nid,
                                 const char *prop_query, void **method)
 {
-    ALGORITHM *alg;
-    QUERY elem, *r;
+    const QUERY_CACHE_TABLE *table;
+    const QUERY_CACHE *cache;
+    QUERY *q;
+#ifdef tsan_ld_acq
+    CACHE_READERS *readers;
+    int epoch;
+#endif
+    size_t i;
     int res = 0;
 
     if (nid <= 0 || store == NULL)
         return 0;
+    if (prop_query == NULL)
+        prop_query = "";
 
+#ifdef tsan_ld_acq
+    if ((readers = cache_read_begin(store, &epoch)) == NULL)
+        return 0;
+#else
     if (!ossl_property_read_lock(store))
         return 0;
-    alg = ossl_method_store_retrieve(store, nid);
-    if (alg == NULL)
-        goto err;
+#endif
 
-    elem.query = prop_query != NULL ? prop_query : "";
-    r = lh_QUERY_retrieve(alg->cache, &elem);
-    if (r == NULL)
-        goto err;
-    if (ossl_method_up_ref(&r->method)) {
-        *method = r->method.method;
-        res = 1;
+    table = cache_ld_acq(&store->cache);
+    if (table != NULL && (size_t)nid < table->size
+            && (cache = cache_ld_acq(&table->caches[nid])) != NULL) {
+        for (i = 0; i < cache->num; i++) {
+            q = (QUERY *)&cache->queries[i];
+            if (strcmp(q->query, prop_query) == 0) {
+                if (ossl_method_up_ref(&q->method)) {
+                    *method = q->method.method;
+                    res = 1;
+                }
+                break;
+            }
+        }
     }
-err:
+
+#ifdef tsan_ld_acq
+    cache_read_end(store, readers, epoch);
+#else
     ossl_property_unlock(store);
+#endif
     return res;
 }
 
@@ -603,56 +895,34 @@ int ossl_method_store_cache_set(OSSL_METHOD_STORE *store, int nid,
                                 int (*method_up_ref)(void *),
                                 void (*method_destruct)(void *))
 {
-    QUERY elem, *old, *p = NULL;
-    ALGORITHM *alg;
-    size_t len;
-    int res = 1;
+    QUERY_CACHE *cache;
+    QUERY add;
+    int res = 0;
 
     if (nid <= 0 || store == NULL)
         return 0;
     if (prop_query == NULL)
         return 1;
 
+    add.query = prop_query;
+    add.method.method = method;
+    add.method.up_ref = method_up_ref;
+    add.method.free = method_destruct;
+
     if (!ossl_property_write_lock(store))
         return 0;
-    if (store->need_flush)
-        ossl_method_cache_flush_some(store);
-    alg = ossl_method_store_retrieve(store, nid);
-    if (alg == NULL)
+    if (ossl_method_store_retrieve(store, nid) == NULL
+            || !query_cache_table_reserve(store, nid)
+            || !query_cache_new(store->cache->caches[nid], prop_query,
+                                method != NULL ? &add : NULL, NULL, &cache))
         goto err;
 
-    if (method == NULL) {
-        elem.query = prop_query;
-        if ((old = lh_QUERY_delete(alg->cache, &elem)) != NULL) {
-            impl_cache_free(old);
-            store->nelem--;
-        }
-        goto end;
-    }
-    p = OPENSSL_malloc(sizeof(*p) + (len = strlen(prop_query)));
-    if (p != NULL) {
-        p->query = p->body;
-        p->method.method = method;
-        p->method.up_ref = method_up_ref;
-        p->method.free = method_destruct;
-        if (!ossl_method_up_ref(&p->method))
-            goto err;
-        memcpy((char *)p->query, prop_query, len + 1);
-        if ((old = lh_QUERY_insert(alg->cache, p)) != NULL) {
-            impl_cache_free(old);
-            goto end;
-        }
-        if (!lh_QUERY_error(alg->cache)) {
-            if (++store->nelem >= IMPL_CACHE_FLUSH_THRESHOLD)
-                store->need_flush = 1;
-            goto end;
-        }
-        ossl_method_free(&p->method);
-    }
-err:
-    res = 0;
-    OPENSSL_free(p);
-end:
+    query_cache_publish(store, nid, cache);
+    if (store->cache_nelem >= IMPL_CACHE_FLUSH_THRESHOLD)
+        ossl_method_cache_flush_some(store);
+    ossl_method_cache_reclaim(store, 0);
+    res = 1;
+ err:
     ossl_property_unlock(store);
     return res;
 }
@@ -0,0 +1,534 @@
+#! /usr/bin/env perl
+# Copyright 2021 The OpenSSL Project Authors. All Rights Reserved.
+#
+# Licensed under the Apache License 2.0 (the "License").  You may not use
+# this file except in compliance with the License.  You can obtain a copy
+# in the file LICENSE in the source distribution or at
+# https://www.openssl.org/source/license.html
+#
+# Multi-state Keccak-f[1600] for x86_64.
+#
+# Unlike keccak1600-avx2.pl and keccak1600-avx512.pl, which spread a
+# single state over vector registers, the permutations below process four
+# (AVX2) or eight (AVX512F) independent states at once, one state per
+# 64-bit element.  The states are kept lane-interleaved, i.e. A[i][lane]
+# is the i-th word of the state in |lane|, and words are numbered as in
+# keccak1600.c, so that i = x + 5*y.  This suits hashing of many
+# independent messages and parallel XOF invocations, while the
+# single-state code remains the best choice for one long message.
+#
+# The 8x AVX512F code keeps all states in registers. Pi is not executed
+# at all, instead the register assignment is permuted at code generation
+# time. As the Pi permutation is of order 24, a fully unrolled round loop
+# ends with the registers in their original order.  The 4x AVX2 code
+# keeps the states in memory and writes the output of Rho and Pi to a
+# buffer on stack, from which Chi reads it row by row.
+#
+# Caller is expected to check keccak1600_mb_lanes() first.
+
+# $output is the last argument if it looks like a file (it has an extension)
+# $flavour is the first argument if it doesn't look like a file
+$output = $#ARGV >= 0 && $ARGV[$#ARGV] =~ m|\.\w+$| ? pop : undef;
+$flavour = $#ARGV >= 0 && $ARGV[0] !~ m|\.| ? shift : undef;
+
+$win64=0; $win64=1 if ($flavour =~ /[nm]asm|mingw64/ || $output =~ /\.asm$/);
+
+$0 =~ m/(.*[\/\\])[^\/\\]+$/; $dir=$1;
+( $xlate="${dir}x86_64-xlate.pl" and -f $xlate ) or
+( $xlate="${dir}../../perlasm/x86_64-xlate.pl" and -f $xlate) or
+die "can't locate x86_64-xlate.pl";
+
+$avx=0;
+
+if (`$ENV{CC} -Wa,-v -c -o /dev/null -x assembler /dev/null 2>&1`
+		=~ /GNU assembler version ([2-9]\.[0-9]+)/) {
+	$avx = ($1>=2.19) + ($1>=2.22) + ($1>=2.25);
+}
+
+if (!$avx && $win64 && ($flavour =~ /nasm/ || $ENV{ASM} =~ /nasm/) &&
+	   `nasm -v 2>&1` =~ /NASM version ([2-9]\.[0-9]+)(?:\.([0-9]+))?/) {
+	$avx = ($1>=2.09) + ($1>=2.10) + ($1>=2.12);
+	$avx += 1 if ($1==2.11 && $2>=8);
+}
+
+if (!$avx && $win64 && ($flavour =~ /masm/ || $ENV{ASM} =~ /ml64/) &&
+	   `ml64 2>&1` =~ /Version ([0-9]+)\./) {
+	$avx = ($1>=10) + ($1>=11);
+}
+
+if (!$avx && `$ENV{CC} -v 2>&1` =~ /((?:clang|LLVM) version|.*based on LLVM) ([0-9]+\.[0-9]+)/) {
+	$avx = ($2>=3.0) + ($2>3.0) + ($2>=3.9);
+}
+
+open OUT,"| \"$^X\" \"$xlate\" $flavour \"$output\""
+    or die "can't call $xlate: $!";
+*STDOUT=*OUT;
+
+# int keccak1600_mb_lanes(void);
+#
+# void keccak1600_x4_avx2(uint64_t A[25][4]);
+# void keccak1600_x8_avx512(uint64_t A[25][8]);
+#
+# keccak1600_mb_lanes() returns 8 if keccak1600_x8_avx512() can be used,
+# 4 if only keccak1600_x4_avx2() can be used and 0 otherwise.
+
+my @rhotates = ( 0,  1, 62, 28, 27,
+		36, 44,  6, 55, 20,
+		 3, 10, 43, 25, 39,
+		41, 45, 15, 21,  8,
+		18,  2, 61, 56, 14 );
+
+# Pi moves word x + 5*y to y + 5*((2*x + 3*y) % 5)
+my @pi = map { my ($x, $y) = ($_ % 5, int($_ / 5));
+	       $y + 5 * ((2 * $x + 3 * $y) % 5) } (0..24);
+
+$code.=<<___;
+.text
+
+.extern	OPENSSL_ia32cap_P
+
+.globl	keccak1600_mb_lanes
+.type	keccak1600_mb_lanes,\@abi-omnipotent
+.align	32
+keccak1600_mb_lanes:
+.cfi_startproc
+	xor	%eax,%eax
+___
+$code.=<<___ if ($avx>1);
+	mov	OPENSSL_ia32cap_P+8(%rip),%ecx
+	test	\$`1<<5`,%ecx			# AVX2 bit
+	jz	.Lmb_lanes_done
+	mov	\$4,%eax
+___
+$code.=<<___ if ($avx>2);
+	test	\$`1<<16`,%ecx			# AVX512F bit
+	jz	.Lmb_lanes_done
+	mov	\$8,%eax
+___
+$code.=<<___;
+.Lmb_lanes_done:
+	ret
+.cfi_endproc
+.size	keccak1600_mb_lanes,.-keccak1600_mb_lanes
+___
+
+if ($avx>1) {{{
+######################################################################
+# 4x AVX2
+#
+my $A = "%rdi";		# 1st arg, states
+my $B = "%rsp";		# output of Rho and Pi
+my $iotas = "%r10";
+my @C = map("%ymm$_",(0..4));
+my @D = map("%ymm$_",(5..9));
+my ($T0,$T1,$T2) = map("%ymm$_",(10..12));
+my $xframe = $win64 ? 0xa8 : 0;
+
+$code.=<<___;
+.globl	keccak1600_x4_avx2
+.type	keccak1600_x4_avx2,\@function,1
+.align	32
+keccak1600_x4_avx2:
+.cfi_startproc
+	mov	%rsp,%r9			# frame pointer
+.cfi_def_cfa_register	%r9
+	sub	\$`25*32+$xframe`,%rsp
+	and	\$-32,%rsp
+___
+$code.=<<___	if ($win64);
+	movaps	%xmm6,-0xa8(%r9)
+	movaps	%xmm7,-0x98(%r9)
+	movaps	%xmm8,-0x88(%r9)
+	movaps	%xmm9,-0x78(%r9)
+	movaps	%xmm10,-0x68(%r9)
+	movaps	%xmm11,-0x58(%r9)
+	movaps	%xmm12,-0x48(%r9)
+	movaps	%xmm13,-0x38(%r9)
+	movaps	%xmm14,-0x28(%r9)
+	movaps	%xmm15,-0x18(%r9)
+.Lx4_body:
+___
+$code.=<<___;
+	lea	iotas(%rip),$iotas
+	mov	\$24,%eax
+	jmp	.Loop_x4_avx2
+
+.align	32
+.Loop_x4_avx2:
+	######################################### Theta
+___
+for (my $x = 0; $x < 5; $x++) {
+    $code.="\tvmovdqa\t`32*$x`($A),$C[$x]\n";
+    for (my $y = 1; $y < 5; $y++) {
+	$code.="\tvpxor\t`32*($x+5*$y)`($A),$C[$x],$C[$x]\n";
+    }
+}
+for (my $x = 0; $x < 5; $x++) {
+    my ($prev, $next) = ($C[($x+4)%5], $C[($x+1)%5]);
+    $code.=<<___;
+	vpsrlq	\$63,$next,$T0
+	vpaddq	$next,$next,$D[$x]
+	vpor	$T0,$D[$x],$D[$x]
+	vpxor	$prev,$D[$x],$D[$x]
+___
+}
+$code.="\t######################################### Rho and Pi\n";
+for (my $i = 0; $i < 25; $i++) {
+    my $r = $rhotates[$i];
+    my $T = ($i & 1) ? $T1 : $T0;	# alternate to break dependencies
+
+    $code.="\tvpxor\t`32*$i`($A),$D[$i%5],$T\n";
+    if ($r == 1) {
+	$code.=<<___;
+	vpsrlq	\$63,$T,$T2
+	vpaddq	$T,$T,$T
+	vpor	$T2,$T,$T
+___
+    } elsif ($r != 0) {
+	$code.=<<___;
+	vpsrlq	\$`64-$r`,$T,$T2
+	vpsllq	\$$r,$T,$T
+	vpor	$T2,$T,$T
+___
+    }
+    $code.="\tvmovdqa\t$T,`32*$pi[$i]`($B)\n";
+}
+$code.="\t######################################### Chi and Iota\n";
+for (my $y = 0; $y < 5; $y++) {
+    my @b = @C;			# Theta output is no longer needed
+
+    for (my $x = 0; $x < 5; $x++) {
+	$code.="\tvmovdqa\t`32*($x+5*$y)`($B),$b[$x]\n";
+    }
+    for (my $x = 0; $x < 5; $x++) {
+	my $T = $D[$x];		# neither is D
+
+	$code.=<<___;
+	vpandn	$b[($x+2)%5],$b[($x+1)%5],$T
+	vpxor	$b[$x],$T,$T
+___
+	$code.=<<___ if ($x == 0 && $y == 0);
+	vpbroadcastq	($iotas),$T0
+	vpxor	$T0,$T,$T
+___
+	$code.="\tvmovdqa\t$T,`32*($x+5*$y)`($A)\n";
+    }
+}
+$code.=<<___;
+
+	lea	8($iotas),$iotas
+	dec	%eax
+	jnz	.Loop_x4_avx2
+
+	vzeroupper
+___
+$code.=<<___	if ($win64);
+	movaps	-0xa8(%r9),%xmm6
+	movaps	-0x98(%r9),%xmm7
+	movaps	-0x88(%r9),%xmm8
+	movaps	-0x78(%r9),%xmm9
+	movaps	-0x68(%r9),%xmm10
+	movaps	-0x58(%r9),%xmm11
+	movaps	-0x48(%r9),%xmm12
+	movaps	-0x38(%r9),%xmm13
+	movaps	-0x28(%r9),%xmm14
+	movaps	-0x18(%r9),%xmm15
+___
+$code.=<<___;
+	lea	(%r9),%rsp
+.cfi_def_cfa_register	%rsp
+.Lx4_epilogue:
+	ret
+.cfi_endproc
+.size	keccak1600_x4_avx2,.-keccak1600_x4_avx2
+___
+}}} else {{{
+# Assembler doesn't support AVX2, keccak1600_mb_lanes() returns 0 and
+# this is never called.
+$code.=<<___;
+.globl	keccak1600_x4_avx2
+.type	keccak1600_x4_avx2,\@abi-omnipotent
+keccak1600_x4_avx2:
+	.byte	0x0f,0x0b	# ud2
+	ret
+.size	keccak1600_x4_avx2,.-keccak1600_x4_avx2
+___
+}}}
+
+if ($avx>2) {{{
+######################################################################
+# 8x AVX512F
+#
+my $A = "%rdi";		# 1st arg, states
+my $iotas = "%r10";
+my @R = map("%zmm$_",(0..24));	# R[i] holds word i of all states
+my @C = map("%zmm$_",(25..29));
+my @T = map("%zmm$_",(30..31));
+my $xframe = $win64 ? 0xa8 : 0;
+
+$code.=<<___;
+.globl	keccak1600_x8_avx512
+.type	keccak1600_x8_avx512,\@function,1
+.align	32
+keccak1600_x8_avx512:
+.cfi_startproc
+	mov	%rsp,%r9			# frame pointer
+.cfi_def_cfa_register	%r9
+___
+$code.=<<___	if ($win64);
+	sub	\$$xframe,%rsp
+	movaps	%xmm6,-0xa8(%r9)
+	movaps	%xmm7,-0x98(%r9)
+	movaps	%xmm8,-0x88(%r9)
+	movaps	%xmm9,-0x78(%r9)
+	movaps	%xmm10,-0x68(%r9)
+	movaps	%xmm11,-0x58(%r9)
+	movaps	%xmm12,-0x48(%r9)
+	movaps	%xmm13,-0x38(%r9)
+	movaps	%xmm14,-0x28(%r9)
+	movaps	%xmm15,-0x18(%r9)
+.Lx8_body:
+___
+$code.="\tlea\tiotas(%rip),$iotas\n";
+for (my $i = 0; $i < 25; $i++) {
+    $code.="\tvmovdqu64\t`64*$i`($A),$R[$i]\n";
+}
+
+for (my $round = 0; $round < 24; $round++) {
+    $code.="\t######################################### Round $round\n";
+    # Theta
+    for (my $x = 0; $x < 5; $x++) {
+	$code.=<<___;
+	vmovdqa64	$R[$x],$C[$x]
+	vpternlogq	\$0x96,$R[$x+10],$R[$x+5],$C[$x]
+	vpternlogq	\$0x96,$R[$x+20],$R[$x+15],$C[$x]
+___
+    }
+    for (my $x = 0; $x < 5; $x++) {
+	my $T = $T[$x & 1];
+
+	$code.="\tvprolq\t\$1,$C[($x+1)%5],$T\n";
+	for (my $y = 0; $y < 5; $y++) {
+	    $code.="\tvpternlogq\t\$0x96,$C[($x+4)%5],$T,$R[$x+5*$y]\n";
+	}
+    }
+    # Rho, Pi is just a renaming of the registers
+    my @Rn;
+    for (my $i = 0; $i < 25; $i++) {
+	$code.="\tvprolq\t\$$rhotates[$i],$R[$i],$R[$i]\n" if ($rhotates[$i]);
+	$Rn[$pi[$i]] = $R[$i];
+    }
+    @R = @Rn;
+    # Chi, b[0] and b[1] are overwritten before last use
+    for (my $y = 0; $y < 5; $y++) {
+	my @b = @R[5*$y .. 5*$y+4];
+
+	$code.=<<___;
+	vmovdqa64	$b[0],$C[0]
+	vmovdqa64	$b[1],$C[1]
+	vpternlogq	\$0xD2,$b[2],$b[1],$b[0]
+	vpternlogq	\$0xD2,$b[3],$b[2],$b[1]
+	vpternlogq	\$0xD2,$b[4],$b[3],$b[2]
+	vpternlogq	\$0xD2,$C[0],$b[4],$b[3]
+	vpternlogq	\$0xD2,$C[1],$C[0],$b[4]
+___
+    }
+    # Iota
+    $code.=<<___;
+	vpbroadcastq	`8*$round`($iotas),$T[0]
+	vpxorq	$T[0],$R[0],$R[0]
+___
+}
+die "register assignment is not restored"
+    if (join(",", @R) ne join(",", map("%zmm$_", (0..24))));
+
+for (my $i = 0; $i < 25; $i++) {
+    $code.="\tvmovdqu64\t$R[$i],`64*$i`($A)\n";
+}
+$code.=<<___;
+	vzeroupper
+___
+$code.=<<___	if ($win64);
+	movaps	-0xa8(%r9),%xmm6
+	movaps	-0x98(%r9),%xmm7
+	movaps	-0x88(%r9),%xmm8
+	movaps	-0x78(%r9),%xmm9
+	movaps	-0x68(%r9),%xmm10
+	movaps	-0x58(%r9),%xmm11
+	movaps	-0x48(%r9),%xmm12
+	movaps	-0x38(%r9),%xmm13
+	movaps	-0x28(%r9),%xmm14
+	movaps	-0x18(%r9),%xmm15
+___
+$code.=<<___;
+	lea	(%r9),%rsp
+.cfi_def_cfa_register	%rsp
+.Lx8_epilogue:
+	ret
+.cfi_endproc
+.size	keccak1600_x8_avx512,.-keccak1600_x8_avx512
+___
+}}} else {{{
+# Assembler doesn't support AVX512F, keccak1600_mb_lanes() never
+# returns 8 and this is never called.
+$code.=<<___;
+.globl	keccak1600_x8_avx512
+.type	keccak1600_x8_avx512,\@abi-omnipotent
+keccak1600_x8_avx512:
+	.byte	0x0f,0x0b	# ud2
+	ret
+.size	keccak1600_x8_avx512,.-keccak1600_x8_avx512
+___
+}}}
+
+$code.=<<___;
+.align	64
+iotas:
+	.quad	0x0000000000000001
+	.quad	0x0000000000008082
+	.quad	0x800000000000808a
+	.quad	0x8000000080008000
+	.quad	0x000000000000808b
+	.quad	0x0000000080000001
+	.quad	0x8000000080008081
+	.quad	0x8000000000008009
+	.quad	0x000000000000008a
+	.quad	0x0000000000000088
+	.quad	0x0000000080008009
+	.quad	0x000000008000000a
+	.quad	0x000000008000808b
+	.quad	0x800000000000008b
+	.quad	0x8000000000008089
+	.quad	0x8000000000008003
+	.quad	0x8000000000008002
+	.quad	0x8000000000000080
+	.quad	0x000000000000800a
+	.quad	0x800000008000000a
+	.quad	0x8000000080008081
+	.quad	0x8000000000008080
+	.quad	0x0000000080000001
+	.quad	0x8000000080008008
+___
+
+if ($win64) {
+# EXCEPTION_DISPOSITION handler (EXCEPTION_RECORD *rec,ULONG64 frame,
+#		CONTEXT *context,DISPATCHER_CONTEXT *disp)
+$rec="%rcx";
+$frame="%rdx";
+$context="%r8";
+$disp="%r9";
+
+$code.=<<___;
+.extern	__imp_RtlVirtualUnwind
+.type	simd_handler,\@abi-omnipotent
+.align	16
+simd_handler:
+	push	%rsi
+	push	%rdi
+	push	%rbx
+	push	%rbp
+	push	%r12
+	push	%r13
+	push	%r14
+	push	%r15
+	pushfq
+	sub	\$64,%rsp
+
+	mov	120($context),%rax	# pull context->Rax
+	mov	248($context),%rbx	# pull context->Rip
+
+	mov	8($disp),%rsi		# disp->ImageBase
+	mov	56($disp),%r11		# disp->HandlerData
+
+	mov	0(%r11),%r10d		# HandlerData[0]
+	lea	(%rsi,%r10),%r10	# prologue label
+	cmp	%r10,%rbx		# context->Rip<prologue label
+	jb	.Lcommon_seh_tail
+
+	mov	192($context),%rax	# pull context->R9
+
+	mov	4(%r11),%r10d		# HandlerData[1]
+	lea	(%rsi,%r10),%r10	# epilogue label
+	cmp	%r10,%rbx		# context->Rip>=epilogue label
+	jae	.Lcommon_seh_tail
+
+	lea	-0xa8(%rax),%rsi
+	lea	512($context),%rdi	# &context.Xmm6
+	mov	\$20,%ecx
+	.long	0xa548f3fc		# cld; rep movsq
+
+.Lcommon_seh_tail:
+	mov	8(%rax),%rdi
+	mov	16(%rax),%rsi
+	mov	%rax,152($context)	# restore context->Rsp
+	mov	%rsi,168($context)	# restore context->Rsi
+	mov	%rdi,176($context)	# restore context->Rdi
+
+	mov	40($disp),%rdi		# disp->ContextRecord
+	mov	$context,%rsi		# context
+	mov	\$154,%ecx		# sizeof(CONTEXT)
+	.long	0xa548f3fc		# cld; rep movsq
+
+	mov	$disp,%rsi
+	xor	%rcx,%rcx		# arg1, UNW_FLAG_NHANDLER
+	mov	8(%rsi),%rdx		# arg2, disp->ImageBase
+	mov	0(%rsi),%r8		# arg3, disp->ControlPc
+	mov	16(%rsi),%r9		# arg4, disp->FunctionEntry
+	mov	40(%rsi),%r10		# disp->ContextRecord
+	lea	56(%rsi),%r11		# &disp->HandlerData
+	lea	24(%rsi),%r12		# &disp->EstablisherFrame
+	mov	%r10,32(%rsp)		# arg5
+	mov	%r11,40(%rsp)		# arg6
+	mov	%r12,48(%rsp)		# arg7
+	mov	%rcx,56(%rsp)		# arg8, (NULL)
+	call	*__imp_RtlVirtualUnwind(%rip)
+
+	mov	\$1,%eax		# ExceptionContinueSearch
+	add	\$64,%rsp
+	popfq
+	pop	%r15
+	pop	%r14
+	pop	%r13
+	pop	%r12
+	pop	%rbp
+	pop	%rbx
+	pop	%rdi
+	pop	%rsi
+	ret
+.size	simd_handler,.-simd_handler
+
+.section	.pdata
+.align	4
+___
+$code.=<<___ if ($avx>1);
+	.rva	.LSEH_begin_keccak1600_x4_avx2
+	.rva	.LSEH_end_keccak1600_x4_avx2
+	.rva	.LSEH_info_keccak1600_x4_avx2
+___
+$code.=<<___ if ($avx>2);
+	.rva	.LSEH_begin_keccak1600_x8_avx512
+	.rva	.LSEH_end_keccak1600_x8_avx512
+	.rva	.LSEH_info_keccak1600_x8_avx512
+___
+$code.=<<___;
+.section	.xdata
+.align	8
+___
+$code.=<<___ if ($avx>1);
+.LSEH_info_keccak1600_x4_avx2:
+	.byte	9,0,0,0
+	.rva	simd_handler
+	.rva	.Lx4_body,.Lx4_epilogue		# HandlerData[]
+___
+$code.=<<___ if ($avx>2);
+.LSEH_info_keccak1600_x8_avx512:
+	.byte	9,0,0,0
+	.rva	simd_handler
+	.rva	.Lx8_body,.Lx8_epilogue		# HandlerData[]
+___
+}
+
+$code =~ s/\`([^\`]*)\`/eval($1)/gem;
+print $code;
+
+close STDOUT or die "error closing STDOUT: $!";
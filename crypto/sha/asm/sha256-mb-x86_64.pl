@@ -312,7 +312,7 @@ ___
 }
 $code.=<<___;
 	test	$num,$num
-	jz	.Ldone
+	jz	.Lnext				# all lanes are idle
 
 	movdqu	0x00-0x80($ctx),$A		# load context
 	 lea	128(%rsp),%rax
@@ -399,6 +399,7 @@ $code.=<<___;
 	dec	$num
 	jnz	.Loop
 
+.Lnext:
 	mov	`$REG_SZ*17+8`(%rsp),$num
 	lea	$REG_SZ($ctx),$ctx
 	lea	`$inp_elm_size*$REG_SZ/4`($inp),$inp
@@ -494,7 +495,7 @@ ___
 }
 $code.=<<___;
 	test	$num,$num
-	jz	.Ldone_shaext
+	jz	.Lskip_shaext			# both lanes are idle
 
 	movq		0x00-0x80($ctx),$ABEF0		# A1.A0
 	movq		0x20-0x80($ctx),@MSG0[0]	# B1.B0
@@ -764,10 +765,16 @@ $code.=<<___;
 	movq		$CDGH0,0x60-0x80($ctx)		# D1.D0
 	movq		@MSG0[1],0xe0-0x80($ctx)	# H1.H0
 
+.Lnext_shaext:
 	lea	`$REG_SZ/2`($ctx),$ctx
 	lea	`$inp_elm_size*2`($inp),$inp
 	dec	$num
 	jnz	.Loop_grande_shaext
+	jmp	.Ldone_shaext
+
+.Lskip_shaext:
+	mov	`$REG_SZ*17+8`(%rsp),$num
+	jmp	.Lnext_shaext
 
 .Ldone_shaext:
 	#mov	`$REG_SZ*17`(%rsp),%rax		# original %rsp
@@ -1017,7 +1024,7 @@ ___
 }
 $code.=<<___;
 	test	$num,$num
-	jz	.Ldone_avx
+	jz	.Lnext_avx			# all lanes are idle
 
 	vmovdqu	0x00-0x80($ctx),$A		# load context
 	 lea	128(%rsp),%rax
@@ -1102,6 +1109,7 @@ $code.=<<___;
 	dec	$num
 	jnz	.Loop_avx
 
+.Lnext_avx:
 	mov	`$REG_SZ*17+8`(%rsp),$num
 	lea	$REG_SZ($ctx),$ctx
 	lea	`$inp_elm_size*$REG_SZ/4`($inp),$inp
@@ -8,10 +8,25 @@
  */
 
 #include <string.h>
+#include <openssl/crypto.h>
 #include "internal/sha3.h"
 
 void SHA3_squeeze(uint64_t A[5][5], unsigned char *out, size_t len, size_t r);
 
+#if defined(KECCAK1600_ASM) && \
+    (defined(__x86_64) || defined(__x86_64__) || \
+     defined(_M_AMD64) || defined(_M_X64))
+# define KECCAK1600_MB_LANES 8
+
+/*
+ * The permutations take |lanes| interleaved states, A[i * lanes + j] is the
+ * i-th word of the state in lane |j|.
+ */
+int keccak1600_mb_lanes(void);
+void keccak1600_x4_avx2(uint64_t *A);
+void keccak1600_x8_avx512(uint64_t *A);
+#endif
+
 void ossl_sha3_reset(KECCAK1600_CTX *ctx)
 {
     memset(ctx->A, 0, sizeof(ctx->A));
@@ -107,3 +122,153 @@ int ossl_sha3_final(unsigned char *md, KECCAK1600_CTX *ctx)
 
     return 1;
 }
+
+#ifdef KECCAK1600_MB_LANES
+typedef struct {
+    const unsigned char *inp;   /* NULL once the padded tail is absorbed */
+    size_t len;                 /* input left */
+    unsigned char *out;
+    size_t outlen;              /* output left, 0 if the lane is idle */
+} SHA3_MB_LANE;
+
+static void sha3_mb_absorb(uint64_t *A, size_t lanes,
+                           const unsigned char *inp, size_t bsz)
+{
+    uint64_t w;
+    size_t i, k;
+
+    for (i = 0; i < bsz / 8; i++, inp += 8, A += lanes) {
+        for (w = 0, k = 8; k-- > 0;)
+            w = w << 8 | inp[k];
+        A[0] ^= w;
+    }
+}
+
+static void sha3_mb_squeeze(const uint64_t *A, size_t lanes,
+                            unsigned char *out, size_t len)
+{
+    uint64_t w;
+    size_t i;
+
+    for (; len >= 8; len -= 8, A += lanes)
+        for (w = A[0], i = 0; i < 8; i++, w >>= 8)
+            *out++ = (unsigned char)w;
+    for (w = A[0], i = 0; i < len; i++, w >>= 8)
+        *out++ = (unsigned char)w;
+}
+
+/*
+ * Each lane takes the next message as soon as it is done with the previous
+ * one, and then absorbs one block, or the padded tail, per permutation.
+ * Once the tail is absorbed the lane squeezes until all of the output is
+ * produced, so that messages and outputs of different lengths can share
+ * the permutations.
+ */
+static void sha3_mb(unsigned char pad, size_t bsz, size_t md_len,
+                    const unsigned char *const in[], const size_t inlen[],
+                    size_t num, unsigned char *const out[], size_t lanes)
+{
+    unsigned char storage[25 * KECCAK1600_MB_LANES * 8 + 64];
+    unsigned char tail[KECCAK1600_WIDTH / 8 - 32];
+    SHA3_MB_LANE lane[KECCAK1600_MB_LANES];
+    uint64_t *A;
+    size_t i, j, len, next = 0, active;
+
+    A = (uint64_t *)(storage + 64 - ((size_t)storage % 64));
+    memset(lane, 0, sizeof(lane));
+
+    for (;;) {
+        active = 0;
+        for (j = 0; j < lanes; j++) {
+            SHA3_MB_LANE *l = &lane[j];
+
+            if (l->outlen == 0) {
+                if (next == num)
+                    continue;
+                for (i = 0; i < 25; i++)
+                    A[i * lanes + j] = 0;
+                l->inp = in[next];
+                l->len = inlen[next];
+                l->out = out[next];
+                l->outlen = md_len;
+                next++;
+            }
+            active++;
+            if (l->inp == NULL)
+                continue;
+            if (l->len >= bsz) {
+                sha3_mb_absorb(A + j, lanes, l->inp, bsz);
+                l->inp += bsz;
+                l->len -= bsz;
+                continue;
+            }
+            /* Pad with 10*1, see ossl_sha3_final() */
+            memset(tail, 0, bsz);
+            if (l->len != 0)
+                memcpy(tail, l->inp, l->len);
+            tail[l->len] = pad;
+            tail[bsz - 1] |= 0x80;
+            sha3_mb_absorb(A + j, lanes, tail, bsz);
+            l->inp = NULL;
+        }
+        if (active == 0)
+            break;
+
+        if (lanes == 8)
+            keccak1600_x8_avx512(A);
+        else
+            keccak1600_x4_avx2(A);
+
+        for (j = 0; j < lanes; j++) {
+            SHA3_MB_LANE *l = &lane[j];
+
+            if (l->outlen == 0 || l->inp != NULL)
+                continue;
+            len = l->outlen < bsz ? l->outlen : bsz;
+            sha3_mb_squeeze(A + j, lanes, l->out, len);
+            l->out += len;
+            l->outlen -= len;
+        }
+    }
+
+    OPENSSL_cleanse(storage, sizeof(storage));
+    OPENSSL_cleanse(tail, sizeof(tail));
+}
+#endif
+
+/*
+ * Hash |num| independent messages, producing |md_len| bytes of output for
+ * each, with the Keccak parameters of ossl_sha3_init().  Where a multi-state
+ * permutation is available, the messages share it, otherwise they are
+ * hashed one at a time.
+ */
+void ossl_sha3_batch(unsigned char pad, size_t bitlen, size_t md_len,
+                     const unsigned char *const in[], const size_t inlen[],
+                     size_t num, unsigned char *const out[])
+{
+    KECCAK1600_CTX ctx;
+    size_t i;
+
+    if (md_len == 0)
+        return;
+
+#ifdef KECCAK1600_MB_LANES
+    if (num > 1) {
+        int lanes = keccak1600_mb_lanes();
+
+        if (lanes != 0) {
+            sha3_mb(pad, SHA3_BLOCKSIZE(bitlen), md_len, in, inlen, num, out,
+                    (size_t)lanes);
+            return;
+        }
+    }
+#endif
+
+    for (i = 0; i < num; i++) {
+        ossl_sha3_init(&ctx, pad, bitlen);
+        ctx.md_size = md_len;
+        ossl_sha3_update(&ctx, in[i], inlen[i]);
+        ossl_sha3_final(out[i], &ctx);
+    }
+    OPENSSL_cleanse(&ctx, sizeof(ctx));
+}
@@ -0,0 +1,602 @@
+/*
+ * Copyright 2021 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * SHA256/512 low level APIs are deprecated for public use, but still ok for
+ * internal use.
+ */
+#include "internal/deprecated.h"
+
+#include <string.h>
+
+#include <openssl/opensslconf.h>
+#include <openssl/crypto.h>
+#include <openssl/sha.h>
+#include <openssl/obj_mac.h>
+#include "internal/cryptlib.h"
+#include "crypto/sha.h"
+
+/*
+ * Hashing of many independent messages at once.  Where a multi-buffer
+ * transform is available, messages are taken in groups that fill the lanes
+ * of a vector register and their blocks are processed in parallel.  The
+ * complete blocks of each message are fed directly from the caller's buffer
+ * and only the padded tail is copied.  Anything else is hashed one message
+ * at a time.
+ */
+
+#if defined(__x86_64) || defined(__x86_64__) || \
+    defined(_M_AMD64) || defined(_M_X64)
+# if defined(SHA256_ASM)
+#  define SHA256_MB_LANES   8
+/* SSSE3 is the baseline of sha256_multi_block */
+#  define SHA256_MB_CAPABLE (OPENSSL_ia32cap_P[1] & (1 << (41 - 32)))
+# endif
+# if defined(SHA512_ASM)
+#  define SHA512_MB_LANES   4
+#  define SHA512_MB_CAPABLE sha512_multi_block_capable()
+# endif
+#endif
+
+/* Keep the per-lane block count of a single call within an int */
+#define MB_MAX_BLOCKS   (1 << 20)
+
+typedef struct {
+    const unsigned char *ptr;
+    int blocks;
+} HASH_DESC;
+
+#ifdef SHA256_MB_LANES
+/* h[i][lane] is the i-th state word (A..H) of the message in |lane| */
+typedef struct {
+    unsigned int h[8][SHA256_MB_LANES];
+} SHA256_MB_CTX;
+
+void sha256_multi_block(SHA256_MB_CTX *ctx, const HASH_DESC *inp, int n4x);
+
+static void sha256_mb(size_t md_len, const unsigned char *const in[],
+                      const size_t inlen[], size_t n,
+                      unsigned char *const out[])
+{
+    unsigned char storage[sizeof(SHA256_MB_CTX) + 32];
+    unsigned char tail[SHA256_MB_LANES][2 * SHA256_CBLOCK];
+    unsigned char md[SHA256_DIGEST_LENGTH];
+    HASH_DESC desc[SHA256_MB_LANES];
+    size_t done[SHA256_MB_LANES], left, len;
+    SHA256_MB_CTX *ctx;
+    SHA256_CTX iv;
+    int n4x = n > 4 ? 2 : 1, more;
+    size_t i, j;
+
+    ctx = (SHA256_MB_CTX *)(storage + 32 - ((size_t)storage % 32));
+
+    if (md_len == SHA224_DIGEST_LENGTH)
+        SHA224_Init(&iv);
+    else
+        SHA256_Init(&iv);
+    for (i = 0; i < 8; i++)
+        for (j = 0; j < SHA256_MB_LANES; j++)
+            ctx->h[i][j] = iv.h[i];
+
+    memset(desc, 0, sizeof(desc));
+    memset(done, 0, sizeof(done));
+
+    /* All complete blocks, straight from the input */
+    do {
+        more = 0;
+        for (i = 0; i < n; i++) {
+            left = (inlen[i] - done[i]) / SHA256_CBLOCK;
+            if (left > MB_MAX_BLOCKS)
+                left = MB_MAX_BLOCKS;
+            desc[i].ptr = in[i] + done[i];
+            desc[i].blocks = (int)left;
+            done[i] += left * SHA256_CBLOCK;
+            more |= left != 0;
+        }
+        if (more)
+            sha256_multi_block(ctx, desc, n4x);
+    } while (more);
+
+    /* The padded tails, one or two blocks each */
+    for (i = 0; i < n; i++) {
+        size_t bits = inlen[i] << 3, blocks;
+
+        len = inlen[i] - done[i];
+        blocks = len + 1 + 8 > SHA256_CBLOCK ? 2 : 1;
+        if (len != 0)
+            memcpy(tail[i], in[i] + done[i], len);
+        tail[i][len++] = 0x80;
+        memset(tail[i] + len, 0, blocks * SHA256_CBLOCK - 8 - len);
+        for (j = 1; j <= 8; j++, bits >>= 8)
+            tail[i][blocks * SHA256_CBLOCK - j] = (unsigned char)bits;
+        desc[i].ptr = tail[i];
+        desc[i].blocks = (int)blocks;
+    }
+    sha256_multi_block(ctx, desc, n4x);
+
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < 8; j++) {
+            unsigned int l = ctx->h[j][i];
+
+            md[4 * j] = (unsigned char)(l >> 24);
+            md[4 * j + 1] = (unsigned char)(l >> 16);
+            md[4 * j + 2] = (unsigned char)(l >> 8);
+            md[4 * j + 3] = (unsigned char)l;
+        }
+        memcpy(out[i], md, md_len);
+    }
+
+    OPENSSL_cleanse(storage, sizeof(storage));
+    OPENSSL_cleanse(tail, sizeof(tail));
+    OPENSSL_cleanse(md, sizeof(md));
+}
+
+static void sha256_hmac_pads(size_t md_len, const unsigned char *pass,
+                             size_t passlen, SHA256_CTX *ipad,
+                             SHA256_CTX *opad)
+{
+    unsigned char key[SHA256_CBLOCK], pad[SHA256_CBLOCK];
+    SHA256_CTX *c[2];
+    size_t i, j;
+
+    memset(key, 0, sizeof(key));
+    if (passlen > SHA256_CBLOCK) {
+        if (md_len == SHA224_DIGEST_LENGTH)
+            SHA224_Init(ipad);
+        else
+            SHA256_Init(ipad);
+        SHA256_Update(ipad, pass, passlen);
+        SHA256_Final(key, ipad);
+    } else if (passlen != 0) {
+        memcpy(key, pass, passlen);
+    }
+
+    c[0] = ipad;
+    c[1] = opad;
+    for (i = 0; i < 2; i++) {
+        for (j = 0; j < SHA256_CBLOCK; j++)
+            pad[j] = key[j] ^ (i == 0 ? 0x36 : 0x5c);
+        if (md_len == SHA224_DIGEST_LENGTH)
+            SHA224_Init(c[i]);
+        else
+            SHA256_Init(c[i]);
+        SHA256_Update(c[i], pad, SHA256_CBLOCK);
+    }
+
+    OPENSSL_cleanse(key, sizeof(key));
+    OPENSSL_cleanse(pad, sizeof(pad));
+}
+
+static void sha256_pbkdf2_mb(size_t md_len, const unsigned char *pass,
+                             size_t passlen, const unsigned char *salt,
+                             size_t saltlen, uint64_t iter, uint32_t block,
+                             size_t n, unsigned char *out)
+{
+    unsigned char storage[sizeof(SHA256_MB_CTX) + 32];
+    unsigned char u[SHA256_MB_LANES][SHA256_CBLOCK];
+    unsigned char itmp[4];
+    HASH_DESC desc[SHA256_MB_LANES];
+    SHA256_CTX ipad, opad, c;
+    SHA256_MB_CTX *ctx;
+    size_t bits = (SHA256_CBLOCK + md_len) << 3;
+    int n4x = n > 4 ? 2 : 1;
+    uint64_t k;
+    size_t i, j, m;
+
+    ctx = (SHA256_MB_CTX *)(storage + 32 - ((size_t)storage % 32));
+    sha256_hmac_pads(md_len, pass, passlen, &ipad, &opad);
+    memset(desc, 0, sizeof(desc));
+
+    /*
+     * U_1 covers the salt, so it is computed one lane at a time.  Every
+     * later U_j is the HMAC of U_{j-1}, a single padded block for both the
+     * inner and the outer hash, and the padding never changes.
+     */
+    for (i = 0; i < n; i++, block++) {
+        itmp[0] = (unsigned char)(block >> 24);
+        itmp[1] = (unsigned char)(block >> 16);
+        itmp[2] = (unsigned char)(block >> 8);
+        itmp[3] = (unsigned char)block;
+        c = ipad;
+        SHA256_Update(&c, salt, saltlen);
+        SHA256_Update(&c, itmp, 4);
+        SHA256_Final(u[i], &c);
+        c = opad;
+        SHA256_Update(&c, u[i], md_len);
+        SHA256_Final(u[i], &c);
+        memcpy(out + i * md_len, u[i], md_len);
+
+        u[i][md_len] = 0x80;
+        memset(u[i] + md_len + 1, 0, SHA256_CBLOCK - 8 - md_len - 1);
+        for (j = 1, m = bits; j <= 8; j++, m >>= 8)
+            u[i][SHA256_CBLOCK - j] = (unsigned char)m;
+        desc[i].ptr = u[i];
+        desc[i].blocks = 1;
+    }
+
+    for (k = 1; k < iter; k++) {
+        for (m = 0; m < 2; m++) {
+            const SHA256_CTX *pad = m == 0 ? &ipad : &opad;
+
+            for (j = 0; j < 8; j++)
+                for (i = 0; i < n; i++)
+                    ctx->h[j][i] = pad->h[j];
+            sha256_multi_block(ctx, desc, n4x);
+            for (i = 0; i < n; i++)
+                for (j = 0; j < md_len / 4; j++) {
+                    unsigned int l = ctx->h[j][i];
+
+                    u[i][4 * j] = (unsigned char)(l >> 24);
+                    u[i][4 * j + 1] = (unsigned char)(l >> 16);
+                    u[i][4 * j + 2] = (unsigned char)(l >> 8);
+                    u[i][4 * j + 3] = (unsigned char)l;
+                }
+        }
+        for (i = 0; i < n; i++)
+            for (j = 0; j < md_len; j++)
+                out[i * md_len + j] ^= u[i][j];
+    }
+
+    OPENSSL_cleanse(storage, sizeof(storage));
+    OPENSSL_cleanse(u, sizeof(u));
+    OPENSSL_cleanse(&ipad, sizeof(ipad));
+    OPENSSL_cleanse(&opad, sizeof(opad));
+    OPENSSL_cleanse(&c, sizeof(c));
+}
+#endif
+
+#ifdef SHA512_MB_LANES
+/* h[i][lane] is the i-th state word (A..H) of the message in |lane| */
+typedef struct {
+    SHA_LONG64 h[8][SHA512_MB_LANES];
+} SHA512_MB_CTX;
+
+int sha512_multi_block_capable(void);
+void sha512_multi_block(SHA512_MB_CTX *ctx, const HASH_DESC *inp);
+
+static void sha512_mb(size_t md_len, const unsigned char *const in[],
+                      const size_t inlen[], size_t n,
+                      unsigned char *const out[])
+{
+    unsigned char storage[sizeof(SHA512_MB_CTX) + 32];
+    unsigned char tail[SHA512_MB_LANES][2 * SHA512_CBLOCK];
+    unsigned char md[SHA512_DIGEST_LENGTH];
+    HASH_DESC desc[SHA512_MB_LANES];
+    size_t done[SHA512_MB_LANES], left, len;
+    SHA512_MB_CTX *ctx;
+    SHA512_CTX iv;
+    int more;
+    size_t i, j;
+
+    ctx = (SHA512_MB_CTX *)(storage + 32 - ((size_t)storage % 32));
+
+    switch (md_len) {
+    case SHA224_DIGEST_LENGTH:
+        sha512_224_init(&iv);
+        break;
+    case SHA256_DIGEST_LENGTH:
+        sha512_256_init(&iv);
+        break;
+    case SHA384_DIGEST_LENGTH:
+        SHA384_Init(&iv);
+        break;
+    default:
+        SHA512_Init(&iv);
+        break;
+    }
+    for (i = 0; i < 8; i++)
+        for (j = 0; j < SHA512_MB_LANES; j++)
+            ctx->h[i][j] = iv.h[i];
+
+    memset(desc, 0, sizeof(desc));
+    memset(done, 0, sizeof(done));
+
+    /* All complete blocks, straight from the input */
+    do {
+        more = 0;
+        for (i = 0; i < n; i++) {
+            left = (inlen[i] - done[i]) / SHA512_CBLOCK;
+            if (left > MB_MAX_BLOCKS)
+                left = MB_MAX_BLOCKS;
+            desc[i].ptr = in[i] + done[i];
+            desc[i].blocks = (int)left;
+            done[i] += left * SHA512_CBLOCK;
+            more |= left != 0;
+        }
+        if (more)
+            sha512_multi_block(ctx, desc);
+    } while (more);
+
+    /* The padded tails, one or two blocks each, with a 128-bit length */
+    for (i = 0; i < n; i++) {
+        SHA_LONG64 bits = (SHA_LONG64)inlen[i] << 3;
+        size_t blocks;
+
+        len = inlen[i] - done[i];
+        blocks = len + 1 + 16 > SHA512_CBLOCK ? 2 : 1;
+        if (len != 0)
+            memcpy(tail[i], in[i] + done[i], len);
+        tail[i][len++] = 0x80;
+        memset(tail[i] + len, 0, blocks * SHA512_CBLOCK - 8 - len);
+        for (j = 1; j <= 8; j++, bits >>= 8)
+            tail[i][blocks * SHA512_CBLOCK - j] = (unsigned char)bits;
+        tail[i][blocks * SHA512_CBLOCK - 9] =
+            (unsigned char)((SHA_LONG64)inlen[i] >> 61);
+        desc[i].ptr = tail[i];
+        desc[i].blocks = (int)blocks;
+    }
+    sha512_multi_block(ctx, desc);
+
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < 8; j++) {
+            SHA_LONG64 l = ctx->h[j][i];
+            size_t k;
+
+            for (k = 8; k-- > 0; l >>= 8)
+                md[8 * j + k] = (unsigned char)l;
+        }
+        memcpy(out[i], md, md_len);
+    }
+
+    OPENSSL_cleanse(storage, sizeof(storage));
+    OPENSSL_cleanse(tail, sizeof(tail));
+    OPENSSL_cleanse(md, sizeof(md));
+}
+
+static void sha512_init(size_t md_len, SHA512_CTX *c)
+{
+    switch (md_len) {
+    case SHA224_DIGEST_LENGTH:
+        sha512_224_init(c);
+        break;
+    case SHA256_DIGEST_LENGTH:
+        sha512_256_init(c);
+        break;
+    case SHA384_DIGEST_LENGTH:
+        SHA384_Init(c);
+        break;
+    default:
+        SHA512_Init(c);
+        break;
+    }
+}
+
+static void sha512_hmac_pads(size_t md_len, const unsigned char *pass,
+                             size_t passlen, SHA512_CTX *ipad,
+                             SHA512_CTX *opad)
+{
+    unsigned char key[SHA512_CBLOCK], pad[SHA512_CBLOCK];
+    SHA512_CTX *c[2];
+    size_t i, j;
+
+    memset(key, 0, sizeof(key));
+    if (passlen > SHA512_CBLOCK) {
+        sha512_init(md_len, ipad);
+        SHA512_Update(ipad, pass, passlen);
+        SHA512_Final(key, ipad);
+    } else if (passlen != 0) {
+        memcpy(key, pass, passlen);
+    }
+
+    c[0] = ipad;
+    c[1] = opad;
+    for (i = 0; i < 2; i++) {
+        for (j = 0; j < SHA512_CBLOCK; j++)
+            pad[j] = key[j] ^ (i == 0 ? 0x36 : 0x5c);
+        sha512_init(md_len, c[i]);
+        SHA512_Update(c[i], pad, SHA512_CBLOCK);
+    }
+
+    OPENSSL_cleanse(key, sizeof(key));
+    OPENSSL_cleanse(pad, sizeof(pad));
+}
+
+static void sha512_pbkdf2_mb(size_t md_len, const unsigned char *pass,
+                             size_t passlen, const unsigned char *salt,
+                             size_t saltlen, uint64_t iter, uint32_t block,
+                             size_t n, unsigned char *out)
+{
+    unsigned char storage[sizeof(SHA512_MB_CTX) + 32];
+    unsigned char u[SHA512_MB_LANES][SHA512_CBLOCK];
+    unsigned char itmp[4];
+    HASH_DESC desc[SHA512_MB_LANES];
+    SHA512_CTX ipad, opad, c;
+    SHA512_MB_CTX *ctx;
+    size_t bits = (SHA512_CBLOCK + md_len) << 3;
+    uint64_t k;
+    size_t i, j, m;
+
+    ctx = (SHA512_MB_CTX *)(storage + 32 - ((size_t)storage % 32));
+    sha512_hmac_pads(md_len, pass, passlen, &ipad, &opad);
+    memset(desc, 0, sizeof(desc));
+
+    /* As for SHA-256, only U_1 is not a single block per hash */
+    for (i = 0; i < n; i++, block++) {
+        itmp[0] = (unsigned char)(block >> 24);
+        itmp[1] = (unsigned char)(block >> 16);
+        itmp[2] = (unsigned char)(block >> 8);
+        itmp[3] = (unsigned char)block;
+        c = ipad;
+        SHA512_Update(&c, salt, saltlen);
+        SHA512_Update(&c, itmp, 4);
+        SHA512_Final(u[i], &c);
+        c = opad;
+        SHA512_Update(&c, u[i], md_len);
+        SHA512_Final(u[i], &c);
+        memcpy(out + i * md_len, u[i], md_len);
+
+        u[i][md_len] = 0x80;
+        memset(u[i] + md_len + 1, 0, SHA512_CBLOCK - 8 - md_len - 1);
+        for (j = 1, m = bits; j <= 8; j++, m >>= 8)
+            u[i][SHA512_CBLOCK - j] = (unsigned char)m;
+        desc[i].ptr = u[i];
+        desc[i].blocks = 1;
+    }
+
+    for (k = 1; k < iter; k++) {
+        for (m = 0; m < 2; m++) {
+            const SHA512_CTX *pad = m == 0 ? &ipad : &opad;
+
+            for (j = 0; j < 8; j++)
+                for (i = 0; i < n; i++)
+                    ctx->h[j][i] = pad->h[j];
+            sha512_multi_block(ctx, desc);
+            /* SHA-512/224 ends in half a word */
+            for (i = 0; i < n; i++)
+                for (j = 0; j < md_len; j++)
+                    u[i][j] = (unsigned char)(ctx->h[j / 8][i]
+                                              >> (56 - 8 * (j % 8)));
+        }
+        for (i = 0; i < n; i++)
+            for (j = 0; j < md_len; j++)
+                out[i * md_len + j] ^= u[i][j];
+    }
+
+    OPENSSL_cleanse(storage, sizeof(storage));
+    OPENSSL_cleanse(u, sizeof(u));
+    OPENSSL_cleanse(&ipad, sizeof(ipad));
+    OPENSSL_cleanse(&opad, sizeof(opad));
+    OPENSSL_cleanse(&c, sizeof(c));
+}
+#endif
+
+void ossl_sha256_batch(size_t md_len, const unsigned char *const in[],
+                       const size_t inlen[], size_t num,
+                       unsigned char *const out[])
+{
+    SHA256_CTX c;
+    size_t i = 0;
+
+#ifdef SHA256_MB_LANES
+    if (num > 1 && SHA256_MB_CAPABLE) {
+        size_t n;
+
+        for (; num - i > 1; i += n) {
+            n = num - i < SHA256_MB_LANES ? num - i : SHA256_MB_LANES;
+            sha256_mb(md_len, in + i, inlen + i, n, out + i);
+        }
+    }
+#endif
+
+    for (; i < num; i++) {
+        if (md_len == SHA224_DIGEST_LENGTH)
+            SHA224_Init(&c);
+        else
+            SHA256_Init(&c);
+        SHA256_Update(&c, in[i], inlen[i]);
+        SHA256_Final(out[i], &c);
+        OPENSSL_cleanse(&c, sizeof(c));
+    }
+}
+
+void ossl_sha512_batch(size_t md_len, const unsigned char *const in[],
+                       const size_t inlen[], size_t num,
+                       unsigned char *const out[])
+{
+    SHA512_CTX c;
+    size_t i = 0;
+
+#ifdef SHA512_MB_LANES
+    if (num > 1 && SHA512_MB_CAPABLE) {
+        size_t n;
+
+        for (; num - i > 1; i += n) {
+            n = num - i < SHA512_MB_LANES ? num - i : SHA512_MB_LANES;
+            sha512_mb(md_len, in + i, inlen + i, n, out + i);
+        }
+    }
+#endif
+
+    for (; i < num; i++) {
+        switch (md_len) {
+        case SHA224_DIGEST_LENGTH:
+            sha512_224_init(&c);
+            break;
+        case SHA256_DIGEST_LENGTH:
+            sha512_256_init(&c);
+            break;
+        case SHA384_DIGEST_LENGTH:
+            SHA384_Init(&c);
+            break;
+        default:
+            SHA512_Init(&c);
+            break;
+        }
+        SHA512_Update(&c, in[i], inlen[i]);
+        SHA512_Final(out[i], &c);
+        OPENSSL_cleanse(&c, sizeof(c));
+    }
+}
+
+#if defined(SHA256_MB_LANES) || defined(SHA512_MB_LANES)
+static size_t sha2_md_len(int nid)
+{
+    switch (nid) {
+    case NID_sha224:
+    case NID_sha512_224:
+        return SHA224_DIGEST_LENGTH;
+    case NID_sha256:
+    case NID_sha512_256:
+        return SHA256_DIGEST_LENGTH;
+    case NID_sha384:
+        return SHA384_DIGEST_LENGTH;
+    case NID_sha512:
+        return SHA512_DIGEST_LENGTH;
+    }
+    return 0;
+}
+#endif
+
+size_t ossl_sha2_pbkdf2_lanes(int nid)
+{
+    switch (nid) {
+#ifdef SHA256_MB_LANES
+    case NID_sha224:
+    case NID_sha256:
+        return SHA256_MB_CAPABLE ? SHA256_MB_LANES : 0;
+#endif
+#ifdef SHA512_MB_LANES
+    case NID_sha384:
+    case NID_sha512:
+    case NID_sha512_224:
+    case NID_sha512_256:
+        return SHA512_MB_CAPABLE ? SHA512_MB_LANES : 0;
+#endif
+    }
+    return 0;
+}
+
+int ossl_sha2_pbkdf2(int nid, const unsigned char *pass, size_t passlen,
+                     const unsigned char *salt, size_t saltlen,
+                     uint64_t iter, uint32_t block, size_t n,
+                     unsigned char *out)
+{
+    if (n == 0 || n > ossl_sha2_pbkdf2_lanes(nid) || iter == 0)
+        return 0;
+
+    switch (nid) {
+#ifdef SHA256_MB_LANES
+    case NID_sha224:
+    case NID_sha256:
+        sha256_pbkdf2_mb(sha2_md_len(nid), pass, passlen, salt, saltlen,
+                         iter, block, n, out);
+        return 1;
+#endif
+#ifdef SHA512_MB_LANES
+    case NID_sha384:
+    case NID_sha512:
+    case NID_sha512_224:
+    case NID_sha512_256:
+        sha512_pbkdf2_mb(sha2_md_len(nid), pass, passlen, salt, saltlen,
+                         iter, block, n, out);
+        return 1;
+#endif
+    }
+    return 0;
+}
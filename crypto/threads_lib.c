@@ -1,12 +1,14 @@
 /*
- * Copyright 2020 The OpenSSL Project Authors. All Rights Reserved.
+ * Copyright 2020-2021 The OpenSSL Project Authors. All Rights Reserved.
  *
  * Licensed under the Apache License 2.0 (the "License").  You may not use
  * this file except in compliance with the License.  You can obtain a copy
  * in the file LICENSE in the source distribution or at
  * https://www.openssl.org/source/license.html
  */
+#include <limits.h>
 #include <openssl/crypto.h>
+#include "internal/thread.h"
 
 #ifndef OPENSSL_NO_DEPRECATED_3_0
 
@@ -23,3 +25,86 @@ void OPENSSL_fork_child(void)
 }
 
 #endif
+
+typedef struct {
+    int (*fn)(void *arg, size_t job, size_t worker);
+    void *arg;
+    size_t jobs;
+    size_t worker;
+    int *next;                  /* number of jobs taken, shared */
+    CRYPTO_RWLOCK *lock;
+    int ok;
+} PARALLEL_WORKER;
+
+static void parallel_worker(void *data)
+{
+    PARALLEL_WORKER *w = data;
+    int taken;
+
+    while (CRYPTO_atomic_add(w->next, 1, &taken, w->lock)
+           && (size_t)taken <= w->jobs)
+        if (!w->fn(w->arg, (size_t)taken - 1, w->worker))
+            w->ok = 0;
+}
+
+int ossl_crypto_parallel_run(size_t jobs, size_t max_threads,
+                             int (*fn)(void *arg, size_t job, size_t worker),
+                             void *arg)
+{
+    PARALLEL_WORKER *w = NULL;
+    CRYPTO_THREAD **threads = NULL;
+    CRYPTO_RWLOCK *lock = NULL;
+    size_t i, started = 0;
+    int next = 0, ret = 1;
+
+#ifdef FIPS_MODULE
+    /* The FIPS provider does not start threads of its own */
+    max_threads = 1;
+#endif
+    if (max_threads > jobs)
+        max_threads = jobs;
+    if (max_threads > 1 && jobs <= INT_MAX
+            && (w = OPENSSL_zalloc(max_threads * sizeof(*w))) != NULL
+            && (threads = OPENSSL_zalloc(max_threads
+                                         * sizeof(*threads))) != NULL)
+        lock = CRYPTO_THREAD_lock_new();
+    if (lock == NULL) {
+        for (i = 0; i < jobs; i++)
+            if (!fn(arg, i, 0))
+                ret = 0;
+        goto end;
+    }
+
+    for (i = 0; i < max_threads; i++) {
+        w[i].fn = fn;
+        w[i].arg = arg;
+        w[i].jobs = jobs;
+        w[i].worker = i;
+        w[i].next = &next;
+        w[i].lock = lock;
+        w[i].ok = 1;
+    }
+    /* Worker 0 is the calling thread */
+    for (started = 1; started < max_threads; started++) {
+        threads[started] = ossl_crypto_thread_native_start(parallel_worker,
+                                                           &w[started]);
+        if (threads[started] == NULL)
+            break;
+    }
+    parallel_worker(&w[0]);
+    for (i = 0; i < started; i++) {
+        if (i > 0 && !ossl_crypto_thread_native_join(threads[i]))
+            ret = 0;
+        if (!w[i].ok)
+            ret = 0;
+    }
+    /* Some jobs were never taken if CRYPTO_atomic_add() failed */
+    if (next <= (int)jobs)
+        ret = 0;
+
+ end:
+    CRYPTO_THREAD_lock_free(lock);
+    OPENSSL_free(threads);
+    OPENSSL_free(w);
+    return ret;
+}
@@ -9,6 +9,7 @@
 
 #include <openssl/crypto.h>
 #include "internal/cryptlib.h"
+#include "internal/thread.h"
 
 #if !defined(OPENSSL_THREADS) || defined(CRYPTO_TDEBUG)
 
@@ -162,4 +163,15 @@ int openssl_get_fork_id(void)
     return 0;
 # endif
 }
+
+CRYPTO_THREAD *ossl_crypto_thread_native_start(void (*routine)(void *),
+                                               void *data)
+{
+    return NULL;
+}
+
+int ossl_crypto_thread_native_join(CRYPTO_THREAD *thread)
+{
+    return 0;
+}
 #endif
@@ -12,6 +12,7 @@
 
 #include <openssl/crypto.h>
 #include "internal/cryptlib.h"
+#include "internal/thread.h"
 
 #if defined(__sun)
 # include <atomic.h>
@@ -288,4 +289,45 @@ int openssl_get_fork_id(void)
 {
     return getpid();
 }
+
+struct crypto_thread_st {
+    pthread_t handle;
+    void (*routine)(void *);
+    void *data;
+};
+
+static void *thread_start(void *vthread)
+{
+    CRYPTO_THREAD *thread = vthread;
+
+    thread->routine(thread->data);
+    return NULL;
+}
+
+CRYPTO_THREAD *ossl_crypto_thread_native_start(void (*routine)(void *),
+                                               void *data)
+{
+    CRYPTO_THREAD *thread;
+
+    if ((thread = OPENSSL_zalloc(sizeof(*thread))) == NULL)
+        return NULL;
+    thread->routine = routine;
+    thread->data = data;
+    if (pthread_create(&thread->handle, NULL, thread_start, thread) != 0) {
+        OPENSSL_free(thread);
+        return NULL;
+    }
+    return thread;
+}
+
+int ossl_crypto_thread_native_join(CRYPTO_THREAD *thread)
+{
+    int ret;
+
+    if (thread == NULL)
+        return 0;
+    ret = pthread_join(thread->handle, NULL) == 0;
+    OPENSSL_free(thread);
+    return ret;
+}
 #endif
@@ -16,6 +16,7 @@
 #endif
 
 #include <openssl/crypto.h>
+#include "internal/thread.h"
 
 #if defined(OPENSSL_THREADS) && !defined(CRYPTO_TDEBUG) && defined(OPENSSL_SYS_WINDOWS)
 
@@ -227,4 +228,47 @@ int openssl_get_fork_id(void)
 {
     return 0;
 }
+
+struct crypto_thread_st {
+    HANDLE handle;
+    void (*routine)(void *);
+    void *data;
+};
+
+static DWORD WINAPI thread_start(LPVOID vthread)
+{
+    CRYPTO_THREAD *thread = vthread;
+
+    thread->routine(thread->data);
+    return 0;
+}
+
+CRYPTO_THREAD *ossl_crypto_thread_native_start(void (*routine)(void *),
+                                               void *data)
+{
+    CRYPTO_THREAD *thread;
+
+    if ((thread = OPENSSL_zalloc(sizeof(*thread))) == NULL)
+        return NULL;
+    thread->routine = routine;
+    thread->data = data;
+    thread->handle = CreateThread(NULL, 0, thread_start, thread, 0, NULL);
+    if (thread->handle == NULL) {
+        OPENSSL_free(thread);
+        return NULL;
+    }
+    return thread;
+}
+
+int ossl_crypto_thread_native_join(CRYPTO_THREAD *thread)
+{
+    int ret;
+
+    if (thread == NULL)
+        return 0;
+    ret = WaitForSingleObject(thread->handle, INFINITE) == WAIT_OBJECT_0;
+    CloseHandle(thread->handle);
+    OPENSSL_free(thread);
+    return ret;
+}
 #endif
@@ -148,6 +148,15 @@ void gcm_ghash_v8(u64 Xi[2],const u128 Htable[16],const u8 *inp, size_t len);
 #  endif
 #  ifdef BSAES_ASM
 #   define BSAES_CAPABLE   (OPENSSL_ia32cap_P[1]&(1<<(41-32)))
+/* AVX2 */
+#   define BSAES_AVX2_CAPABLE (BSAES_CAPABLE && \
+                               (OPENSSL_ia32cap_P[2] & (1 << 5)))
+void ossl_bsaes_ctr32_encrypt_blocks_avx2(const unsigned char *in,
+                                          unsigned char *out, size_t len,
+                                          const AES_KEY *key,
+                                          const unsigned char ivec[16]);
+void ossl_bsaes_encrypt_block_avx2(const unsigned char *in, unsigned char *out,
+                                   const AES_KEY *key);
 #  endif
 
 #  define AES_GCM_ENC_BYTES 32
@@ -227,6 +236,21 @@ void gcm_ghash_avx(u64 Xi[2], const u128 Htable[16], const u8 *in, size_t len);
 #   define AES_gcm_decrypt aesni_gcm_decrypt
 #   define AES_GCM_ASM(ctx)    (ctx->ctr == aesni_ctr32_encrypt_blocks && \
                                 ctx->gcm.ghash == gcm_ghash_avx)
+
+/* AVX2, VAES and VPCLMULQDQ */
+#   define AES_GCM_VAES_CAPABLE (AESNI_CAPABLE && \
+                                 (OPENSSL_ia32cap_P[2] & (1 << 5)) && \
+                                 (OPENSSL_ia32cap_P[3] & (3 << 9)) == (3 << 9))
+
+void ossl_gcm_init_vaes_avx2(u128 Htable[16], const u64 H[2]);
+size_t ossl_aes_gcm_encrypt_vaes_avx2(const unsigned char *in,
+                                      unsigned char *out, size_t len,
+                                      const void *key, unsigned char ivec[16],
+                                      u64 *Xi, const u128 Htable[16]);
+size_t ossl_aes_gcm_decrypt_vaes_avx2(const unsigned char *in,
+                                      unsigned char *out, size_t len,
+                                      const void *key, unsigned char ivec[16],
+                                      u64 *Xi, const u128 Htable[16]);
 #  endif
 
 
@@ -87,6 +87,8 @@ EC_KEY *ossl_ec_key_from_pkcs8(const PKCS8_PRIV_KEY_INFO *p8inf,
                                OSSL_LIB_CTX *libctx, const char *propq);
 
 int ossl_ec_set_ecdh_cofactor_mode(EC_KEY *ec, int mode);
+int ossl_ec_key_set_pub_pre_comp(EC_KEY *key, int enable);
+size_t ossl_ec_key_pub_pre_comp_size(const EC_KEY *key);
 int ossl_ec_encoding_name2id(const char *name);
 int ossl_ec_encoding_param2id(const OSSL_PARAM *p, int *id);
 int ossl_ec_pt_format_name2id(const char *name);
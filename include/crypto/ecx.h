@@ -102,6 +102,14 @@ ossl_ed25519_verify(const uint8_t *message, size_t message_len,
                     const uint8_t signature[64], const uint8_t public_key[32],
                     OSSL_LIB_CTX *libctx, const char *propq);
 
+int
+ossl_ed25519_verify_batch(const uint8_t *const messages[],
+                          const size_t message_lens[],
+                          const uint8_t *const signatures[],
+                          const uint8_t *const public_keys[], size_t num,
+                          int results[], OSSL_LIB_CTX *libctx,
+                          const char *propq);
+
 int
 ossl_ed448_public_from_private(OSSL_LIB_CTX *ctx, uint8_t out_public_key[57],
                                const uint8_t private_key[57], const char *propq);
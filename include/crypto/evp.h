@@ -286,6 +286,7 @@ struct evp_md_st {
     OSSL_FUNC_digest_update_fn *dupdate;
     OSSL_FUNC_digest_final_fn *dfinal;
     OSSL_FUNC_digest_digest_fn *digest;
+    OSSL_FUNC_digest_digest_batch_fn *digest_batch;
     OSSL_FUNC_digest_freectx_fn *freectx;
     OSSL_FUNC_digest_dupctx_fn *dupctx;
     OSSL_FUNC_digest_get_params_fn *get_params;
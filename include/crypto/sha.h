@@ -13,10 +13,29 @@
 # pragma once
 
 # include <openssl/sha.h>
+# include <openssl/e_os2.h>
 
 int sha512_224_init(SHA512_CTX *);
 int sha512_256_init(SHA512_CTX *);
 int ossl_sha1_ctrl(SHA_CTX *ctx, int cmd, int mslen, void *ms);
 unsigned char *ossl_sha1(const unsigned char *d, size_t n, unsigned char *md);
+void ossl_sha256_batch(size_t md_len, const unsigned char *const in[],
+                       const size_t inlen[], size_t num,
+                       unsigned char *const out[]);
+void ossl_sha512_batch(size_t md_len, const unsigned char *const in[],
+                       const size_t inlen[], size_t num,
+                       unsigned char *const out[]);
+
+/*
+ * PBKDF2 with HMAC over the SHA-2 digest |nid|, computing the |n| output
+ * blocks numbered |block| onwards into |out| side by side.  |n| may not
+ * exceed ossl_sha2_pbkdf2_lanes(), which is 0 when no multi-buffer
+ * transform can be used for |nid|.
+ */
+size_t ossl_sha2_pbkdf2_lanes(int nid);
+int ossl_sha2_pbkdf2(int nid, const unsigned char *pass, size_t passlen,
+                     const unsigned char *salt, size_t saltlen,
+                     uint64_t iter, uint32_t block, size_t n,
+                     unsigned char *out);
 
 #endif
@@ -197,6 +197,15 @@ static ossl_inline ossl_ssize_t ktls_sendfile(int s, int fd, off_t off,
     return sbytes;
 }
 
+/*
+ * Whether new TLSv1.3 keys can be passed to the kernel after a KeyUpdate.
+ * Not supported.
+ */
+static ossl_inline int ktls_tls13_key_update_supported(void)
+{
+    return 0;
+}
+
 #  endif                         /* __FreeBSD__ */
 
 #  if defined(OPENSSL_SYS_LINUX)
@@ -223,7 +232,13 @@ static ossl_inline ossl_ssize_t ktls_sendfile(int s, int fd, off_t off,
 #    endif
 #   endif
 
+#   if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 14, 0)
+#    define OPENSSL_KTLS_TLS13_KEY_UPDATE
+#   endif
+
+#   include <stdio.h>
 #   include <sys/sendfile.h>
+#   include <sys/utsname.h>
 #   include <netinet/tcp.h>
 #   include <linux/socket.h>
 #   include <openssl/ssl3.h>
@@ -334,6 +349,27 @@ static ossl_inline ossl_ssize_t ktls_sendfile(int s, int fd, off_t off, size_t s
     return sendfile(s, fd, &off, size);
 }
 
+/*
+ * Whether new TLSv1.3 keys can be passed to the kernel after a KeyUpdate,
+ * by setting TLS_TX or TLS_RX again.  The kernel headers only tell what the
+ * kernel we were built for can do, so check the running kernel as well:
+ * older ones refuse the new keys.
+ */
+static ossl_inline int ktls_tls13_key_update_supported(void)
+{
+#   ifdef OPENSSL_KTLS_TLS13_KEY_UPDATE
+    struct utsname name;
+    int major, minor;
+
+    if (uname(&name) != 0
+            || sscanf(name.release, "%d.%d", &major, &minor) != 2)
+        return 0;
+    return major > 6 || (major == 6 && minor >= 14);
+#   else
+    return 0;
+#   endif
+}
+
 #   ifdef OPENSSL_NO_KTLS_RX
 
 
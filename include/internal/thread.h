@@ -0,0 +1,38 @@
+/*
+ * Copyright 2021 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#ifndef OSSL_INTERNAL_THREAD_H
+# define OSSL_INTERNAL_THREAD_H
+# pragma once
+
+# include <stddef.h>
+
+typedef struct crypto_thread_st CRYPTO_THREAD;
+
+/*
+ * Start a thread running |routine(data)|.  Returns NULL if threads are not
+ * supported or the thread could not be created.  Every thread that was
+ * started must be joined, which also frees it.
+ */
+CRYPTO_THREAD *ossl_crypto_thread_native_start(void (*routine)(void *),
+                                               void *data);
+int ossl_crypto_thread_native_join(CRYPTO_THREAD *thread);
+
+/*
+ * Call |fn(arg, job, worker)| for each |job| from 0 to |jobs| - 1, on up to
+ * |max_threads| threads including the calling one.  |worker| identifies
+ * the thread, it is less than |max_threads| and the jobs of one worker are
+ * run one after the other.  The jobs are run in the calling thread if no
+ * other threads can be started.  Returns 1 when all |fn| calls returned 1.
+ */
+int ossl_crypto_parallel_run(size_t jobs, size_t max_threads,
+                             int (*fn)(void *arg, size_t job, size_t worker),
+                             void *arg);
+
+#endif
@@ -220,6 +220,7 @@ extern "C" {
 #define OSSL_KDF_PARAM_X942_SUPP_PUBINFO    "supp-pubinfo"
 #define OSSL_KDF_PARAM_X942_SUPP_PRIVINFO   "supp-privinfo"
 #define OSSL_KDF_PARAM_X942_USE_KEYBITS     "use-keybits"
+#define OSSL_KDF_PARAM_THREADS      "threads"   /* uint32_t */
 
 /* Known KDF names */
 #define OSSL_KDF_NAME_HKDF           "HKDF"
@@ -414,6 +415,8 @@ extern "C" {
 #define OSSL_PKEY_PARAM_EC_POINT_CONVERSION_FORMAT "point-format"
 #define OSSL_PKEY_PARAM_EC_GROUP_CHECK_TYPE        "group-check"
 #define OSSL_PKEY_PARAM_EC_INCLUDE_PUBLIC          "include-public"
+#define OSSL_PKEY_PARAM_EC_PUB_PRECOMP             "pub-precomp"
+#define OSSL_PKEY_PARAM_EC_PUB_PRECOMP_SIZE        "pub-precomp-size"
 
 /* OSSL_PKEY_PARAM_EC_ENCODING values */
 #define OSSL_PKEY_EC_ENCODING_EXPLICIT  "explicit"
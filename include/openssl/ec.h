@@ -939,6 +939,7 @@ OSSL_DEPRECATEDIN_3_0 int ECPKParameters_print_fp(FILE *fp, const EC_GROUP *x,
 
 /* some values for the flags field */
 #  define EC_FLAG_SM2_RANGE              0x0004
+#  define EC_FLAG_NO_PUBKEY_PRECOMP      0x0008
 #  define EC_FLAG_COFACTOR_ECDH          0x1000
 #  define EC_FLAG_CHECK_NAMED_GROUP      0x2000
 #  define EC_FLAG_CHECK_NAMED_GROUP_NIST 0x4000
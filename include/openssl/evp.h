@@ -97,6 +97,8 @@ extern "C" {
 int EVP_set_default_properties(OSSL_LIB_CTX *libctx, const char *propq);
 int EVP_default_properties_is_fips_enabled(OSSL_LIB_CTX *libctx);
 int EVP_default_properties_enable_fips(OSSL_LIB_CTX *libctx, int enable);
+int EVP_thread_fetch_cache_enable(OSSL_LIB_CTX *libctx, int enable);
+int EVP_thread_fetch_cache_is_enabled(OSSL_LIB_CTX *libctx);
 
 # define EVP_PKEY_MO_SIGN        0x0001
 # define EVP_PKEY_MO_VERIFY      0x0002
@@ -714,6 +716,13 @@ __owur int EVP_DigestFinal_ex(EVP_MD_CTX *ctx, unsigned char *md,
 __owur int EVP_Digest(const void *data, size_t count,
                           unsigned char *md, unsigned int *size,
                           const EVP_MD *type, ENGINE *impl);
+__owur int EVP_Digest_batch(const void *const data[], const size_t counts[],
+                            size_t num, unsigned char *const mds[],
+                            const EVP_MD *type);
+__owur int EVP_DigestXOF_batch(const void *const data[],
+                               const size_t counts[], size_t num,
+                               unsigned char *const mds[], size_t outlen,
+                               const EVP_MD *type);
 __owur int EVP_Q_digest(OSSL_LIB_CTX *libctx, const char *name,
                         const char *propq, const void *data, size_t datalen,
                         unsigned char *md, size_t *mdlen);
@@ -816,6 +825,13 @@ __owur int EVP_VerifyFinal_ex(EVP_MD_CTX *ctx, const unsigned char *sigbuf,
 __owur int EVP_DigestVerify(EVP_MD_CTX *ctx, const unsigned char *sigret,
                             size_t siglen, const unsigned char *tbs,
                             size_t tbslen);
+__owur int EVP_DigestVerify_batch(EVP_PKEY *const pkeys[],
+                                  const unsigned char *const sigs[],
+                                  const size_t siglens[],
+                                  const unsigned char *const tbs[],
+                                  const size_t tbslens[], size_t num,
+                                  int results[], OSSL_LIB_CTX *libctx,
+                                  const char *propq);
 
 int EVP_DigestSignInit_ex(EVP_MD_CTX *ctx, EVP_PKEY_CTX **pctx,
                           const char *mdname, OSSL_LIB_CTX *libctx,
@@ -216,6 +216,7 @@
 # define SSL_R_PIPELINE_FAILURE                           406
 # define SSL_R_POST_HANDSHAKE_AUTH_ENCODING_ERR           278
 # define SSL_R_PRIVATE_KEY_MISMATCH                       288
+# define SSL_R_PRIVATE_KEY_OPERATION_FAILED               411
 # define SSL_R_PROTOCOL_IS_SHUTDOWN                       207
 # define SSL_R_PSK_IDENTITY_NOT_FOUND                     223
 # define SSL_R_PSK_NO_CLIENT_CB                           224
@@ -39,6 +39,11 @@ typedef struct prov_aes_gcm_ctx_st {
             int res;
         } s390x;
 #endif /* defined(OPENSSL_CPUID_OBJ) && defined(__s390__) */
+#if defined(AES_GCM_VAES_CAPABLE)
+        struct {
+            u128 Htable[16];    /* H^16..H^1 for the VAES kernels */
+        } vaes;
+#endif /* defined(AES_GCM_VAES_CAPABLE) */
     } plat;
 } PROV_AES_GCM_CTX;
 
@@ -34,6 +34,14 @@ static int aes_gcm_initkey(PROV_GCM_CTX *ctx, const unsigned char *key,
     } else
 # endif /* HWAES_CAPABLE */
 
+# ifdef BSAES_AVX2_CAPABLE
+    if (BSAES_AVX2_CAPABLE) {
+        GCM_HW_SET_KEY_CTR_FN(ks, AES_set_encrypt_key,
+                              ossl_bsaes_encrypt_block_avx2,
+                              ossl_bsaes_ctr32_encrypt_blocks_avx2);
+    } else
+# endif /* BSAES_AVX2_CAPABLE */
+
 # ifdef BSAES_CAPABLE
     if (BSAES_CAPABLE) {
         GCM_HW_SET_KEY_CTR_FN(ks, AES_set_encrypt_key, AES_encrypt,
@@ -92,6 +92,12 @@ static int cipher_hw_aes_initkey(PROV_CIPHER_CTX *dat,
         ret = AES_set_encrypt_key(key, keylen * 8, ks);
         dat->block = (block128_f)AES_encrypt;
         dat->stream.ctr = (ctr128_f)ossl_bsaes_ctr32_encrypt_blocks;
+# ifdef BSAES_AVX2_CAPABLE
+        if (BSAES_AVX2_CAPABLE) {
+            dat->block = (block128_f)ossl_bsaes_encrypt_block_avx2;
+            dat->stream.ctr = (ctr128_f)ossl_bsaes_ctr32_encrypt_blocks_avx2;
+        }
+# endif
     } else
 #endif
 #ifdef VPAES_CAPABLE
@@ -64,32 +64,38 @@ IMPLEMENT_digest_functions_with_settable_ctx(
     sha1_settable_ctx_params, sha1_set_ctx_params)
 
 /* ossl_sha224_functions */
-IMPLEMENT_digest_functions(sha224, SHA256_CTX,
-                           SHA256_CBLOCK, SHA224_DIGEST_LENGTH, SHA2_FLAGS,
-                           SHA224_Init, SHA224_Update, SHA224_Final)
+IMPLEMENT_digest_functions_with_batch(
+    sha224, SHA256_CTX, SHA256_CBLOCK, SHA224_DIGEST_LENGTH, SHA2_FLAGS,
+    SHA224_Init, SHA224_Update, SHA224_Final,
+    ossl_sha256_batch)
 
 /* ossl_sha256_functions */
-IMPLEMENT_digest_functions(sha256, SHA256_CTX,
-                           SHA256_CBLOCK, SHA256_DIGEST_LENGTH, SHA2_FLAGS,
-                           SHA256_Init, SHA256_Update, SHA256_Final)
+IMPLEMENT_digest_functions_with_batch(
+    sha256, SHA256_CTX, SHA256_CBLOCK, SHA256_DIGEST_LENGTH, SHA2_FLAGS,
+    SHA256_Init, SHA256_Update, SHA256_Final,
+    ossl_sha256_batch)
 
 /* ossl_sha384_functions */
-IMPLEMENT_digest_functions(sha384, SHA512_CTX,
-                           SHA512_CBLOCK, SHA384_DIGEST_LENGTH, SHA2_FLAGS,
-                           SHA384_Init, SHA384_Update, SHA384_Final)
+IMPLEMENT_digest_functions_with_batch(
+    sha384, SHA512_CTX, SHA512_CBLOCK, SHA384_DIGEST_LENGTH, SHA2_FLAGS,
+    SHA384_Init, SHA384_Update, SHA384_Final,
+    ossl_sha512_batch)
 
 /* ossl_sha512_functions */
-IMPLEMENT_digest_functions(sha512, SHA512_CTX,
-                           SHA512_CBLOCK, SHA512_DIGEST_LENGTH, SHA2_FLAGS,
-                           SHA512_Init, SHA512_Update, SHA512_Final)
+IMPLEMENT_digest_functions_with_batch(
+    sha512, SHA512_CTX, SHA512_CBLOCK, SHA512_DIGEST_LENGTH, SHA2_FLAGS,
+    SHA512_Init, SHA512_Update, SHA512_Final,
+    ossl_sha512_batch)
 
 /* ossl_sha512_224_functions */
-IMPLEMENT_digest_functions(sha512_224, SHA512_CTX,
-                           SHA512_CBLOCK, SHA224_DIGEST_LENGTH, SHA2_FLAGS,
-                           sha512_224_init, SHA512_Update, SHA512_Final)
+IMPLEMENT_digest_functions_with_batch(
+    sha512_224, SHA512_CTX, SHA512_CBLOCK, SHA224_DIGEST_LENGTH, SHA2_FLAGS,
+    sha512_224_init, SHA512_Update, SHA512_Final,
+    ossl_sha512_batch)
 
 /* ossl_sha512_256_functions */
-IMPLEMENT_digest_functions(sha512_256, SHA512_CTX,
-                           SHA512_CBLOCK, SHA256_DIGEST_LENGTH, SHA2_FLAGS,
-                           sha512_256_init, SHA512_Update, SHA512_Final)
+IMPLEMENT_digest_functions_with_batch(
+    sha512_256, SHA512_CTX, SHA512_CBLOCK, SHA256_DIGEST_LENGTH, SHA2_FLAGS,
+    sha512_256_init, SHA512_Update, SHA512_Final,
+    ossl_sha512_batch)
 
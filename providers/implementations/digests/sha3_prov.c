@@ -238,17 +238,44 @@ const OSSL_DISPATCH ossl_##name##_functions[] = {                              \
     { OSSL_FUNC_DIGEST_DUPCTX, (void (*)(void))keccak_dupctx },                \
     PROV_DISPATCH_FUNC_DIGEST_GET_PARAMS(name)
 
+/*
+ * The XOFs produce as much output as the caller has room for, everything
+ * else produces the digest size.
+ */
+#define SHA3_digest_batch(name, bitlen, pad, dgstsize, xof)                    \
+static OSSL_FUNC_digest_digest_batch_fn name##_digest_batch;                   \
+static int name##_digest_batch(ossl_unused void *provctx,                      \
+                               const unsigned char *const in[],                \
+                               const size_t inl[], size_t num,                 \
+                               unsigned char *const out[], size_t outsz)       \
+{                                                                              \
+    if (!ossl_prov_is_running() || (!(xof) && outsz < (dgstsize)))             \
+        return 0;                                                              \
+    ossl_sha3_batch(pad, bitlen, (xof) ? outsz : (dgstsize), in, inl, num,     \
+                    out);                                                      \
+    return 1;                                                                  \
+}
+
 #define PROV_FUNC_SHA3_DIGEST(name, bitlen, blksize, dgstsize, flags)          \
     PROV_FUNC_SHA3_DIGEST_COMMON(name, bitlen, blksize, dgstsize, flags),      \
     { OSSL_FUNC_DIGEST_INIT, (void (*)(void))keccak_init },                    \
+    { OSSL_FUNC_DIGEST_DIGEST_BATCH, (void (*)(void))name##_digest_batch },    \
     PROV_DISPATCH_FUNC_DIGEST_CONSTRUCT_END
 
-#define PROV_FUNC_SHAKE_DIGEST(name, bitlen, blksize, dgstsize, flags)         \
+#define PROV_FUNC_SHAKE_DIGEST_COMMON(name, bitlen, blksize, dgstsize, flags)  \
     PROV_FUNC_SHA3_DIGEST_COMMON(name, bitlen, blksize, dgstsize, flags),      \
     { OSSL_FUNC_DIGEST_INIT, (void (*)(void))keccak_init_params },             \
     { OSSL_FUNC_DIGEST_SET_CTX_PARAMS, (void (*)(void))shake_set_ctx_params }, \
     { OSSL_FUNC_DIGEST_SETTABLE_CTX_PARAMS,                                    \
-     (void (*)(void))shake_settable_ctx_params },                              \
+     (void (*)(void))shake_settable_ctx_params }
+
+#define PROV_FUNC_SHAKE_DIGEST(name, bitlen, blksize, dgstsize, flags)         \
+    PROV_FUNC_SHAKE_DIGEST_COMMON(name, bitlen, blksize, dgstsize, flags),     \
+    { OSSL_FUNC_DIGEST_DIGEST_BATCH, (void (*)(void))name##_digest_batch },    \
+    PROV_DISPATCH_FUNC_DIGEST_CONSTRUCT_END
+
+#define PROV_FUNC_KMAC_DIGEST(name, bitlen, blksize, dgstsize, flags)          \
+    PROV_FUNC_SHAKE_DIGEST_COMMON(name, bitlen, blksize, dgstsize, flags),     \
     PROV_DISPATCH_FUNC_DIGEST_CONSTRUCT_END
 
 static void keccak_freectx(void *vctx)
@@ -299,20 +326,22 @@ static int shake_set_ctx_params(void *vctx, const OSSL_PARAM params[])
 
 #define IMPLEMENT_SHA3_functions(bitlen)                                       \
     SHA3_newctx(sha3, SHA3_##bitlen, sha3_##bitlen, bitlen, '\x06')            \
+    SHA3_digest_batch(sha3_##bitlen, bitlen, '\x06', SHA3_MDSIZE(bitlen), 0)   \
     PROV_FUNC_SHA3_DIGEST(sha3_##bitlen, bitlen,                               \
                           SHA3_BLOCKSIZE(bitlen), SHA3_MDSIZE(bitlen),         \
                           SHA3_FLAGS)
 
 #define IMPLEMENT_SHAKE_functions(bitlen)                                      \
     SHA3_newctx(shake, SHAKE_##bitlen, shake_##bitlen, bitlen, '\x1f')         \
+    SHA3_digest_batch(shake_##bitlen, bitlen, '\x1f', SHA3_MDSIZE(bitlen), 1) \
     PROV_FUNC_SHAKE_DIGEST(shake_##bitlen, bitlen,                             \
                           SHA3_BLOCKSIZE(bitlen), SHA3_MDSIZE(bitlen),         \
                           SHAKE_FLAGS)
 #define IMPLEMENT_KMAC_functions(bitlen)                                       \
     KMAC_newctx(keccak_kmac_##bitlen, bitlen, '\x04')                          \
-    PROV_FUNC_SHAKE_DIGEST(keccak_kmac_##bitlen, bitlen,                       \
-                           SHA3_BLOCKSIZE(bitlen), KMAC_MDSIZE(bitlen),        \
-                           KMAC_FLAGS)
+    PROV_FUNC_KMAC_DIGEST(keccak_kmac_##bitlen, bitlen,                        \
+                          SHA3_BLOCKSIZE(bitlen), KMAC_MDSIZE(bitlen),         \
+                          KMAC_FLAGS)
 
 /* ossl_sha3_224_functions */
 IMPLEMENT_SHA3_functions(224)
@@ -94,6 +94,31 @@ PROV_DISPATCH_FUNC_DIGEST_CONSTRUCT_START(name, CTX, blksize, dgstsize, flags, \
     { OSSL_FUNC_DIGEST_INIT, (void (*)(void))name##_internal_init },           \
 PROV_DISPATCH_FUNC_DIGEST_CONSTRUCT_END
 
+# define IMPLEMENT_digest_functions_with_batch(                                \
+    name, CTX, blksize, dgstsize, flags, init, upd, fin, batch)                \
+static OSSL_FUNC_digest_init_fn name##_internal_init;                          \
+static int name##_internal_init(void *ctx,                                     \
+                                ossl_unused const OSSL_PARAM params[])         \
+{                                                                              \
+    return ossl_prov_is_running() && init(ctx);                                \
+}                                                                              \
+static OSSL_FUNC_digest_digest_batch_fn name##_digest_batch;                   \
+static int name##_digest_batch(ossl_unused void *provctx,                      \
+                               const unsigned char *const in[],                \
+                               const size_t inl[], size_t num,                 \
+                               unsigned char *const out[], size_t outsz)       \
+{                                                                              \
+    if (!ossl_prov_is_running() || outsz < dgstsize)                           \
+        return 0;                                                              \
+    batch(dgstsize, in, inl, num, out);                                        \
+    return 1;                                                                  \
+}                                                                              \
+PROV_DISPATCH_FUNC_DIGEST_CONSTRUCT_START(name, CTX, blksize, dgstsize, flags, \
+                                          upd, fin),                           \
+    { OSSL_FUNC_DIGEST_INIT, (void (*)(void))name##_internal_init },           \
+    { OSSL_FUNC_DIGEST_DIGEST_BATCH, (void (*)(void))name##_digest_batch },    \
+PROV_DISPATCH_FUNC_DIGEST_CONSTRUCT_END
+
 # define IMPLEMENT_digest_functions_with_settable_ctx(                         \
     name, CTX, blksize, dgstsize, flags, init, upd, fin,                       \
     settable_ctx_params, set_ctx_params)                                       \
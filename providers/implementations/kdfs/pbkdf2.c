@@ -23,7 +23,10 @@
 #include <openssl/proverr.h>
 #include "internal/cryptlib.h"
 #include "internal/numbers.h"
+#include "internal/provider.h"
+#include "internal/thread.h"
 #include "crypto/evp.h"
+#include "crypto/sha.h"
 #include "prov/provider_ctx.h"
 #include "prov/providercommon.h"
 #include "prov/implementations.h"
@@ -48,7 +51,8 @@ static OSSL_FUNC_kdf_get_ctx_params_fn kdf_pbkdf2_get_ctx_params;
 static int  pbkdf2_derive(const char *pass, size_t passlen,
                           const unsigned char *salt, int saltlen, uint64_t iter,
                           const EVP_MD *digest, unsigned char *key,
-                          size_t keylen, int extra_checks);
+                          size_t keylen, int extra_checks, uint32_t threads,
+                          void *provctx);
 
 typedef struct {
     void *provctx;
@@ -59,6 +63,7 @@ typedef struct {
     uint64_t iter;
     PROV_DIGEST digest;
     int lower_bound_checks;
+    uint32_t threads;
 } KDF_PBKDF2;
 
 static void kdf_pbkdf2_init(KDF_PBKDF2 *ctx);
@@ -120,6 +125,7 @@ static void kdf_pbkdf2_init(KDF_PBKDF2 *ctx)
         ossl_prov_digest_reset(&ctx->digest);
     ctx->iter = PKCS5_DEFAULT_ITER;
     ctx->lower_bound_checks = ossl_kdf_pbkdf2_default_checks;
+    ctx->threads = 1;
 }
 
 static int pbkdf2_set_membuf(unsigned char **buffer, size_t *buflen,
@@ -161,7 +167,8 @@ static int kdf_pbkdf2_derive(void *vctx, unsigned char *key, size_t keylen,
     md = ossl_prov_digest_md(&ctx->digest);
     return pbkdf2_derive((char *)ctx->pass, ctx->pass_len,
                          ctx->salt, ctx->salt_len, ctx->iter,
-                         md, key, keylen, ctx->lower_bound_checks);
+                         md, key, keylen, ctx->lower_bound_checks,
+                         ctx->threads, ctx->provctx);
 }
 
 static int kdf_pbkdf2_set_ctx_params(void *vctx, const OSSL_PARAM params[])
@@ -170,7 +177,7 @@ static int kdf_pbkdf2_set_ctx_params(void *vctx, const OSSL_PARAM params[])
     KDF_PBKDF2 *ctx = vctx;
     OSSL_LIB_CTX *provctx = PROV_LIBCTX_OF(ctx->provctx);
     int pkcs5;
-    uint64_t iter, min_iter;
+    uint64_t iter, min_iter, threads;
 
     if (params == NULL)
         return 1;
@@ -208,6 +215,16 @@ static int kdf_pbkdf2_set_ctx_params(void *vctx, const OSSL_PARAM params[])
         }
         ctx->iter = iter;
     }
+
+    if ((p = OSSL_PARAM_locate_const(params, OSSL_KDF_PARAM_THREADS)) != NULL) {
+        if (!OSSL_PARAM_get_uint64(p, &threads))
+            return 0;
+        if (threads < 1 || threads > UINT32_MAX) {
+            ERR_raise(ERR_LIB_PROV, PROV_R_VALUE_ERROR);
+            return 0;
+        }
+        ctx->threads = (uint32_t)threads;
+    }
     return 1;
 }
 
@@ -221,6 +238,7 @@ static const OSSL_PARAM *kdf_pbkdf2_settable_ctx_params(ossl_unused void *ctx,
         OSSL_PARAM_octet_string(OSSL_KDF_PARAM_SALT, NULL, 0),
         OSSL_PARAM_uint64(OSSL_KDF_PARAM_ITER, NULL),
         OSSL_PARAM_int(OSSL_KDF_PARAM_PKCS5, NULL),
+        OSSL_PARAM_uint32(OSSL_KDF_PARAM_THREADS, NULL),
         OSSL_PARAM_END
     };
     return known_settable_ctx_params;
@@ -259,6 +277,106 @@ const OSSL_DISPATCH ossl_kdf_pbkdf2_functions[] = {
     { 0, NULL }
 };
 
+/* The most output blocks computed side by side by one job */
+#define PBKDF2_MAX_LANES 8
+
+typedef struct {
+    const char *pass;
+    size_t passlen;
+    const unsigned char *salt;
+    int saltlen;
+    uint64_t iter;
+    unsigned char *key;
+    size_t keylen;
+    int mdlen;
+    int nid;
+    size_t lanes;               /* output blocks per job */
+    HMAC_CTX *tpl;
+    HMAC_CTX **hctx;            /* one per worker */
+} PBKDF2_JOBS;
+
+/* T_i, truncated to |cplen| bytes, one HMAC at a time */
+static int pbkdf2_block(const PBKDF2_JOBS *pj, HMAC_CTX *hctx,
+                        unsigned long i, unsigned char *p, int cplen)
+{
+    unsigned char digtmp[EVP_MAX_MD_SIZE], itmp[4];
+    uint64_t j;
+    int k, ret = 0;
+
+    /*
+     * We are unlikely to ever use more than 256 blocks (5120 bits!) but
+     * just in case...
+     */
+    itmp[0] = (unsigned char)((i >> 24) & 0xff);
+    itmp[1] = (unsigned char)((i >> 16) & 0xff);
+    itmp[2] = (unsigned char)((i >> 8) & 0xff);
+    itmp[3] = (unsigned char)(i & 0xff);
+    if (!HMAC_CTX_copy(hctx, pj->tpl))
+        goto err;
+    if (!HMAC_Update(hctx, pj->salt, pj->saltlen)
+            || !HMAC_Update(hctx, itmp, 4)
+            || !HMAC_Final(hctx, digtmp, NULL))
+        goto err;
+    memcpy(p, digtmp, cplen);
+    for (j = 1; j < pj->iter; j++) {
+        if (!HMAC_CTX_copy(hctx, pj->tpl))
+            goto err;
+        if (!HMAC_Update(hctx, digtmp, pj->mdlen)
+                || !HMAC_Final(hctx, digtmp, NULL))
+            goto err;
+        for (k = 0; k < cplen; k++)
+            p[k] ^= digtmp[k];
+    }
+    ret = 1;
+ err:
+    OPENSSL_cleanse(digtmp, sizeof(digtmp));
+    return ret;
+}
+
+/* Job |job| produces the output blocks from |job| * |lanes| on */
+static int pbkdf2_job(void *arg, size_t job, size_t worker)
+{
+    const PBKDF2_JOBS *pj = arg;
+    size_t first = job * pj->lanes, off = first * pj->mdlen, n, len;
+    HMAC_CTX *hctx;
+
+    n = (pj->keylen - off + pj->mdlen - 1) / pj->mdlen;
+    if (n > pj->lanes)
+        n = pj->lanes;
+
+#ifndef FIPS_MODULE
+    if (n > 1 && pj->nid != NID_undef) {
+        unsigned char tmp[PBKDF2_MAX_LANES * EVP_MAX_MD_SIZE];
+        int ok;
+
+        len = pj->keylen - off;
+        if (len > n * pj->mdlen)
+            len = n * pj->mdlen;
+        ok = ossl_sha2_pbkdf2(pj->nid, (const unsigned char *)pj->pass,
+                              pj->passlen, pj->salt, pj->saltlen, pj->iter,
+                              (uint32_t)(first + 1), n, tmp);
+        if (ok)
+            memcpy(pj->key + off, tmp, len);
+        OPENSSL_cleanse(tmp, sizeof(tmp));
+        return ok;
+    }
+#endif
+
+    if (pj->hctx[worker] == NULL
+            && (pj->hctx[worker] = HMAC_CTX_new()) == NULL)
+        return 0;
+    hctx = pj->hctx[worker];
+    for (; n > 0; n--, first++, off += len) {
+        len = pj->keylen - off;
+        if (len > (size_t)pj->mdlen)
+            len = pj->mdlen;
+        if (!pbkdf2_block(pj, hctx, (unsigned long)first + 1, pj->key + off,
+                          (int)len))
+            return 0;
+    }
+    return 1;
+}
+
 /*
  * This is an implementation of PKCS#5 v2.0 password based encryption key
  * derivation function PBKDF2. SHA1 version verified against test vectors
@@ -272,14 +390,13 @@ const OSSL_DISPATCH ossl_kdf_pbkdf2_functions[] = {
 static int pbkdf2_derive(const char *pass, size_t passlen,
                          const unsigned char *salt, int saltlen, uint64_t iter,
                          const EVP_MD *digest, unsigned char *key,
-                         size_t keylen, int lower_bound_checks)
+                         size_t keylen, int lower_bound_checks,
+                         uint32_t threads, void *provctx)
 {
     int ret = 0;
-    unsigned char digtmp[EVP_MAX_MD_SIZE], *p, itmp[4];
-    int cplen, k, tkeylen, mdlen;
-    uint64_t j;
-    unsigned long i = 1;
-    HMAC_CTX *hctx_tpl = NULL, *hctx = NULL;
+    int mdlen;
+    size_t nblocks, jobs, i;
+    PBKDF2_JOBS pj;
 
     mdlen = EVP_MD_get_size(digest);
     if (mdlen <= 0)
@@ -308,54 +425,63 @@ static int pbkdf2_derive(const char *pass, size_t passlen,
             return 0;
         }
     }
+    if (keylen == 0)
+        return 1;
 
-    hctx_tpl = HMAC_CTX_new();
-    if (hctx_tpl == NULL)
-        return 0;
-    p = key;
-    tkeylen = keylen;
-    if (!HMAC_Init_ex(hctx_tpl, pass, passlen, digest, NULL))
-        goto err;
-    hctx = HMAC_CTX_new();
-    if (hctx == NULL)
-        goto err;
-    while (tkeylen) {
-        if (tkeylen > mdlen)
-            cplen = mdlen;
-        else
-            cplen = tkeylen;
-        /*
-         * We are unlikely to ever use more than 256 blocks (5120 bits!) but
-         * just in case...
-         */
-        itmp[0] = (unsigned char)((i >> 24) & 0xff);
-        itmp[1] = (unsigned char)((i >> 16) & 0xff);
-        itmp[2] = (unsigned char)((i >> 8) & 0xff);
-        itmp[3] = (unsigned char)(i & 0xff);
-        if (!HMAC_CTX_copy(hctx, hctx_tpl))
-            goto err;
-        if (!HMAC_Update(hctx, salt, saltlen)
-                || !HMAC_Update(hctx, itmp, 4)
-                || !HMAC_Final(hctx, digtmp, NULL))
-            goto err;
-        memcpy(p, digtmp, cplen);
-        for (j = 1; j < iter; j++) {
-            if (!HMAC_CTX_copy(hctx, hctx_tpl))
-                goto err;
-            if (!HMAC_Update(hctx, digtmp, mdlen)
-                    || !HMAC_Final(hctx, digtmp, NULL))
-                goto err;
-            for (k = 0; k < cplen; k++)
-                p[k] ^= digtmp[k];
+    memset(&pj, 0, sizeof(pj));
+    pj.pass = pass;
+    pj.passlen = passlen;
+    pj.salt = salt;
+    pj.saltlen = saltlen;
+    pj.iter = iter;
+    pj.key = key;
+    pj.keylen = keylen;
+    pj.mdlen = mdlen;
+    pj.nid = NID_undef;
+    pj.lanes = 1;
+
+    /*
+     * The output blocks are independent of each other.  They are shared out
+     * over the threads, and where our own SHA-2 is in use each thread
+     * computes a group of them side by side in the lanes of a multi-buffer
+     * transform.
+     */
+    nblocks = (keylen + mdlen - 1) / mdlen;
+#ifndef FIPS_MODULE
+    if (nblocks > 1 && EVP_MD_get0_provider(digest) != NULL
+            && ossl_provider_ctx(EVP_MD_get0_provider(digest)) == provctx) {
+        size_t lanes = ossl_sha2_pbkdf2_lanes(EVP_MD_get_type(digest));
+        size_t per_thread = (nblocks + threads - 1) / threads;
+
+        if (lanes > PBKDF2_MAX_LANES)
+            lanes = PBKDF2_MAX_LANES;
+        if (lanes > per_thread)
+            lanes = per_thread;
+        if (lanes > 1) {
+            pj.nid = EVP_MD_get_type(digest);
+            pj.lanes = lanes;
         }
-        tkeylen -= cplen;
-        i++;
-        p += cplen;
     }
-    ret = 1;
+#endif
+    jobs = (nblocks + pj.lanes - 1) / pj.lanes;
+    if (threads > jobs)
+        threads = (uint32_t)jobs;
+
+    pj.tpl = HMAC_CTX_new();
+    pj.hctx = OPENSSL_zalloc(threads * sizeof(*pj.hctx));
+    if (pj.tpl == NULL || pj.hctx == NULL)
+        goto err;
+    if (!HMAC_Init_ex(pj.tpl, pass, passlen, digest, NULL))
+        goto err;
+    ret = ossl_crypto_parallel_run(jobs, threads, pbkdf2_job, &pj);
 
 err:
-    HMAC_CTX_free(hctx);
-    HMAC_CTX_free(hctx_tpl);
+    if (pj.hctx != NULL)
+        for (i = 0; i < threads; i++)
+            HMAC_CTX_free(pj.hctx[i]);
+    OPENSSL_free(pj.hctx);
+    HMAC_CTX_free(pj.tpl);
+    if (!ret)
+        OPENSSL_cleanse(key, keylen);
     return ret;
 }
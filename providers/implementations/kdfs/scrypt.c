@@ -17,6 +17,7 @@
 #include <openssl/proverr.h>
 #include "crypto/evp.h"
 #include "internal/numbers.h"
+#include "internal/thread.h"
 #include "prov/implementations.h"
 #include "prov/provider_ctx.h"
 #include "prov/providercommon.h"
@@ -36,8 +37,9 @@ static OSSL_FUNC_kdf_get_ctx_params_fn kdf_scrypt_get_ctx_params;
 static int scrypt_alg(const char *pass, size_t passlen,
                       const unsigned char *salt, size_t saltlen,
                       uint64_t N, uint64_t r, uint64_t p, uint64_t maxmem,
-                      unsigned char *key, size_t keylen, EVP_MD *sha256,
-                      OSSL_LIB_CTX *libctx, const char *propq);
+                      uint64_t threads, unsigned char *key, size_t keylen,
+                      EVP_MD *sha256, OSSL_LIB_CTX *libctx,
+                      const char *propq);
 
 typedef struct {
     OSSL_LIB_CTX *libctx;
@@ -49,6 +51,7 @@ typedef struct {
     uint64_t N;
     uint64_t r, p;
     uint64_t maxmem_bytes;
+    uint64_t threads;
     EVP_MD *sha256;
 } KDF_SCRYPT;
 
@@ -102,6 +105,7 @@ static void kdf_scrypt_init(KDF_SCRYPT *ctx)
     ctx->r = 8;
     ctx->p = 1;
     ctx->maxmem_bytes = 1025 * 1024 * 1024;
+    ctx->threads = 1;
 }
 
 static int scrypt_set_membuf(unsigned char **buffer, size_t *buflen,
@@ -170,8 +174,8 @@ static int kdf_scrypt_derive(void *vctx, unsigned char *key, size_t keylen,
 
     return scrypt_alg((char *)ctx->pass, ctx->pass_len, ctx->salt,
                       ctx->salt_len, ctx->N, ctx->r, ctx->p,
-                      ctx->maxmem_bytes, key, keylen, ctx->sha256,
-                      ctx->libctx, ctx->propq);
+                      ctx->maxmem_bytes, ctx->threads, key, keylen,
+                      ctx->sha256, ctx->libctx, ctx->propq);
 }
 
 static int is_power_of_two(uint64_t value)
@@ -226,6 +230,13 @@ static int kdf_scrypt_set_ctx_params(void *vctx, const OSSL_PARAM params[])
         ctx->maxmem_bytes = u64_value;
     }
 
+    if ((p = OSSL_PARAM_locate_const(params, OSSL_KDF_PARAM_THREADS))
+        != NULL) {
+        if (!OSSL_PARAM_get_uint64(p, &u64_value) || u64_value < 1)
+            return 0;
+        ctx->threads = u64_value;
+    }
+
     p = OSSL_PARAM_locate_const(params, OSSL_KDF_PARAM_PROPERTIES);
     if (p != NULL) {
         if (p->data_type != OSSL_PARAM_UTF8_STRING
@@ -246,6 +257,7 @@ static const OSSL_PARAM *kdf_scrypt_settable_ctx_params(ossl_unused void *ctx,
         OSSL_PARAM_uint32(OSSL_KDF_PARAM_SCRYPT_R, NULL),
         OSSL_PARAM_uint32(OSSL_KDF_PARAM_SCRYPT_P, NULL),
         OSSL_PARAM_uint64(OSSL_KDF_PARAM_SCRYPT_MAXMEM, NULL),
+        OSSL_PARAM_uint32(OSSL_KDF_PARAM_THREADS, NULL),
         OSSL_PARAM_utf8_string(OSSL_KDF_PARAM_PROPERTIES, NULL, 0),
         OSSL_PARAM_END
     };
@@ -405,16 +417,39 @@ static void scryptROMix(unsigned char *B, uint64_t r, uint64_t N,
 
 #define SCRYPT_PR_MAX   ((1 << 30) - 1)
 
+/*
+ * The p instances of ROMix are independent of each other.  Each worker
+ * thread has its own X, T and V in |work|.
+ */
+typedef struct {
+    unsigned char *B;
+    unsigned char *work;
+    uint64_t r, N, Vlen;
+} SCRYPT_JOBS;
+
+static int scrypt_job(void *arg, size_t job, size_t worker)
+{
+    const SCRYPT_JOBS *sj = arg;
+    uint32_t *X, *T, *V;
+
+    X = (uint32_t *)(sj->work + worker * sj->Vlen);
+    T = X + 32 * sj->r;
+    V = T + 32 * sj->r;
+    scryptROMix(sj->B + 128 * sj->r * job, sj->r, sj->N, X, T, V);
+    return 1;
+}
+
 static int scrypt_alg(const char *pass, size_t passlen,
                       const unsigned char *salt, size_t saltlen,
                       uint64_t N, uint64_t r, uint64_t p, uint64_t maxmem,
-                      unsigned char *key, size_t keylen, EVP_MD *sha256,
-                      OSSL_LIB_CTX *libctx, const char *propq)
+                      uint64_t threads, unsigned char *key, size_t keylen,
+                      EVP_MD *sha256, OSSL_LIB_CTX *libctx,
+                      const char *propq)
 {
     int rv = 0;
     unsigned char *B;
-    uint32_t *X, *V, *T;
-    uint64_t i, Blen, Vlen;
+    uint64_t i, Blen, Vlen, alloclen;
+    SCRYPT_JOBS sj;
 
     /* Sanity check parameters */
     /* initial check, r,p must be non zero, N >= 2 and a power of 2 */
@@ -485,20 +520,33 @@ static int scrypt_alg(const char *pass, size_t passlen,
     if (key == NULL)
         return 1;
 
-    B = OPENSSL_malloc((size_t)(Blen + Vlen));
+    /*
+     * Every thread needs a V of its own, so there are no more of them than
+     * fit in the memory limit.
+     */
+    if (threads > p)
+        threads = p;
+    if (threads > (maxmem - Blen) / Vlen)
+        threads = (maxmem - Blen) / Vlen;
+    alloclen = Blen + threads * Vlen;
+
+    B = OPENSSL_malloc((size_t)alloclen);
     if (B == NULL) {
         ERR_raise(ERR_LIB_EVP, ERR_R_MALLOC_FAILURE);
         return 0;
     }
-    X = (uint32_t *)(B + Blen);
-    T = X + 32 * r;
-    V = T + 32 * r;
     if (ossl_pkcs5_pbkdf2_hmac_ex(pass, passlen, salt, saltlen, 1, sha256,
                                   (int)Blen, B, libctx, propq) == 0)
         goto err;
 
-    for (i = 0; i < p; i++)
-        scryptROMix(B + 128 * r * i, r, N, X, T, V);
+    sj.B = B;
+    sj.work = B + Blen;
+    sj.r = r;
+    sj.N = N;
+    sj.Vlen = Vlen;
+    if (!ossl_crypto_parallel_run((size_t)p, (size_t)threads, scrypt_job,
+                                  &sj))
+        goto err;
 
     if (ossl_pkcs5_pbkdf2_hmac_ex(pass, passlen, B, (int)Blen, 1, sha256,
                                   keylen, key, libctx, propq) == 0)
@@ -508,7 +556,7 @@ static int scrypt_alg(const char *pass, size_t passlen,
     if (rv == 0)
         ERR_raise(ERR_LIB_EVP, EVP_R_PBKDF2_ERROR);
 
-    OPENSSL_clear_free(B, (size_t)(Blen + Vlen));
+    OPENSSL_clear_free(B, (size_t)alloclen);
     return rv;
 }
 
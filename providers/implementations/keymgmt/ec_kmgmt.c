@@ -260,6 +260,11 @@ int otherparams_to_params(const EC_KEY *ec, OSSL_PARAM_BLD *tmpl,
                                          OSSL_PKEY_PARAM_EC_INCLUDE_PUBLIC, 0))
         return 0;
 
+    if ((EC_KEY_get_flags(ec) & EC_FLAG_NO_PUBKEY_PRECOMP) != 0
+            && !ossl_param_build_set_int(tmpl, params,
+                                         OSSL_PKEY_PARAM_EC_PUB_PRECOMP, 0))
+        return 0;
+
     ecdh_cofactor_mode =
         (EC_KEY_get_flags(ec) & EC_FLAG_COFACTOR_ECDH) ? 1 : 0;
     return ossl_param_build_set_int(tmpl, params,
@@ -521,7 +526,8 @@ end:
     OSSL_PARAM_BN(OSSL_PKEY_PARAM_PRIV_KEY, NULL, 0)
 # define EC_IMEXPORTABLE_OTHER_PARAMETERS                                      \
     OSSL_PARAM_int(OSSL_PKEY_PARAM_USE_COFACTOR_ECDH, NULL),                   \
-    OSSL_PARAM_int(OSSL_PKEY_PARAM_EC_INCLUDE_PUBLIC, NULL)
+    OSSL_PARAM_int(OSSL_PKEY_PARAM_EC_INCLUDE_PUBLIC, NULL),                   \
+    OSSL_PARAM_int(OSSL_PKEY_PARAM_EC_PUB_PRECOMP, NULL)
 
 /*
  * Include all the possible combinations of OSSL_PARAM arrays for
@@ -689,6 +695,11 @@ int common_get_params(void *key, OSSL_PARAM params[], int sm2)
             goto err;
     }
 
+    if ((p = OSSL_PARAM_locate(params, OSSL_PKEY_PARAM_EC_PUB_PRECOMP_SIZE))
+            != NULL
+        && !OSSL_PARAM_set_size_t(p, ossl_ec_key_pub_pre_comp_size(eck)))
+        goto err;
+
     if (!sm2) {
         if ((p = OSSL_PARAM_locate(params, OSSL_PKEY_PARAM_DEFAULT_DIGEST)) != NULL
                 && !OSSL_PARAM_set_utf8_string(p, EC_DEFAULT_MD))
@@ -760,6 +771,7 @@ static const OSSL_PARAM ec_known_gettable_params[] = {
     OSSL_PARAM_utf8_string(OSSL_PKEY_PARAM_DEFAULT_DIGEST, NULL, 0),
     OSSL_PARAM_octet_string(OSSL_PKEY_PARAM_ENCODED_PUBLIC_KEY, NULL, 0),
     OSSL_PARAM_int(OSSL_PKEY_PARAM_EC_DECODED_FROM_EXPLICIT_PARAMS, NULL),
+    OSSL_PARAM_size_t(OSSL_PKEY_PARAM_EC_PUB_PRECOMP_SIZE, NULL),
     EC_IMEXPORTABLE_DOM_PARAMETERS,
     EC2M_GETTABLE_DOM_PARAMS
     EC_IMEXPORTABLE_PUBLIC_KEY,
@@ -784,6 +796,7 @@ static const OSSL_PARAM ec_known_settable_params[] = {
     OSSL_PARAM_octet_string(OSSL_PKEY_PARAM_EC_SEED, NULL, 0),
     OSSL_PARAM_int(OSSL_PKEY_PARAM_EC_INCLUDE_PUBLIC, NULL),
     OSSL_PARAM_utf8_string(OSSL_PKEY_PARAM_EC_GROUP_CHECK_TYPE, NULL, 0),
+    OSSL_PARAM_int(OSSL_PKEY_PARAM_EC_PUB_PRECOMP, NULL),
     OSSL_PARAM_END
 };
 
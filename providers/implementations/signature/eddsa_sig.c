@@ -50,6 +50,7 @@ static OSSL_FUNC_signature_digest_sign_fn ed25519_digest_sign;
 static OSSL_FUNC_signature_digest_sign_fn ed448_digest_sign;
 static OSSL_FUNC_signature_digest_verify_fn ed25519_digest_verify;
 static OSSL_FUNC_signature_digest_verify_fn ed448_digest_verify;
+static OSSL_FUNC_signature_digest_verify_batch_fn ed25519_digest_verify_batch;
 static OSSL_FUNC_signature_freectx_fn eddsa_freectx;
 static OSSL_FUNC_signature_dupctx_fn eddsa_dupctx;
 static OSSL_FUNC_signature_get_ctx_params_fn eddsa_get_ctx_params;
@@ -218,6 +219,52 @@ int ed25519_digest_verify(void *vpeddsactx, const unsigned char *sig,
                                peddsactx->libctx, edkey->propq);
 }
 
+static int ed25519_digest_verify_batch(void *vpeddsactx,
+                                       void *const provkeys[],
+                                       const unsigned char *const sigs[],
+                                       const size_t siglens[],
+                                       const unsigned char *const tbs[],
+                                       const size_t tbslens[], size_t num,
+                                       int results[])
+{
+    PROV_EDDSA_CTX *peddsactx = (PROV_EDDSA_CTX *)vpeddsactx;
+    const unsigned char **pubkeys;
+    const ECX_KEY *edkey;
+    size_t i;
+    int ret;
+
+    if (!ossl_prov_is_running())
+        return 0;
+
+    for (i = 0; i < num; i++)
+        results[i] = siglens[i] == ED25519_SIGSIZE;
+
+#ifdef S390X_EC_ASM
+    if (S390X_CAN_SIGN(ED25519)) {
+        for (i = 0; i < num; i++)
+            if (results[i])
+                results[i] = s390x_ed25519_digestverify(provkeys[i], sigs[i],
+                                                        tbs[i], tbslens[i]);
+        return 1;
+    }
+#endif /* S390X_EC_ASM */
+
+    pubkeys = OPENSSL_malloc(num * sizeof(*pubkeys));
+    if (pubkeys == NULL) {
+        ERR_raise(ERR_LIB_PROV, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    for (i = 0; i < num; i++) {
+        edkey = provkeys[i];
+        pubkeys[i] = edkey->pubkey;
+    }
+    edkey = provkeys[0];
+    ret = ossl_ed25519_verify_batch(tbs, tbslens, sigs, pubkeys, num, results,
+                                    peddsactx->libctx, edkey->propq);
+    OPENSSL_free(pubkeys);
+    return ret;
+}
+
 int ed448_digest_verify(void *vpeddsactx, const unsigned char *sig,
                         size_t siglen, const unsigned char *tbs,
                         size_t tbslen)
@@ -310,6 +357,8 @@ const OSSL_DISPATCH ossl_ed25519_signature_functions[] = {
       (void (*)(void))eddsa_digest_signverify_init },
     { OSSL_FUNC_SIGNATURE_DIGEST_VERIFY,
       (void (*)(void))ed25519_digest_verify },
+    { OSSL_FUNC_SIGNATURE_DIGEST_VERIFY_BATCH,
+      (void (*)(void))ed25519_digest_verify_batch },
     { OSSL_FUNC_SIGNATURE_FREECTX, (void (*)(void))eddsa_freectx },
     { OSSL_FUNC_SIGNATURE_DUPCTX, (void (*)(void))eddsa_dupctx },
     { OSSL_FUNC_SIGNATURE_GET_CTX_PARAMS, (void (*)(void))eddsa_get_ctx_params },
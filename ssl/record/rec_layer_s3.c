@@ -52,6 +52,8 @@ void RECORD_LAYER_clear(RECORD_LAYER *rl)
     rl->wpend_type = 0;
     rl->wpend_ret = 0;
     rl->wpend_buf = NULL;
+    rl->wiov_bufs = NULL;
+    rl->wiov_done = 0;
 
     SSL3_BUFFER_clear(&rl->rbuf);
     ssl3_release_write_buffer(rl->s);
@@ -574,7 +576,10 @@ int ssl3_write_bytes(SSL *s, int type, const void *buf_, size_t len,
      * If max_pipelines is 0 then this means "undefined" and we default to
      * 1 pipeline. Similarly if the cipher does not support pipelined
      * processing then we also only use 1 pipeline, or if we're not using
-     * explicit IVs
+     * explicit IVs. With SSL_MODE_BATCH_AEAD_WRITES, AEAD ciphers without
+     * pipeline support still get several records per call for application
+     * data: do_ssl3_write() seals them one after the other into a single
+     * write buffer that is then written out in one go.
      */
     maxpipes = s->max_pipelines;
     if (maxpipes > SSL_MAX_PIPELINES) {
@@ -585,12 +590,23 @@ int ssl3_write_bytes(SSL *s, int type, const void *buf_, size_t len,
         SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
         return -1;
     }
-    if (maxpipes == 0
-        || s->enc_write_ctx == NULL
-        || (EVP_CIPHER_get_flags(EVP_CIPHER_CTX_get0_cipher(s->enc_write_ctx))
-            & EVP_CIPH_FLAG_PIPELINE) == 0
-        || !SSL_USE_EXPLICIT_IV(s))
+    if (maxpipes == 0 || s->enc_write_ctx == NULL) {
         maxpipes = 1;
+    } else {
+        unsigned long flags =
+            EVP_CIPHER_get_flags(EVP_CIPHER_CTX_get0_cipher(s->enc_write_ctx));
+
+        if ((flags & EVP_CIPH_FLAG_PIPELINE) != 0) {
+            if (!SSL_USE_EXPLICIT_IV(s))
+                maxpipes = 1;
+        } else if ((s->mode & SSL_MODE_BATCH_AEAD_WRITES) == 0
+                   || (flags & EVP_CIPH_FLAG_AEAD_CIPHER) == 0
+                   || type != SSL3_RT_APPLICATION_DATA
+                   || s->compress != NULL
+                   || BIO_get_ktls_send(s->wbio)) {
+            maxpipes = 1;
+        }
+    }
     if (max_send_fragment == 0
             || split_send_fragment == 0
             || split_send_fragment > max_send_fragment) {
@@ -664,6 +680,39 @@ int ssl3_write_bytes(SSL *s, int type, const void *buf_, size_t len,
     }
 }
 
+/*
+ * Copy the next |len| bytes of a record that SSL_writev_ex() gathers from
+ * several fragments into |pkt|, straight from the caller's buffers, and move
+ * the gather cursor past them for the next record or pipeline.
+ */
+static int ssl3_write_gather(SSL *s, WPACKET *pkt, size_t len)
+{
+    RECORD_LAYER *rl = &s->rlayer;
+    size_t idx = rl->wiov_idx, off = rl->wiov_off, n;
+
+    while (len > 0) {
+        if (idx >= rl->wiov_num || off > rl->wiov_lens[idx])
+            return 0;
+        /* Never read past the end of the current fragment */
+        n = rl->wiov_lens[idx] - off;
+        if (n > len)
+            n = len;
+        if (n > 0
+                && !WPACKET_memcpy(pkt, (const unsigned char *)rl->wiov_bufs[idx]
+                                        + off, n))
+            return 0;
+        len -= n;
+        off += n;
+        if (off == rl->wiov_lens[idx]) {
+            idx++;
+            off = 0;
+        }
+    }
+    rl->wiov_idx = idx;
+    rl->wiov_off = off;
+    return 1;
+}
+
 int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
                   size_t *pipelens, size_t numpipes,
                   int create_empty_fragment, size_t *written)
@@ -680,7 +729,9 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
     SSL3_BUFFER *wb;
     SSL_SESSION *sess;
     size_t totlen = 0, len, wpinited = 0;
+    size_t batchlen = 0;
     size_t j;
+    int batch = 0;
 
     for (j = 0; j < numpipes; j++)
         totlen += pipelens[j];
@@ -703,7 +754,32 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
         /* if it went, fall through and send more stuff */
     }
 
-    if (s->rlayer.numwpipes < numpipes) {
+    /*
+     * Without pipeline support in the cipher, several records are sealed one
+     * by one and laid out back to back in the first write buffer. With 4 or
+     * more pipes that buffer is too large for the SSL_CTX buffer pool, and
+     * is allocated directly.
+     */
+    if (numpipes > 1
+            && (EVP_CIPHER_get_flags(EVP_CIPHER_CTX_get0_cipher(
+                                         s->enc_write_ctx))
+                & EVP_CIPH_FLAG_PIPELINE) == 0) {
+        size_t batchbuflen = numpipes * (ssl_get_max_send_fragment(s)
+                                         + SSL3_RT_SEND_MAX_ENCRYPTED_OVERHEAD
+                                         + SSL3_RT_HEADER_LENGTH);
+
+#if defined(SSL3_ALIGN_PAYLOAD) && SSL3_ALIGN_PAYLOAD!=0
+        batchbuflen += SSL3_ALIGN_PAYLOAD - 1;
+#endif
+        batch = 1;
+        if (SSL3_BUFFER_get_buf(&s->rlayer.wbuf[0]) == NULL
+                || SSL3_BUFFER_get_len(&s->rlayer.wbuf[0]) < batchbuflen) {
+            if (!ssl3_setup_write_buffer(s, 1, batchbuflen)) {
+                /* SSLfatal() already called */
+                return -1;
+            }
+        }
+    } else if (s->rlayer.numwpipes < numpipes) {
         if (!ssl3_setup_write_buffer(s, numpipes, 0)) {
             /* SSLfatal() already called */
             return -1;
@@ -764,6 +840,27 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
         s->s3.empty_fragment_done = 1;
     }
 
+    if (batch) {
+        /*
+         * Seal all records but the last with recursive calls that only append
+         * them to the buffer, like an empty fragment. The last one is sealed
+         * below and everything is written out together.
+         */
+        for (j = 0; j < numpipes - 1; j++) {
+            int ret;
+
+            ret = do_ssl3_write(s, type, &buf[batchlen], &pipelens[j], 1, 1,
+                                &prefix_len);
+            if (ret <= 0) {
+                /* SSLfatal() already called if appropriate */
+                goto err;
+            }
+            batchlen += pipelens[j];
+        }
+        pipelens += numpipes - 1;
+        numpipes = 1;
+    }
+
     if (BIO_get_ktls_send(s->wbio)) {
         /*
          * ktls doesn't modify the buffer, but to avoid a warning we need to
@@ -778,20 +875,28 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
     }
 
     if (create_empty_fragment) {
-        wb = &s->rlayer.wbuf[0];
-#if defined(SSL3_ALIGN_PAYLOAD) && SSL3_ALIGN_PAYLOAD!=0
         /*
-         * extra fragment would be couple of cipher blocks, which would be
-         * multiple of SSL3_ALIGN_PAYLOAD, so if we want to align the real
-         * payload, then we can just pretend we simply have two headers.
+         * |*written| holds the length of the records that earlier recursive
+         * calls have already put into the buffer; this one goes after them
          */
-        align = (size_t)SSL3_BUFFER_get_buf(wb) + 2 * SSL3_RT_HEADER_LENGTH;
-        align = SSL3_ALIGN_PAYLOAD - 1 - ((align - 1) % SSL3_ALIGN_PAYLOAD);
+        wb = &s->rlayer.wbuf[0];
+        if (*written == 0) {
+#if defined(SSL3_ALIGN_PAYLOAD) && SSL3_ALIGN_PAYLOAD!=0
+            /*
+             * extra fragment would be couple of cipher blocks, which would be
+             * multiple of SSL3_ALIGN_PAYLOAD, so if we want to align the real
+             * payload, then we can just pretend we simply have two headers.
+             */
+            align = (size_t)SSL3_BUFFER_get_buf(wb) + 2 * SSL3_RT_HEADER_LENGTH;
+            align = SSL3_ALIGN_PAYLOAD - 1 - ((align - 1) % SSL3_ALIGN_PAYLOAD);
 #endif
-        SSL3_BUFFER_set_offset(wb, align);
+            SSL3_BUFFER_set_offset(wb, align);
+        }
         if (!WPACKET_init_static_len(&pkt[0], SSL3_BUFFER_get_buf(wb),
                                      SSL3_BUFFER_get_len(wb), 0)
-                || !WPACKET_allocate_bytes(&pkt[0], align, NULL)) {
+                || !WPACKET_allocate_bytes(&pkt[0],
+                                           SSL3_BUFFER_get_offset(wb)
+                                           + *written, NULL)) {
             SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
             goto err;
         }
@@ -905,7 +1010,7 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
         /* lets setup the record stuff. */
         SSL3_RECORD_set_data(thiswr, compressdata);
         SSL3_RECORD_set_length(thiswr, pipelens[j]);
-        SSL3_RECORD_set_input(thiswr, (unsigned char *)&buf[totlen]);
+        SSL3_RECORD_set_input(thiswr, (unsigned char *)&buf[batchlen + totlen]);
         totlen += pipelens[j];
 
         /*
@@ -923,6 +1028,13 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
         } else {
             if (BIO_get_ktls_send(s->wbio)) {
                 SSL3_RECORD_reset_data(&wr[j]);
+            } else if (s->rlayer.wiov_bufs != NULL
+                       && type == SSL3_RT_APPLICATION_DATA) {
+                if (!ssl3_write_gather(s, thispkt, thiswr->length)) {
+                    SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
+                    goto err;
+                }
+                SSL3_RECORD_reset_input(&wr[j]);
             } else {
                 if (!WPACKET_memcpy(thispkt, thiswr->input, thiswr->length)) {
                     SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
@@ -1117,7 +1229,7 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
                 SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
                 goto err;
             }
-            *written = SSL3_RECORD_get_length(thiswr);
+            *written += SSL3_RECORD_get_length(thiswr);
             return 1;
         }
 
@@ -1138,6 +1250,7 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
      * memorize arguments so that ssl3_write_pending can detect bad write
      * retries later
      */
+    totlen += batchlen;
     s->rlayer.wpend_tot = totlen;
     s->rlayer.wpend_buf = buf;
     s->rlayer.wpend_type = type;
@@ -1262,6 +1375,73 @@ int ssl3_write_pending(SSL *s, int type, const unsigned char *buf, size_t len,
  *     Application data protocol
  *             none of our business
  */
+/* Mark |n| bytes of the application data in |rr| as read */
+static void ssl3_record_consume(SSL *s, SSL3_RECORD *rr, size_t n)
+{
+    if (s->options & SSL_OP_CLEANSE_PLAINTEXT)
+        OPENSSL_cleanse(&(rr->data[rr->off]), n);
+    SSL3_RECORD_sub_length(rr, n);
+    SSL3_RECORD_add_off(rr, n);
+    if (SSL3_RECORD_get_length(rr) == 0) {
+        s->rlayer.rstate = SSL_ST_READ_HEADER;
+        SSL3_RECORD_set_off(rr, 0);
+        SSL3_RECORD_set_read(rr);
+    }
+}
+
+/*
+ * Find the record with the application data that the next read returns,
+ * after a successful peek
+ */
+static SSL3_RECORD *ssl3_next_read_record(RECORD_LAYER *rl)
+{
+    size_t i;
+
+    for (i = 0; i < rl->numrpipes; i++) {
+        SSL3_RECORD *rr = &rl->rrec[i];
+
+        if (!SSL3_RECORD_is_read(rr)
+                && SSL3_RECORD_get_type(rr) == SSL3_RT_APPLICATION_DATA
+                && SSL3_RECORD_get_length(rr) > 0)
+            return rr;
+    }
+    return NULL;
+}
+
+/*
+ * Point |*data| at the unread application data of the current record,
+ * without copying it. A successful peek must have made it available.
+ */
+int RECORD_LAYER_get_read_data(RECORD_LAYER *rl, const unsigned char **data,
+                               size_t *len)
+{
+    SSL3_RECORD *rr = ssl3_next_read_record(rl);
+
+    if (rr == NULL)
+        return 0;
+    *data = &rr->data[rr->off];
+    *len = SSL3_RECORD_get_length(rr);
+    return 1;
+}
+
+/*
+ * Mark |num| bytes returned by RECORD_LAYER_get_read_data() as read, which
+ * must not be more than it returned
+ */
+int RECORD_LAYER_consume_read_data(RECORD_LAYER *rl, size_t num)
+{
+    SSL3_RECORD *rr = ssl3_next_read_record(rl);
+
+    if (rr == NULL || num > SSL3_RECORD_get_length(rr))
+        return 0;
+    ssl3_record_consume(rl->s, rr, num);
+    if (ssl3_next_read_record(rl) == NULL
+            && (rl->s->mode & SSL_MODE_RELEASE_BUFFERS) != 0
+            && SSL3_BUFFER_get_left(&rl->rbuf) == 0)
+        ssl3_release_read_buffer(rl->s);
+    return 1;
+}
+
 int ssl3_read_bytes(SSL *s, int type, int *recvd_type, unsigned char *buf,
                     size_t len, int peek, size_t *readbytes)
 {
@@ -1345,7 +1525,13 @@ int ssl3_read_bytes(SSL *s, int type, int *recvd_type, unsigned char *buf,
     do {
         /* get new records if necessary */
         if (num_recs == 0) {
+            if ((s->mode & SSL_MODE_DECRYPT_INTO_APP_BUFFER) != 0
+                    && type == SSL3_RT_APPLICATION_DATA && !peek && len > 0) {
+                s->rlayer.rdirect_buf = buf;
+                s->rlayer.rdirect_len = len;
+            }
             ret = ssl3_get_record(s);
+            s->rlayer.rdirect_buf = NULL;
             if (ret <= 0) {
                 /* SSLfatal() already called if appropriate */
                 return ret;
@@ -1452,23 +1638,23 @@ int ssl3_read_bytes(SSL *s, int type, int *recvd_type, unsigned char *buf,
             else
                 n = len - totalbytes;
 
-            memcpy(buf, &(rr->data[rr->off]), n);
-            buf += n;
-            if (peek) {
-                /* Mark any zero length record as consumed CVE-2016-6305 */
-                if (SSL3_RECORD_get_length(rr) == 0)
-                    SSL3_RECORD_set_read(rr);
-            } else {
-                if (s->options & SSL_OP_CLEANSE_PLAINTEXT)
-                    OPENSSL_cleanse(&(rr->data[rr->off]), n);
+            if (&rr->data[rr->off] == buf) {
+                /* Decrypted into the caller's buffer, nothing to copy */
                 SSL3_RECORD_sub_length(rr, n);
-                SSL3_RECORD_add_off(rr, n);
-                if (SSL3_RECORD_get_length(rr) == 0) {
-                    s->rlayer.rstate = SSL_ST_READ_HEADER;
-                    SSL3_RECORD_set_off(rr, 0);
-                    SSL3_RECORD_set_read(rr);
+                SSL3_RECORD_set_off(rr, 0);
+                SSL3_RECORD_set_read(rr);
+                s->rlayer.rstate = SSL_ST_READ_HEADER;
+            } else {
+                memcpy(buf, &(rr->data[rr->off]), n);
+                if (peek) {
+                    /* Mark any zero length record as consumed CVE-2016-6305 */
+                    if (SSL3_RECORD_get_length(rr) == 0)
+                        SSL3_RECORD_set_read(rr);
+                } else {
+                    ssl3_record_consume(s, rr, n);
                 }
             }
+            buf += n;
             if (SSL3_RECORD_get_length(rr) == 0
                 || (peek && n == SSL3_RECORD_get_length(rr))) {
                 curr_rec++;
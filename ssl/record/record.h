@@ -27,6 +27,8 @@ typedef struct ssl3_buffer_st {
     size_t left;
     /* 'buf' is from application for KTLS */
     int app_buffer;
+    /* 'buf' was borrowed from the buffer pool of the SSL_CTX */
+    int pooled;
 } SSL3_BUFFER;
 
 #define SEQ_NUM_SIZE                            8
@@ -162,6 +164,33 @@ typedef struct record_layer_st {
     /* number of bytes submitted */
     size_t wpend_ret;
     const unsigned char *wpend_buf;
+    /*
+     * SSL_writev_ex() state.  While a record is gathered from several of the
+     * fragments passed to it, |wiov_bufs| is set and |wiov_idx| and
+     * |wiov_off| point at the next byte to gather.  The cursor is advanced as
+     * each record, or pipeline, is filled, and the caller only sets it for
+     * the duration of a single ssl_write_internal() call of at most one
+     * record's worth of data.
+     *
+     * |wiov_done| counts the bytes an interrupted call already wrote.  As for
+     * SSL_write(), the call has to be retried with the same fragments, and it
+     * then carries on from there: the record that was pending is flushed as
+     * it is, and the cursor is recomputed from |wiov_done| for the records
+     * after it.  It is not used with SSL_MODE_ENABLE_PARTIAL_WRITE, where the
+     * caller passes the remaining data instead.
+     */
+    const void *const *wiov_bufs;
+    const size_t *wiov_lens;
+    size_t wiov_num;
+    size_t wiov_idx;
+    size_t wiov_off;
+    size_t wiov_done;
+    /*
+     * With SSL_MODE_DECRYPT_INTO_APP_BUFFER, the buffer passed to SSL_read()
+     * while the next record is read and decrypted
+     */
+    unsigned char *rdirect_buf;
+    size_t rdirect_len;
     unsigned char read_sequence[SEQ_NUM_SIZE];
     unsigned char write_sequence[SEQ_NUM_SIZE];
     /* Set to true if this is the first record in a connection */
@@ -205,6 +234,9 @@ void RECORD_LAYER_release(RECORD_LAYER *rl);
 int RECORD_LAYER_read_pending(const RECORD_LAYER *rl);
 int RECORD_LAYER_processed_read_pending(const RECORD_LAYER *rl);
 int RECORD_LAYER_write_pending(const RECORD_LAYER *rl);
+int RECORD_LAYER_get_read_data(RECORD_LAYER *rl, const unsigned char **data,
+                               size_t *len);
+int RECORD_LAYER_consume_read_data(RECORD_LAYER *rl, size_t num);
 void RECORD_LAYER_reset_read_sequence(RECORD_LAYER *rl);
 void RECORD_LAYER_reset_write_sequence(RECORD_LAYER *rl);
 int RECORD_LAYER_is_sslv2_record(RECORD_LAYER *rl);
@@ -1,5 +1,5 @@
 /*
- * Copyright 1995-2020 The OpenSSL Project Authors. All Rights Reserved.
+ * Copyright 1995-2021 The OpenSSL Project Authors. All Rights Reserved.
  *
  * Licensed under the Apache License 2.0 (the "License").  You may not use
  * this file except in compliance with the License.  You can obtain a copy
@@ -7,9 +7,243 @@
  * https://www.openssl.org/source/license.html
  */
 
+#include "internal/tsan_assist.h"
 #include "../ssl_local.h"
 #include "record_local.h"
 
+/*
+ * Record buffers can be borrowed from a pool shared by the SSL objects of an
+ * SSL_CTX, see SSL_CTX_set_buffer_pool_size(). Pooled buffers are rounded up
+ * to a multiple of SSL_BUFFER_POOL_GRANULE and kept on one free list per
+ * size. The pool is split into shards with a lock of their own, and an SSL
+ * object always uses the same shard.
+ *
+ * Buffers larger than the largest size class are always allocated and freed
+ * directly. That includes the write buffer used by SSL_MODE_BATCH_AEAD_WRITES
+ * with 4 or more pipelines, which holds that many full records.
+ */
+#define SSL_BUFFER_POOL_SHARDS  8
+#define SSL_BUFFER_POOL_CLASSES 16
+#define SSL_BUFFER_POOL_GRANULE 4096
+
+typedef struct ssl_buffer_pool_shard_st {
+    CRYPTO_RWLOCK *lock;
+    /* Free buffers of each size, linked through their first bytes */
+    unsigned char *free[SSL_BUFFER_POOL_CLASSES];
+    size_t num_free;
+    size_t max_free;
+} SSL_BUFFER_POOL_SHARD;
+
+struct ssl_buffer_pool_st {
+    SSL_BUFFER_POOL_SHARD shards[SSL_BUFFER_POOL_SHARDS];
+    size_t max_free;
+    /* Serialises the updates of stats.peak_in_use */
+    CRYPTO_RWLOCK *peak_lock;
+    struct {
+        TSAN_QUALIFIER int hits;
+        TSAN_QUALIFIER int misses;
+        TSAN_QUALIFIER int in_use;
+        TSAN_QUALIFIER int peak_in_use;
+        TSAN_QUALIFIER int cached;
+    } stats;
+};
+
+static SSL_BUFFER_POOL_SHARD *buffer_pool_shard(SSL_BUFFER_POOL *pool,
+                                                const SSL *s)
+{
+    uint32_t h = (uint32_t)((uintptr_t)s >> 4) * 0x9E3779B1U;
+
+    return &pool->shards[(h >> 16) % SSL_BUFFER_POOL_SHARDS];
+}
+
+/* Trim the free lists of |sh| to its maximum, called with its lock held */
+static void buffer_pool_shard_trim(SSL_BUFFER_POOL *pool,
+                                   SSL_BUFFER_POOL_SHARD *sh)
+{
+    size_t i;
+    unsigned char *p;
+
+    for (i = 0; i < SSL_BUFFER_POOL_CLASSES && sh->num_free > sh->max_free;
+         i++) {
+        while (sh->free[i] != NULL && sh->num_free > sh->max_free) {
+            p = sh->free[i];
+            memcpy(&sh->free[i], p, sizeof(p));
+            OPENSSL_free(p);
+            sh->num_free--;
+            tsan_decr(&pool->stats.cached);
+        }
+    }
+}
+
+int ssl_buffer_pool_set_size(SSL_CTX *ctx, size_t max_free)
+{
+    SSL_BUFFER_POOL *pool = ctx->buf_pool;
+    size_t i;
+
+    if (pool == NULL) {
+        if (max_free == 0)
+            return 1;
+        if ((pool = OPENSSL_zalloc(sizeof(*pool))) == NULL) {
+            ERR_raise(ERR_LIB_SSL, ERR_R_MALLOC_FAILURE);
+            return 0;
+        }
+        if ((pool->peak_lock = CRYPTO_THREAD_lock_new()) == NULL) {
+            ERR_raise(ERR_LIB_SSL, ERR_R_MALLOC_FAILURE);
+            ssl_buffer_pool_free(pool);
+            return 0;
+        }
+        for (i = 0; i < SSL_BUFFER_POOL_SHARDS; i++) {
+            if ((pool->shards[i].lock = CRYPTO_THREAD_lock_new()) == NULL) {
+                ERR_raise(ERR_LIB_SSL, ERR_R_MALLOC_FAILURE);
+                ssl_buffer_pool_free(pool);
+                return 0;
+            }
+        }
+        ctx->buf_pool = pool;
+    }
+
+    pool->max_free = max_free;
+    for (i = 0; i < SSL_BUFFER_POOL_SHARDS; i++) {
+        SSL_BUFFER_POOL_SHARD *sh = &pool->shards[i];
+
+        if (!CRYPTO_THREAD_write_lock(sh->lock))
+            return 0;
+        /* Spread the remainder over the first shards, to keep n in total */
+        sh->max_free = max_free / SSL_BUFFER_POOL_SHARDS
+                       + (i < max_free % SSL_BUFFER_POOL_SHARDS);
+        buffer_pool_shard_trim(pool, sh);
+        CRYPTO_THREAD_unlock(sh->lock);
+    }
+    return 1;
+}
+
+void ssl_buffer_pool_free(SSL_BUFFER_POOL *pool)
+{
+    size_t i;
+
+    if (pool == NULL)
+        return;
+    for (i = 0; i < SSL_BUFFER_POOL_SHARDS; i++) {
+        pool->shards[i].max_free = 0;
+        buffer_pool_shard_trim(pool, &pool->shards[i]);
+        CRYPTO_THREAD_lock_free(pool->shards[i].lock);
+    }
+    CRYPTO_THREAD_lock_free(pool->peak_lock);
+    OPENSSL_free(pool);
+}
+
+long ssl_buffer_pool_ctrl(const SSL_CTX *ctx, int cmd)
+{
+    SSL_BUFFER_POOL *pool = ctx->buf_pool;
+
+    if (pool == NULL)
+        return 0;
+    switch (cmd) {
+    case SSL_CTRL_GET_BUFFER_POOL_SIZE:
+        return (long)pool->max_free;
+    case SSL_CTRL_BUFFER_POOL_HITS:
+        return tsan_load(&pool->stats.hits);
+    case SSL_CTRL_BUFFER_POOL_MISSES:
+        return tsan_load(&pool->stats.misses);
+    case SSL_CTRL_BUFFER_POOL_IN_USE:
+        return tsan_load(&pool->stats.in_use);
+    case SSL_CTRL_BUFFER_POOL_PEAK_IN_USE:
+        return tsan_load(&pool->stats.peak_in_use);
+    case SSL_CTRL_BUFFER_POOL_CACHED:
+        return tsan_load(&pool->stats.cached);
+    default:
+        return 0;
+    }
+}
+
+/*
+ * Allocate the memory for a record buffer of |len| bytes, from the pool if
+ * the SSL_CTX has one. DTLS buffers are moved into record queues and freed
+ * from there, so they never come from the pool.
+ */
+static unsigned char *ssl3_buffer_alloc(SSL *s, size_t len, int *pooled)
+{
+    SSL_BUFFER_POOL *pool = s->session_ctx->buf_pool;
+    SSL_BUFFER_POOL_SHARD *sh;
+    unsigned char *p = NULL;
+    size_t cls;
+    int in_use;
+
+    *pooled = 0;
+    if (pool == NULL || SSL_IS_DTLS(s) || len == 0
+            || len > SSL_BUFFER_POOL_CLASSES * SSL_BUFFER_POOL_GRANULE)
+        return OPENSSL_malloc(len);
+
+    cls = (len - 1) / SSL_BUFFER_POOL_GRANULE;
+    sh = buffer_pool_shard(pool, s);
+    if (CRYPTO_THREAD_write_lock(sh->lock)) {
+        if ((p = sh->free[cls]) != NULL) {
+            memcpy(&sh->free[cls], p, sizeof(p));
+            sh->num_free--;
+        }
+        CRYPTO_THREAD_unlock(sh->lock);
+    }
+    if (p != NULL) {
+        tsan_counter(&pool->stats.hits);
+        tsan_decr(&pool->stats.cached);
+    } else {
+        p = OPENSSL_malloc((cls + 1) * SSL_BUFFER_POOL_GRANULE);
+        if (p == NULL)
+            return NULL;
+        tsan_counter(&pool->stats.misses);
+    }
+    /*
+     * A new peak is only stored under the lock, and only if it is still
+     * higher than the current one, so concurrent updates can't lose a
+     * maximum. The lock is rarely taken once the pool has warmed up.
+     */
+    in_use = tsan_counter(&pool->stats.in_use) + 1;
+    if (in_use > tsan_load(&pool->stats.peak_in_use)
+            && CRYPTO_THREAD_write_lock(pool->peak_lock)) {
+        if (in_use > tsan_load(&pool->stats.peak_in_use))
+            tsan_store(&pool->stats.peak_in_use, in_use);
+        CRYPTO_THREAD_unlock(pool->peak_lock);
+    }
+    *pooled = 1;
+    return p;
+}
+
+/* Free the memory of |b|, or give it back to the pool it was borrowed from */
+static void ssl3_buffer_free(SSL *s, SSL3_BUFFER *b)
+{
+    SSL_BUFFER_POOL *pool = s->session_ctx->buf_pool;
+    SSL_BUFFER_POOL_SHARD *sh;
+    unsigned char *p = b->buf;
+    size_t cls;
+
+    b->buf = NULL;
+    if (!b->pooled || pool == NULL) {
+        b->pooled = 0;
+        OPENSSL_free(p);
+        return;
+    }
+    b->pooled = 0;
+    tsan_decr(&pool->stats.in_use);
+
+    /* The next connection to get the buffer must not see this one's data */
+    OPENSSL_cleanse(p, b->len);
+    cls = (b->len - 1) / SSL_BUFFER_POOL_GRANULE;
+    sh = buffer_pool_shard(pool, s);
+    if (CRYPTO_THREAD_write_lock(sh->lock)) {
+        if (sh->num_free < sh->max_free) {
+            memcpy(p, &sh->free[cls], sizeof(p));
+            sh->free[cls] = p;
+            sh->num_free++;
+            p = NULL;
+        }
+        CRYPTO_THREAD_unlock(sh->lock);
+    }
+    if (p == NULL)
+        tsan_counter(&pool->stats.cached);
+    else
+        OPENSSL_free(p);
+}
+
 void SSL3_BUFFER_set_data(SSL3_BUFFER *b, const unsigned char *d, size_t n)
 {
     if (d != NULL)
@@ -39,6 +273,7 @@ int ssl3_setup_read_buffer(SSL *s)
     unsigned char *p;
     size_t len, align = 0, headerlen;
     SSL3_BUFFER *b;
+    int pooled;
 
     b = RECORD_LAYER_get_rbuf(&s->rlayer);
 
@@ -60,7 +295,7 @@ int ssl3_setup_read_buffer(SSL *s)
 #endif
         if (b->default_len > len)
             len = b->default_len;
-        if ((p = OPENSSL_malloc(len)) == NULL) {
+        if ((p = ssl3_buffer_alloc(s, len, &pooled)) == NULL) {
             /*
              * We've got a malloc failure, and we're still initialising buffers.
              * We assume we're so doomed that we won't even be able to send an
@@ -71,6 +306,7 @@ int ssl3_setup_read_buffer(SSL *s)
         }
         b->buf = p;
         b->len = len;
+        b->pooled = pooled;
     }
 
     RECORD_LAYER_set_packet(&s->rlayer, &(b->buf[0]));
@@ -83,6 +319,7 @@ int ssl3_setup_write_buffer(SSL *s, size_t numwpipes, size_t len)
     size_t align = 0, headerlen;
     SSL3_BUFFER *wb;
     size_t currpipe;
+    int pooled = 0;
 
     s->rlayer.numwpipes = numwpipes;
 
@@ -110,14 +347,12 @@ int ssl3_setup_write_buffer(SSL *s, size_t numwpipes, size_t len)
     for (currpipe = 0; currpipe < numwpipes; currpipe++) {
         SSL3_BUFFER *thiswb = &wb[currpipe];
 
-        if (thiswb->len != len) {
-            OPENSSL_free(thiswb->buf);
-            thiswb->buf = NULL;         /* force reallocation */
-        }
+        if (thiswb->len != len)
+            ssl3_buffer_free(s, thiswb); /* force reallocation */
 
         if (thiswb->buf == NULL) {
             if (s->wbio == NULL || !BIO_get_ktls_send(s->wbio)) {
-                p = OPENSSL_malloc(len);
+                p = ssl3_buffer_alloc(s, len, &pooled);
                 if (p == NULL) {
                     s->rlayer.numwpipes = currpipe;
                     /*
@@ -130,10 +365,12 @@ int ssl3_setup_write_buffer(SSL *s, size_t numwpipes, size_t len)
                 }
             } else {
                 p = NULL;
+                pooled = 0;
             }
             memset(thiswb, 0, sizeof(SSL3_BUFFER));
             thiswb->buf = p;
             thiswb->len = len;
+            thiswb->pooled = pooled;
         }
     }
 
@@ -165,7 +402,7 @@ int ssl3_release_write_buffer(SSL *s)
         if (SSL3_BUFFER_is_app_buffer(wb))
             SSL3_BUFFER_set_app_buffer(wb, 0);
         else
-            OPENSSL_free(wb->buf);
+            ssl3_buffer_free(s, wb);
         wb->buf = NULL;
         pipes--;
     }
@@ -180,7 +417,6 @@ int ssl3_release_read_buffer(SSL *s)
     b = RECORD_LAYER_get_rbuf(&s->rlayer);
     if (s->options & SSL_OP_CLEANSE_PLAINTEXT)
         OPENSSL_cleanse(b->buf, b->len);
-    OPENSSL_free(b->buf);
-    b->buf = NULL;
+    ssl3_buffer_free(s, b);
     return 1;
 }
@@ -185,13 +185,17 @@ int ssl3_get_record(SSL *s)
     int imac_size;
     size_t num_recs = 0, max_recs, j;
     PACKET pkt, sslv2pkt;
-    int is_ktls_left;
+    int is_ktls_left, using_ktls;
     SSL_MAC_BUF *macbufs = NULL;
+    unsigned char *direct = NULL;
+    size_t directlen = 0;
     int ret = -1;
 
     rr = RECORD_LAYER_get_rrec(&s->rlayer);
     rbuf = RECORD_LAYER_get_rbuf(&s->rlayer);
     is_ktls_left = (rbuf->left > 0);
+    /* Records read from the kernel are already decrypted */
+    using_ktls = BIO_get_ktls_recv(s->rbio) && !is_ktls_left;
     max_recs = s->max_pipelines;
     if (max_recs == 0)
         max_recs = 1;
@@ -361,7 +365,8 @@ int ssl3_get_record(SSL *s)
                     }
                 }
 
-                if (SSL_IS_TLS13(s) && s->enc_read_ctx != NULL) {
+                if (SSL_IS_TLS13(s) && s->enc_read_ctx != NULL
+                        && !using_ktls) {
                     if (thisrr->type != SSL3_RT_APPLICATION_DATA
                             && (thisrr->type != SSL3_RT_CHANGE_CIPHER_SPEC
                                 || !SSL_IS_FIRST_HANDSHAKE(s))
@@ -487,7 +492,8 @@ int ssl3_get_record(SSL *s)
     if (num_recs == 1
             && thisrr->type == SSL3_RT_CHANGE_CIPHER_SPEC
             && (SSL_IS_TLS13(s) || s->hello_retry_request != SSL_HRR_NONE)
-            && SSL_IS_FIRST_HANDSHAKE(s)) {
+            && SSL_IS_FIRST_HANDSHAKE(s)
+            && !using_ktls) {
         /*
          * CCS messages must be exactly 1 byte long, containing the value 0x01
          */
@@ -518,7 +524,7 @@ int ssl3_get_record(SSL *s)
      * KTLS reads full records. If there is any data left,
      * then it is from before enabling ktls
      */
-    if (BIO_get_ktls_recv(s->rbio) && !is_ktls_left)
+    if (using_ktls)
         goto skip_decryption;
 
     if (s->read_hash != NULL) {
@@ -572,6 +578,29 @@ int ssl3_get_record(SSL *s)
         }
     }
 
+    /*
+     * A TLSv1.3 application data record that fits into the buffer passed to
+     * SSL_read() is decrypted straight into it. The tag is not part of the
+     * output; it is the same size as in tls13_enc().
+     */
+    if (s->rlayer.rdirect_buf != NULL
+            && num_recs == 1
+            && SSL_IS_TLS13(s)
+            && s->enc_read_ctx != NULL
+            && s->s3.tmp.new_cipher != NULL
+            && rr[0].type == SSL3_RT_APPLICATION_DATA) {
+        size_t taglen = EVP_GCM_TLS_TAG_LEN;
+
+        if ((s->s3.tmp.new_cipher->algorithm_enc
+             & (SSL_AES128CCM8 | SSL_AES256CCM8)) != 0)
+            taglen = EVP_CCM8_TLS_TAG_LEN;
+        if (rr[0].length <= s->rlayer.rdirect_len + taglen) {
+            rr[0].data = direct = s->rlayer.rdirect_buf;
+            directlen = rr[0].length < s->rlayer.rdirect_len
+                        ? rr[0].length : s->rlayer.rdirect_len;
+        }
+    }
+
     enc_err = s->method->ssl3_enc->enc(s, rr, num_recs, 0, macbufs, mac_size);
 
     /*-
@@ -670,8 +699,22 @@ int ssl3_get_record(SSL *s)
             }
         }
 
+        /*
+         * In TLSv1.3 the kernel removes the padding and reports the inner
+         * content type as the record type
+         */
+        if (SSL_IS_TLS13(s)
+                && using_ktls
+                && thisrr->type != SSL3_RT_APPLICATION_DATA
+                && thisrr->type != SSL3_RT_ALERT
+                && thisrr->type != SSL3_RT_HANDSHAKE) {
+            SSLfatal(s, SSL_AD_UNEXPECTED_MESSAGE, SSL_R_BAD_RECORD_TYPE);
+            goto end;
+        }
+
         if (SSL_IS_TLS13(s)
                 && s->enc_read_ctx != NULL
+                && !using_ktls
                 && thisrr->type != SSL3_RT_ALERT) {
             size_t end;
 
@@ -697,6 +740,18 @@ int ssl3_get_record(SSL *s)
             if (s->msg_callback)
                 s->msg_callback(0, s->version, SSL3_RT_INNER_CONTENT_TYPE,
                                 &thisrr->data[end], 1, s, s->msg_callback_arg);
+
+            /*
+             * Only application data may stay in the caller's buffer, anything
+             * else is processed later and goes back into the read buffer
+             */
+            if (thisrr->data != thisrr->input
+                    && thisrr->type != SSL3_RT_APPLICATION_DATA) {
+                memcpy(thisrr->input, thisrr->data, thisrr->length);
+                thisrr->data = thisrr->input;
+                OPENSSL_cleanse(direct, directlen);
+                direct = NULL;
+            }
         }
 
         /*
@@ -759,6 +814,12 @@ int ssl3_get_record(SSL *s)
     RECORD_LAYER_set_numrpipes(&s->rlayer, num_recs);
     ret = 1;
  end:
+    /*
+     * Don't leave anything in the caller's buffer unless it holds the
+     * authenticated application data of the record
+     */
+    if (direct != NULL && (ret <= 0 || rr[0].length == 0))
+        OPENSSL_cleanse(direct, directlen);
     if (macbufs != NULL) {
         for (j = 0; j < num_recs; j++) {
             if (macbufs[j].alloced)
@@ -3458,6 +3458,8 @@ long ssl3_ctrl(SSL *s, int cmd, long larg, void *parg)
         }
 #endif
     case SSL_CTRL_SET_DH_AUTO:
+        if (!ssl_cert_unshare(s, NULL))
+            return 0;
         s->cert->dh_tmp_auto = larg;
         return 1;
 #if !defined(OPENSSL_NO_DEPRECATED_3_0)
@@ -3570,7 +3572,8 @@ long ssl3_ctrl(SSL *s, int cmd, long larg, void *parg)
         break;
 
     case SSL_CTRL_SELECT_CURRENT_CERT:
-        return ssl_cert_select_current(s->cert, (X509 *)parg);
+        return ssl_cert_unshare(s, NULL)
+               && ssl_cert_select_current(s->cert, (X509 *)parg);
 
     case SSL_CTRL_SET_CURRENT_CERT:
         if (larg == SSL_CERT_SET_SERVER) {
@@ -3588,10 +3591,10 @@ long ssl3_ctrl(SSL *s, int cmd, long larg, void *parg)
                 return 2;
             if (s->s3.tmp.cert == NULL)
                 return 0;
-            s->cert->key = s->s3.tmp.cert;
-            return 1;
+            return ssl_cert_set_current_pkey(s, s->s3.tmp.cert);
         }
-        return ssl_cert_set_current(s->cert, larg);
+        return ssl_cert_unshare(s, NULL)
+               && ssl_cert_set_current(s->cert, larg);
 
     case SSL_CTRL_GET_GROUPS:
         {
@@ -3647,16 +3650,20 @@ long ssl3_ctrl(SSL *s, int cmd, long larg, void *parg)
             break;
         }
     case SSL_CTRL_SET_SIGALGS:
-        return tls1_set_sigalgs(s->cert, parg, larg, 0);
+        return ssl_cert_unshare(s, NULL)
+               && tls1_set_sigalgs(s->cert, parg, larg, 0);
 
     case SSL_CTRL_SET_SIGALGS_LIST:
-        return tls1_set_sigalgs_list(s->cert, parg, 0);
+        return ssl_cert_unshare(s, NULL)
+               && tls1_set_sigalgs_list(s->cert, parg, 0);
 
     case SSL_CTRL_SET_CLIENT_SIGALGS:
-        return tls1_set_sigalgs(s->cert, parg, larg, 1);
+        return ssl_cert_unshare(s, NULL)
+               && tls1_set_sigalgs(s->cert, parg, larg, 1);
 
     case SSL_CTRL_SET_CLIENT_SIGALGS_LIST:
-        return tls1_set_sigalgs_list(s->cert, parg, 1);
+        return ssl_cert_unshare(s, NULL)
+               && tls1_set_sigalgs_list(s->cert, parg, 1);
 
     case SSL_CTRL_GET_CLIENT_CERT_TYPES:
         {
@@ -3671,16 +3678,19 @@ long ssl3_ctrl(SSL *s, int cmd, long larg, void *parg)
     case SSL_CTRL_SET_CLIENT_CERT_TYPES:
         if (!s->server)
             return 0;
-        return ssl3_set_req_cert_type(s->cert, parg, larg);
+        return ssl_cert_unshare(s, NULL)
+               && ssl3_set_req_cert_type(s->cert, parg, larg);
 
     case SSL_CTRL_BUILD_CERT_CHAIN:
         return ssl_build_cert_chain(s, NULL, larg);
 
     case SSL_CTRL_SET_VERIFY_CERT_STORE:
-        return ssl_cert_set_cert_store(s->cert, parg, 0, larg);
+        return ssl_cert_unshare(s, NULL)
+               && ssl_cert_set_cert_store(s->cert, parg, 0, larg);
 
     case SSL_CTRL_SET_CHAIN_CERT_STORE:
-        return ssl_cert_set_cert_store(s->cert, parg, 1, larg);
+        return ssl_cert_unshare(s, NULL)
+               && ssl_cert_set_cert_store(s->cert, parg, 1, larg);
 
     case SSL_CTRL_GET_PEER_SIGNATURE_NID:
         if (s->s3.tmp.peer_sigalg == NULL)
@@ -3735,6 +3745,8 @@ long ssl3_callback_ctrl(SSL *s, int cmd, void (*fp) (void))
     switch (cmd) {
 #if !defined(OPENSSL_NO_DEPRECATED_3_0)
     case SSL_CTRL_SET_TMP_DH_CB:
+        if (!ssl_cert_unshare(s, NULL))
+            break;
         s->cert->dh_tmp_cb = (DH *(*)(SSL *, int, int))fp;
         ret = 1;
         break;
@@ -3780,6 +3792,8 @@ long ssl3_ctx_ctrl(SSL_CTX *ctx, int cmd, long larg, void *parg)
         }
 #endif
     case SSL_CTRL_SET_DH_AUTO:
+        if (!ssl_cert_unshare(NULL, ctx))
+            return 0;
         ctx->cert->dh_tmp_auto = larg;
         return 1;
 #if !defined(OPENSSL_NO_DEPRECATED_3_0)
@@ -3900,28 +3914,35 @@ long ssl3_ctx_ctrl(SSL_CTX *ctx, int cmd, long larg, void *parg)
                                     parg);
 
     case SSL_CTRL_SET_SIGALGS:
-        return tls1_set_sigalgs(ctx->cert, parg, larg, 0);
+        return ssl_cert_unshare(NULL, ctx)
+               && tls1_set_sigalgs(ctx->cert, parg, larg, 0);
 
     case SSL_CTRL_SET_SIGALGS_LIST:
-        return tls1_set_sigalgs_list(ctx->cert, parg, 0);
+        return ssl_cert_unshare(NULL, ctx)
+               && tls1_set_sigalgs_list(ctx->cert, parg, 0);
 
     case SSL_CTRL_SET_CLIENT_SIGALGS:
-        return tls1_set_sigalgs(ctx->cert, parg, larg, 1);
+        return ssl_cert_unshare(NULL, ctx)
+               && tls1_set_sigalgs(ctx->cert, parg, larg, 1);
 
     case SSL_CTRL_SET_CLIENT_SIGALGS_LIST:
-        return tls1_set_sigalgs_list(ctx->cert, parg, 1);
+        return ssl_cert_unshare(NULL, ctx)
+               && tls1_set_sigalgs_list(ctx->cert, parg, 1);
 
     case SSL_CTRL_SET_CLIENT_CERT_TYPES:
-        return ssl3_set_req_cert_type(ctx->cert, parg, larg);
+        return ssl_cert_unshare(NULL, ctx)
+               && ssl3_set_req_cert_type(ctx->cert, parg, larg);
 
     case SSL_CTRL_BUILD_CERT_CHAIN:
         return ssl_build_cert_chain(NULL, ctx, larg);
 
     case SSL_CTRL_SET_VERIFY_CERT_STORE:
-        return ssl_cert_set_cert_store(ctx->cert, parg, 0, larg);
+        return ssl_cert_unshare(NULL, ctx)
+               && ssl_cert_set_cert_store(ctx->cert, parg, 0, larg);
 
     case SSL_CTRL_SET_CHAIN_CERT_STORE:
-        return ssl_cert_set_cert_store(ctx->cert, parg, 1, larg);
+        return ssl_cert_unshare(NULL, ctx)
+               && ssl_cert_set_cert_store(ctx->cert, parg, 1, larg);
 
         /* A Thawte special :-) */
     case SSL_CTRL_EXTRA_CHAIN_CERT:
@@ -3966,10 +3987,12 @@ long ssl3_ctx_ctrl(SSL_CTX *ctx, int cmd, long larg, void *parg)
         break;
 
     case SSL_CTRL_SELECT_CURRENT_CERT:
-        return ssl_cert_select_current(ctx->cert, (X509 *)parg);
+        return ssl_cert_unshare(NULL, ctx)
+               && ssl_cert_select_current(ctx->cert, (X509 *)parg);
 
     case SSL_CTRL_SET_CURRENT_CERT:
-        return ssl_cert_set_current(ctx->cert, larg);
+        return ssl_cert_unshare(NULL, ctx)
+               && ssl_cert_set_current(ctx->cert, larg);
 
     default:
         return 0;
@@ -3983,6 +4006,8 @@ long ssl3_ctx_callback_ctrl(SSL_CTX *ctx, int cmd, void (*fp) (void))
 #if !defined(OPENSSL_NO_DEPRECATED_3_0)
     case SSL_CTRL_SET_TMP_DH_CB:
         {
+            if (!ssl_cert_unshare(NULL, ctx))
+                return 0;
             ctx->cert->dh_tmp_cb = (DH *(*)(SSL *, int, int))fp;
         }
         break;
@@ -248,13 +248,60 @@ void ssl_cert_free(CERT *c)
     OPENSSL_free(c);
 }
 
+/*
+ * An SSL starts out sharing the CERT of the SSL_CTX it was created from, so
+ * anything about to modify s->cert or ctx->cert (exactly one of |s| and |ctx|
+ * is non-NULL) must call this first to get a private copy of a shared CERT.
+ * As the ClientHello template of |ctx| depends on its CERT, that is dropped.
+ */
+int ssl_cert_unshare(SSL *s, SSL_CTX *ctx)
+{
+    CERT **pc = s != NULL ? &s->cert : &ctx->cert;
+    CERT *ret;
+
+    if (ctx != NULL)
+        ssl_ctx_clear_ch_template(ctx);
+
+    /*
+     * Only the holders of a CERT can take further references to it, and a
+     * reference count of one means that we are the only holder.
+     */
+    if ((*pc)->references == 1)
+        return 1;
+    if ((ret = ssl_cert_dup(*pc)) == NULL)
+        return 0;
+    if (s != NULL && s->s3.tmp.cert != NULL)
+        s->s3.tmp.cert = &ret->pkeys[s->s3.tmp.cert - (*pc)->pkeys];
+    ssl_cert_free(*pc);
+    *pc = ret;
+    return 1;
+}
+
+/*
+ * Make |cpk|, an element of s->cert->pkeys, the current certificate of |s|.
+ * This happens on every handshake, so it leaves a shared CERT alone if the
+ * certificate is current already.
+ */
+int ssl_cert_set_current_pkey(SSL *s, CERT_PKEY *cpk)
+{
+    size_t idx = cpk - s->cert->pkeys;
+
+    if (s->cert->key == cpk)
+        return 1;
+    if (!ssl_cert_unshare(s, NULL))
+        return 0;
+    s->cert->key = &s->cert->pkeys[idx];
+    return 1;
+}
+
 int ssl_cert_set0_chain(SSL *s, SSL_CTX *ctx, STACK_OF(X509) *chain)
 {
     int i, r;
-    CERT_PKEY *cpk = s != NULL ? s->cert->key : ctx->cert->key;
+    CERT_PKEY *cpk;
 
-    if (!cpk)
+    if (!ssl_cert_unshare(s, ctx))
         return 0;
+    cpk = s != NULL ? s->cert->key : ctx->cert->key;
     for (i = 0; i < sk_X509_num(chain); i++) {
         X509 *x = sk_X509_value(chain, i);
 
@@ -287,9 +334,11 @@ int ssl_cert_set1_chain(SSL *s, SSL_CTX *ctx, STACK_OF(X509) *chain)
 int ssl_cert_add0_chain_cert(SSL *s, SSL_CTX *ctx, X509 *x)
 {
     int r;
-    CERT_PKEY *cpk = s ? s->cert->key : ctx->cert->key;
-    if (!cpk)
+    CERT_PKEY *cpk;
+
+    if (!ssl_cert_unshare(s, ctx))
         return 0;
+    cpk = s != NULL ? s->cert->key : ctx->cert->key;
     r = ssl_security_cert(s, ctx, x, 0, 0);
     if (r != 1) {
         ERR_raise(ERR_LIB_SSL, r);
@@ -362,6 +411,10 @@ void ssl_cert_set_cert_cb(CERT *c, int (*cb) (SSL *ssl, void *arg), void *arg)
     c->cert_cb_arg = arg;
 }
 
+/*
+ * Returns 1 if the chain verified, 0 if it did not and -1 if the application
+ * asked for the verification to be retried later.
+ */
 int ssl_verify_cert_chain(SSL *s, STACK_OF(X509) *sk)
 {
     X509 *x;
@@ -423,10 +476,18 @@ int ssl_verify_cert_chain(SSL *s, STACK_OF(X509) *sk)
     if (s->verify_callback)
         X509_STORE_CTX_set_verify_cb(ctx, s->verify_callback);
 
-    if (s->ctx->app_verify_callback != NULL)
+    s->rwstate = SSL_NOTHING;
+    if (s->ctx->app_verify_callback != NULL) {
         i = s->ctx->app_verify_callback(ctx, s->ctx->app_verify_arg);
-    else
+    } else {
         i = X509_verify_cert(ctx);
+        /* We treat an error in the same way as a failure to verify */
+        if (i < 0)
+            i = 0;
+    }
+    /* A callback may have asked for the verification to be retried */
+    if (s->rwstate == SSL_RETRY_VERIFY)
+        i = -1;
 
     s->verify_result = X509_STORE_CTX_get_error(ctx);
     sk_X509_pop_free(s->verified_chain, X509_free);
@@ -840,8 +901,8 @@ int SSL_add_store_cert_subjects_to_stack(STACK_OF(X509_NAME) *stack,
 /* Build a certificate chain for current certificate */
 int ssl_build_cert_chain(SSL *s, SSL_CTX *ctx, int flags)
 {
-    CERT *c = s ? s->cert : ctx->cert;
-    CERT_PKEY *cpk = c->key;
+    CERT *c;
+    CERT_PKEY *cpk;
     X509_STORE *chain_store = NULL;
     X509_STORE_CTX *xs_ctx = NULL;
     STACK_OF(X509) *chain = NULL, *untrusted = NULL;
@@ -849,6 +910,10 @@ int ssl_build_cert_chain(SSL *s, SSL_CTX *ctx, int flags)
     SSL_CTX *real_ctx = (s == NULL) ? ctx : s->ctx;
     int i, rv = 0;
 
+    if (!ssl_cert_unshare(s, ctx))
+        return 0;
+    c = s ? s->cert : ctx->cert;
+    cpk = c->key;
     if (!cpk->x509) {
         ERR_raise(ERR_LIB_SSL, SSL_R_NO_CERTIFICATE_SET);
         goto err;
@@ -960,23 +1025,26 @@ int ssl_cert_set_cert_store(CERT *c, X509_STORE *store, int chain, int ref)
     return 1;
 }
 
+/*
+ * note that there's a corresponding minbits_table
+ * in crypto/x509/x509_vfy.c that's used for checking the security level
+ * of RSA and DSA keys
+ */
+static const int minbits_table[SSL_MAX_SECURITY_LEVEL + 1] = {
+    0, 80, 112, 128, 192, 256
+};
+
 int ssl_get_security_level_bits(const SSL *s, const SSL_CTX *ctx, int *levelp)
 {
     int level;
-    /*
-     * note that there's a corresponding minbits_table
-     * in crypto/x509/x509_vfy.c that's used for checking the security level
-     * of RSA and DSA keys
-     */
-    static const int minbits_table[5 + 1] = { 0, 80, 112, 128, 192, 256 };
 
     if (ctx != NULL)
         level = SSL_CTX_get_security_level(ctx);
     else
         level = SSL_get_security_level(s);
 
-    if (level > 5)
-        level = 5;
+    if (level > SSL_MAX_SECURITY_LEVEL)
+        level = SSL_MAX_SECURITY_LEVEL;
     else if (level < 0)
         level = 0;
 
@@ -986,6 +1054,15 @@ int ssl_get_security_level_bits(const SSL *s, const SSL_CTX *ctx, int *levelp)
     return minbits_table[level];
 }
 
+/*
+ * Would the default security callback at |level| accept |bits| of security
+ * for an operation without further restrictions, such as a group or sigalg?
+ */
+int ssl_security_level_allows(int level, int bits)
+{
+    return level == 0 || bits >= minbits_table[level];
+}
+
 static int ssl_security_default_callback(const SSL *s, const SSL_CTX *ctx,
                                          int op, int bits, int nid, void *other,
                                          void *ex)
@@ -1074,6 +1151,15 @@ int ssl_ctx_security(const SSL_CTX *ctx, int op, int bits, int nid, void *other)
                              ctx->cert->sec_ex);
 }
 
+/*
+ * The default callback only looks at the security level, so its answers can
+ * be cached as long as the CERT holding that level does not change.
+ */
+int ssl_security_is_default(const SSL *s)
+{
+    return s->cert->sec_cb == ssl_security_default_callback;
+}
+
 int ssl_cert_lookup_by_nid(int nid, size_t *pidx)
 {
     size_t i;
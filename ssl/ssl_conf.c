@@ -87,8 +87,6 @@ struct ssl_conf_ctx_st {
     uint64_t *poptions;
     /* Certificate filenames for each type */
     char *cert_filename[SSL_PKEY_NUM];
-    /* Pointer to SSL or SSL_CTX cert_flags or NULL if none */
-    uint32_t *pcert_flags;
     /* Pointer to SSL or SSL_CTX verify_mode or NULL if none */
     uint32_t *pvfy_flags;
     /* Pointer to SSL or SSL_CTX min_version field or NULL if none */
@@ -115,7 +113,11 @@ static void ssl_set_option(SSL_CONF_CTX *cctx, unsigned int name_flags,
     switch (name_flags & SSL_TFLAG_TYPE_MASK) {
 
     case SSL_TFLAG_CERT:
-        pflags = cctx->pcert_flags;
+        /* The CERT can be shared, so look up its cert_flags every time */
+        if (!ssl_cert_unshare(cctx->ssl, cctx->ctx))
+            return;
+        pflags = cctx->ssl != NULL ? &cctx->ssl->cert->cert_flags
+                                   : &cctx->ctx->cert->cert_flags;
         break;
 
     case SSL_TFLAG_VFY:
@@ -477,9 +479,13 @@ static int do_store(SSL_CONF_CTX *cctx,
     const char *propq = NULL;
 
     if (cctx->ctx != NULL) {
+        if (!ssl_cert_unshare(NULL, cctx->ctx))
+            return 0;
         cert = cctx->ctx->cert;
         ctx = cctx->ctx;
     } else if (cctx->ssl != NULL) {
+        if (!ssl_cert_unshare(cctx->ssl, NULL))
+            return 0;
         cert = cctx->ssl->cert;
         ctx = cctx->ssl->ctx;
     } else {
@@ -1043,13 +1049,11 @@ void SSL_CONF_CTX_set_ssl(SSL_CONF_CTX *cctx, SSL *ssl)
         cctx->poptions = &ssl->options;
         cctx->min_version = &ssl->min_proto_version;
         cctx->max_version = &ssl->max_proto_version;
-        cctx->pcert_flags = &ssl->cert->cert_flags;
         cctx->pvfy_flags = &ssl->verify_mode;
     } else {
         cctx->poptions = NULL;
         cctx->min_version = NULL;
         cctx->max_version = NULL;
-        cctx->pcert_flags = NULL;
         cctx->pvfy_flags = NULL;
     }
 }
@@ -1062,13 +1066,11 @@ void SSL_CONF_CTX_set_ssl_ctx(SSL_CONF_CTX *cctx, SSL_CTX *ctx)
         cctx->poptions = &ctx->options;
         cctx->min_version = &ctx->min_proto_version;
         cctx->max_version = &ctx->max_proto_version;
-        cctx->pcert_flags = &ctx->cert->cert_flags;
         cctx->pvfy_flags = &ctx->verify_mode;
     } else {
         cctx->poptions = NULL;
         cctx->min_version = NULL;
         cctx->max_version = NULL;
-        cctx->pcert_flags = NULL;
         cctx->pvfy_flags = NULL;
     }
 }
@@ -651,6 +651,7 @@ int SSL_CTX_set_ssl_version(SSL_CTX *ctx, const SSL_METHOD *meth)
     STACK_OF(SSL_CIPHER) *sk;
 
     ctx->method = meth;
+    ssl_ctx_clear_ch_template(ctx);
 
     if (!SSL_CTX_set_ciphersuites(ctx, OSSL_default_ciphersuites())) {
         ERR_raise(ERR_LIB_SSL, SSL_R_SSL_LIBRARY_HAS_NO_CIPHERS);
@@ -672,6 +673,7 @@ int SSL_CTX_set_ssl_version(SSL_CTX *ctx, const SSL_METHOD *meth)
 SSL *SSL_new(SSL_CTX *ctx)
 {
     SSL *s;
+    int i;
 
     if (ctx == NULL) {
         ERR_raise(ERR_LIB_SSL, SSL_R_NULL_SSL_CTX);
@@ -707,23 +709,26 @@ SSL *SSL_new(SSL_CTX *ctx)
     s->num_tickets = ctx->num_tickets;
     s->pha_enabled = ctx->pha_enabled;
 
-    /* Shallow copy of the ciphersuites stack */
-    s->tls13_ciphersuites = sk_SSL_CIPHER_dup(ctx->tls13_ciphersuites);
-    if (s->tls13_ciphersuites == NULL)
-        goto err;
+    /*
+     * The TLSv1.3 ciphersuites are only copied from the SSL_CTX when the SSL
+     * gets a cipher list of its own, see SSL_set_cipher_list().
+     */
+    s->tls13_ciphersuites = NULL;
 
     /*
-     * Earlier library versions used to copy the pointer to the CERT, not
-     * its contents; only when setting new parameters for the per-SSL
-     * copy, ssl_cert_new would be called (and the direct reference to
-     * the per-SSL_CTX settings would be lost, but those still were
-     * indirectly accessed for various purposes, and for that reason they
-     * used to be known as s->ctx->default_cert). Now we don't look at the
-     * SSL_CTX's CERT after having duplicated it once.
+     * The CERT is shared with the SSL_CTX until either side modifies it (see
+     * ssl_cert_unshare()), which saves copying the certificates, chains and
+     * sigalg lists for each connection. Custom extensions keep per-handshake
+     * state in the CERT, so those need a copy from the start.
      */
-    s->cert = ssl_cert_dup(ctx->cert);
-    if (s->cert == NULL)
-        goto err;
+    if (ctx->cert->custext.meths_count == 0) {
+        CRYPTO_UP_REF(&ctx->cert->references, &i, ctx->cert->lock);
+        s->cert = ctx->cert;
+    } else {
+        s->cert = ssl_cert_dup(ctx->cert);
+        if (s->cert == NULL)
+            goto err;
+    }
 
     RECORD_LAYER_set_read_ahead(&s->rlayer, ctx->read_ahead);
     s->msg_callback = ctx->msg_callback;
@@ -926,6 +931,7 @@ int SSL_has_matching_session_id(const SSL *ssl, const unsigned char *id,
      * by this SSL.
      */
     SSL_SESSION r, *p;
+    SSL_SESSION_CACHE_SHARD *sh;
 
     if (id_len > sizeof(r.session_id))
         return 0;
@@ -934,10 +940,11 @@ int SSL_has_matching_session_id(const SSL *ssl, const unsigned char *id,
     r.session_id_length = id_len;
     memcpy(r.session_id, id, id_len);
 
-    if (!CRYPTO_THREAD_read_lock(ssl->session_ctx->lock))
+    sh = ssl_session_cache_shard(ssl->session_ctx, &r);
+    if (!CRYPTO_THREAD_read_lock(sh->lock))
         return 0;
-    p = lh_SSL_SESSION_retrieve(ssl->session_ctx->sessions, &r);
-    CRYPTO_THREAD_unlock(ssl->session_ctx->lock);
+    p = lh_SSL_SESSION_retrieve(sh->sessions, &r);
+    CRYPTO_THREAD_unlock(sh->lock);
     return (p != NULL);
 }
 
@@ -1166,6 +1173,8 @@ X509_VERIFY_PARAM *SSL_get0_param(SSL *ssl)
 
 void SSL_certs_clear(SSL *s)
 {
+    if (!ssl_cert_unshare(s, NULL))
+        return;
     ssl_cert_clear_certs(s->cert);
 }
 
@@ -1233,6 +1242,7 @@ void SSL_free(SSL *s)
 #endif
     OPENSSL_free(s->ext.ocsp.resp);
     OPENSSL_free(s->ext.alpn);
+    ssl_clear_ch_template(s);
     OPENSSL_free(s->ext.tls13_cookie);
     if (s->clienthello != NULL)
         OPENSSL_free(s->clienthello->pre_proc_exts);
@@ -2006,6 +2016,42 @@ int SSL_peek_ex(SSL *s, void *buf, size_t num, size_t *readbytes)
     return ret;
 }
 
+/*
+ * Like SSL_peek_ex(), but instead of copying the data, point |*data| at the
+ * application data of the current record. It stays valid until the next
+ * call that reads from |s|.
+ */
+int SSL_peek_record_ex(SSL *s, const unsigned char **data, size_t *len)
+{
+    unsigned char c;
+    size_t readbytes;
+
+    if (SSL_IS_DTLS(s)) {
+        ERR_raise(ERR_LIB_SSL, SSL_R_WRONG_SSL_VERSION);
+        return 0;
+    }
+    if (ssl_peek_internal(s, &c, 1, &readbytes) <= 0)
+        return 0;
+    if (!RECORD_LAYER_get_read_data(&s->rlayer, data, len)) {
+        ERR_raise(ERR_LIB_SSL, ERR_R_INTERNAL_ERROR);
+        return 0;
+    }
+    return 1;
+}
+
+int SSL_consume(SSL *s, size_t num)
+{
+    if (SSL_IS_DTLS(s)) {
+        ERR_raise(ERR_LIB_SSL, SSL_R_WRONG_SSL_VERSION);
+        return 0;
+    }
+    if (num > 0 && !RECORD_LAYER_consume_read_data(&s->rlayer, num)) {
+        ERR_raise(ERR_LIB_SSL, SSL_R_BAD_LENGTH);
+        return 0;
+    }
+    return 1;
+}
+
 int ssl_write_internal(SSL *s, const void *buf, size_t num, size_t *written)
 {
     if (s->handshake_func == NULL) {
@@ -2141,6 +2187,95 @@ int SSL_write_ex(SSL *s, const void *buf, size_t num, size_t *written)
     return ret;
 }
 
+/*
+ * Write |nbufs| fragments as if they were one contiguous buffer. Runs of
+ * whole records are written from the fragments as they are. A record that
+ * would span fragments is gathered from them by the record layer, straight
+ * into its write buffer.
+ */
+int SSL_writev_ex(SSL *s, const void *const bufs[], const size_t lens[],
+                  size_t nbufs, size_t *written)
+{
+    RECORD_LAYER *rl = &s->rlayer;
+    size_t total = 0, done, idx, off, rem, chunk, tmpwrit, i;
+    int partial = (s->mode & SSL_MODE_ENABLE_PARTIAL_WRITE) != 0;
+    int ret;
+
+    for (i = 0; i < nbufs; i++) {
+        if (lens[i] > SIZE_MAX - total) {
+            ERR_raise(ERR_LIB_SSL, ERR_R_PASSED_INVALID_ARGUMENT);
+            return 0;
+        }
+        total += lens[i];
+    }
+    if (total == 0)
+        return SSL_write_ex(s, nbufs > 0 ? bufs[0] : NULL, 0, written);
+
+    /*
+     * Carry on where an interrupted call stopped, unless partial writes are
+     * reported, in which case the caller passes the remaining data
+     */
+    done = partial ? 0 : rl->wiov_done;
+    rl->wiov_done = 0;
+    if (done >= total) {
+        ERR_raise(ERR_LIB_SSL, SSL_R_BAD_LENGTH);
+        return 0;
+    }
+    for (idx = 0, off = done; off >= lens[idx]; idx++)
+        off -= lens[idx];
+
+    while (done < total) {
+        /* Unless a record is gathered, never write past this fragment */
+        rem = lens[idx] - off;
+        chunk = rem;
+
+        if (!SSL_is_init_finished(s)
+                || SSL_IS_DTLS(s)
+                || s->compress != NULL
+                || (s->mode & SSL_MODE_ASYNC) != 0
+                || BIO_get_ktls_send(s->wbio)
+                || done + rem == total) {
+            /* No gathering, the fragment is written on its own */
+        } else if (rem >= ssl_get_max_send_fragment(s)) {
+            /* Whole records from this fragment, the rest is gathered */
+            chunk = rem - rem % ssl_get_max_send_fragment(s);
+        } else {
+            /*
+             * A single record spanning fragments.  The record layer reads
+             * it through the gather cursor only, never through the pointer
+             * passed below.
+             */
+            chunk = total - done;
+            if (chunk > ssl_get_split_send_fragment(s))
+                chunk = ssl_get_split_send_fragment(s);
+            rl->wiov_bufs = bufs;
+            rl->wiov_lens = lens;
+            rl->wiov_num = nbufs;
+            rl->wiov_idx = idx;
+            rl->wiov_off = off;
+        }
+
+        ret = ssl_write_internal(s, (const unsigned char *)bufs[idx] + off,
+                                 chunk, &tmpwrit);
+        rl->wiov_bufs = NULL;
+        if (ret <= 0) {
+            if (partial && done > 0)
+                break;
+            rl->wiov_done = done;
+            return 0;
+        }
+
+        done += tmpwrit;
+        for (off += tmpwrit; idx < nbufs && off >= lens[idx]; idx++)
+            off -= lens[idx];
+        if (tmpwrit < chunk)
+            break;
+    }
+
+    *written = done;
+    return 1;
+}
+
 int SSL_write_early_data(SSL *s, const void *buf, size_t num, size_t *written)
 {
     int ret, early_data_state;
@@ -2387,8 +2522,12 @@ long SSL_ctrl(SSL *s, int cmd, long larg, void *parg)
     case SSL_CTRL_GET_RI_SUPPORT:
         return s->s3.send_connection_binding;
     case SSL_CTRL_CERT_FLAGS:
+        if (!ssl_cert_unshare(s, NULL))
+            return 0;
         return (s->cert->cert_flags |= larg);
     case SSL_CTRL_CLEAR_CERT_FLAGS:
+        if (!ssl_cert_unshare(s, NULL))
+            return 0;
         return (s->cert->cert_flags &= ~larg);
 
     case SSL_CTRL_GET_RAW_CIPHERLIST:
@@ -2441,7 +2580,8 @@ long SSL_callback_ctrl(SSL *s, int cmd, void (*fp) (void))
 
 LHASH_OF(SSL_SESSION) *SSL_CTX_sessions(SSL_CTX *ctx)
 {
-    return ctx->sessions;
+    /* Only the first shard of a sharded cache */
+    return ctx->sess_cache[0].sessions;
 }
 
 long SSL_CTX_ctrl(SSL_CTX *ctx, int cmd, long larg, void *parg)
@@ -2496,8 +2636,49 @@ long SSL_CTX_ctrl(SSL_CTX *ctx, int cmd, long larg, void *parg)
     case SSL_CTRL_GET_SESS_CACHE_MODE:
         return ctx->session_cache_mode;
 
+    case SSL_CTRL_SET_SESS_CACHE_SHARDS:
+        if (larg <= 0)
+            return 0;
+        return ssl_session_cache_init(ctx, (size_t)larg);
+    case SSL_CTRL_GET_SESS_CACHE_SHARDS:
+        return (long)ctx->sess_cache_shards;
+    case SSL_CTRL_SESS_SHARD_NUMBER:
+    case SSL_CTRL_SESS_SHARD_HITS:
+    case SSL_CTRL_SESS_SHARD_MISSES:
+    case SSL_CTRL_SESS_SHARD_TIMEOUTS:
+    case SSL_CTRL_SESS_SHARD_CACHE_FULL:
+        {
+            SSL_SESSION_CACHE_SHARD *sh;
+
+            if (larg < 0 || (size_t)larg >= ctx->sess_cache_shards)
+                return -1;
+            sh = &ctx->sess_cache[larg];
+            switch (cmd) {
+            case SSL_CTRL_SESS_SHARD_NUMBER:
+                return lh_SSL_SESSION_num_items(sh->sessions);
+            case SSL_CTRL_SESS_SHARD_HITS:
+                return tsan_load(&sh->stats.sess_hit);
+            case SSL_CTRL_SESS_SHARD_MISSES:
+                return tsan_load(&sh->stats.sess_miss);
+            case SSL_CTRL_SESS_SHARD_TIMEOUTS:
+                return tsan_load(&sh->stats.sess_timeout);
+            default:
+                return tsan_load(&sh->stats.sess_cache_full);
+            }
+        }
+    case SSL_CTRL_SET_BUFFER_POOL_SIZE:
+        if (larg < 0)
+            return 0;
+        return ssl_buffer_pool_set_size(ctx, (size_t)larg);
+    case SSL_CTRL_GET_BUFFER_POOL_SIZE:
+    case SSL_CTRL_BUFFER_POOL_HITS:
+    case SSL_CTRL_BUFFER_POOL_MISSES:
+    case SSL_CTRL_BUFFER_POOL_IN_USE:
+    case SSL_CTRL_BUFFER_POOL_PEAK_IN_USE:
+    case SSL_CTRL_BUFFER_POOL_CACHED:
+        return ssl_buffer_pool_ctrl(ctx, cmd);
     case SSL_CTRL_SESS_NUMBER:
-        return lh_SSL_SESSION_num_items(ctx->sessions);
+        return (long)ssl_session_cache_num_items(ctx);
     case SSL_CTRL_SESS_CONNECT:
         return tsan_load(&ctx->stats.sess_connect);
     case SSL_CTRL_SESS_CONNECT_GOOD:
@@ -2542,8 +2723,12 @@ long SSL_CTX_ctrl(SSL_CTX *ctx, int cmd, long larg, void *parg)
         ctx->max_pipelines = larg;
         return 1;
     case SSL_CTRL_CERT_FLAGS:
+        if (!ssl_cert_unshare(NULL, ctx))
+            return 0;
         return (ctx->cert->cert_flags |= larg);
     case SSL_CTRL_CLEAR_CERT_FLAGS:
+        if (!ssl_cert_unshare(NULL, ctx))
+            return 0;
         return (ctx->cert->cert_flags &= ~larg);
     case SSL_CTRL_SET_MIN_PROTO_VERSION:
         return ssl_check_allowed_versions(larg, ctx->max_proto_version)
@@ -2703,11 +2888,25 @@ static int cipher_list_tls12_num(STACK_OF(SSL_CIPHER) *sk)
     return num;
 }
 
+/*
+ * The "SUITEB..." and "@SECLEVEL=n" rules of a cipher string are stored in the
+ * CERT by ssl_create_cipher_list(), so the CERT must not be shared for those.
+ */
+static int cipher_list_sets_cert(const char *str)
+{
+    return str != NULL
+           && (strstr(str, "SUITEB") != NULL
+               || strstr(str, "SECLEVEL=") != NULL);
+}
+
 /** specify the ciphers to be used by default by the SSL_CTX */
 int SSL_CTX_set_cipher_list(SSL_CTX *ctx, const char *str)
 {
     STACK_OF(SSL_CIPHER) *sk;
 
+    ssl_ctx_clear_ch_template(ctx);
+    if (cipher_list_sets_cert(str) && !ssl_cert_unshare(NULL, ctx))
+        return 0;
     sk = ssl_create_cipher_list(ctx, ctx->tls13_ciphersuites,
                                 &ctx->cipher_list, &ctx->cipher_list_by_id, str,
                                 ctx->cert);
@@ -2732,6 +2931,13 @@ int SSL_set_cipher_list(SSL *s, const char *str)
 {
     STACK_OF(SSL_CIPHER) *sk;
 
+    if (cipher_list_sets_cert(str) && !ssl_cert_unshare(s, NULL))
+        return 0;
+    if (s->tls13_ciphersuites == NULL) {
+        s->tls13_ciphersuites = sk_SSL_CIPHER_dup(s->ctx->tls13_ciphersuites);
+        if (s->tls13_ciphersuites == NULL)
+            return 0;
+    }
     sk = ssl_create_cipher_list(s->ctx, s->tls13_ciphersuites,
                                 &s->cipher_list, &s->cipher_list_by_id, str,
                                 s->cert);
@@ -3119,49 +3325,6 @@ int SSL_export_keying_material_early(SSL *s, unsigned char *out, size_t olen,
                                               context, contextlen);
 }
 
-static unsigned long ssl_session_hash(const SSL_SESSION *a)
-{
-    const unsigned char *session_id = a->session_id;
-    unsigned long l;
-    unsigned char tmp_storage[4];
-
-    if (a->session_id_length < sizeof(tmp_storage)) {
-        memset(tmp_storage, 0, sizeof(tmp_storage));
-        memcpy(tmp_storage, a->session_id, a->session_id_length);
-        session_id = tmp_storage;
-    }
-
-    l = (unsigned long)
-        ((unsigned long)session_id[0]) |
-        ((unsigned long)session_id[1] << 8L) |
-        ((unsigned long)session_id[2] << 16L) |
-        ((unsigned long)session_id[3] << 24L);
-    return l;
-}
-
-/*
- * NB: If this function (or indeed the hash function which uses a sort of
- * coarser function than this one) is changed, ensure
- * SSL_CTX_has_matching_session_id() is checked accordingly. It relies on
- * being able to construct an SSL_SESSION that will collide with any existing
- * session with a matching session ID.
- */
-static int ssl_session_cmp(const SSL_SESSION *a, const SSL_SESSION *b)
-{
-    if (a->ssl_version != b->ssl_version)
-        return 1;
-    if (a->session_id_length != b->session_id_length)
-        return 1;
-    return memcmp(a->session_id, b->session_id, a->session_id_length);
-}
-
-/*
- * These wrapper functions should remain rather than redeclaring
- * SSL_SESSION_hash and SSL_SESSION_cmp for void* types and casting each
- * variable. The reason is that the functions aren't static, they're exposed
- * via ssl.h.
- */
-
 SSL_CTX *SSL_CTX_new_ex(OSSL_LIB_CTX *libctx, const char *propq,
                         const SSL_METHOD *meth)
 {
@@ -3212,8 +3375,7 @@ SSL_CTX *SSL_CTX_new_ex(OSSL_LIB_CTX *libctx, const char *propq,
     if ((ret->cert = ssl_cert_new()) == NULL)
         goto err;
 
-    ret->sessions = lh_SSL_SESSION_new(ssl_session_hash, ssl_session_cmp);
-    if (ret->sessions == NULL)
+    if (!ssl_session_cache_init(ret, 1))
         goto err;
     ret->cert_store = X509_STORE_new();
     if (ret->cert_store == NULL)
@@ -3408,11 +3570,13 @@ void SSL_CTX_free(SSL_CTX *a)
      * free ex_data, then finally free the cache.
      * (See ticket [openssl.org #212].)
      */
-    if (a->sessions != NULL)
+    if (a->sess_cache != NULL)
         SSL_CTX_flush_sessions(a, 0);
 
     CRYPTO_free_ex_data(CRYPTO_EX_INDEX_SSL_CTX, a, &a->ex_data);
-    lh_SSL_SESSION_free(a->sessions);
+    ssl_session_cache_free(a);
+    SSL_SHARED_SESSION_CACHE_free(a->shared_sess_cache);
+    ssl_buffer_pool_free(a->buf_pool);
     X509_STORE_free(a->cert_store);
 #ifndef OPENSSL_NO_CT
     CTLOG_STORE_free(a->ctlog_store);
@@ -3440,6 +3604,7 @@ void SSL_CTX_free(SSL_CTX *a)
     OPENSSL_free(a->ext.supported_groups_default);
     OPENSSL_free(a->ext.alpn);
     OPENSSL_secure_free(a->ext.secure);
+    ssl_ctx_clear_ch_template(a);
 
     ssl_evp_md_free(a->md5);
     ssl_evp_md_free(a->sha1);
@@ -3526,11 +3691,15 @@ void SSL_CTX_set_verify_depth(SSL_CTX *ctx, int depth)
 
 void SSL_CTX_set_cert_cb(SSL_CTX *c, int (*cb) (SSL *ssl, void *arg), void *arg)
 {
+    if (!ssl_cert_unshare(NULL, c))
+        return;
     ssl_cert_set_cert_cb(c->cert, cb, arg);
 }
 
 void SSL_set_cert_cb(SSL *s, int (*cb) (SSL *ssl, void *arg), void *arg)
 {
+    if (!ssl_cert_unshare(s, NULL))
+        return;
     ssl_cert_set_cert_cb(s->cert, cb, arg);
 }
 
@@ -3711,6 +3880,19 @@ void ssl_update_cache(SSL *s, int mode)
                     || (s->options & SSL_OP_NO_TICKET) != 0))
             SSL_CTX_add_session(s->session_ctx, s->session);
 
+        /*
+         * Servers also put the session into the shared cache, unless it is a
+         * stateless TLSv1.3 ticket that is never looked up.
+         */
+        if (s->server
+                && s->session_ctx->shared_sess_cache != NULL
+                && (!SSL_IS_TLS13(s)
+                    || (s->max_early_data > 0
+                        && (s->options & SSL_OP_NO_ANTI_REPLAY) == 0)
+                    || (s->options & SSL_OP_NO_TICKET) != 0))
+            (void)ssl_shcache_store(s->session_ctx->shared_sess_cache,
+                                    s->session);
+
         /*
          * Add the session to the external cache. We do this even in server side
          * TLSv1.3 without early data because some applications just want to
@@ -3730,8 +3912,18 @@ void ssl_update_cache(SSL *s, int mode)
             stat = &s->session_ctx->stats.sess_connect_good;
         else
             stat = &s->session_ctx->stats.sess_accept_good;
-        if ((tsan_load(stat) & 0xff) == 0xff)
-            SSL_CTX_flush_sessions(s->session_ctx, (unsigned long)time(NULL));
+        if ((tsan_load(stat) & 0xff) == 0xff) {
+            SSL_CTX *ctx = s->session_ctx;
+            size_t turn = (unsigned int)tsan_load(stat) >> 8;
+
+            /* A sharded cache is flushed one shard at a time, in turn */
+            if (ctx->sess_cache_shards > 1)
+                ssl_session_cache_flush_shard(ctx,
+                                              turn % ctx->sess_cache_shards,
+                                              time(NULL));
+            else
+                SSL_CTX_flush_sessions(ctx, (unsigned long)time(NULL));
+        }
     }
 }
 
@@ -3845,6 +4037,8 @@ int SSL_get_error(const SSL *s, int i)
         return SSL_ERROR_WANT_ASYNC_JOB;
     if (SSL_want_client_hello_cb(s))
         return SSL_ERROR_WANT_CLIENT_HELLO_CB;
+    if (SSL_want_private_key_operation(s))
+        return SSL_ERROR_WANT_PRIVATE_KEY_OPERATION;
 
     if ((s->shutdown & SSL_RECEIVED_SHUTDOWN) &&
         (s->s3.warn_alert == SSL_AD_CLOSE_NOTIFY))
@@ -4426,6 +4620,16 @@ long SSL_get_verify_result(const SSL *ssl)
     return ssl->verify_result;
 }
 
+int SSL_set_retry_verify(SSL *ssl)
+{
+    /* Only allowed while verifying the peer certificate chain */
+    if (ssl->statem.state != MSG_FLOW_READING)
+        return 0;
+
+    ssl->rwstate = SSL_RETRY_VERIFY;
+    return 1;
+}
+
 size_t SSL_get_client_random(const SSL *ssl, unsigned char *out, size_t outlen)
 {
     if (outlen == 0)
@@ -4519,6 +4723,8 @@ int SSL_CTX_use_psk_identity_hint(SSL_CTX *ctx, const char *identity_hint)
         ERR_raise(ERR_LIB_SSL, SSL_R_DATA_LENGTH_TOO_LONG);
         return 0;
     }
+    if (!ssl_cert_unshare(NULL, ctx))
+        return 0;
     OPENSSL_free(ctx->cert->psk_identity_hint);
     if (identity_hint != NULL) {
         ctx->cert->psk_identity_hint = OPENSSL_strdup(identity_hint);
@@ -4538,6 +4744,8 @@ int SSL_use_psk_identity_hint(SSL *s, const char *identity_hint)
         ERR_raise(ERR_LIB_SSL, SSL_R_DATA_LENGTH_TOO_LONG);
         return 0;
     }
+    if (!ssl_cert_unshare(s, NULL))
+        return 0;
     OPENSSL_free(s->cert->psk_identity_hint);
     if (identity_hint != NULL) {
         s->cert->psk_identity_hint = OPENSSL_strdup(identity_hint);
@@ -4808,6 +5016,8 @@ void SSL_set_debug(SSL *s, int debug)
 
 void SSL_set_security_level(SSL *s, int level)
 {
+    if (!ssl_cert_unshare(s, NULL))
+        return;
     s->cert->sec_level = level;
 }
 
@@ -4821,6 +5031,8 @@ void SSL_set_security_callback(SSL *s,
                                           int op, int bits, int nid,
                                           void *other, void *ex))
 {
+    if (!ssl_cert_unshare(s, NULL))
+        return;
     s->cert->sec_cb = cb;
 }
 
@@ -4833,6 +5045,8 @@ int (*SSL_get_security_callback(const SSL *s)) (const SSL *s,
 
 void SSL_set0_security_ex_data(SSL *s, void *ex)
 {
+    if (!ssl_cert_unshare(s, NULL))
+        return;
     s->cert->sec_ex = ex;
 }
 
@@ -4843,6 +5057,8 @@ void *SSL_get0_security_ex_data(const SSL *s)
 
 void SSL_CTX_set_security_level(SSL_CTX *ctx, int level)
 {
+    if (!ssl_cert_unshare(NULL, ctx))
+        return;
     ctx->cert->sec_level = level;
 }
 
@@ -4856,6 +5072,8 @@ void SSL_CTX_set_security_callback(SSL_CTX *ctx,
                                               int op, int bits, int nid,
                                               void *other, void *ex))
 {
+    if (!ssl_cert_unshare(NULL, ctx))
+        return;
     ctx->cert->sec_cb = cb;
 }
 
@@ -4870,6 +5088,8 @@ int (*SSL_CTX_get_security_callback(const SSL_CTX *ctx)) (const SSL *s,
 
 void SSL_CTX_set0_security_ex_data(SSL_CTX *ctx, void *ex)
 {
+    if (!ssl_cert_unshare(NULL, ctx))
+        return;
     ctx->cert->sec_ex = ex;
 }
 
@@ -5415,6 +5635,14 @@ int SSL_client_hello_get0_ext(SSL *s, unsigned int type, const unsigned char **o
     return 0;
 }
 
+void SSL_CTX_set_private_key_sign_cb(SSL_CTX *ctx,
+                                     SSL_private_key_sign_cb_fn cb,
+                                     void *arg)
+{
+    ctx->private_key_sign_cb = cb;
+    ctx->private_key_sign_cb_arg = arg;
+}
+
 int SSL_free_buffers(SSL *ssl)
 {
     RECORD_LAYER *rl = &ssl->rlayer;
@@ -5971,6 +6199,10 @@ int SSL_set0_tmp_dh_pkey(SSL *s, EVP_PKEY *dhpkey)
         EVP_PKEY_free(dhpkey);
         return 0;
     }
+    if (!ssl_cert_unshare(s, NULL)) {
+        EVP_PKEY_free(dhpkey);
+        return 0;
+    }
     EVP_PKEY_free(s->cert->dh_tmp);
     s->cert->dh_tmp = dhpkey;
     return 1;
@@ -5984,6 +6216,10 @@ int SSL_CTX_set0_tmp_dh_pkey(SSL_CTX *ctx, EVP_PKEY *dhpkey)
         EVP_PKEY_free(dhpkey);
         return 0;
     }
+    if (!ssl_cert_unshare(NULL, ctx)) {
+        EVP_PKEY_free(dhpkey);
+        return 0;
+    }
     EVP_PKEY_free(ctx->cert->dh_tmp);
     ctx->cert->dh_tmp = dhpkey;
     return 1;
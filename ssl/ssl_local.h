@@ -289,6 +289,12 @@
 
 #define SSL_MD_NUM_IDX  SSL_MAX_DIGEST
 
+/* Security levels above this one are treated as this one */
+# define SSL_MAX_SECURITY_LEVEL 5
+
+/* Slots in the sigalg hash table of an SSL_CTX, also the bitmap size */
+# define SSL_SIGALG_HASH_SIZE 64
+
 /* Bits for algorithm2 (handshake digests and other extra flags) */
 
 /* Bits 0-7 are handshake MAC */
@@ -835,6 +841,34 @@ typedef struct tls_group_info_st {
 
 # define TLS_GROUP_FFDHE_FOR_TLS1_3 (TLS_GROUP_FFDHE|TLS_GROUP_ONLY_FOR_TLS1_3)
 
+/* Upper limit for SSL_CTX_set_session_cache_shards() */
+# define SSL_SESSION_CACHE_MAX_SHARDS       256
+/* Most expired sessions removed from a shard by one SSL_CTX_add_session() */
+# define SSL_SESSION_CACHE_EXPIRE_BATCH     16
+
+/*
+ * One independently locked part of the internal session cache.  A session
+ * lives in the shard selected by its session ID, see ssl_session_cache_shard().
+ * Sessions are held both in the hash and in a doubly linked list, sorted by
+ * the time they expire, the oldest at the tail.
+ */
+typedef struct ssl_session_cache_shard_st {
+    CRYPTO_RWLOCK *lock;
+    int lock_owned;
+    LHASH_OF(SSL_SESSION) *sessions;
+    struct ssl_session_st *session_cache_head;
+    struct ssl_session_st *session_cache_tail;
+    struct {
+        TSAN_QUALIFIER int sess_hit;        /* lookups found in this shard */
+        TSAN_QUALIFIER int sess_miss;       /* lookups not found */
+        TSAN_QUALIFIER int sess_timeout;    /* found, but timed out */
+        TSAN_QUALIFIER int sess_cache_full; /* removed due to full shard */
+    } stats;
+} SSL_SESSION_CACHE_SHARD;
+
+/* Record buffers shared by the SSL objects of an SSL_CTX, see ssl3_buffer.c */
+typedef struct ssl_buffer_pool_st SSL_BUFFER_POOL;
+
 struct ssl_ctx_st {
     OSSL_LIB_CTX *libctx;
 
@@ -845,14 +879,21 @@ struct ssl_ctx_st {
     /* TLSv1.3 specific ciphersuites */
     STACK_OF(SSL_CIPHER) *tls13_ciphersuites;
     struct x509_store_st /* X509_STORE */ *cert_store;
-    LHASH_OF(SSL_SESSION) *sessions;
+    /*
+     * The internal session cache, split into |sess_cache_shards| independently
+     * locked shards.  With a single shard (the default) the shard uses |lock|.
+     */
+    SSL_SESSION_CACHE_SHARD *sess_cache;
+    size_t sess_cache_shards;
+    /* Session cache shared with other processes, consulted by servers */
+    SSL_SHARED_SESSION_CACHE *shared_sess_cache;
+    /* Pool of record buffers, NULL unless SSL_CTX_set_buffer_pool_size() */
+    SSL_BUFFER_POOL *buf_pool;
     /*
      * Most session-ids that will be cached, default is
      * SSL_SESSION_CACHE_MAX_SIZE_DEFAULT. 0 is unlimited.
      */
     size_t session_cache_size;
-    struct ssl_session_st *session_cache_head;
-    struct ssl_session_st *session_cache_tail;
     /*
      * This can have one of 2 values, ored together, SSL_SESS_CACHE_CLIENT,
      * SSL_SESS_CACHE_SERVER, Default is SSL_SESSION_CACHE_SERVER, which
@@ -1026,6 +1067,10 @@ struct ssl_ctx_st {
     SSL_client_hello_cb_fn client_hello_cb;
     void *client_hello_cb_arg;
 
+    /* Private key method: handshake signatures are made by this callback */
+    SSL_private_key_sign_cb_fn private_key_sign_cb;
+    void *private_key_sign_cb_arg;
+
     /* TLS extensions. */
     struct {
         /* TLS extensions servername callback */
@@ -1063,6 +1108,9 @@ struct ssl_ctx_st {
 
         uint16_t *supported_groups_default;
         size_t supported_groups_default_len;
+
+        /* Pre-encoded parts of the ClientHello, see tls_ch_template_start() */
+        struct ch_template_st *ch_template;
         /*
          * ALPN information (we are in the process of transitioning from NPN to
          * ALPN.)
@@ -1187,12 +1235,21 @@ struct ssl_ctx_st {
     const EVP_MD *ssl_digest_methods[SSL_MD_NUM_IDX];
     size_t ssl_mac_secret_size[SSL_MD_NUM_IDX];
 
-    /* Cache of all sigalgs we know and whether they are available or not */
+    /*
+     * Cache of all sigalgs we know and whether they are available or not,
+     * indexed by code point in sigalg_lookup_hash (which holds cache indices
+     * plus one). For each security level, sigalg_secmask has a bit set for
+     * the entries which the default security callback accepts.
+     */
     struct sigalg_lookup_st *sigalg_lookup_cache;
+    unsigned char sigalg_lookup_hash[SSL_SIGALG_HASH_SIZE];
+    uint64_t sigalg_secmask[SSL_MAX_SECURITY_LEVEL + 1];
 
+    /* As sigalg_secmask, if group_list has no more than 64 entries */
     TLS_GROUP_INFO *group_list;
     size_t group_list_len;
     size_t group_list_max_len;
+    uint64_t group_secmask[SSL_MAX_SECURITY_LEVEL + 1];
 
     /* masks of disabled algorithms */
     uint32_t disabled_enc_mask;
@@ -1308,6 +1365,11 @@ struct ssl_st {
             /* used to hold the new cipher we are going to use */
             const SSL_CIPHER *new_cipher;
             EVP_PKEY *pkey;         /* holds short lived key exchange key */
+            /*
+             * Set while the private key method is working on a signature: the
+             * message is constructed again on resumption and must not change
+             */
+            int pkey_op_pending;
             /* used for certificate requests */
             int cert_req;
             /* Certificate types in certificate request message. */
@@ -1674,6 +1736,9 @@ struct ssl_st {
          * selected.
          */
         int tick_identity;
+
+        /* The ClientHello template being used or recorded, if any */
+        struct ch_template_st *ch_template;
     } ext;
 
     /*
@@ -2066,7 +2131,8 @@ typedef struct cert_st {
     /* If not NULL psk identity hint to use for servers */
     char *psk_identity_hint;
 # endif
-    CRYPTO_REF_COUNT references;             /* >1 only if SSL_copy_session_id is used */
+    /* >1 while shared between an SSL_CTX and the SSLs created from it */
+    CRYPTO_REF_COUNT references;
     CRYPTO_RWLOCK *lock;
 } CERT;
 
@@ -2385,12 +2451,32 @@ __owur CERT *ssl_cert_new(void);
 __owur CERT *ssl_cert_dup(CERT *cert);
 void ssl_cert_clear_certs(CERT *c);
 void ssl_cert_free(CERT *c);
+__owur int ssl_cert_unshare(SSL *s, SSL_CTX *ctx);
+__owur int ssl_cert_set_current_pkey(SSL *s, CERT_PKEY *cpk);
+void ssl_clear_ch_template(SSL *s);
+void ssl_ctx_clear_ch_template(SSL_CTX *ctx);
 __owur int ssl_generate_session_id(SSL *s, SSL_SESSION *ss);
 __owur int ssl_get_new_session(SSL *s, int session);
 __owur SSL_SESSION *lookup_sess_in_cache(SSL *s, const unsigned char *sess_id,
                                          size_t sess_id_len);
 __owur int ssl_get_prev_session(SSL *s, CLIENTHELLO_MSG *hello);
+__owur int ssl_take_session(SSL_CTX *ctx, SSL_SESSION *c);
 __owur SSL_SESSION *ssl_session_dup(const SSL_SESSION *src, int ticket);
+__owur int ssl_session_cache_init(SSL_CTX *ctx, size_t shards);
+void ssl_session_cache_free(SSL_CTX *ctx);
+SSL_SESSION_CACHE_SHARD *ssl_session_cache_shard(const SSL_CTX *ctx,
+                                                 const SSL_SESSION *s);
+size_t ssl_session_cache_num_items(const SSL_CTX *ctx);
+void ssl_session_cache_flush_shard(SSL_CTX *ctx, size_t idx, time_t t);
+int ssl_shcache_store(SSL_SHARED_SESSION_CACHE *cache,
+                      const SSL_SESSION *sess);
+SSL_SESSION *ssl_shcache_lookup(SSL_SHARED_SESSION_CACHE *cache, int version,
+                                const unsigned char *id, size_t id_len);
+int ssl_shcache_remove(SSL_SHARED_SESSION_CACHE *cache,
+                       const SSL_SESSION *sess);
+__owur int ssl_buffer_pool_set_size(SSL_CTX *ctx, size_t max_free);
+void ssl_buffer_pool_free(SSL_BUFFER_POOL *pool);
+long ssl_buffer_pool_ctrl(const SSL_CTX *ctx, int cmd);
 __owur int ssl_cipher_id_cmp(const SSL_CIPHER *a, const SSL_CIPHER *b);
 DECLARE_OBJ_BSEARCH_GLOBAL_CMP_FN(SSL_CIPHER, SSL_CIPHER, ssl_cipher_id);
 __owur int ssl_cipher_ptr_id_cmp(const SSL_CIPHER *const *ap,
@@ -2436,7 +2522,9 @@ __owur int ssl_cert_set_cert_store(CERT *c, X509_STORE *store, int chain,
 __owur int ssl_security(const SSL *s, int op, int bits, int nid, void *other);
 __owur int ssl_ctx_security(const SSL_CTX *ctx, int op, int bits, int nid,
                             void *other);
+int ssl_security_is_default(const SSL *s);
 int ssl_get_security_level_bits(const SSL *s, const SSL_CTX *ctx, int *levelp);
+int ssl_security_level_allows(int level, int bits);
 
 __owur int ssl_cert_lookup_by_nid(int nid, size_t *pidx);
 __owur const SSL_CERT_LOOKUP *ssl_cert_lookup_by_pkey(const EVP_PKEY *pk,
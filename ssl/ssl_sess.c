@@ -17,12 +17,18 @@
 #include <openssl/engine.h>
 #include "internal/refcount.h"
 #include "internal/cryptlib.h"
+#include "internal/nelem.h"
 #include "ssl_local.h"
 #include "statem/statem_local.h"
 
-static void SSL_SESSION_list_remove(SSL_CTX *ctx, SSL_SESSION *s);
-static void SSL_SESSION_list_add(SSL_CTX *ctx, SSL_SESSION *s);
+static void SSL_SESSION_list_remove(SSL_SESSION_CACHE_SHARD *sh,
+                                    SSL_SESSION *s);
+static void SSL_SESSION_list_add(SSL_CTX *ctx, SSL_SESSION_CACHE_SHARD *sh,
+                                 SSL_SESSION *s);
 static int remove_session_lock(SSL_CTX *ctx, SSL_SESSION *c, int lck);
+static SSL_SESSION *session_cache_expire_tail(SSL_CTX *ctx,
+                                              SSL_SESSION_CACHE_SHARD *sh,
+                                              time_t t);
 
 DEFINE_STACK_OF(SSL_SESSION)
 
@@ -76,6 +82,150 @@ void ssl_session_calculate_timeout(SSL_SESSION *ss)
      */
 }
 
+/*
+ * These wrapper functions should remain rather than redeclaring
+ * SSL_SESSION_hash and SSL_SESSION_cmp for void* types and casting each
+ * variable. The reason is that the functions aren't static, they're exposed
+ * via ssl.h.
+ */
+
+static unsigned long ssl_session_hash(const SSL_SESSION *a)
+{
+    const unsigned char *session_id = a->session_id;
+    unsigned long l;
+    unsigned char tmp_storage[4];
+
+    if (a->session_id_length < sizeof(tmp_storage)) {
+        memset(tmp_storage, 0, sizeof(tmp_storage));
+        memcpy(tmp_storage, a->session_id, a->session_id_length);
+        session_id = tmp_storage;
+    }
+
+    l = (unsigned long)
+        ((unsigned long)session_id[0]) |
+        ((unsigned long)session_id[1] << 8L) |
+        ((unsigned long)session_id[2] << 16L) |
+        ((unsigned long)session_id[3] << 24L);
+    return l;
+}
+
+/*
+ * NB: If this function (or indeed the hash function which uses a sort of
+ * coarser function than this one) is changed, ensure
+ * SSL_CTX_has_matching_session_id() is checked accordingly. It relies on
+ * being able to construct an SSL_SESSION that will collide with any existing
+ * session with a matching session ID.
+ */
+static int ssl_session_cmp(const SSL_SESSION *a, const SSL_SESSION *b)
+{
+    if (a->ssl_version != b->ssl_version)
+        return 1;
+    if (a->session_id_length != b->session_id_length)
+        return 1;
+    return memcmp(a->session_id, b->session_id, a->session_id_length);
+}
+
+/*
+ * Selects the shard of the internal session cache for a session ID.  This
+ * deliberately mixes all of the ID rather than reusing ssl_session_hash(), so
+ * that the sessions within one shard are still spread over its hash buckets.
+ */
+static size_t session_id_shard(const SSL_CTX *ctx, const unsigned char *id,
+                               size_t id_len)
+{
+    uint32_t h = 0x811c9dc5;     /* FNV-1a */
+    size_t i;
+
+    if (ctx->sess_cache_shards <= 1)
+        return 0;
+    for (i = 0; i < id_len; i++)
+        h = (h ^ id[i]) * 0x01000193;
+    /* Scale rather than take the remainder, the low bits mix poorly */
+    return (size_t)(((uint64_t)h * ctx->sess_cache_shards) >> 32);
+}
+
+SSL_SESSION_CACHE_SHARD *ssl_session_cache_shard(const SSL_CTX *ctx,
+                                                 const SSL_SESSION *s)
+{
+    return &ctx->sess_cache[session_id_shard(ctx, s->session_id,
+                                             s->session_id_length)];
+}
+
+static void session_cache_free(SSL_SESSION_CACHE_SHARD *cache, size_t shards)
+{
+    size_t i;
+
+    if (cache == NULL)
+        return;
+    for (i = 0; i < shards; i++) {
+        lh_SSL_SESSION_free(cache[i].sessions);
+        if (cache[i].lock_owned)
+            CRYPTO_THREAD_lock_free(cache[i].lock);
+    }
+    OPENSSL_free(cache);
+}
+
+/*
+ * (Re)creates the internal session cache of |ctx| with |shards| shards.  A
+ * single shard shares the lock of the SSL_CTX, as the cache always did; more
+ * shards get a lock each.  Fails if the current cache still holds sessions.
+ */
+int ssl_session_cache_init(SSL_CTX *ctx, size_t shards)
+{
+    SSL_SESSION_CACHE_SHARD *cache;
+    size_t i;
+
+    if (shards == 0 || shards > SSL_SESSION_CACHE_MAX_SHARDS)
+        return 0;
+    if (ssl_session_cache_num_items(ctx) != 0)
+        return 0;
+
+    if ((cache = OPENSSL_zalloc(sizeof(*cache) * shards)) == NULL) {
+        ERR_raise(ERR_LIB_SSL, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    for (i = 0; i < shards; i++) {
+        if (shards == 1) {
+            cache[i].lock = ctx->lock;
+        } else {
+            cache[i].lock = CRYPTO_THREAD_lock_new();
+            if (cache[i].lock == NULL)
+                goto err;
+            cache[i].lock_owned = 1;
+        }
+        cache[i].sessions = lh_SSL_SESSION_new(ssl_session_hash,
+                                               ssl_session_cmp);
+        if (cache[i].sessions == NULL)
+            goto err;
+    }
+
+    ssl_session_cache_free(ctx);
+    ctx->sess_cache = cache;
+    ctx->sess_cache_shards = shards;
+    return 1;
+
+ err:
+    ERR_raise(ERR_LIB_SSL, ERR_R_MALLOC_FAILURE);
+    session_cache_free(cache, shards);
+    return 0;
+}
+
+void ssl_session_cache_free(SSL_CTX *ctx)
+{
+    session_cache_free(ctx->sess_cache, ctx->sess_cache_shards);
+    ctx->sess_cache = NULL;
+    ctx->sess_cache_shards = 0;
+}
+
+size_t ssl_session_cache_num_items(const SSL_CTX *ctx)
+{
+    size_t i, n = 0;
+
+    for (i = 0; i < ctx->sess_cache_shards; i++)
+        n += lh_SSL_SESSION_num_items(ctx->sess_cache[i].sessions);
+    return n;
+}
+
 /*
  * SSL_get_session() and SSL_get1_session() are problematic in TLS1.3 because,
  * unlike in earlier protocol versions, the session ticket may not have been
@@ -483,6 +633,7 @@ SSL_SESSION *lookup_sess_in_cache(SSL *s, const unsigned char *sess_id,
 
     if ((s->session_ctx->session_cache_mode
          & SSL_SESS_CACHE_NO_INTERNAL_LOOKUP) == 0) {
+        SSL_SESSION_CACHE_SHARD *sh;
         SSL_SESSION data;
 
         data.ssl_version = s->version;
@@ -492,16 +643,34 @@ SSL_SESSION *lookup_sess_in_cache(SSL *s, const unsigned char *sess_id,
         memcpy(data.session_id, sess_id, sess_id_len);
         data.session_id_length = sess_id_len;
 
-        if (!CRYPTO_THREAD_read_lock(s->session_ctx->lock))
+        sh = &s->session_ctx->sess_cache[session_id_shard(s->session_ctx,
+                                                          sess_id,
+                                                          sess_id_len)];
+        if (!CRYPTO_THREAD_read_lock(sh->lock))
             return NULL;
-        ret = lh_SSL_SESSION_retrieve(s->session_ctx->sessions, &data);
+        ret = lh_SSL_SESSION_retrieve(sh->sessions, &data);
         if (ret != NULL) {
             /* don't allow other threads to steal it: */
             SSL_SESSION_up_ref(ret);
         }
-        CRYPTO_THREAD_unlock(s->session_ctx->lock);
-        if (ret == NULL)
+        CRYPTO_THREAD_unlock(sh->lock);
+        if (ret == NULL) {
             tsan_counter(&s->session_ctx->stats.sess_miss);
+            tsan_counter(&sh->stats.sess_miss);
+        } else {
+            tsan_counter(&sh->stats.sess_hit);
+        }
+    }
+
+    if (ret == NULL && s->session_ctx->shared_sess_cache != NULL) {
+        ret = ssl_shcache_lookup(s->session_ctx->shared_sess_cache, s->version,
+                                 sess_id, sess_id_len);
+
+        /* Like an externally cached session, see below */
+        if (ret != NULL
+                && (s->session_ctx->session_cache_mode &
+                    SSL_SESS_CACHE_NO_INTERNAL_STORE) == 0)
+            (void)SSL_CTX_add_session(s->session_ctx, ret);
     }
 
     if (ret == NULL && s->session_ctx->get_session_cb != NULL) {
@@ -644,6 +813,8 @@ int ssl_get_prev_session(SSL *s, CLIENTHELLO_MSG *hello)
         tsan_counter(&s->session_ctx->stats.sess_timeout);
         if (try_session_cache) {
             /* session was from the cache, so remove it */
+            tsan_counter(&ssl_session_cache_shard(s->session_ctx,
+                                                  ret)->stats.sess_timeout);
             SSL_CTX_remove_session(s->session_ctx, ret);
         }
         goto err;
@@ -697,6 +868,9 @@ int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
 {
     int ret = 0;
     SSL_SESSION *s;
+    SSL_SESSION_CACHE_SHARD *sh;
+    SSL_SESSION *expired[SSL_SESSION_CACHE_EXPIRE_BATCH];
+    size_t i, nexpired = 0;
 
     /*
      * add just 1 reference count for the SSL_CTX's session cache even though
@@ -708,20 +882,21 @@ int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
      * if session c is in already in cache, we take back the increment later
      */
 
-    if (!CRYPTO_THREAD_write_lock(ctx->lock)) {
+    sh = ssl_session_cache_shard(ctx, c);
+    if (!CRYPTO_THREAD_write_lock(sh->lock)) {
         SSL_SESSION_free(c);
         return 0;
     }
-    s = lh_SSL_SESSION_insert(ctx->sessions, c);
+    s = lh_SSL_SESSION_insert(sh->sessions, c);
 
     /*
      * s != NULL iff we already had a session with the given PID. In this
      * case, s == c should hold (then we did not really modify
-     * ctx->sessions), or we're in trouble.
+     * sh->sessions), or we're in trouble.
      */
     if (s != NULL && s != c) {
         /* We *are* in trouble ... */
-        SSL_SESSION_list_remove(ctx, s);
+        SSL_SESSION_list_remove(sh, s);
         SSL_SESSION_free(s);
         /*
          * ... so pretend the other session did not exist in cache (we cannot
@@ -731,7 +906,7 @@ int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
          */
         s = NULL;
     } else if (s == NULL &&
-               lh_SSL_SESSION_retrieve(ctx->sessions, c) == NULL) {
+               lh_SSL_SESSION_retrieve(sh->sessions, c) == NULL) {
         /* s == NULL can also mean OOM error in lh_SSL_SESSION_insert ... */
 
         /*
@@ -746,7 +921,7 @@ int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
         c->time = time(NULL);
         ssl_session_calculate_timeout(c);
     }
-    SSL_SESSION_list_add(ctx, c);
+    SSL_SESSION_list_add(ctx, sh, c);
 
     if (s != NULL) {
         /*
@@ -764,42 +939,88 @@ int SSL_CTX_add_session(SSL_CTX *ctx, SSL_SESSION *c)
         ret = 1;
 
         if (SSL_CTX_sess_get_cache_size(ctx) > 0) {
-            while (SSL_CTX_sess_number(ctx) > SSL_CTX_sess_get_cache_size(ctx)) {
-                if (!remove_session_lock(ctx, ctx->session_cache_tail, 0))
+            /* Each shard gets its part of the limit */
+            size_t limit = (ctx->session_cache_size
+                            + ctx->sess_cache_shards - 1)
+                           / ctx->sess_cache_shards;
+
+            while (lh_SSL_SESSION_num_items(sh->sessions) > limit) {
+                if (!remove_session_lock(ctx, sh->session_cache_tail, 0))
                     break;
-                else
-                    tsan_counter(&ctx->stats.sess_cache_full);
+                tsan_counter(&ctx->stats.sess_cache_full);
+                tsan_counter(&sh->stats.sess_cache_full);
             }
         }
     }
-    CRYPTO_THREAD_unlock(ctx->lock);
+
+    /*
+     * A sharded cache is not flushed as a whole every so many connections,
+     * see ssl_update_cache(), so retire a few expired sessions of this shard
+     * on every addition instead.
+     */
+    if (ctx->sess_cache_shards > 1) {
+        time_t now = time(NULL);
+
+        while (nexpired < OSSL_NELEM(expired)
+               && sh->session_cache_tail != c
+               && (expired[nexpired] = session_cache_expire_tail(ctx, sh,
+                                                                 now)) != NULL)
+            nexpired++;
+    }
+    CRYPTO_THREAD_unlock(sh->lock);
+
+    for (i = 0; i < nexpired; i++)
+        SSL_SESSION_free(expired[i]);
     return ret;
 }
 
 int SSL_CTX_remove_session(SSL_CTX *ctx, SSL_SESSION *c)
 {
+    if (c != NULL && ctx->shared_sess_cache != NULL)
+        (void)ssl_shcache_remove(ctx->shared_sess_cache, c);
     return remove_session_lock(ctx, c, 1);
 }
 
+/*
+ * Remove |c| from the session caches of |ctx| for the TLSv1.3 anti-replay
+ * check, and return 1 only if this call is the one that removed it.  With a
+ * shared session cache, only the shared cache can decide that: the SSL_CTX
+ * that issued the session keeps it in its internal cache, and any other
+ * SSL_CTX that found it in the shared cache has added it to its own.
+ */
+int ssl_take_session(SSL_CTX *ctx, SSL_SESSION *c)
+{
+    int ret;
+
+    if (ctx->shared_sess_cache == NULL)
+        return remove_session_lock(ctx, c, 1);
+
+    ret = ssl_shcache_remove(ctx->shared_sess_cache, c);
+    (void)remove_session_lock(ctx, c, 1);
+    return ret;
+}
+
 static int remove_session_lock(SSL_CTX *ctx, SSL_SESSION *c, int lck)
 {
+    SSL_SESSION_CACHE_SHARD *sh;
     SSL_SESSION *r;
     int ret = 0;
 
     if ((c != NULL) && (c->session_id_length != 0)) {
+        sh = ssl_session_cache_shard(ctx, c);
         if (lck) {
-            if (!CRYPTO_THREAD_write_lock(ctx->lock))
+            if (!CRYPTO_THREAD_write_lock(sh->lock))
                 return 0;
         }
-        if ((r = lh_SSL_SESSION_retrieve(ctx->sessions, c)) != NULL) {
+        if ((r = lh_SSL_SESSION_retrieve(sh->sessions, c)) != NULL) {
             ret = 1;
-            r = lh_SSL_SESSION_delete(ctx->sessions, r);
-            SSL_SESSION_list_remove(ctx, r);
+            r = lh_SSL_SESSION_delete(sh->sessions, r);
+            SSL_SESSION_list_remove(sh, r);
         }
         c->not_resumable = 1;
 
         if (lck)
-            CRYPTO_THREAD_unlock(ctx->lock);
+            CRYPTO_THREAD_unlock(sh->lock);
 
         if (ctx->remove_session_cb != NULL)
             ctx->remove_session_cb(ctx, c);
@@ -893,12 +1114,14 @@ long SSL_SESSION_set_timeout(SSL_SESSION *s, long t)
     if (s == NULL || t < 0)
         return 0;
     if (s->owner != NULL) {
-        if (!CRYPTO_THREAD_write_lock(s->owner->lock))
+        SSL_SESSION_CACHE_SHARD *sh = ssl_session_cache_shard(s->owner, s);
+
+        if (!CRYPTO_THREAD_write_lock(sh->lock))
             return 0;
         s->timeout = new_timeout;
         ssl_session_calculate_timeout(s);
-        SSL_SESSION_list_add(s->owner, s);
-        CRYPTO_THREAD_unlock(s->owner->lock);
+        SSL_SESSION_list_add(s->owner, sh, s);
+        CRYPTO_THREAD_unlock(sh->lock);
     } else {
         s->timeout = new_timeout;
         ssl_session_calculate_timeout(s);
@@ -927,12 +1150,14 @@ long SSL_SESSION_set_time(SSL_SESSION *s, long t)
     if (s == NULL)
         return 0;
     if (s->owner != NULL) {
-        if (!CRYPTO_THREAD_write_lock(s->owner->lock))
+        SSL_SESSION_CACHE_SHARD *sh = ssl_session_cache_shard(s->owner, s);
+
+        if (!CRYPTO_THREAD_write_lock(sh->lock))
             return 0;
         s->time = new_time;
         ssl_session_calculate_timeout(s);
-        SSL_SESSION_list_add(s->owner, s);
-        CRYPTO_THREAD_unlock(s->owner->lock);
+        SSL_SESSION_list_add(s->owner, sh, s);
+        CRYPTO_THREAD_unlock(sh->lock);
     } else {
         s->time = new_time;
         ssl_session_calculate_timeout(s);
@@ -1130,54 +1355,77 @@ int SSL_set_session_ticket_ext(SSL *s, void *ext_data, int ext_len)
     return 0;
 }
 
-void SSL_CTX_flush_sessions(SSL_CTX *s, long t)
+/*
+ * Removes the oldest session of a shard if it has timed out at |t|, or if |t|
+ * is 0, and returns it.  The remove_session_cb() is called, but freeing the
+ * session is left to the caller so that it can happen outside of the lock.
+ * Must be called with the shard locked for write.
+ */
+static SSL_SESSION *session_cache_expire_tail(SSL_CTX *ctx,
+                                              SSL_SESSION_CACHE_SHARD *sh,
+                                              time_t t)
+{
+    SSL_SESSION *current = sh->session_cache_tail;
+
+    if (current == NULL || (t != 0 && !sess_timedout(t, current)))
+        return NULL;
+
+    lh_SSL_SESSION_delete(sh->sessions, current);
+    SSL_SESSION_list_remove(sh, current);
+    current->not_resumable = 1;
+    if (ctx->remove_session_cb != NULL)
+        ctx->remove_session_cb(ctx, current);
+    return current;
+}
+
+void ssl_session_cache_flush_shard(SSL_CTX *ctx, size_t idx, time_t t)
 {
+    SSL_SESSION_CACHE_SHARD *sh = &ctx->sess_cache[idx];
     STACK_OF(SSL_SESSION) *sk;
     SSL_SESSION *current;
     unsigned long i;
 
-    if (!CRYPTO_THREAD_write_lock(s->lock))
+    if (!CRYPTO_THREAD_write_lock(sh->lock))
         return;
 
     sk = sk_SSL_SESSION_new_null();
-    i = lh_SSL_SESSION_get_down_load(s->sessions);
-    lh_SSL_SESSION_set_down_load(s->sessions, 0);
+    i = lh_SSL_SESSION_get_down_load(sh->sessions);
+    lh_SSL_SESSION_set_down_load(sh->sessions, 0);
 
     /*
      * Iterate over the list from the back (oldest), and stop
      * when a session can no longer be removed.
      * Add the session to a temporary list to be freed outside
-     * the SSL_CTX lock.
+     * the lock of the shard.
      * But still do the remove_session_cb() within the lock.
      */
-    while (s->session_cache_tail != NULL) {
-        current = s->session_cache_tail;
-        if (t == 0 || sess_timedout((time_t)t, current)) {
-            lh_SSL_SESSION_delete(s->sessions, current);
-            SSL_SESSION_list_remove(s, current);
-            current->not_resumable = 1;
-            if (s->remove_session_cb != NULL)
-                s->remove_session_cb(s, current);
-            /*
-             * Throw the session on a stack, it's entirely plausible
-             * that while freeing outside the critical section, the
-             * session could be re-added, so avoid using the next/prev
-             * pointers. If the stack failed to create, or the session
-             * couldn't be put on the stack, just free it here
-             */
-            if (sk == NULL || !sk_SSL_SESSION_push(sk, current))
-                SSL_SESSION_free(current);
-        } else {
-            break;
-        }
+    while ((current = session_cache_expire_tail(ctx, sh, t)) != NULL) {
+        /*
+         * Throw the session on a stack, it's entirely plausible
+         * that while freeing outside the critical section, the
+         * session could be re-added, so avoid using the next/prev
+         * pointers. If the stack failed to create, or the session
+         * couldn't be put on the stack, just free it here
+         */
+        if (sk == NULL || !sk_SSL_SESSION_push(sk, current))
+            SSL_SESSION_free(current);
     }
 
-    lh_SSL_SESSION_set_down_load(s->sessions, i);
-    CRYPTO_THREAD_unlock(s->lock);
+    lh_SSL_SESSION_set_down_load(sh->sessions, i);
+    CRYPTO_THREAD_unlock(sh->lock);
 
     sk_SSL_SESSION_pop_free(sk, SSL_SESSION_free);
 }
 
+void SSL_CTX_flush_sessions(SSL_CTX *s, long t)
+{
+    size_t i;
+
+    /* Each shard is flushed under its own lock, one after the other */
+    for (i = 0; i < s->sess_cache_shards; i++)
+        ssl_session_cache_flush_shard(s, i, (time_t)t);
+}
+
 int ssl_clear_bad_session(SSL *s)
 {
     if ((s->session != NULL) &&
@@ -1189,27 +1437,28 @@ int ssl_clear_bad_session(SSL *s)
         return 0;
 }
 
-/* locked by SSL_CTX in the calling function */
-static void SSL_SESSION_list_remove(SSL_CTX *ctx, SSL_SESSION *s)
+/* locked by the shard in the calling function */
+static void SSL_SESSION_list_remove(SSL_SESSION_CACHE_SHARD *sh,
+                                    SSL_SESSION *s)
 {
     if ((s->next == NULL) || (s->prev == NULL))
         return;
 
-    if (s->next == (SSL_SESSION *)&(ctx->session_cache_tail)) {
+    if (s->next == (SSL_SESSION *)&(sh->session_cache_tail)) {
         /* last element in list */
-        if (s->prev == (SSL_SESSION *)&(ctx->session_cache_head)) {
+        if (s->prev == (SSL_SESSION *)&(sh->session_cache_head)) {
             /* only one element in list */
-            ctx->session_cache_head = NULL;
-            ctx->session_cache_tail = NULL;
+            sh->session_cache_head = NULL;
+            sh->session_cache_tail = NULL;
         } else {
-            ctx->session_cache_tail = s->prev;
-            s->prev->next = (SSL_SESSION *)&(ctx->session_cache_tail);
+            sh->session_cache_tail = s->prev;
+            s->prev->next = (SSL_SESSION *)&(sh->session_cache_tail);
         }
     } else {
-        if (s->prev == (SSL_SESSION *)&(ctx->session_cache_head)) {
+        if (s->prev == (SSL_SESSION *)&(sh->session_cache_head)) {
             /* first element in list */
-            ctx->session_cache_head = s->next;
-            s->next->prev = (SSL_SESSION *)&(ctx->session_cache_head);
+            sh->session_cache_head = s->next;
+            s->next->prev = (SSL_SESSION *)&(sh->session_cache_head);
         } else {
             /* middle of list */
             s->next->prev = s->prev;
@@ -1220,41 +1469,42 @@ static void SSL_SESSION_list_remove(SSL_CTX *ctx, SSL_SESSION *s)
     s->owner = NULL;
 }
 
-static void SSL_SESSION_list_add(SSL_CTX *ctx, SSL_SESSION *s)
+static void SSL_SESSION_list_add(SSL_CTX *ctx, SSL_SESSION_CACHE_SHARD *sh,
+                                 SSL_SESSION *s)
 {
     SSL_SESSION *next;
 
     if ((s->next != NULL) && (s->prev != NULL))
-        SSL_SESSION_list_remove(ctx, s);
+        SSL_SESSION_list_remove(sh, s);
 
-    if (ctx->session_cache_head == NULL) {
-        ctx->session_cache_head = s;
-        ctx->session_cache_tail = s;
-        s->prev = (SSL_SESSION *)&(ctx->session_cache_head);
-        s->next = (SSL_SESSION *)&(ctx->session_cache_tail);
+    if (sh->session_cache_head == NULL) {
+        sh->session_cache_head = s;
+        sh->session_cache_tail = s;
+        s->prev = (SSL_SESSION *)&(sh->session_cache_head);
+        s->next = (SSL_SESSION *)&(sh->session_cache_tail);
     } else {
-        if (timeoutcmp(s, ctx->session_cache_head) >= 0) {
+        if (timeoutcmp(s, sh->session_cache_head) >= 0) {
             /*
              * if we timeout after (or the same time as) the first
              * session, put us first - usual case
              */
-            s->next = ctx->session_cache_head;
+            s->next = sh->session_cache_head;
             s->next->prev = s;
-            s->prev = (SSL_SESSION *)&(ctx->session_cache_head);
-            ctx->session_cache_head = s;
-        } else if (timeoutcmp(s, ctx->session_cache_tail) < 0) {
+            s->prev = (SSL_SESSION *)&(sh->session_cache_head);
+            sh->session_cache_head = s;
+        } else if (timeoutcmp(s, sh->session_cache_tail) < 0) {
             /* if we timeout before the last session, put us last */
-            s->prev = ctx->session_cache_tail;
+            s->prev = sh->session_cache_tail;
             s->prev->next = s;
-            s->next = (SSL_SESSION *)&(ctx->session_cache_tail);
-            ctx->session_cache_tail = s;
+            s->next = (SSL_SESSION *)&(sh->session_cache_tail);
+            sh->session_cache_tail = s;
         } else {
             /*
              * we timeout somewhere in-between - if there is only
              * one session in the cache it will be caught above
              */
-            next = ctx->session_cache_head->next;
-            while (next != (SSL_SESSION*)&(ctx->session_cache_tail)) {
+            next = sh->session_cache_head->next;
+            while (next != (SSL_SESSION*)&(sh->session_cache_tail)) {
                 if (timeoutcmp(s, next) >= 0) {
                     s->next = next;
                     s->prev = next->prev;
@@ -1305,6 +1555,21 @@ SSL_SESSION *(*SSL_CTX_sess_get_get_cb(SSL_CTX *ctx)) (SSL *ssl,
     return ctx->get_session_cb;
 }
 
+int SSL_CTX_set1_shared_session_cache(SSL_CTX *ctx,
+                                      SSL_SHARED_SESSION_CACHE *cache)
+{
+    if (cache != NULL && !SSL_SHARED_SESSION_CACHE_up_ref(cache))
+        return 0;
+    SSL_SHARED_SESSION_CACHE_free(ctx->shared_sess_cache);
+    ctx->shared_sess_cache = cache;
+    return 1;
+}
+
+SSL_SHARED_SESSION_CACHE *SSL_CTX_get0_shared_session_cache(const SSL_CTX *ctx)
+{
+    return ctx->shared_sess_cache;
+}
+
 void SSL_CTX_set_info_callback(SSL_CTX *ctx,
                                void (*cb) (const SSL *ssl, int type, int val))
 {
@@ -0,0 +1,413 @@
+/*
+ * Copyright 2021 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * A session cache in anonymous shared memory, for servers that fork worker
+ * processes after creating it.  The memory is split into buckets of
+ * SHCACHE_WAYS slots, each slot holding one DER encoded session.  A session
+ * ID always maps to the same bucket, and every bucket has its own process
+ * shared mutex.  When a bucket is full, its least recently used slot is
+ * reused.
+ */
+
+#include "e_os.h"
+#include <string.h>
+#include <time.h>
+#include "internal/refcount.h"
+#include "ssl_local.h"
+
+#if defined(OPENSSL_SYS_UNIX) && defined(OPENSSL_THREADS)
+# include <errno.h>
+# include <unistd.h>
+# include <sys/mman.h>
+# include <pthread.h>
+# if !defined(MAP_ANON) && defined(MAP_ANONYMOUS)
+#  define MAP_ANON MAP_ANONYMOUS
+# endif
+# if defined(MAP_ANON) && defined(_POSIX_THREAD_PROCESS_SHARED) \
+     && _POSIX_THREAD_PROCESS_SHARED > 0
+#  define SHCACHE_SUPPORTED
+#  if defined(_POSIX_VERSION) && _POSIX_VERSION >= 200809L \
+      && defined(EOWNERDEAD)
+#   define SHCACHE_ROBUST
+#  endif
+# endif
+#endif
+
+struct ssl_shared_session_cache_st {
+    CRYPTO_REF_COUNT references;
+    CRYPTO_RWLOCK *lock;
+    unsigned char *map;
+    size_t map_size;
+    size_t num_buckets;
+    size_t bucket_size;         /* bytes per bucket, including its slots */
+    size_t slot_size;           /* bytes per slot, including its header */
+    size_t max_der_len;
+};
+
+#ifdef SHCACHE_SUPPORTED
+
+/* Slots per bucket */
+# define SHCACHE_WAYS                   8
+# define SHCACHE_ALIGN                  64
+# define SHCACHE_DEFAULT_SESSION_SIZE   2048
+# define SHCACHE_MAX_SESSION_SIZE       65536
+# define SHCACHE_MAX_SESSIONS           (1 << 24)
+
+typedef struct {
+    pthread_mutex_t lock;
+    uint64_t clock;             /* advanced on every use of one of its slots */
+} SHCACHE_BUCKET;
+
+/* The DER encoded session follows the slot header */
+typedef struct {
+    uint64_t last_used;         /* bucket clock when last stored or found */
+    int64_t expires;            /* the session times out after this time */
+    uint32_t ssl_version;
+    uint32_t id_len;            /* 0 if the slot is free */
+    uint32_t der_len;
+    unsigned char id[SSL_MAX_SSL_SESSION_ID_LENGTH];
+} SHCACHE_SLOT;
+
+static size_t shcache_round(size_t n, size_t to)
+{
+    return (n + to - 1) / to * to;
+}
+
+static SHCACHE_BUCKET *shcache_bucket(const SSL_SHARED_SESSION_CACHE *cache,
+                                      const unsigned char *id, size_t id_len)
+{
+    uint32_t h = 0x811c9dc5;     /* FNV-1a */
+    size_t i;
+
+    for (i = 0; i < id_len; i++)
+        h = (h ^ id[i]) * 0x01000193;
+    i = (size_t)(((uint64_t)h * cache->num_buckets) >> 32);
+    return (SHCACHE_BUCKET *)(cache->map + i * cache->bucket_size);
+}
+
+static SHCACHE_SLOT *shcache_slot(const SSL_SHARED_SESSION_CACHE *cache,
+                                  SHCACHE_BUCKET *b, size_t i)
+{
+    return (SHCACHE_SLOT *)((unsigned char *)b
+                            + shcache_round(sizeof(*b), SHCACHE_ALIGN)
+                            + i * cache->slot_size);
+}
+
+static int shcache_slot_matches(const SHCACHE_SLOT *slot, int version,
+                                const unsigned char *id, size_t id_len)
+{
+    return slot->id_len == id_len
+           && slot->ssl_version == (uint32_t)version
+           && memcmp(slot->id, id, id_len) == 0;
+}
+
+/* Free slots are reused first, then expired ones, then the least used */
+static uint64_t shcache_slot_rank(const SHCACHE_SLOT *slot, int64_t now)
+{
+    if (slot->id_len == 0)
+        return 0;
+    if (now > slot->expires)
+        return 1;
+    return slot->last_used + 2;
+}
+
+static int shcache_lock(const SSL_SHARED_SESSION_CACHE *cache,
+                        SHCACHE_BUCKET *b)
+{
+    int ret = pthread_mutex_lock(&b->lock);
+
+# ifdef SHCACHE_ROBUST
+    if (ret == EOWNERDEAD) {
+        size_t i;
+
+        /*
+         * A process died while holding the lock, so the bucket may be half
+         * written.  Forget everything in it.
+         */
+        for (i = 0; i < SHCACHE_WAYS; i++)
+            shcache_slot(cache, b, i)->id_len = 0;
+        if (pthread_mutex_consistent(&b->lock) != 0) {
+            pthread_mutex_unlock(&b->lock);
+            return 0;
+        }
+        return 1;
+    }
+# endif
+    return ret == 0;
+}
+
+static void shcache_unlock(SHCACHE_BUCKET *b)
+{
+    pthread_mutex_unlock(&b->lock);
+}
+
+SSL_SHARED_SESSION_CACHE *SSL_SHARED_SESSION_CACHE_new(size_t num_sessions,
+                                                       size_t max_session_size)
+{
+    SSL_SHARED_SESSION_CACHE *cache;
+    pthread_mutexattr_t attr;
+    size_t i;
+    int ok;
+
+    if (max_session_size == 0)
+        max_session_size = SHCACHE_DEFAULT_SESSION_SIZE;
+    if (num_sessions == 0 || num_sessions > SHCACHE_MAX_SESSIONS
+            || max_session_size > SHCACHE_MAX_SESSION_SIZE) {
+        ERR_raise(ERR_LIB_SSL, ERR_R_PASSED_INVALID_ARGUMENT);
+        return NULL;
+    }
+
+    if ((cache = OPENSSL_zalloc(sizeof(*cache))) == NULL) {
+        ERR_raise(ERR_LIB_SSL, ERR_R_MALLOC_FAILURE);
+        return NULL;
+    }
+    cache->references = 1;
+    cache->lock = CRYPTO_THREAD_lock_new();
+    if (cache->lock == NULL) {
+        ERR_raise(ERR_LIB_SSL, ERR_R_MALLOC_FAILURE);
+        OPENSSL_free(cache);
+        return NULL;
+    }
+
+    cache->max_der_len = max_session_size;
+    cache->slot_size = shcache_round(sizeof(SHCACHE_SLOT) + max_session_size,
+                                     sizeof(uint64_t));
+    cache->bucket_size = shcache_round(shcache_round(sizeof(SHCACHE_BUCKET),
+                                                     SHCACHE_ALIGN)
+                                       + SHCACHE_WAYS * cache->slot_size,
+                                       SHCACHE_ALIGN);
+    cache->num_buckets = (num_sessions + SHCACHE_WAYS - 1) / SHCACHE_WAYS;
+    if (cache->num_buckets > SIZE_MAX / cache->bucket_size) {
+        ERR_raise(ERR_LIB_SSL, ERR_R_PASSED_INVALID_ARGUMENT);
+        goto err;
+    }
+    cache->map_size = cache->num_buckets * cache->bucket_size;
+
+    /* Anonymous memory is zeroed, so all slots start out free */
+    cache->map = mmap(NULL, cache->map_size, PROT_READ | PROT_WRITE,
+                      MAP_ANON | MAP_SHARED, -1, 0);
+    if (cache->map == MAP_FAILED) {
+        cache->map = NULL;
+        ERR_raise_data(ERR_LIB_SYS, get_last_sys_error(), "calling mmap()");
+        goto err;
+    }
+
+    if (pthread_mutexattr_init(&attr) != 0) {
+        ERR_raise(ERR_LIB_SSL, ERR_R_INTERNAL_ERROR);
+        goto err;
+    }
+    ok = pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED) == 0;
+# ifdef SHCACHE_ROBUST
+    ok = ok && pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST) == 0;
+# endif
+    for (i = 0; ok && i < cache->num_buckets; i++) {
+        SHCACHE_BUCKET *b = (SHCACHE_BUCKET *)(cache->map
+                                               + i * cache->bucket_size);
+
+        ok = pthread_mutex_init(&b->lock, &attr) == 0;
+    }
+    pthread_mutexattr_destroy(&attr);
+    if (!ok) {
+        ERR_raise(ERR_LIB_SSL, ERR_R_INTERNAL_ERROR);
+        goto err;
+    }
+    return cache;
+
+ err:
+    SSL_SHARED_SESSION_CACHE_free(cache);
+    return NULL;
+}
+
+/*
+ * Stores |sess| in the cache.  An earlier copy of the same session is
+ * replaced, otherwise the session takes the best slot of its bucket according
+ * to shcache_slot_rank().  Sessions too large for a slot are not stored.
+ */
+int ssl_shcache_store(SSL_SHARED_SESSION_CACHE *cache, const SSL_SESSION *sess)
+{
+    SHCACHE_BUCKET *b;
+    SHCACHE_SLOT *slot, *victim = NULL;
+    const unsigned char *id = sess->session_id;
+    size_t i, id_len = sess->session_id_length;
+    int64_t now = (int64_t)time(NULL);
+    unsigned char *p;
+    int len, ret;
+
+    if (id_len == 0 || id_len > SSL_MAX_SSL_SESSION_ID_LENGTH)
+        return 0;
+    len = i2d_SSL_SESSION(sess, NULL);
+    if (len <= 0 || (size_t)len > cache->max_der_len)
+        return 0;
+
+    b = shcache_bucket(cache, id, id_len);
+    if (!shcache_lock(cache, b))
+        return 0;
+    for (i = 0; i < SHCACHE_WAYS; i++) {
+        slot = shcache_slot(cache, b, i);
+        if (shcache_slot_matches(slot, sess->ssl_version, id, id_len)) {
+            victim = slot;
+            break;
+        }
+        if (victim == NULL
+                || shcache_slot_rank(slot, now)
+                   < shcache_slot_rank(victim, now))
+            victim = slot;
+    }
+
+    p = (unsigned char *)(victim + 1);
+    len = i2d_SSL_SESSION(sess, &p);
+    if (len <= 0 || (size_t)len > cache->max_der_len) {
+        victim->id_len = 0;
+    } else {
+        victim->der_len = (uint32_t)len;
+        victim->ssl_version = (uint32_t)sess->ssl_version;
+        victim->id_len = (uint32_t)id_len;
+        memcpy(victim->id, id, id_len);
+        victim->expires = sess->timeout_ovf ? INT64_MAX
+                                            : (int64_t)sess->calc_timeout;
+        victim->last_used = ++b->clock;
+    }
+    ret = victim->id_len != 0;
+    shcache_unlock(b);
+    return ret;
+}
+
+/*
+ * Returns a new SSL_SESSION decoded from the cache, or NULL if there is no
+ * session for |id| that has not yet timed out.
+ */
+SSL_SESSION *ssl_shcache_lookup(SSL_SHARED_SESSION_CACHE *cache, int version,
+                                const unsigned char *id, size_t id_len)
+{
+    SHCACHE_BUCKET *b;
+    SHCACHE_SLOT *slot;
+    SSL_SESSION *ret = NULL;
+    const unsigned char *p;
+    size_t i;
+
+    if (id_len == 0 || id_len > SSL_MAX_SSL_SESSION_ID_LENGTH)
+        return NULL;
+
+    b = shcache_bucket(cache, id, id_len);
+    if (!shcache_lock(cache, b))
+        return NULL;
+    for (i = 0; i < SHCACHE_WAYS; i++) {
+        slot = shcache_slot(cache, b, i);
+        if (!shcache_slot_matches(slot, version, id, id_len))
+            continue;
+        if ((int64_t)time(NULL) > slot->expires) {
+            slot->id_len = 0;
+            break;
+        }
+        slot->last_used = ++b->clock;
+        p = (const unsigned char *)(slot + 1);
+        ret = d2i_SSL_SESSION(NULL, &p, (long)slot->der_len);
+        break;
+    }
+    shcache_unlock(b);
+    return ret;
+}
+
+/*
+ * Removes |sess| from the cache.  Returns 1 if this call removed it, or 0 if
+ * it wasn't there, for example because someone else removed it first.  Since
+ * the check and the removal happen under the bucket lock, only one caller
+ * across all processes can ever get 1 for the same stored session.
+ */
+int ssl_shcache_remove(SSL_SHARED_SESSION_CACHE *cache,
+                       const SSL_SESSION *sess)
+{
+    SHCACHE_BUCKET *b;
+    SHCACHE_SLOT *slot;
+    size_t i;
+    int ret = 0;
+
+    if (sess->session_id_length == 0)
+        return 0;
+
+    b = shcache_bucket(cache, sess->session_id, sess->session_id_length);
+    if (!shcache_lock(cache, b))
+        return 0;
+    for (i = 0; i < SHCACHE_WAYS; i++) {
+        slot = shcache_slot(cache, b, i);
+        if (shcache_slot_matches(slot, sess->ssl_version, sess->session_id,
+                                 sess->session_id_length)) {
+            ret = (int64_t)time(NULL) <= slot->expires;
+            slot->id_len = 0;
+            break;
+        }
+    }
+    shcache_unlock(b);
+    return ret;
+}
+
+#else
+
+SSL_SHARED_SESSION_CACHE *SSL_SHARED_SESSION_CACHE_new(size_t num_sessions,
+                                                       size_t max_session_size)
+{
+    ERR_raise(ERR_LIB_SSL, ERR_R_UNSUPPORTED);
+    return NULL;
+}
+
+int ssl_shcache_store(SSL_SHARED_SESSION_CACHE *cache, const SSL_SESSION *sess)
+{
+    return 0;
+}
+
+SSL_SESSION *ssl_shcache_lookup(SSL_SHARED_SESSION_CACHE *cache, int version,
+                                const unsigned char *id, size_t id_len)
+{
+    return NULL;
+}
+
+int ssl_shcache_remove(SSL_SHARED_SESSION_CACHE *cache,
+                       const SSL_SESSION *sess)
+{
+    return 0;
+}
+
+#endif
+
+int SSL_SHARED_SESSION_CACHE_up_ref(SSL_SHARED_SESSION_CACHE *cache)
+{
+    int i;
+
+    if (CRYPTO_UP_REF(&cache->references, &i, cache->lock) <= 0)
+        return 0;
+
+    REF_PRINT_COUNT("SSL_SHARED_SESSION_CACHE", cache);
+    REF_ASSERT_ISNT(i < 2);
+    return ((i > 1) ? 1 : 0);
+}
+
+/*
+ * The mutexes in the shared memory are never destroyed, other processes may
+ * still be using them.  The memory is only unmapped from this process.
+ */
+void SSL_SHARED_SESSION_CACHE_free(SSL_SHARED_SESSION_CACHE *cache)
+{
+    int i;
+
+    if (cache == NULL)
+        return;
+    CRYPTO_DOWN_REF(&cache->references, &i, cache->lock);
+    REF_PRINT_COUNT("SSL_SHARED_SESSION_CACHE", cache);
+    if (i > 0)
+        return;
+    REF_ASSERT_ISNT(i < 0);
+
+#ifdef SHCACHE_SUPPORTED
+    if (cache->map != NULL)
+        munmap(cache->map, cache->map_size);
+#endif
+    CRYPTO_THREAD_lock_free(cache->lock);
+    OPENSSL_free(cache);
+}
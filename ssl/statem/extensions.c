@@ -785,6 +785,268 @@ int should_add_extension(SSL *s, unsigned int extctx, unsigned int thisctx,
  * 0 being the first in the chain). Returns 1 on success or 0 on failure. On a
  * failure construction stops at the first extension to fail to construct.
  */
+/*
+ * The built-in ClientHello extensions whose encoding only depends on the
+ * configuration recorded in a CH_TEMPLATE and have no other side effect than
+ * being marked as sent. ALPN is a copy of the configured value already.
+ */
+static int ch_template_ext(size_t idx)
+{
+    switch (idx) {
+    case TLSEXT_IDX_ec_point_formats:
+    case TLSEXT_IDX_supported_groups:
+    case TLSEXT_IDX_signature_algorithms:
+    case TLSEXT_IDX_supported_versions:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/*
+ * The parts of the cipher masks set by ssl_set_client_disabled() which do not
+ * follow from the rest of the configuration.
+ */
+static uint32_t ch_template_mask(const SSL *s)
+{
+    uint32_t mask = 0;
+
+#ifndef OPENSSL_NO_PSK
+    if (s->psk_client_callback == NULL)
+        mask |= SSL_PSK;
+#endif
+#ifndef OPENSSL_NO_SRP
+    if ((s->srp_ctx.srp_Mask & SSL_kSRP) == 0)
+        mask |= SSL_kSRP;
+#endif
+    return mask;
+}
+
+static void ch_template_free(CH_TEMPLATE *t)
+{
+    int i;
+
+    if (t == NULL)
+        return;
+
+    CRYPTO_DOWN_REF(&t->references, &i, t->lock);
+    REF_PRINT_COUNT("CH_TEMPLATE", t);
+    if (i > 0)
+        return;
+    REF_ASSERT_ISNT(i < 0);
+
+    OPENSSL_free(t->groups);
+    OPENSSL_free(t->formats);
+    OPENSSL_free(t->data);
+    CRYPTO_THREAD_lock_free(t->lock);
+    OPENSSL_free(t);
+}
+
+/* Was |t| recorded with the current configuration of |s|? */
+static int ch_template_matches(const CH_TEMPLATE *t, const SSL *s)
+{
+    if (t->method != s->method
+            || t->cert != s->cert
+            || t->options != s->options
+            || t->fallback_scsv != (s->mode & SSL_MODE_SEND_FALLBACK_SCSV)
+            || t->version != s->version
+            || t->min_proto_version != s->min_proto_version
+            || t->max_proto_version != s->max_proto_version
+            || t->mask != ch_template_mask(s))
+        return 0;
+
+    /* A NULL list selects the defaults, which differ from an empty list */
+    if ((t->groups == NULL) != (s->ext.supportedgroups == NULL)
+            || t->groups_len != s->ext.supportedgroups_len
+            || (t->groups_len > 0
+                && memcmp(t->groups, s->ext.supportedgroups,
+                          t->groups_len * sizeof(*t->groups)) != 0))
+        return 0;
+    if ((t->formats == NULL) != (s->ext.ecpointformats == NULL)
+            || t->formats_len != s->ext.ecpointformats_len
+            || (t->formats_len > 0
+                && memcmp(t->formats, s->ext.ecpointformats,
+                          t->formats_len) != 0))
+        return 0;
+
+    return 1;
+}
+
+/* Create an empty template for the current configuration of |s| */
+static CH_TEMPLATE *ch_template_new(const SSL *s)
+{
+    CH_TEMPLATE *t;
+
+    /* The copies below can't preserve a non-NULL empty list */
+    if ((s->ext.supportedgroups != NULL && s->ext.supportedgroups_len == 0)
+            || (s->ext.ecpointformats != NULL
+                && s->ext.ecpointformats_len == 0))
+        return NULL;
+
+    if ((t = OPENSSL_zalloc(sizeof(*t))) == NULL)
+        return NULL;
+    t->references = 1;
+    t->lock = CRYPTO_THREAD_lock_new();
+    if (t->lock == NULL)
+        goto err;
+
+    t->method = s->method;
+    t->cert = s->cert;
+    t->options = s->options;
+    t->fallback_scsv = s->mode & SSL_MODE_SEND_FALLBACK_SCSV;
+    t->version = s->version;
+    t->min_proto_version = s->min_proto_version;
+    t->max_proto_version = s->max_proto_version;
+    t->mask = ch_template_mask(s);
+    if (s->ext.supportedgroups != NULL) {
+        t->groups = OPENSSL_memdup(s->ext.supportedgroups,
+                                   s->ext.supportedgroups_len
+                                   * sizeof(*s->ext.supportedgroups));
+        if (t->groups == NULL)
+            goto err;
+        t->groups_len = s->ext.supportedgroups_len;
+    }
+    if (s->ext.ecpointformats != NULL) {
+        t->formats = OPENSSL_memdup(s->ext.ecpointformats,
+                                    s->ext.ecpointformats_len);
+        if (t->formats == NULL)
+            goto err;
+        t->formats_len = s->ext.ecpointformats_len;
+    }
+
+    return t;
+ err:
+    ch_template_free(t);
+    return NULL;
+}
+
+void ssl_clear_ch_template(SSL *s)
+{
+    ch_template_free(s->ext.ch_template);
+    s->ext.ch_template = NULL;
+}
+
+/* Called whenever the configuration of |ctx| changes */
+void ssl_ctx_clear_ch_template(SSL_CTX *ctx)
+{
+    CH_TEMPLATE *t;
+
+    if (!CRYPTO_THREAD_write_lock(ctx->lock))
+        return;
+    t = ctx->ext.ch_template;
+    ctx->ext.ch_template = NULL;
+    CRYPTO_THREAD_unlock(ctx->lock);
+    ch_template_free(t);
+}
+
+/*
+ * Called by a client about to construct the ciphersuites and extensions of a
+ * ClientHello. Picks up the template of the SSL_CTX if it matches, or else
+ * starts recording a new one. This is only done for the first handshake of a
+ * connection which still uses the CERT, ciphers and (default) security
+ * callback of its SSL_CTX. Failures just mean that no template is used.
+ */
+void tls_ch_template_start(SSL *s)
+{
+    SSL_CTX *ctx = s->ctx;
+    CH_TEMPLATE *t;
+    int i;
+
+    ssl_clear_ch_template(s);
+    if (s->server || s->renegotiate || !SSL_IS_FIRST_HANDSHAKE(s)
+            || s->cert != ctx->cert || s->cipher_list != NULL
+            || !ssl_security_is_default(s))
+        return;
+
+    if (!CRYPTO_THREAD_read_lock(ctx->lock))
+        return;
+    t = ctx->ext.ch_template;
+    if (t != NULL && ch_template_matches(t, s)) {
+        CRYPTO_UP_REF(&t->references, &i, t->lock);
+        REF_PRINT_COUNT("CH_TEMPLATE", t);
+        s->ext.ch_template = t;
+    }
+    CRYPTO_THREAD_unlock(ctx->lock);
+
+    if (s->ext.ch_template == NULL)
+        s->ext.ch_template = ch_template_new(s);
+}
+
+/*
+ * Called once the ClientHello has been constructed successfully, to publish a
+ * newly recorded template in the SSL_CTX.
+ */
+void tls_ch_template_finish(SSL *s)
+{
+    CH_TEMPLATE *t = s->ext.ch_template;
+    SSL_CTX *ctx = s->ctx;
+
+    s->ext.ch_template = NULL;
+    /* Don't publish a template if the SSL_CTX changed meanwhile */
+    if (t != NULL && !t->complete && t->cert == ctx->cert
+            && CRYPTO_THREAD_write_lock(ctx->lock)) {
+        CH_TEMPLATE *old = ctx->ext.ch_template;
+
+        t->complete = 1;
+        ctx->ext.ch_template = t;
+        CRYPTO_THREAD_unlock(ctx->lock);
+        t = old;
+    }
+    ch_template_free(t);
+}
+
+/*
+ * If the ClientHello template in use by |s| has |part|, add that to |pkt| and
+ * set |*len| to its length. Returns 1 if the part was added, 0 if it needs to
+ * be constructed and -1 on error.
+ */
+int tls_ch_template_put(SSL *s, size_t part, WPACKET *pkt, size_t *len)
+{
+    const CH_TEMPLATE *t = s->ext.ch_template;
+    const CH_TEMPLATE_PART *p;
+
+    if (t == NULL || !t->complete || !t->parts[part].present)
+        return 0;
+
+    p = &t->parts[part];
+    if (!WPACKET_memcpy(pkt, t->data + p->off, p->len))
+        return -1;
+    *len = p->len;
+    return 1;
+}
+
+/*
+ * Record |part| in the ClientHello template being recorded by |s|. It has
+ * just been constructed in |pkt|, starting when it had |start| bytes written.
+ */
+void tls_ch_template_record(SSL *s, size_t part, WPACKET *pkt, size_t start)
+{
+    CH_TEMPLATE *t = s->ext.ch_template;
+    unsigned char *curr, *data;
+    size_t written, len;
+
+    if (t == NULL || t->complete)
+        return;
+
+    if (!WPACKET_get_total_written(pkt, &written)
+            || (curr = WPACKET_get_curr(pkt)) == NULL)
+        goto err;
+    len = written - start;
+    if (len > 0) {
+        if ((data = OPENSSL_realloc(t->data, t->data_len + len)) == NULL)
+            goto err;
+        memcpy(data + t->data_len, curr - len, len);
+        t->data = data;
+    }
+    t->parts[part].present = 1;
+    t->parts[part].off = t->data_len;
+    t->parts[part].len = len;
+    t->data_len += len;
+    return;
+ err:
+    ssl_clear_ch_template(s);
+}
+
 int tls_construct_extensions(SSL *s, WPACKET *pkt, unsigned int context,
                              X509 *x, size_t chainidx)
 {
@@ -839,7 +1101,31 @@ int tls_construct_extensions(SSL *s, WPACKET *pkt, unsigned int context,
         if (construct == NULL)
             continue;
 
-        ret = construct(s, pkt, context, x, chainidx);
+        if (s->ext.ch_template != NULL
+                && (context & SSL_EXT_CLIENT_HELLO) != 0
+                && ch_template_ext(i)) {
+            size_t len, start;
+            int put = tls_ch_template_put(s, i, pkt, &len);
+
+            if (put < 0) {
+                SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
+                return 0;
+            }
+            if (put > 0) {
+                if (len > 0)
+                    s->ext.extflags[i] |= SSL_EXT_FLAG_SENT;
+                continue;
+            }
+            if (!WPACKET_get_total_written(pkt, &start)) {
+                SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
+                return 0;
+            }
+            ret = construct(s, pkt, context, x, chainidx);
+            if (ret != EXT_RETURN_FAIL)
+                tls_ch_template_record(s, i, pkt, start);
+        } else {
+            ret = construct(s, pkt, context, x, chainidx);
+        }
         if (ret == EXT_RETURN_FAIL) {
             /* SSLfatal() already called */
             return 0;
@@ -345,7 +345,7 @@ static int add_custom_ext_intern(SSL_CTX *ctx, ENDPOINT role,
                                  SSL_custom_ext_parse_cb_ex parse_cb,
                                  void *parse_arg)
 {
-    custom_ext_methods *exts = &ctx->cert->custext;
+    custom_ext_methods *exts;
     custom_ext_method *meth, *tmp;
 
     /*
@@ -355,6 +355,10 @@ static int add_custom_ext_intern(SSL_CTX *ctx, ENDPOINT role,
     if (add_cb == NULL && free_cb != NULL)
         return 0;
 
+    if (!ssl_cert_unshare(NULL, ctx))
+        return 0;
+    exts = &ctx->cert->custext;
+
 #ifndef OPENSSL_NO_CT
     /*
      * We don't want applications registering callbacks for SCT extensions
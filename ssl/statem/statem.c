@@ -740,6 +740,9 @@ static void init_write_state_machine(SSL *s)
  * |      WRITE_STATE_PRE_WORK -----> [SUB_STATE_END_HANDSHAKE]
  * |             |
  * |             v
+ * |     WRITE_STATE_CONSTRUCT
+ * |             |
+ * |             v
  * |       WRITE_STATE_SEND
  * |             |
  * |             v
@@ -754,6 +757,10 @@ static void init_write_state_machine(SSL *s)
  * which case control returns to the calling application. When this function
  * is recalled we will resume in the same state where we left off.
  *
+ * WRITE_STATE_CONSTRUCT constructs the message. This can be suspended while
+ * the private key method works on a signature, in which case the whole
+ * message is constructed again when this function is recalled.
+ *
  * WRITE_STATE_SEND sends the message and performs any work to be done after
  * sending.
  *
@@ -827,12 +834,16 @@ static SUB_STATE_RETURN write_state_machine(SSL *s)
                 return SUB_STATE_ERROR;
 
             case WORK_FINISHED_CONTINUE:
-                st->write_state = WRITE_STATE_SEND;
+                st->write_state = WRITE_STATE_CONSTRUCT;
                 break;
 
             case WORK_FINISHED_STOP:
                 return SUB_STATE_END_HANDSHAKE;
             }
+
+            /* Fall through */
+
+        case WRITE_STATE_CONSTRUCT:
             if (!get_construct_message_f(s, &pkt, &confunc, &mt)) {
                 /* SSLfatal() already called */
                 return SUB_STATE_ERROR;
@@ -851,6 +862,14 @@ static SUB_STATE_RETURN write_state_machine(SSL *s)
             }
             if (confunc != NULL && !confunc(s, &pkt)) {
                 WPACKET_cleanup(&pkt);
+                if (s->rwstate == SSL_PRIVATE_KEY_OPERATION
+                        && !ossl_statem_in_error(s)) {
+                    /* Start this message afresh when we are recalled */
+                    if (SSL_IS_DTLS(s))
+                        s->d1->next_handshake_write_seq =
+                            s->d1->handshake_write_seq;
+                    return SUB_STATE_ERROR;
+                }
                 check_fatal(s);
                 return SUB_STATE_ERROR;
             }
@@ -860,6 +879,7 @@ static SUB_STATE_RETURN write_state_machine(SSL *s)
                 SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
                 return SUB_STATE_ERROR;
             }
+            st->write_state = WRITE_STATE_SEND;
 
             /* Fall through */
 
@@ -67,6 +67,7 @@ typedef enum {
 typedef enum {
     WRITE_STATE_TRANSITION,
     WRITE_STATE_PRE_WORK,
+    WRITE_STATE_CONSTRUCT,
     WRITE_STATE_SEND,
     WRITE_STATE_POST_WORK
 } WRITE_STATE;
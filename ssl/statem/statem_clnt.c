@@ -1226,6 +1226,12 @@ int tls_construct_client_hello(SSL *s, WPACKET *pkt)
         }
     }
 
+    /*
+     * The rest of the ClientHello is mostly fixed by the configuration, so it
+     * may be possible to copy parts of it from a template.
+     */
+    tls_ch_template_start(s);
+
     /* Ciphers supported */
     if (!WPACKET_start_sub_packet_u16(pkt)) {
         SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
@@ -1271,6 +1277,7 @@ int tls_construct_client_hello(SSL *s, WPACKET *pkt)
         /* SSLfatal() already called */
         return 0;
     }
+    tls_ch_template_finish(s);
 
     return 1;
 }
@@ -3666,8 +3673,8 @@ int ssl_do_client_cert_cb(SSL *s, X509 **px509, EVP_PKEY **ppkey)
 
 int ssl_cipher_list_to_bytes(SSL *s, STACK_OF(SSL_CIPHER) *sk, WPACKET *pkt)
 {
-    int i;
-    size_t totlen = 0, len, maxlen, maxverok = 0;
+    int i, put;
+    size_t totlen = 0, len, maxlen, maxverok = 0, start;
     int empty_reneg_info_scsv = !s->renegotiate;
 
     /* Set disabled masks for this session */
@@ -3702,7 +3709,16 @@ int ssl_cipher_list_to_bytes(SSL *s, STACK_OF(SSL_CIPHER) *sk, WPACKET *pkt)
     if (s->mode & SSL_MODE_SEND_FALLBACK_SCSV)
         maxlen -= 2;
 
-    for (i = 0; i < sk_SSL_CIPHER_num(sk) && totlen < maxlen; i++) {
+    /* A template only ever holds a list which passed the checks below */
+    put = tls_ch_template_put(s, CH_TEMPLATE_CIPHERS, pkt, &totlen);
+    if (put < 0 || !WPACKET_get_total_written(pkt, &start)) {
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
+        return 0;
+    }
+    if (put > 0)
+        maxverok = 1;
+
+    for (i = 0; !put && i < sk_SSL_CIPHER_num(sk) && totlen < maxlen; i++) {
         const SSL_CIPHER *c;
 
         c = sk_SSL_CIPHER_value(sk, i);
@@ -3742,6 +3758,9 @@ int ssl_cipher_list_to_bytes(SSL *s, STACK_OF(SSL_CIPHER) *sk, WPACKET *pkt)
         return 0;
     }
 
+    if (!put)
+        tls_ch_template_record(s, CH_TEMPLATE_CIPHERS, pkt, start);
+
     if (totlen != 0) {
         if (empty_reneg_info_scsv) {
             static SSL_CIPHER scsv = {
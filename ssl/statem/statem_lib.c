@@ -269,6 +269,63 @@ static int get_cert_verify_tbs_data(SSL *s, unsigned char *tls13tbs,
     return 1;
 }
 
+/*
+ * Sign |tbs| with the private key method of the SSL_CTX instead of |pkey|,
+ * which may hold just the public key of the certificate. The signature for
+ * |lu| is returned in |*psig|, which the caller must free. Returns 1 on
+ * success and 0 on failure (SSLfatal() already called). Returns -1 if the
+ * application will deliver the signature later: the handshake then stops
+ * with SSL_ERROR_WANT_PRIVATE_KEY_OPERATION and the message is constructed
+ * again, with the same |tbs|, when it is resumed.
+ */
+int tls_private_key_sign(SSL *s, const SIGALG_LOOKUP *lu, EVP_PKEY *pkey,
+                         const unsigned char *tbs, size_t tbslen,
+                         unsigned char **psig, size_t *psiglen)
+{
+    unsigned char *sig;
+    size_t siglen;
+    int sigsize, ret;
+
+    /* SSLv3 mixes the master secret into the signature */
+    if (s->version == SSL3_VERSION) {
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_R_UNSUPPORTED_SSL_VERSION);
+        return 0;
+    }
+
+    sigsize = EVP_PKEY_get_size(pkey);
+    if (sigsize <= 0) {
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
+        return 0;
+    }
+    sig = OPENSSL_malloc(sigsize);
+    if (sig == NULL) {
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+
+    siglen = sigsize;
+    ret = s->ctx->private_key_sign_cb(s, sig, &siglen, sigsize, lu->sigalg,
+                                      tbs, tbslen,
+                                      s->ctx->private_key_sign_cb_arg);
+    if (ret < 0) {
+        OPENSSL_free(sig);
+        s->rwstate = SSL_PRIVATE_KEY_OPERATION;
+        s->s3.tmp.pkey_op_pending = 1;
+        return -1;
+    }
+    s->rwstate = SSL_NOTHING;
+    s->s3.tmp.pkey_op_pending = 0;
+    if (ret == 0 || siglen == 0 || siglen > (size_t)sigsize) {
+        OPENSSL_free(sig);
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_R_PRIVATE_KEY_OPERATION_FAILED);
+        return 0;
+    }
+
+    *psig = sig;
+    *psiglen = siglen;
+    return 1;
+}
+
 int tls_construct_cert_verify(SSL *s, WPACKET *pkt)
 {
     EVP_PKEY *pkey = NULL;
@@ -309,69 +366,79 @@ int tls_construct_cert_verify(SSL *s, WPACKET *pkt)
         goto err;
     }
 
-    if (EVP_DigestSignInit_ex(mctx, &pctx,
-                              md == NULL ? NULL : EVP_MD_get0_name(md),
-                              s->ctx->libctx, s->ctx->propq, pkey,
-                              NULL) <= 0) {
-        SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_EVP_LIB);
-        goto err;
-    }
-
-    if (lu->sig == EVP_PKEY_RSA_PSS) {
-        if (EVP_PKEY_CTX_set_rsa_padding(pctx, RSA_PKCS1_PSS_PADDING) <= 0
-            || EVP_PKEY_CTX_set_rsa_pss_saltlen(pctx,
-                                                RSA_PSS_SALTLEN_DIGEST) <= 0) {
-            SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_EVP_LIB);
+    if (s->ctx->private_key_sign_cb != NULL) {
+        if (tls_private_key_sign(s, lu, pkey, hdata, hdatalen,
+                                 &sig, &siglen) <= 0)
+            /* SSLfatal() already called, unless the operation is pending */
             goto err;
-        }
-    }
-    if (s->version == SSL3_VERSION) {
-        /*
-         * Here we use EVP_DigestSignUpdate followed by EVP_DigestSignFinal
-         * in order to add the EVP_CTRL_SSL3_MASTER_SECRET call between them.
-         */
-        if (EVP_DigestSignUpdate(mctx, hdata, hdatalen) <= 0
-            || EVP_MD_CTX_ctrl(mctx, EVP_CTRL_SSL3_MASTER_SECRET,
-                               (int)s->session->master_key_length,
-                               s->session->master_key) <= 0
-            || EVP_DigestSignFinal(mctx, NULL, &siglen) <= 0) {
-
-            SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_EVP_LIB);
-            goto err;
-        }
-        sig = OPENSSL_malloc(siglen);
-        if (sig == NULL
-                || EVP_DigestSignFinal(mctx, sig, &siglen) <= 0) {
-            SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_EVP_LIB);
-            goto err;
-        }
     } else {
-        /*
-         * Here we *must* use EVP_DigestSign() because Ed25519/Ed448 does not
-         * support streaming via EVP_DigestSignUpdate/EVP_DigestSignFinal
-         */
-        if (EVP_DigestSign(mctx, NULL, &siglen, hdata, hdatalen) <= 0) {
+        if (EVP_DigestSignInit_ex(mctx, &pctx,
+                                  md == NULL ? NULL : EVP_MD_get0_name(md),
+                                  s->ctx->libctx, s->ctx->propq, pkey,
+                                  NULL) <= 0) {
             SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_EVP_LIB);
             goto err;
         }
-        sig = OPENSSL_malloc(siglen);
-        if (sig == NULL
-                || EVP_DigestSign(mctx, sig, &siglen, hdata, hdatalen) <= 0) {
-            SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_EVP_LIB);
-            goto err;
+
+        if (lu->sig == EVP_PKEY_RSA_PSS) {
+            if (EVP_PKEY_CTX_set_rsa_padding(pctx, RSA_PKCS1_PSS_PADDING) <= 0
+                || EVP_PKEY_CTX_set_rsa_pss_saltlen(pctx,
+                                                RSA_PSS_SALTLEN_DIGEST) <= 0) {
+                SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_EVP_LIB);
+                goto err;
+            }
+        }
+        if (s->version == SSL3_VERSION) {
+            /*
+             * Here we use EVP_DigestSignUpdate followed by
+             * EVP_DigestSignFinal in order to add the
+             * EVP_CTRL_SSL3_MASTER_SECRET call between them.
+             */
+            if (EVP_DigestSignUpdate(mctx, hdata, hdatalen) <= 0
+                || EVP_MD_CTX_ctrl(mctx, EVP_CTRL_SSL3_MASTER_SECRET,
+                                   (int)s->session->master_key_length,
+                                   s->session->master_key) <= 0
+                || EVP_DigestSignFinal(mctx, NULL, &siglen) <= 0) {
+
+                SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_EVP_LIB);
+                goto err;
+            }
+            sig = OPENSSL_malloc(siglen);
+            if (sig == NULL
+                    || EVP_DigestSignFinal(mctx, sig, &siglen) <= 0) {
+                SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_EVP_LIB);
+                goto err;
+            }
+        } else {
+            /*
+             * Here we *must* use EVP_DigestSign() because Ed25519/Ed448 does
+             * not support streaming via
+             * EVP_DigestSignUpdate/EVP_DigestSignFinal
+             */
+            if (EVP_DigestSign(mctx, NULL, &siglen, hdata, hdatalen) <= 0) {
+                SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_EVP_LIB);
+                goto err;
+            }
+            sig = OPENSSL_malloc(siglen);
+            if (sig == NULL
+                    || EVP_DigestSign(mctx, sig, &siglen,
+                                      hdata, hdatalen) <= 0) {
+                SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_EVP_LIB);
+                goto err;
+            }
         }
-    }
 
 #ifndef OPENSSL_NO_GOST
-    {
-        int pktype = lu->sig;
+        {
+            int pktype = lu->sig;
 
-        if (pktype == NID_id_GostR3410_2001
-            || pktype == NID_id_GostR3410_2012_256
-            || pktype == NID_id_GostR3410_2012_512)
-            BUF_reverse(sig, NULL, siglen);
-    }
+            if (pktype == NID_id_GostR3410_2001
+                || pktype == NID_id_GostR3410_2012_256
+                || pktype == NID_id_GostR3410_2012_512)
+                BUF_reverse(sig, NULL, siglen);
+        }
 #endif
+    }
 
     if (!WPACKET_sub_memcpy_u16(pkt, sig, siglen)) {
         SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
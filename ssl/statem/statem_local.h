@@ -67,6 +67,9 @@ const STACK_OF(X509_NAME) *get_ca_names(SSL *s);
 int construct_ca_names(SSL *s, const STACK_OF(X509_NAME) *ca_sk, WPACKET *pkt);
 size_t construct_key_exchange_tbs(SSL *s, unsigned char **ptbs,
                                   const void *param, size_t paramlen);
+int tls_private_key_sign(SSL *s, const SIGALG_LOOKUP *lu, EVP_PKEY *pkey,
+                         const unsigned char *tbs, size_t tbslen,
+                         unsigned char **psig, size_t *psiglen);
 
 /*
  * TLS/DTLS client state machine functions
@@ -151,6 +154,7 @@ __owur int tls_construct_server_key_exchange(SSL *s, WPACKET *pkt);
 __owur int tls_construct_certificate_request(SSL *s, WPACKET *pkt);
 __owur int tls_construct_server_done(SSL *s, WPACKET *pkt);
 __owur MSG_PROCESS_RETURN tls_process_client_certificate(SSL *s, PACKET *pkt);
+__owur WORK_STATE tls_post_process_client_certificate(SSL *s, WORK_STATE wst);
 __owur MSG_PROCESS_RETURN tls_process_client_key_exchange(SSL *s, PACKET *pkt);
 __owur WORK_STATE tls_post_process_client_key_exchange(SSL *s, WORK_STATE wst);
 __owur MSG_PROCESS_RETURN tls_process_cert_verify(SSL *s, PACKET *pkt);
@@ -174,6 +178,53 @@ typedef enum ext_return_en {
     EXT_RETURN_NOT_SENT
 } EXT_RETURN;
 
+/*
+ * A ClientHello template records the encoding of the parts of a ClientHello
+ * which only depend on the configuration: the ciphersuites and some of the
+ * extensions. The first ClientHello built with a given configuration records
+ * them and puts the template in the SSL_CTX, and later ClientHellos with the
+ * same configuration copy them from there.
+ */
+#define CH_TEMPLATE_CIPHERS     TLSEXT_IDX_num_builtins
+#define CH_TEMPLATE_NUM_PARTS   (TLSEXT_IDX_num_builtins + 1)
+
+typedef struct {
+    /* Set if the part was recorded, a length of zero means "not sent" */
+    int present;
+    size_t off;
+    size_t len;
+} CH_TEMPLATE_PART;
+
+typedef struct ch_template_st {
+    /* The configuration this template was recorded with */
+    const SSL_METHOD *method;
+    const CERT *cert;
+    uint64_t options;
+    uint32_t fallback_scsv;
+    int version;
+    int min_proto_version;
+    int max_proto_version;
+    uint32_t mask;
+    uint16_t *groups;
+    size_t groups_len;
+    unsigned char *formats;
+    size_t formats_len;
+
+    /* Once set the template is read-only and can be shared */
+    int complete;
+    CH_TEMPLATE_PART parts[CH_TEMPLATE_NUM_PARTS];
+    unsigned char *data;
+    size_t data_len;
+
+    CRYPTO_REF_COUNT references;
+    CRYPTO_RWLOCK *lock;
+} CH_TEMPLATE;
+
+void tls_ch_template_start(SSL *s);
+void tls_ch_template_finish(SSL *s);
+__owur int tls_ch_template_put(SSL *s, size_t part, WPACKET *pkt, size_t *len);
+void tls_ch_template_record(SSL *s, size_t part, WPACKET *pkt, size_t start);
+
 __owur int tls_validate_all_contexts(SSL *s, unsigned int thisctx,
                                      RAW_EXTENSION *exts);
 __owur int extension_is_relevant(SSL *s, unsigned int extctx,
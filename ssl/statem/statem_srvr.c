@@ -1235,6 +1235,9 @@ WORK_STATE ossl_statem_server_post_process_message(SSL *s, WORK_STATE wst)
     case TLS_ST_SR_CLNT_HELLO:
         return tls_post_process_client_hello(s, wst);
 
+    case TLS_ST_SR_CERT:
+        return tls_post_process_client_certificate(s, wst);
+
     case TLS_ST_SR_KEY_EXCH:
         return tls_post_process_client_key_exchange(s, wst);
     }
@@ -2077,7 +2080,10 @@ static int tls_handle_status_request(SSL *s)
              * Set current certificate to one we will use so SSL_get_certificate
              * et al can pick it up.
              */
-            s->cert->key = s->s3.tmp.cert;
+            if (!ssl_cert_set_current_pkey(s, s->s3.tmp.cert)) {
+                SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_MALLOC_FAILURE);
+                return 0;
+            }
             ret = s->ctx->ext.status_cb(s, s->ctx->ext.status_arg);
             switch (ret) {
                 /* We don't want to send a status request response */
@@ -2484,12 +2490,14 @@ int tls_construct_server_key_exchange(SSL *s, WPACKET *pkt)
             SSLfatal(s, SSL_AD_HANDSHAKE_FAILURE, SSL_R_DH_KEY_TOO_SMALL);
             goto err;
         }
-        if (s->s3.tmp.pkey != NULL) {
+        /* A pending private key operation is signing the key we have */
+        if (s->s3.tmp.pkey != NULL && !s->s3.tmp.pkey_op_pending) {
             SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
             goto err;
         }
 
-        s->s3.tmp.pkey = ssl_generate_pkey(s, pkdhp);
+        if (s->s3.tmp.pkey == NULL)
+            s->s3.tmp.pkey = ssl_generate_pkey(s, pkdhp);
         if (s->s3.tmp.pkey == NULL) {
             SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
             goto err;
@@ -2511,7 +2519,7 @@ int tls_construct_server_key_exchange(SSL *s, WPACKET *pkt)
         }
     } else if (type & (SSL_kECDHE | SSL_kECDHEPSK)) {
 
-        if (s->s3.tmp.pkey != NULL) {
+        if (s->s3.tmp.pkey != NULL && !s->s3.tmp.pkey_op_pending) {
             SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
             goto err;
         }
@@ -2526,7 +2534,8 @@ int tls_construct_server_key_exchange(SSL *s, WPACKET *pkt)
         /* Cache the group used in the SSL_SESSION */
         s->session->kex_group = curve_id;
         /* Generate a new key for this curve */
-        s->s3.tmp.pkey = ssl_generate_pkey_group(s, curve_id);
+        if (s->s3.tmp.pkey == NULL)
+            s->s3.tmp.pkey = ssl_generate_pkey_group(s, curve_id);
         if (s->s3.tmp.pkey == NULL) {
             /* SSLfatal() already called */
             goto err;
@@ -2677,20 +2686,6 @@ int tls_construct_server_key_exchange(SSL *s, WPACKET *pkt)
             goto err;
         }
 
-        if (EVP_DigestSignInit_ex(md_ctx, &pctx,
-                                  md == NULL ? NULL : EVP_MD_get0_name(md),
-                                  s->ctx->libctx, s->ctx->propq, pkey,
-                                  NULL) <= 0) {
-            SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
-            goto err;
-        }
-        if (lu->sig == EVP_PKEY_RSA_PSS) {
-            if (EVP_PKEY_CTX_set_rsa_padding(pctx, RSA_PKCS1_PSS_PADDING) <= 0
-                || EVP_PKEY_CTX_set_rsa_pss_saltlen(pctx, RSA_PSS_SALTLEN_DIGEST) <= 0) {
-                SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_EVP_LIB);
-                goto err;
-            }
-        }
         tbslen = construct_key_exchange_tbs(s, &tbs,
                                             s->init_buf->data + paramoffset,
                                             paramlen);
@@ -2699,16 +2694,53 @@ int tls_construct_server_key_exchange(SSL *s, WPACKET *pkt)
             goto err;
         }
 
-        if (EVP_DigestSign(md_ctx, NULL, &siglen, tbs, tbslen) <=0
-                || !WPACKET_sub_reserve_bytes_u16(pkt, siglen, &sigbytes1)
-                || EVP_DigestSign(md_ctx, sigbytes1, &siglen, tbs, tbslen) <= 0
-                || !WPACKET_sub_allocate_bytes_u16(pkt, siglen, &sigbytes2)
-                || sigbytes1 != sigbytes2) {
+        if (s->ctx->private_key_sign_cb != NULL) {
+            unsigned char *sig = NULL;
+            int rv;
+
+            rv = tls_private_key_sign(s, lu, pkey, tbs, tbslen, &sig, &siglen);
+            OPENSSL_free(tbs);
+            if (rv <= 0) {
+                /* SSLfatal() already called, unless the operation is pending */
+                goto err;
+            }
+            rv = WPACKET_sub_memcpy_u16(pkt, sig, siglen);
+            OPENSSL_free(sig);
+            if (!rv) {
+                SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
+                goto err;
+            }
+        } else {
+            if (EVP_DigestSignInit_ex(md_ctx, &pctx,
+                                      md == NULL ? NULL : EVP_MD_get0_name(md),
+                                      s->ctx->libctx, s->ctx->propq, pkey,
+                                      NULL) <= 0) {
+                OPENSSL_free(tbs);
+                SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
+                goto err;
+            }
+            if (lu->sig == EVP_PKEY_RSA_PSS) {
+                if (EVP_PKEY_CTX_set_rsa_padding(pctx,
+                                                 RSA_PKCS1_PSS_PADDING) <= 0
+                    || EVP_PKEY_CTX_set_rsa_pss_saltlen(pctx,
+                                                RSA_PSS_SALTLEN_DIGEST) <= 0) {
+                    OPENSSL_free(tbs);
+                    SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_EVP_LIB);
+                    goto err;
+                }
+            }
+            if (EVP_DigestSign(md_ctx, NULL, &siglen, tbs, tbslen) <= 0
+                    || !WPACKET_sub_reserve_bytes_u16(pkt, siglen, &sigbytes1)
+                    || EVP_DigestSign(md_ctx, sigbytes1, &siglen,
+                                      tbs, tbslen) <= 0
+                    || !WPACKET_sub_allocate_bytes_u16(pkt, siglen, &sigbytes2)
+                    || sigbytes1 != sigbytes2) {
+                OPENSSL_free(tbs);
+                SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
+                goto err;
+            }
             OPENSSL_free(tbs);
-            SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
-            goto err;
         }
-        OPENSSL_free(tbs);
     }
 
     ret = 1;
@@ -3411,7 +3443,6 @@ WORK_STATE tls_post_process_client_key_exchange(SSL *s, WORK_STATE wst)
 
 MSG_PROCESS_RETURN tls_process_client_certificate(SSL *s, PACKET *pkt)
 {
-    int i;
     MSG_PROCESS_RETURN ret = MSG_PROCESS_ERROR;
     X509 *x = NULL;
     unsigned long l;
@@ -3516,24 +3547,6 @@ MSG_PROCESS_RETURN tls_process_client_certificate(SSL *s, PACKET *pkt)
             /* SSLfatal() already called */
             goto err;
         }
-    } else {
-        EVP_PKEY *pkey;
-        i = ssl_verify_cert_chain(s, sk);
-        if (i <= 0) {
-            SSLfatal(s, ssl_x509err2alert(s->verify_result),
-                     SSL_R_CERTIFICATE_VERIFY_FAILED);
-            goto err;
-        }
-        if (i > 1) {
-            SSLfatal(s, SSL_AD_HANDSHAKE_FAILURE, i);
-            goto err;
-        }
-        pkey = X509_get0_pubkey(sk_X509_value(sk, 0));
-        if (pkey == NULL) {
-            SSLfatal(s, SSL_AD_HANDSHAKE_FAILURE,
-                     SSL_R_UNKNOWN_CERTIFICATE_TYPE);
-            goto err;
-        }
     }
 
     /*
@@ -3554,12 +3567,62 @@ MSG_PROCESS_RETURN tls_process_client_certificate(SSL *s, PACKET *pkt)
         s->session = new_sess;
     }
 
+    /*
+     * Keep the whole chain until it has been verified in
+     * tls_post_process_client_certificate(), which may need to be retried.
+     */
     X509_free(s->session->peer);
-    s->session->peer = sk_X509_shift(sk);
-    s->session->verify_result = s->verify_result;
-
+    s->session->peer = NULL;
     sk_X509_pop_free(s->session->peer_chain, X509_free);
     s->session->peer_chain = sk;
+    sk = NULL;
+
+    ret = MSG_PROCESS_CONTINUE_PROCESSING;
+
+ err:
+    X509_free(x);
+    sk_X509_pop_free(sk, X509_free);
+    return ret;
+}
+
+/*
+ * Verify the s->session->peer_chain received from the client, if any.
+ * On success set s->session->peer and s->session->verify_result.
+ * Else the peer certificate verification callback may request retry.
+ */
+WORK_STATE tls_post_process_client_certificate(SSL *s, WORK_STATE wst)
+{
+    STACK_OF(X509) *sk = s->session->peer_chain;
+    int i;
+
+    if (sk_X509_num(sk) > 0) {
+        i = ssl_verify_cert_chain(s, sk);
+        if (i == -1) {
+            s->rwstate = SSL_RETRY_VERIFY;
+            return WORK_MORE_A;
+        }
+        if (i <= 0) {
+            SSLfatal(s, ssl_x509err2alert(s->verify_result),
+                     SSL_R_CERTIFICATE_VERIFY_FAILED);
+            return WORK_ERROR;
+        }
+        if (i > 1) {
+            SSLfatal(s, SSL_AD_HANDSHAKE_FAILURE, i);
+            return WORK_ERROR;
+        }
+        if (X509_get0_pubkey(sk_X509_value(sk, 0)) == NULL) {
+            SSLfatal(s, SSL_AD_HANDSHAKE_FAILURE,
+                     SSL_R_UNKNOWN_CERTIFICATE_TYPE);
+            return WORK_ERROR;
+        }
+
+        /*
+         * Inconsistency alert: cert_chain does *not* include the peer's own
+         * certificate, while we do include it in statem_clnt.c
+         */
+        s->session->peer = sk_X509_shift(sk);
+    }
+    s->session->verify_result = s->verify_result;
 
     /*
      * Freeze the handshake buffer. For <TLS1.3 we do this after the CKE
@@ -3567,34 +3630,23 @@ MSG_PROCESS_RETURN tls_process_client_certificate(SSL *s, PACKET *pkt)
      */
     if (SSL_IS_TLS13(s) && !ssl3_digest_cached_records(s, 1)) {
         /* SSLfatal() already called */
-        goto err;
+        return WORK_ERROR;
     }
 
-    /*
-     * Inconsistency alert: cert_chain does *not* include the peer's own
-     * certificate, while we do include it in statem_clnt.c
-     */
-    sk = NULL;
-
     /* Save the current hash state for when we receive the CertificateVerify */
     if (SSL_IS_TLS13(s)) {
         if (!ssl_handshake_hash(s, s->cert_verify_hash,
                                 sizeof(s->cert_verify_hash),
                                 &s->cert_verify_hash_len)) {
             /* SSLfatal() already called */
-            goto err;
+            return WORK_ERROR;
         }
 
         /* Resend session tickets */
         s->sent_tickets = 0;
     }
 
-    ret = MSG_PROCESS_CONTINUE_READING;
-
- err:
-    X509_free(x);
-    sk_X509_pop_free(sk, X509_free);
-    return ret;
+    return WORK_FINISHED_CONTINUE;
 }
 
 int tls_construct_server_certificate(SSL *s, WPACKET *pkt)
@@ -20,6 +20,7 @@
 #include <openssl/bn.h>
 #include <openssl/provider.h>
 #include <openssl/param_build.h>
+#include "internal/cryptlib.h"
 #include "internal/nelem.h"
 #include "internal/sizes.h"
 #include "internal/tlsgroups.h"
@@ -28,6 +29,7 @@
 
 static const SIGALG_LOOKUP *find_sig_alg(SSL *s, X509 *x, EVP_PKEY *pkey);
 static int tls12_sigalg_allowed(const SSL *s, int op, const SIGALG_LOOKUP *lu);
+static int sigalg_security_bits(SSL_CTX *ctx, const SIGALG_LOOKUP *lu);
 
 SSL3_ENC_METHOD const TLSv1_enc_data = {
     tls1_enc,
@@ -387,11 +389,21 @@ static int discover_provider_groups(OSSL_PROVIDER *provider, void *vctx)
 int ssl_load_groups(SSL_CTX *ctx)
 {
     size_t i, j, num_deflt_grps = 0;
+    int level;
     uint16_t tmp_supp_groups[OSSL_NELEM(supported_groups_default)];
 
     if (!OSSL_PROVIDER_do_all(ctx->libctx, discover_provider_groups, ctx))
         return 0;
 
+    if (ctx->group_list_len <= 64) {
+        for (i = 0; i < ctx->group_list_len; i++) {
+            for (level = 0; level <= SSL_MAX_SECURITY_LEVEL; level++)
+                if (ssl_security_level_allows(level,
+                                              ctx->group_list[i].secbits))
+                    ctx->group_secmask[level] |= (uint64_t)1 << i;
+        }
+    }
+
     for (i = 0; i < OSSL_NELEM(supported_groups_default); i++) {
         for (j = 0; j < ctx->group_list_len; j++) {
             if (ctx->group_list[j].group_id == supported_groups_default[i]) {
@@ -561,15 +573,35 @@ int tls_valid_group(SSL *s, uint16_t group_id, int minversion, int maxversion,
     return ret;
 }
 
+/*
+ * The bitmap over the group_list of the SSL_CTX of |s| of the groups allowed
+ * by the default security callback, for use if |s| has that callback.
+ * Returns 0 if there is no such bitmap.
+ */
+static int tls1_group_secmask(SSL *s, uint64_t *mask)
+{
+    int level;
+
+    if (s->ctx->group_list_len > 64 || !ssl_security_is_default(s))
+        return 0;
+    ssl_get_security_level_bits(s, NULL, &level);
+    *mask = s->ctx->group_secmask[level];
+    return 1;
+}
+
 /* See if group is allowed by security callback */
 int tls_group_allowed(SSL *s, uint16_t group, int op)
 {
     const TLS_GROUP_INFO *ginfo = tls1_group_id_lookup(s->ctx, group);
     unsigned char gtmp[2];
+    uint64_t mask;
 
     if (ginfo == NULL)
         return 0;
 
+    if (tls1_group_secmask(s, &mask))
+        return (mask >> (ginfo - s->ctx->group_list)) & 1;
+
     gtmp[0] = group >> 8;
     gtmp[1] = group & 0xff;
     return ssl_security(s, op, ginfo->secbits,
@@ -1113,6 +1145,11 @@ static const SIGALG_LOOKUP sigalg_lookup_tbl[] = {
      NID_undef, NID_undef, 1}
 #endif
 };
+
+/* Slot of |sigalg| in sigalg_lookup_hash, before any probing */
+#define SIGALG_HASH(sigalg) \
+    ((((sigalg) >> 8) * 9 + ((sigalg) & 0xff)) % SSL_SIGALG_HASH_SIZE)
+
 /* Legacy sigalgs for TLS < 1.2 RSA TLS signatures */
 static const SIGALG_LOOKUP legacy_rsa_sigalg = {
     "rsa_pkcs1_md5_sha1", 0,
@@ -1139,14 +1176,19 @@ static const uint16_t tls_default_sigalg[] = {
 
 int ssl_setup_sig_algs(SSL_CTX *ctx)
 {
-    size_t i;
+    size_t i, h;
     const SIGALG_LOOKUP *lu;
     SIGALG_LOOKUP *cache
         = OPENSSL_malloc(sizeof(*lu) * OSSL_NELEM(sigalg_lookup_tbl));
     EVP_PKEY *tmpkey = EVP_PKEY_new();
-    int ret = 0;
+    int ret = 0, level;
 
-    if (cache == NULL || tmpkey == NULL)
+    /*
+     * The cache must fit into the bitmaps in sigalg_secmask, and must leave
+     * free slots in sigalg_lookup_hash.
+     */
+    if (!ossl_assert(OSSL_NELEM(sigalg_lookup_tbl) < SSL_SIGALG_HASH_SIZE)
+            || cache == NULL || tmpkey == NULL)
         goto err;
 
     ERR_set_mark();
@@ -1181,6 +1223,21 @@ int ssl_setup_sig_algs(SSL_CTX *ctx)
         EVP_PKEY_CTX_free(pctx);
     }
     ERR_pop_to_mark();
+
+    for (i = 0; i < OSSL_NELEM(sigalg_lookup_tbl); i++) {
+        int secbits = sigalg_security_bits(ctx, &cache[i]);
+
+        /* Earlier entries for the same code point take precedence */
+        for (h = SIGALG_HASH(cache[i].sigalg); ctx->sigalg_lookup_hash[h] != 0;
+             h = (h + 1) % SSL_SIGALG_HASH_SIZE)
+            continue;
+        ctx->sigalg_lookup_hash[h] = (unsigned char)(i + 1);
+
+        for (level = 0; level <= SSL_MAX_SECURITY_LEVEL; level++)
+            if (ssl_security_level_allows(level, secbits))
+                ctx->sigalg_secmask[level] |= (uint64_t)1 << i;
+    }
+
     ctx->sigalg_lookup_cache = cache;
     cache = NULL;
 
@@ -1194,13 +1251,14 @@ int ssl_setup_sig_algs(SSL_CTX *ctx)
 /* Lookup TLS signature algorithm */
 static const SIGALG_LOOKUP *tls1_lookup_sigalg(const SSL *s, uint16_t sigalg)
 {
-    size_t i;
+    const SSL_CTX *ctx = s->ctx;
     const SIGALG_LOOKUP *lu;
+    size_t h;
 
-    for (i = 0, lu = s->ctx->sigalg_lookup_cache;
-         /* cache should have the same number of elements as sigalg_lookup_tbl */
-         i < OSSL_NELEM(sigalg_lookup_tbl);
-         lu++, i++) {
+    /* An open addressing hash table over the cache, see ssl_setup_sig_algs() */
+    for (h = SIGALG_HASH(sigalg); ctx->sigalg_lookup_hash[h] != 0;
+         h = (h + 1) % SSL_SIGALG_HASH_SIZE) {
+        lu = &ctx->sigalg_lookup_cache[ctx->sigalg_lookup_hash[h] - 1];
         if (lu->sigalg == sigalg) {
             if (!lu->enabled)
                 return NULL;
@@ -1209,6 +1267,18 @@ static const SIGALG_LOOKUP *tls1_lookup_sigalg(const SSL *s, uint16_t sigalg)
     }
     return NULL;
 }
+
+/*
+ * The bit of |lu| in the sigalg bitmaps of the SSL_CTX, which exists for the
+ * entries of sigalg_lookup_cache only.
+ */
+static uint64_t tls1_sigalg_bit(const SSL *s, const SIGALG_LOOKUP *lu)
+{
+    if (lu == &legacy_rsa_sigalg)
+        return 0;
+    return (uint64_t)1 << (lu - s->ctx->sigalg_lookup_cache);
+}
+
 /* Lookup hash: return 0 if invalid or not enabled */
 int tls1_lookup_md(SSL_CTX *ctx, const SIGALG_LOOKUP *lu, const EVP_MD **pmd)
 {
@@ -2037,6 +2107,7 @@ static int tls12_sigalg_allowed(const SSL *s, int op, const SIGALG_LOOKUP *lu)
 {
     unsigned char sigalgstr[2];
     int secbits;
+    uint64_t bit;
 
     if (lu == NULL || !lu->enabled)
         return 0;
@@ -2097,6 +2168,12 @@ static int tls12_sigalg_allowed(const SSL *s, int op, const SIGALG_LOOKUP *lu)
     }
 
     /* Finally see if security callback allows it */
+    if (ssl_security_is_default(s) && (bit = tls1_sigalg_bit(s, lu)) != 0) {
+        int level;
+
+        ssl_get_security_level_bits(s, NULL, &level);
+        return (s->ctx->sigalg_secmask[level] & bit) != 0;
+    }
     secbits = sigalg_security_bits(s->ctx, lu);
     sigalgstr[0] = (lu->sigalg >> 8) & 0xff;
     sigalgstr[1] = lu->sigalg & 0xff;
@@ -2173,22 +2250,30 @@ static size_t tls12_shared_sigalgs(SSL *s, const SIGALG_LOOKUP **shsig,
                                    const uint16_t *allow, size_t allowlen)
 {
     const uint16_t *ptmp, *atmp;
-    size_t i, j, nmatch = 0;
+    const SIGALG_LOOKUP *lu;
+    size_t i, nmatch = 0;
+    uint64_t allowmask = 0;
+
+    /*
+     * Only known and enabled sigalgs can be shared, so the allowed ones can
+     * be reduced to a bitmap over the sigalg_lookup_cache first.
+     */
+    for (i = 0, atmp = allow; i < allowlen; i++, atmp++) {
+        if ((lu = tls1_lookup_sigalg(s, *atmp)) != NULL)
+            allowmask |= tls1_sigalg_bit(s, lu);
+    }
+
     for (i = 0, ptmp = pref; i < preflen; i++, ptmp++) {
-        const SIGALG_LOOKUP *lu = tls1_lookup_sigalg(s, *ptmp);
+        lu = tls1_lookup_sigalg(s, *ptmp);
 
         /* Skip disabled hashes or signature algorithms */
         if (lu == NULL
+                || (allowmask & tls1_sigalg_bit(s, lu)) == 0
                 || !tls12_sigalg_allowed(s, SSL_SECOP_SIGALG_SHARED, lu))
             continue;
-        for (j = 0, atmp = allow; j < allowlen; j++, atmp++) {
-            if (*ptmp == *atmp) {
-                nmatch++;
-                if (shsig)
-                    *shsig++ = lu;
-                break;
-            }
-        }
+        nmatch++;
+        if (shsig)
+            *shsig++ = lu;
     }
     return nmatch;
 }
@@ -3334,8 +3419,12 @@ int tls_choose_sigalg(SSL *s, int fatalerrs)
     }
     if (sig_idx == -1)
         sig_idx = lu->sig_idx;
-    s->s3.tmp.cert = &s->cert->pkeys[sig_idx];
-    s->cert->key = s->s3.tmp.cert;
+    if (!ssl_cert_set_current_pkey(s, &s->cert->pkeys[sig_idx])) {
+        if (fatalerrs)
+            SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    s->s3.tmp.cert = s->cert->key;
     s->s3.tmp.sigalg = lu;
     return 1;
 }
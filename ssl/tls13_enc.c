@@ -444,6 +444,39 @@ static int derive_secret_key_and_iv(SSL *s, int sending, const EVP_MD *md,
     return 1;
 }
 
+#if !defined(OPENSSL_NO_KTLS) && defined(OPENSSL_KTLS_TLS13)
+/*
+ * Pass the traffic keys of one direction to the kernel, both when they are
+ * first installed and after a KeyUpdate.  Returns 1 if the kernel accepted
+ * them, or 0 otherwise.
+ */
+static int tls13_ktls_set_keys(SSL *s, int sending, const EVP_CIPHER *cipher,
+                               EVP_CIPHER_CTX *ciph_ctx, unsigned char *iv,
+                               unsigned char *key)
+{
+    ktls_crypto_info_t crypto_info;
+    BIO *bio;
+    void *rl_sequence;
+    int ret;
+
+    if (sending) {
+        bio = s->wbio;
+        rl_sequence = RECORD_LAYER_get_write_sequence(&s->rlayer);
+    } else {
+        bio = s->rbio;
+        rl_sequence = RECORD_LAYER_get_read_sequence(&s->rlayer);
+    }
+
+    if (!ktls_configure_crypto(s, cipher, ciph_ctx, rl_sequence, &crypto_info,
+                               NULL, iv, key, NULL, 0))
+        return 0;
+
+    ret = BIO_set_ktls(bio, &crypto_info, sending) > 0;
+    OPENSSL_cleanse(&crypto_info, sizeof(crypto_info));
+    return ret;
+}
+#endif
+
 int tls13_change_cipher_state(SSL *s, int which)
 {
 #ifdef CHARSET_EBCDIC
@@ -481,7 +514,6 @@ int tls13_change_cipher_state(SSL *s, int which)
     const EVP_MD *md = NULL;
     const EVP_CIPHER *cipher = NULL;
 #if !defined(OPENSSL_NO_KTLS) && defined(OPENSSL_KTLS_TLS13)
-    ktls_crypto_info_t crypto_info;
     BIO *bio;
 #endif
 
@@ -736,8 +768,7 @@ int tls13_change_cipher_state(SSL *s, int which)
         s->statem.enc_write_state = ENC_WRITE_STATE_VALID;
 #ifndef OPENSSL_NO_KTLS
 # if defined(OPENSSL_KTLS_TLS13)
-    if (!(which & SSL3_CC_WRITE)
-            || !(which & SSL3_CC_APPLICATION)
+    if (!(which & SSL3_CC_APPLICATION)
             || (s->options & SSL_OP_ENABLE_KTLS) == 0)
         goto skip_ktls;
 
@@ -746,32 +777,53 @@ int tls13_change_cipher_state(SSL *s, int which)
         goto skip_ktls;
 
     /* ktls does not support record padding */
-    if (s->record_padding_cb != NULL)
+    if ((which & SSL3_CC_WRITE) && s->record_padding_cb != NULL)
         goto skip_ktls;
 
     /* check that cipher is supported */
     if (!ktls_check_supported_cipher(s, cipher, ciph_ctx))
         goto skip_ktls;
 
-    bio = s->wbio;
+    bio = (which & SSL3_CC_WRITE) ? s->wbio : s->rbio;
 
     if (!ossl_assert(bio != NULL)) {
         SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
         goto err;
     }
 
-    /* All future data will get encrypted by ktls. Flush the BIO or skip ktls */
-    if (BIO_flush(bio) <= 0)
+    if (which & SSL3_CC_WRITE) {
+        /*
+         * All future data will get encrypted by ktls. Flush the BIO or skip
+         * ktls
+         */
+        if (BIO_flush(bio) <= 0)
+            goto skip_ktls;
+    } else {
+# ifdef OPENSSL_NO_KTLS_RX
         goto skip_ktls;
+# else
+        /*
+         * Records that were read ahead are protected with the new keys, and
+         * the kernel would start with the wrong sequence number
+         */
+        if (RECORD_LAYER_read_pending(&s->rlayer))
+            goto skip_ktls;
+        /*
+         * Once the kernel decrypts the records, a KeyUpdate from the peer
+         * can only be handled if the kernel takes new keys.  Otherwise keep
+         * receiving in user space.
+         */
+        if (!ktls_tls13_key_update_supported())
+            goto skip_ktls;
+# endif
+    }
 
-    /* configure kernel crypto structure */
-    if (!ktls_configure_crypto(s, cipher, ciph_ctx,
-                               RECORD_LAYER_get_write_sequence(&s->rlayer),
-                               &crypto_info, NULL, iv, key, NULL, 0))
+    if (!tls13_ktls_set_keys(s, which & SSL3_CC_WRITE, cipher, ciph_ctx, iv,
+                             key))
         goto skip_ktls;
 
     /* ktls works with user provided buffers directly */
-    if (BIO_set_ktls(bio, &crypto_info, which & SSL3_CC_WRITE))
+    if (which & SSL3_CC_WRITE)
         ssl3_release_write_buffer(s);
 skip_ktls:
 # endif
@@ -829,6 +881,21 @@ int tls13_update_key(SSL *s, int sending)
 
     memcpy(insecret, secret, hashlen);
 
+#if !defined(OPENSSL_NO_KTLS) && defined(OPENSSL_KTLS_TLS13)
+    /*
+     * If the kernel handles this direction it must switch to the new keys,
+     * there is no way back to encrypting or decrypting the records ourselves.
+     * Receiving is only offloaded if the kernel supports this, but sending
+     * might be with an older kernel.
+     */
+    if ((sending ? BIO_get_ktls_send(s->wbio) : BIO_get_ktls_recv(s->rbio))
+            && !tls13_ktls_set_keys(s, sending, s->s3.tmp.new_sym_enc,
+                                    ciph_ctx, iv, key)) {
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, ERR_R_INTERNAL_ERROR);
+        goto err;
+    }
+#endif
+
     s->statem.enc_write_state = ENC_WRITE_STATE_VALID;
     ret = 1;
  err:
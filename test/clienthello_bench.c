@@ -0,0 +1,139 @@
+/*
+ * Copyright 2021 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * ClientHello construction microbenchmark.
+ *
+ * A client SSL is created for every iteration and SSL_connect() is called on
+ * it once, which builds the ClientHello (key share generation included) and
+ * writes it to one half of a memory BIO pair.  The other half is drained and
+ * the SSL freed again.  Only SSL_connect() is timed.  With -custom-seccb a
+ * security callback that defers to the default one is installed, which
+ * disables the SSL_CTX's ClientHello template and so shows what it saves.
+ */
+
+#include <openssl/ssl.h>
+#include "testutil.h"
+#include "helpers/bench.h"
+
+#define CONNECT_COUNT   "1000"
+
+static ossl_intmax_t connect_count;
+static int custom_seccb = 0;
+static int (*default_seccb)(const SSL *s, const SSL_CTX *ctx, int op,
+                            int bits, int nid, void *other, void *ex);
+
+static int passthrough_seccb(const SSL *s, const SSL_CTX *ctx, int op,
+                             int bits, int nid, void *other, void *ex)
+{
+    return default_seccb(s, ctx, op, bits, nid, other, ex);
+}
+
+static int test_clienthello_construction(void)
+{
+    SSL_CTX *ctx = NULL;
+    SSL *s = NULL;
+    BIO *client = NULL, *peer = NULL;
+    unsigned char buf[4096];
+    size_t chlen = 0;
+    ossl_intmax_t i;
+    double start, elapsed = 0;
+    int ret, n, testresult = 0;
+
+    if (!TEST_ptr(ctx = SSL_CTX_new(TLS_client_method()))
+            || !TEST_true(BIO_new_bio_pair(&client, 0, &peer, 0)))
+        goto end;
+
+    if (custom_seccb) {
+        default_seccb = SSL_CTX_get_security_callback(ctx);
+        SSL_CTX_set_security_callback(ctx, passthrough_seccb);
+    }
+
+    for (i = 0; i < connect_count; i++) {
+        if (!TEST_ptr(s = SSL_new(ctx))
+                || !TEST_true(BIO_up_ref(client)))
+            goto end;
+        SSL_set_bio(s, client, client);
+
+        start = bench_time();
+        ret = SSL_connect(s);
+        elapsed += bench_time() - start;
+
+        if (!TEST_int_le(ret, 0)
+                || !TEST_int_eq(SSL_get_error(s, ret), SSL_ERROR_WANT_READ))
+            goto end;
+
+        chlen = 0;
+        while ((n = BIO_read(peer, buf, sizeof(buf))) > 0)
+            chlen += n;
+        if (!TEST_size_t_gt(chlen, 0))
+            goto end;
+
+        SSL_free(s);
+        s = NULL;
+    }
+
+    TEST_info("%12.0f ClientHellos/s, %zu bytes each",
+              elapsed > 0 ? connect_count / elapsed : 0, chlen);
+    testresult = 1;
+ end:
+    SSL_free(s);
+    BIO_free(client);
+    BIO_free(peer);
+    SSL_CTX_free(ctx);
+    return testresult;
+}
+
+typedef enum OPTION_choice {
+    OPT_ERR = -1,
+    OPT_EOF = 0,
+    OPT_COUNT,
+    OPT_CUSTOM_SECCB,
+    OPT_TEST_ENUM
+} OPTION_CHOICE;
+
+const OPTIONS *test_get_options(void)
+{
+    static const OPTIONS test_options[] = {
+        OPT_TEST_OPTIONS_DEFAULT_USAGE,
+        { "count", OPT_COUNT, 'M', "Number of ClientHellos to construct" },
+        { "custom-seccb", OPT_CUSTOM_SECCB, '-',
+          "Install a pass-through security callback (disables the template)" },
+        { NULL }
+    };
+    return test_options;
+}
+
+int setup_tests(void)
+{
+    OPTION_CHOICE o;
+
+    if (!opt_intmax(CONNECT_COUNT, &connect_count))
+        return 0;
+
+    while ((o = opt_next()) != OPT_EOF) {
+        switch (o) {
+        case OPT_COUNT:
+            if (!opt_intmax(opt_arg(), &connect_count) || connect_count < 1)
+                return 0;
+            break;
+        case OPT_CUSTOM_SECCB:
+            custom_seccb = 1;
+            break;
+        case OPT_TEST_CASES:
+            break;
+        default:
+        case OPT_ERR:
+            return 0;
+        }
+    }
+
+    ADD_TEST(test_clienthello_construction);
+    return 1;
+}
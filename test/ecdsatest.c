@@ -22,6 +22,7 @@
 # include <openssl/bn.h>
 # include <openssl/ec.h>
 # include <openssl/rand.h>
+# include <openssl/core_names.h>
 # include "internal/nelem.h"
 # include "ecdsatest.h"
 
@@ -335,6 +336,100 @@ static int test_builtin(int n, int as)
     return ret;
 }
 
+/*
+ * Verify a batch of signatures repeatedly with one key, so that multiples
+ * of the public key are precomputed, and again with that disabled.
+ */
+static const char *pub_precomp_curves[] = {
+    "brainpoolP256r1", "brainpoolP384r1", "secp256k1"
+};
+
+static int get_pub_precomp_size(EVP_PKEY *pkey, size_t *size)
+{
+    return EVP_PKEY_get_size_t_param(pkey, OSSL_PKEY_PARAM_EC_PUB_PRECOMP_SIZE,
+                                     size);
+}
+
+static int verify_batch(EVP_PKEY *pkey, unsigned char sigs[][256],
+                        size_t *sig_lens, unsigned char tbs[][32], size_t n)
+{
+    EVP_MD_CTX *mctx = NULL;
+    size_t i;
+    int ret = 0;
+
+    for (i = 0; i < n; i++) {
+        if (!TEST_ptr(mctx = EVP_MD_CTX_new())
+            || !TEST_true(EVP_DigestVerifyInit(mctx, NULL, EVP_sha256(), NULL,
+                                               pkey))
+            || !TEST_int_eq(EVP_DigestVerify(mctx, sigs[i], sig_lens[i],
+                                             tbs[i], sizeof(tbs[i])), 1))
+            goto err;
+        EVP_MD_CTX_free(mctx);
+        /* each signature must fail for the next message */
+        if (!TEST_ptr(mctx = EVP_MD_CTX_new())
+            || !TEST_true(EVP_DigestVerifyInit(mctx, NULL, EVP_sha256(), NULL,
+                                               pkey))
+            || !TEST_int_eq(EVP_DigestVerify(mctx, sigs[i], sig_lens[i],
+                                             tbs[(i + 1) % n],
+                                             sizeof(tbs[i])), 0))
+            goto err;
+        EVP_MD_CTX_free(mctx);
+        mctx = NULL;
+    }
+    ret = 1;
+ err:
+    EVP_MD_CTX_free(mctx);
+    return ret;
+}
+
+static int test_pub_precomp(int n)
+{
+    unsigned char tbs[8][32], sigs[8][256];
+    size_t sig_lens[8], size = 0, i;
+    EVP_PKEY *pkey = NULL;
+    EVP_MD_CTX *mctx = NULL;
+    OSSL_PARAM params[2];
+    int off = 0, ret = 0;
+
+    if (!TEST_ptr(pkey = EVP_PKEY_Q_keygen(NULL, NULL, "EC",
+                                           pub_precomp_curves[n])))
+        goto err;
+
+    for (i = 0; i < OSSL_NELEM(tbs); i++) {
+        sig_lens[i] = sizeof(sigs[i]);
+        if (!TEST_true(RAND_bytes(tbs[i], sizeof(tbs[i])))
+            || !TEST_ptr(mctx = EVP_MD_CTX_new())
+            || !TEST_true(EVP_DigestSignInit(mctx, NULL, EVP_sha256(), NULL,
+                                             pkey))
+            || !TEST_true(EVP_DigestSign(mctx, sigs[i], &sig_lens[i], tbs[i],
+                                         sizeof(tbs[i]))))
+            goto err;
+        EVP_MD_CTX_free(mctx);
+        mctx = NULL;
+    }
+
+    if (!verify_batch(pkey, sigs, sig_lens, tbs, OSSL_NELEM(tbs))
+        || !TEST_true(get_pub_precomp_size(pkey, &size))
+        || !TEST_size_t_gt(size, 0))
+        goto err;
+
+    params[0] = OSSL_PARAM_construct_int(OSSL_PKEY_PARAM_EC_PUB_PRECOMP, &off);
+    params[1] = OSSL_PARAM_construct_end();
+    if (!TEST_true(EVP_PKEY_set_params(pkey, params))
+        || !TEST_true(get_pub_precomp_size(pkey, &size))
+        || !TEST_size_t_eq(size, 0)
+        || !verify_batch(pkey, sigs, sig_lens, tbs, OSSL_NELEM(tbs))
+        || !TEST_true(get_pub_precomp_size(pkey, &size))
+        || !TEST_size_t_eq(size, 0))
+        goto err;
+
+    ret = 1;
+ err:
+    EVP_MD_CTX_free(mctx);
+    EVP_PKEY_free(pkey);
+    return ret;
+}
+
 static int test_builtin_as_ec(int n)
 {
     return test_builtin(n, EVP_PKEY_EC);
@@ -369,6 +464,7 @@ int setup_tests(void)
     ADD_ALL_TESTS(test_builtin_as_sm2, crv_len);
 # endif
     ADD_ALL_TESTS(x9_62_tests, OSSL_NELEM(ecdsa_cavs_kats));
+    ADD_ALL_TESTS(test_pub_precomp, OSSL_NELEM(pub_precomp_curves));
 #endif
     return 1;
 }
@@ -1266,6 +1266,38 @@ static const struct nistp_test_params nistp_tests_params[] = {
      /* d */
      "c477f9f65c22cce20657faa5b2d1d8122336f851a508a1ed04e479c34985bf96",
      },
+    {
+     /* P-384 */
+     NID_secp384r1,
+     384,
+     /* p */
+     "fffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffe"
+     "ffffffff0000000000000000ffffffff",
+     /* a */
+     "fffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffe"
+     "ffffffff0000000000000000fffffffc",
+     /* b */
+     "b3312fa7e23ee7e4988e056be3f82d19181d9c6efe8141120314088f5013875a"
+     "c656398d8a2ed19d2a85c8edd3ec2aef",
+     /* Qx */
+     "1fbac8eebd0cbf35640b39efe0808dd774debff20a2a329e91713baf7d7f3c3e"
+     "81546d883730bee7e48678f857b02ca0",
+     /* Qy */
+     "eb213103bd68ce343365a8a4c3d4555fa385f5330203bdd76ffad1f3affb9575"
+     "1c132007e1b240353cb0a4cf1693bdf9",
+     /* Gx */
+     "aa87ca22be8b05378eb1c71ef320ad746e1d3b628ba79b9859f741e082542a38"
+     "5502f25dbf55296c3a545e3872760ab7",
+     /* Gy */
+     "3617de4a96262c6f5d9e98bf9292dc29f8f41dbd289a147ce9da3113b5f0b8c0"
+     "0a60b1ce1d7e819d7a431d7c90ea0e5f",
+     /* order */
+     "ffffffffffffffffffffffffffffffffffffffffffffffffc7634d81f4372ddf"
+     "581a0db248b0a77aecec196accc52973",
+     /* d */
+     "c838b85253ef8dc7394fa5808a5183981c7deef5a69ba8f4f2117ffea39cfcd9"
+     "0e95f6cbc854abacab701d50c1f3cf24",
+     },
     {
      /* P-521 */
      NID_secp521r1,
@@ -3367,6 +3367,455 @@ static int test_gcm_reinit(int idx)
     return testresult;
 }
 
+#ifndef OPENSSL_NO_EC
+# define BATCH_NUM 70
+
+/*
+ * Test EVP_DigestVerify_batch() with more signatures than are combined into
+ * one batch by the Ed25519 implementation.  Ed448 has no batch verification
+ * and is verified one by one.
+ */
+static int test_EVP_DigestVerify_batch(int idx)
+{
+    const char *keytype = idx == 0 ? "ED25519" : "ED448";
+    EVP_PKEY *pkeys[BATCH_NUM] = { NULL };
+    unsigned char msgs[BATCH_NUM][BATCH_NUM];
+    unsigned char sigbufs[BATCH_NUM][114];
+    const unsigned char *tbs[BATCH_NUM], *sigs[BATCH_NUM];
+    size_t tbslens[BATCH_NUM], siglens[BATCH_NUM];
+    int results[BATCH_NUM];
+    EVP_MD_CTX *mctx = NULL;
+    size_t i;
+    int testresult = 0;
+
+    if (!TEST_ptr(mctx = EVP_MD_CTX_new()))
+        goto err;
+    for (i = 0; i < BATCH_NUM; i++) {
+        memset(msgs[i], (int)i, i);
+        tbs[i] = msgs[i];
+        tbslens[i] = i;
+        sigs[i] = sigbufs[i];
+        siglens[i] = sizeof(sigbufs[i]);
+        if (!TEST_ptr(pkeys[i] = EVP_PKEY_Q_keygen(testctx, testpropq,
+                                                   keytype))
+                || !TEST_true(EVP_MD_CTX_reset(mctx))
+                || !TEST_int_eq(EVP_DigestSignInit_ex(mctx, NULL, NULL,
+                                                      testctx, testpropq,
+                                                      pkeys[i], NULL), 1)
+                || !TEST_int_eq(EVP_DigestSign(mctx, sigbufs[i], &siglens[i],
+                                               tbs[i], tbslens[i]), 1))
+            goto err;
+    }
+
+    if (!TEST_int_eq(EVP_DigestVerify_batch(pkeys, sigs, siglens, tbs,
+                                            tbslens, BATCH_NUM, results,
+                                            testctx, testpropq), 1))
+        goto err;
+    for (i = 0; i < BATCH_NUM; i++)
+        if (!TEST_int_eq(results[i], 1))
+            goto err;
+
+    sigbufs[3][0] ^= 1;
+    sigbufs[66][siglens[66] - 1] ^= 0x10;
+    siglens[40]--;
+    if (!TEST_int_eq(EVP_DigestVerify_batch(pkeys, sigs, siglens, tbs,
+                                            tbslens, BATCH_NUM, results,
+                                            testctx, testpropq), 0))
+        goto err;
+    for (i = 0; i < BATCH_NUM; i++)
+        if (!TEST_int_eq(results[i], i != 3 && i != 40 && i != 66))
+            goto err;
+
+    testresult = 1;
+ err:
+    for (i = 0; i < BATCH_NUM; i++)
+        EVP_PKEY_free(pkeys[i]);
+    EVP_MD_CTX_free(mctx);
+    return testresult;
+}
+
+/* h = SHA512(R || A || M) mod L */
+static int ed25519_hram(BIGNUM *h, const unsigned char *r,
+                        const unsigned char *pub, const unsigned char *msg,
+                        size_t msglen, const BIGNUM *l, BN_CTX *bnctx)
+{
+    EVP_MD_CTX *mctx = EVP_MD_CTX_new();
+    EVP_MD *sha512 = EVP_MD_fetch(testctx, "SHA512", testpropq);
+    unsigned char md[EVP_MAX_MD_SIZE];
+    int ret = 0;
+
+    if (TEST_ptr(mctx)
+            && TEST_ptr(sha512)
+            && TEST_true(EVP_DigestInit_ex(mctx, sha512, NULL))
+            && TEST_true(EVP_DigestUpdate(mctx, r, 32))
+            && TEST_true(EVP_DigestUpdate(mctx, pub, 32))
+            && TEST_true(EVP_DigestUpdate(mctx, msg, msglen))
+            && TEST_true(EVP_DigestFinal_ex(mctx, md, NULL))
+            && TEST_ptr(BN_lebin2bn(md, 64, h))
+            && TEST_true(BN_nnmod(h, h, l, bnctx)))
+        ret = 1;
+    EVP_MD_free(sha512);
+    EVP_MD_CTX_free(mctx);
+    return ret;
+}
+
+/*
+ * Signs |msg| with |pkey| and replaces R in the signature with R + T if
+ * |mixed| is set, or with T otherwise, where T is the point of order 2.
+ * S is adjusted so that the result satisfies the cofactored verification
+ * equation, but not the cofactorless one.
+ */
+static int ed25519_small_order_sig(EVP_PKEY *pkey, const unsigned char *msg,
+                                   size_t msglen, unsigned char sig[64],
+                                   int mixed)
+{
+    static const char l_hex[] =
+        "1000000000000000000000000000000014DEF9DEA2F79CD65812631A5CF5D3ED";
+    static const char p_hex[] =
+        "7FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFED";
+    unsigned char seed[32], pub[32], az[64];
+    size_t len;
+    EVP_MD_CTX *mctx = NULL;
+    BN_CTX *bnctx = NULL;
+    BIGNUM *l = NULL, *p = NULL, *a = NULL, *h = NULL, *k = NULL, *y = NULL;
+    int sign, ret = 0;
+
+    len = sizeof(seed);
+    if (!TEST_true(EVP_PKEY_get_raw_private_key(pkey, seed, &len))
+            || !TEST_size_t_eq(len, sizeof(seed)))
+        goto err;
+    len = sizeof(pub);
+    if (!TEST_true(EVP_PKEY_get_raw_public_key(pkey, pub, &len))
+            || !TEST_size_t_eq(len, sizeof(pub)))
+        goto err;
+    len = 64;
+    if (!TEST_ptr(mctx = EVP_MD_CTX_new())
+            || !TEST_int_eq(EVP_DigestSignInit_ex(mctx, NULL, NULL, testctx,
+                                                  testpropq, pkey, NULL), 1)
+            || !TEST_int_eq(EVP_DigestSign(mctx, sig, &len, msg, msglen), 1)
+            || !TEST_true(EVP_Q_digest(testctx, "SHA512", testpropq,
+                                       seed, sizeof(seed), az, NULL)))
+        goto err;
+    az[0] &= 248;
+    az[31] &= 63;
+    az[31] |= 64;
+
+    if (!TEST_ptr(bnctx = BN_CTX_new_ex(testctx))
+            || !TEST_true(BN_hex2bn(&l, l_hex))
+            || !TEST_true(BN_hex2bn(&p, p_hex))
+            || !TEST_ptr(a = BN_lebin2bn(az, 32, NULL))
+            || !TEST_ptr(h = BN_new())
+            || !TEST_ptr(k = BN_lebin2bn(sig + 32, 32, NULL))
+            || !TEST_ptr(y = BN_new()))
+        goto err;
+
+    if (mixed) {
+        /* The nonce is k = S - h * a, and R + T is (-x, -y) for R = (x, y) */
+        if (!ed25519_hram(h, sig, pub, msg, msglen, l, bnctx)
+                || !TEST_true(BN_mod_mul(h, h, a, l, bnctx))
+                || !TEST_true(BN_mod_sub(k, k, h, l, bnctx)))
+            goto err;
+        sign = sig[31] & 0x80;
+        sig[31] &= 0x7f;
+        if (!TEST_ptr(BN_lebin2bn(sig, 32, y))
+                || !TEST_true(BN_sub(y, p, y)))
+            goto err;
+    } else {
+        /* T is (0, -1) with the nonce 0 */
+        sign = 0x80;
+        BN_zero(k);
+        if (!TEST_true(BN_sub(y, p, BN_value_one())))
+            goto err;
+    }
+    if (!TEST_int_eq(BN_bn2lebinpad(y, sig, 32), 32))
+        goto err;
+    sig[31] |= sign ^ 0x80;
+
+    /* S = k + h * a with h for the new R */
+    if (!ed25519_hram(h, sig, pub, msg, msglen, l, bnctx)
+            || !TEST_true(BN_mod_mul(h, h, a, l, bnctx))
+            || !TEST_true(BN_mod_add(k, k, h, l, bnctx))
+            || !TEST_int_eq(BN_bn2lebinpad(k, sig + 32, 32), 32))
+        goto err;
+    ret = 1;
+ err:
+    BN_free(l);
+    BN_free(p);
+    BN_free(a);
+    BN_free(h);
+    BN_free(k);
+    BN_free(y);
+    BN_CTX_free(bnctx);
+    EVP_MD_CTX_free(mctx);
+    return ret;
+}
+
+/*
+ * The batch verification of Ed25519 uses the cofactored equation.  A
+ * signature whose R has a small order component must get the same result
+ * whether it is verified alone or together with an invalid signature, which
+ * makes the combined check fail and the signatures be verified one by one.
+ * R of small order is always rejected.
+ */
+static int test_EVP_DigestVerify_batch_small_order(void)
+{
+    static const int batch_expected[] = { 1, 1, 0, 0 };
+    static const int single_expected[] = { 1, 0, 0, 0 };
+    static const unsigned char msg[] = "small order";
+    static const unsigned char othermsg[] = "other message";
+    EVP_PKEY *pkey = NULL;
+    EVP_PKEY *pkeys[OSSL_NELEM(batch_expected)];
+    unsigned char sigbufs[OSSL_NELEM(batch_expected)][64];
+    const unsigned char *tbs[OSSL_NELEM(batch_expected)];
+    const unsigned char *sigs[OSSL_NELEM(batch_expected)];
+    size_t tbslens[OSSL_NELEM(batch_expected)];
+    size_t siglens[OSSL_NELEM(batch_expected)];
+    int results[OSSL_NELEM(batch_expected)];
+    EVP_MD_CTX *mctx = NULL;
+    size_t i, len = sizeof(sigbufs[0]);
+    int testresult = 0;
+
+    if (!TEST_ptr(pkey = EVP_PKEY_Q_keygen(testctx, testpropq, "ED25519"))
+            || !TEST_ptr(mctx = EVP_MD_CTX_new())
+            || !TEST_int_eq(EVP_DigestSignInit_ex(mctx, NULL, NULL, testctx,
+                                                  testpropq, pkey, NULL), 1)
+            || !TEST_int_eq(EVP_DigestSign(mctx, sigbufs[0], &len,
+                                           msg, sizeof(msg)), 1)
+            || !ed25519_small_order_sig(pkey, msg, sizeof(msg), sigbufs[1], 1)
+            || !ed25519_small_order_sig(pkey, msg, sizeof(msg), sigbufs[2], 0))
+        goto err;
+    /* A valid signature for another message */
+    memcpy(sigbufs[3], sigbufs[0], sizeof(sigbufs[3]));
+
+    for (i = 0; i < OSSL_NELEM(batch_expected); i++) {
+        pkeys[i] = pkey;
+        sigs[i] = sigbufs[i];
+        siglens[i] = sizeof(sigbufs[i]);
+        tbs[i] = i == 3 ? othermsg : msg;
+        tbslens[i] = i == 3 ? sizeof(othermsg) : sizeof(msg);
+
+        if (!TEST_true(EVP_MD_CTX_reset(mctx))
+                || !TEST_int_eq(EVP_DigestVerifyInit_ex(mctx, NULL, NULL,
+                                                        testctx, testpropq,
+                                                        pkey, NULL), 1)
+                || !TEST_int_eq(EVP_DigestVerify(mctx, sigs[i], siglens[i],
+                                                 tbs[i], tbslens[i]),
+                                single_expected[i]))
+            goto err;
+
+        if (!TEST_int_eq(EVP_DigestVerify_batch(pkeys + i, sigs + i,
+                                                siglens + i, tbs + i,
+                                                tbslens + i, 1, results + i,
+                                                testctx, testpropq),
+                         batch_expected[i])
+                || !TEST_int_eq(results[i], batch_expected[i]))
+            goto err;
+    }
+
+    if (!TEST_int_eq(EVP_DigestVerify_batch(pkeys, sigs, siglens, tbs,
+                                            tbslens, 2, results,
+                                            testctx, testpropq), 1)
+            || !TEST_int_eq(EVP_DigestVerify_batch(pkeys, sigs, siglens, tbs,
+                                                   tbslens,
+                                                   OSSL_NELEM(results),
+                                                   results, testctx,
+                                                   testpropq), 0))
+        goto err;
+    for (i = 0; i < OSSL_NELEM(results); i++)
+        if (!TEST_int_eq(results[i], batch_expected[i]))
+            goto err;
+
+    testresult = 1;
+ err:
+    EVP_PKEY_free(pkey);
+    EVP_MD_CTX_free(mctx);
+    return testresult;
+}
+#endif
+
+static const char *digest_batch_names[] = {
+    "SHA224", "SHA256", "SHA384", "SHA512", "SHA512-224", "SHA512-256",
+    "SHA1", "SHA3-224", "SHA3-256", "SHA3-384", "SHA3-512", "SHAKE128",
+    "SHAKE256"
+};
+
+/*
+ * Check EVP_Digest_batch() against EVP_Digest() for lengths around the
+ * padding boundaries and for batches that do and don't fill the lanes of
+ * the multi-buffer implementations.  SHA1 has no batch function and is
+ * hashed one message at a time.
+ */
+static int test_EVP_Digest_batch(int idx)
+{
+    static const size_t lens[] = {
+        0, 1, 55, 56, 63, 64, 65, 71, 72, 103, 104, 111, 112, 113, 127,
+        128, 129, 135, 136, 143, 144, 167, 168, 200, 1000, 1024, 4099, 5, 300
+    };
+    static const size_t nums[] = { 1, 3, 9, OSSL_NELEM(lens) };
+    const size_t n = OSSL_NELEM(lens);
+    EVP_MD *md = NULL;
+    unsigned char *buf = NULL;
+    unsigned char mdbufs[OSSL_NELEM(lens)][EVP_MAX_MD_SIZE];
+    unsigned char expected[EVP_MAX_MD_SIZE];
+    const void *data[OSSL_NELEM(lens)];
+    unsigned char *mds[OSSL_NELEM(lens)];
+    unsigned int mdlen;
+    size_t i, j;
+    int testresult = 0;
+
+    if (!TEST_ptr(md = EVP_MD_fetch(testctx, digest_batch_names[idx],
+                                    testpropq))
+            || !TEST_ptr(buf = OPENSSL_malloc(n * 4099)))
+        goto err;
+    for (i = 0; i < n * 4099; i++)
+        buf[i] = (unsigned char)(i * 7 + (i >> 8));
+    for (i = 0; i < n; i++) {
+        data[i] = buf + i * 4099;
+        mds[i] = mdbufs[i];
+    }
+
+    if (!TEST_true(EVP_Digest_batch(data, lens, 0, mds, md)))
+        goto err;
+    for (j = 0; j < OSSL_NELEM(nums); j++) {
+        memset(mdbufs, 0, sizeof(mdbufs));
+        if (!TEST_true(EVP_Digest_batch(data, lens, nums[j], mds, md)))
+            goto err;
+        for (i = 0; i < nums[j]; i++) {
+            if (!TEST_true(EVP_Digest(data[i], lens[i], expected, &mdlen, md,
+                                      NULL))
+                    || !TEST_mem_eq(mds[i], mdlen, expected, mdlen)) {
+                TEST_note("message %zu of %zu, length %zu", i, nums[j],
+                          lens[i]);
+                goto err;
+            }
+        }
+    }
+
+    testresult = 1;
+ err:
+    OPENSSL_free(buf);
+    EVP_MD_free(md);
+    return testresult;
+}
+
+/*
+ * Check EVP_DigestXOF_batch() against EVP_DigestFinalXOF() for outputs
+ * shorter and longer than one block, with messages of different lengths
+ * sharing the multi-state Keccak permutations.
+ */
+static int test_EVP_DigestXOF_batch(int idx)
+{
+    static const size_t lens[] = { 0, 3, 136, 168, 500, 17, 1000, 135, 9 };
+    static const size_t outlens[] = { 1, 32, 136, 168, 169, 700 };
+    const size_t n = OSSL_NELEM(lens);
+    EVP_MD *md = NULL, *sha256 = NULL;
+    EVP_MD_CTX *ctx = NULL;
+    unsigned char *buf = NULL, *out = NULL, expected[700];
+    const void *data[OSSL_NELEM(lens)];
+    unsigned char *mds[OSSL_NELEM(lens)];
+    size_t i, j;
+    int testresult = 0;
+
+    if (!TEST_ptr(md = EVP_MD_fetch(testctx, idx == 0 ? "SHAKE128"
+                                                      : "SHAKE256",
+                                    testpropq))
+            || !TEST_ptr(sha256 = EVP_MD_fetch(testctx, "SHA256", testpropq))
+            || !TEST_ptr(ctx = EVP_MD_CTX_new())
+            || !TEST_ptr(buf = OPENSSL_malloc(n * 1000))
+            || !TEST_ptr(out = OPENSSL_malloc(n * sizeof(expected))))
+        goto err;
+    for (i = 0; i < n * 1000; i++)
+        buf[i] = (unsigned char)(i * 13 + (i >> 8));
+    for (i = 0; i < n; i++) {
+        data[i] = buf + i * 1000;
+        mds[i] = out + i * sizeof(expected);
+    }
+
+    for (j = 0; j < OSSL_NELEM(outlens); j++) {
+        memset(out, 0, n * sizeof(expected));
+        if (!TEST_true(EVP_DigestXOF_batch(data, lens, n, mds, outlens[j],
+                                           md)))
+            goto err;
+        for (i = 0; i < n; i++) {
+            if (!TEST_true(EVP_DigestInit_ex(ctx, md, NULL))
+                    || !TEST_true(EVP_DigestUpdate(ctx, data[i], lens[i]))
+                    || !TEST_true(EVP_DigestFinalXOF(ctx, expected,
+                                                     outlens[j]))
+                    || !TEST_mem_eq(mds[i], outlens[j], expected,
+                                    outlens[j])) {
+                TEST_note("message %zu, length %zu, output length %zu", i,
+                          lens[i], outlens[j]);
+                goto err;
+            }
+        }
+    }
+
+    if (!TEST_false(EVP_DigestXOF_batch(data, lens, n, mds, 32, sha256))
+            || !TEST_false(EVP_DigestXOF_batch(data, lens, n, mds, 0, sha256))
+            || !TEST_true(EVP_DigestXOF_batch(data, lens, n, mds, 0, md)))
+        goto err;
+
+    testresult = 1;
+ err:
+    OPENSSL_free(buf);
+    OPENSSL_free(out);
+    EVP_MD_CTX_free(ctx);
+    EVP_MD_free(sha256);
+    EVP_MD_free(md);
+    return testresult;
+}
+
+#ifndef OPENSSL_NO_EC
+/*
+ * The public key of a generated X25519 key comes from a fixed-base
+ * multiplication on the Edwards curve.  Check it against the Montgomery
+ * ladder, by deriving the shared secret with the base point u = 9.
+ */
+static int test_X25519_keygen_basepoint(void)
+{
+    static const unsigned char base[32] = { 9 };
+    EVP_PKEY_CTX *gctx = NULL, *dctx = NULL;
+    EVP_PKEY *key = NULL, *peer = NULL;
+    unsigned char pub[32], secret[32];
+    size_t len;
+    int i, testresult = 0;
+
+    if (!TEST_ptr(peer = EVP_PKEY_new_raw_public_key_ex(testctx, "X25519",
+                                                        testpropq, base,
+                                                        sizeof(base)))
+            || !TEST_ptr(gctx = EVP_PKEY_CTX_new_from_name(testctx, "X25519",
+                                                           testpropq))
+            || !TEST_int_gt(EVP_PKEY_keygen_init(gctx), 0))
+        goto err;
+
+    for (i = 0; i < 64; i++) {
+        len = sizeof(pub);
+        if (!TEST_int_gt(EVP_PKEY_keygen(gctx, &key), 0)
+                || !TEST_true(EVP_PKEY_get_raw_public_key(key, pub, &len))
+                || !TEST_ptr(dctx = EVP_PKEY_CTX_new_from_pkey(testctx, key,
+                                                               testpropq))
+                || !TEST_int_gt(EVP_PKEY_derive_init(dctx), 0)
+                || !TEST_int_gt(EVP_PKEY_derive_set_peer(dctx, peer), 0))
+            goto err;
+        len = sizeof(secret);
+        if (!TEST_int_gt(EVP_PKEY_derive(dctx, secret, &len), 0)
+                || !TEST_mem_eq(pub, sizeof(pub), secret, len))
+            goto err;
+        EVP_PKEY_CTX_free(dctx);
+        dctx = NULL;
+        EVP_PKEY_free(key);
+        key = NULL;
+    }
+
+    testresult = 1;
+ err:
+    EVP_PKEY_CTX_free(dctx);
+    EVP_PKEY_CTX_free(gctx);
+    EVP_PKEY_free(key);
+    EVP_PKEY_free(peer);
+    return testresult;
+}
+#endif
 
 typedef enum OPTION_choice {
     OPT_ERR = -1,
@@ -3487,6 +3936,15 @@ int setup_tests(void)
     ADD_ALL_TESTS(test_evp_init_seq, OSSL_NELEM(evp_init_tests));
     ADD_ALL_TESTS(test_evp_reset, OSSL_NELEM(evp_reset_tests));
     ADD_ALL_TESTS(test_gcm_reinit, OSSL_NELEM(gcm_reinit_tests));
+#ifndef OPENSSL_NO_EC
+    ADD_ALL_TESTS(test_EVP_DigestVerify_batch, 2);
+    ADD_TEST(test_EVP_DigestVerify_batch_small_order);
+#endif
+    ADD_ALL_TESTS(test_EVP_Digest_batch, OSSL_NELEM(digest_batch_names));
+    ADD_ALL_TESTS(test_EVP_DigestXOF_batch, 2);
+#ifndef OPENSSL_NO_EC
+    ADD_TEST(test_X25519_keygen_basepoint);
+#endif
 
     return 1;
 }
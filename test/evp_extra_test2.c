@@ -24,6 +24,7 @@
 # include <openssl/rsa.h>
 #endif
 #include <openssl/core_names.h>
+#include <openssl/core_dispatch.h>
 #include "testutil.h"
 #include "internal/nelem.h"
 
@@ -384,6 +385,137 @@ static int test_alternative_default(void)
     return ok;
 }
 
+/*
+ * A provider with a single digest that it doesn't let the method store keep.
+ * Every fetch that isn't served from the per thread fetch cache therefore
+ * ends up querying the provider, which lets us count them.
+ */
+static int fetchcount_queries = 0;
+
+static int fetchcount_get_params(OSSL_PARAM params[])
+{
+    OSSL_PARAM *p;
+
+    if ((p = OSSL_PARAM_locate(params, OSSL_DIGEST_PARAM_SIZE)) != NULL
+            && !OSSL_PARAM_set_size_t(p, 1))
+        return 0;
+    if ((p = OSSL_PARAM_locate(params, OSSL_DIGEST_PARAM_BLOCK_SIZE)) != NULL
+            && !OSSL_PARAM_set_size_t(p, 1))
+        return 0;
+    return 1;
+}
+
+static int fetchcount_digest(void *provctx, const unsigned char *in,
+                             size_t inl, unsigned char *out, size_t *outl,
+                             size_t outsz)
+{
+    return 0;
+}
+
+static const OSSL_DISPATCH fetchcount_md_functions[] = {
+    { OSSL_FUNC_DIGEST_GET_PARAMS, (void (*)(void))fetchcount_get_params },
+    { OSSL_FUNC_DIGEST_DIGEST, (void (*)(void))fetchcount_digest },
+    { 0, NULL }
+};
+
+static const OSSL_ALGORITHM fetchcount_digests[] = {
+    { "FETCHCOUNT-MD", "provider=fetchcount", fetchcount_md_functions },
+    { NULL, NULL, NULL }
+};
+
+static const OSSL_ALGORITHM *fetchcount_query(void *provctx, int operation_id,
+                                              int *no_cache)
+{
+    *no_cache = 1;
+    if (operation_id != OSSL_OP_DIGEST)
+        return NULL;
+    fetchcount_queries++;
+    return fetchcount_digests;
+}
+
+static const OSSL_DISPATCH fetchcount_dispatch_table[] = {
+    { OSSL_FUNC_PROVIDER_QUERY_OPERATION, (void (*)(void))fetchcount_query },
+    { 0, NULL }
+};
+
+static int fetchcount_provider_init(const OSSL_CORE_HANDLE *handle,
+                                    const OSSL_DISPATCH *in,
+                                    const OSSL_DISPATCH **out,
+                                    void **provctx)
+{
+    *provctx = (void *)handle;
+    *out = fetchcount_dispatch_table;
+    return 1;
+}
+
+static int test_thread_fetch_cache(void)
+{
+    OSSL_LIB_CTX *ctx = NULL;
+    OSSL_PROVIDER *prov = NULL;
+    EVP_MD *md1 = NULL, *md2 = NULL;
+    int queries, ok = 0;
+
+    if (!TEST_ptr(ctx = OSSL_LIB_CTX_new())
+        || !TEST_true(OSSL_PROVIDER_add_builtin(ctx, "fetchcount",
+                                                fetchcount_provider_init))
+        || !TEST_ptr(prov = OSSL_PROVIDER_load(ctx, "fetchcount")))
+        goto err;
+
+    /* Without the cache, every fetch goes to the provider */
+    queries = fetchcount_queries;
+    if (!TEST_false(EVP_thread_fetch_cache_is_enabled(ctx))
+        || !TEST_ptr(md1 = EVP_MD_fetch(ctx, "FETCHCOUNT-MD", NULL))
+        || !TEST_ptr(md2 = EVP_MD_fetch(ctx, "FETCHCOUNT-MD", NULL))
+        || !TEST_int_eq(fetchcount_queries, queries + 2))
+        goto err;
+    EVP_MD_free(md1);
+    EVP_MD_free(md2);
+    md1 = md2 = NULL;
+
+    /* With the cache, only the first one does */
+    queries = fetchcount_queries;
+    if (!TEST_true(EVP_thread_fetch_cache_enable(ctx, 1))
+        || !TEST_true(EVP_thread_fetch_cache_is_enabled(ctx))
+        || !TEST_ptr(md1 = EVP_MD_fetch(ctx, "FETCHCOUNT-MD", NULL))
+        || !TEST_ptr(md2 = EVP_MD_fetch(ctx, "FETCHCOUNT-MD", NULL))
+        || !TEST_ptr_eq(md1, md2)
+        || !TEST_int_eq(fetchcount_queries, queries + 1))
+        goto err;
+    EVP_MD_free(md2);
+    md2 = NULL;
+
+    /* Changing the default properties must force a new fetch */
+    queries = fetchcount_queries;
+    if (!TEST_true(EVP_set_default_properties(ctx, "provider=nonexistent"))
+        || !TEST_ptr_null(md2 = EVP_MD_fetch(ctx, "FETCHCOUNT-MD", NULL))
+        || !TEST_int_eq(fetchcount_queries, queries + 1)
+        || !TEST_true(EVP_set_default_properties(ctx, NULL))
+        || !TEST_ptr(md2 = EVP_MD_fetch(ctx, "FETCHCOUNT-MD", NULL))
+        || !TEST_ptr_ne(md1, md2)
+        || !TEST_int_eq(fetchcount_queries, queries + 2))
+        goto err;
+    EVP_MD_free(md2);
+    md2 = NULL;
+
+    /* So must deactivating the provider */
+    OSSL_PROVIDER_unload(prov);
+    prov = NULL;
+    if (!TEST_ptr_null(md2 = EVP_MD_fetch(ctx, "FETCHCOUNT-MD", NULL)))
+        goto err;
+
+    if (!TEST_true(EVP_thread_fetch_cache_enable(ctx, 0))
+        || !TEST_false(EVP_thread_fetch_cache_is_enabled(ctx)))
+        goto err;
+
+    ok = 1;
+ err:
+    EVP_MD_free(md1);
+    EVP_MD_free(md2);
+    OSSL_PROVIDER_unload(prov);
+    OSSL_LIB_CTX_free(ctx);
+    return ok;
+}
+
 static int test_d2i_PrivateKey_ex(int testid)
 {
     int ok = 0;
@@ -827,6 +959,7 @@ int setup_tests(void)
     }
 
     ADD_TEST(test_alternative_default);
+    ADD_TEST(test_thread_fetch_cache);
     ADD_ALL_TESTS(test_d2i_AutoPrivateKey_ex, OSSL_NELEM(keydata));
 #ifndef OPENSSL_NO_EC
     ADD_ALL_TESTS(test_d2i_PrivateKey_ex, 2);
@@ -224,10 +224,14 @@ static int test_mod_exp_x2(int idx)
     int factor_size = 0;
 
     /*
-     * Currently only 1024-bit factor size is supported.
+     * Currently only 1024, 1536 and 2048-bit factor sizes are supported.
      */
-    if (idx <= 100)
+    if (idx < 100)
         factor_size = 1024;
+    else if (idx < 200)
+        factor_size = 1536;
+    else
+        factor_size = 2048;
 
     if (!TEST_ptr(ctx = BN_CTX_new()))
         goto err;
@@ -303,6 +307,6 @@ int setup_tests(void)
 {
     ADD_TEST(test_mod_exp_zero);
     ADD_ALL_TESTS(test_mod_exp, 200);
-    ADD_ALL_TESTS(test_mod_exp_x2, 100);
+    ADD_ALL_TESTS(test_mod_exp_x2, 300);
     return 1;
 }
@@ -0,0 +1,161 @@
+/*
+ * Copyright 2021 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * Multi-threaded fetch microbenchmark for the method store query cache.
+ *
+ * Each thread repeatedly fetches and frees a few digests and ciphers, so that
+ * nearly every fetch is answered from the query cache.  The run is repeated
+ * with 1, 2, 4, ... threads up to -threads, and the aggregate fetch rate is
+ * reported for each, which shows how the cache read path scales.  With
+ * -thread-cache the per thread fetch cache is turned on first.
+ */
+
+#include <openssl/evp.h>
+#include "internal/nelem.h"
+#include "testutil.h"
+#include "threadstest.h"
+#include "helpers/bench.h"
+
+#define FETCH_COUNT     "2000"
+#define FETCH_THREADS   "4"
+
+static ossl_intmax_t fetch_count;
+static int max_threads;
+static int thread_cache = 0;
+static int bench_success;
+
+static void thread_fetch(void)
+{
+    static const char *mdnames[] = {
+        "SHA2-256", "SHA2-512", "SHA3-256", "SHA1"
+    };
+    static const char *ciphnames[] = {
+        "AES-128-CBC", "AES-256-GCM", "ChaCha20-Poly1305"
+    };
+    EVP_MD *md;
+    EVP_CIPHER *ciph;
+    ossl_intmax_t i;
+
+    for (i = 0; i < fetch_count; i++) {
+        md = EVP_MD_fetch(NULL, mdnames[i % OSSL_NELEM(mdnames)], NULL);
+        ciph = EVP_CIPHER_fetch(NULL, ciphnames[i % OSSL_NELEM(ciphnames)],
+                                NULL);
+        if (md == NULL || ciph == NULL)
+            bench_success = 0;
+        EVP_MD_free(md);
+        EVP_CIPHER_free(ciph);
+    }
+}
+
+static int test_fetch_scaling(void)
+{
+    thread_t *threads;
+    int nthreads, started, i;
+    double start, elapsed, rate;
+    int testresult = 0;
+
+    if (!TEST_ptr(threads = OPENSSL_malloc(sizeof(*threads) * max_threads))
+            || !TEST_true(EVP_thread_fetch_cache_enable(NULL, thread_cache))) {
+        OPENSSL_free(threads);
+        return 0;
+    }
+
+    /* Populate the query cache before timing anything */
+    bench_success = 1;
+    thread_fetch();
+
+    for (nthreads = 1; ; nthreads *= 2) {
+        if (nthreads > max_threads)
+            nthreads = max_threads;
+
+        start = bench_time();
+        for (started = 0; started < nthreads; started++)
+            if (!TEST_true(run_thread(&threads[started], thread_fetch)))
+                break;
+        for (i = 0; i < started; i++)
+            if (!TEST_true(wait_for_thread(threads[i])))
+                bench_success = 0;
+        elapsed = bench_time() - start;
+
+        if (!TEST_int_eq(started, nthreads) || !TEST_true(bench_success))
+            goto end;
+
+        rate = elapsed > 0 ? 2.0 * fetch_count * nthreads / elapsed : 0;
+        TEST_info("%3d threads: %12.0f fetches/s, %12.0f per thread",
+                  nthreads, rate, rate / nthreads);
+
+        if (nthreads == max_threads)
+            break;
+    }
+
+    testresult = 1;
+ end:
+    EVP_thread_fetch_cache_enable(NULL, 0);
+    OPENSSL_free(threads);
+    return testresult;
+}
+
+typedef enum OPTION_choice {
+    OPT_ERR = -1,
+    OPT_EOF = 0,
+    OPT_COUNT,
+    OPT_THREADS,
+    OPT_THREAD_CACHE,
+    OPT_TEST_ENUM
+} OPTION_CHOICE;
+
+const OPTIONS *test_get_options(void)
+{
+    static const OPTIONS test_options[] = {
+        OPT_TEST_OPTIONS_DEFAULT_USAGE,
+        { "count", OPT_COUNT, 'M', "Number of fetch pairs per thread" },
+        { "threads", OPT_THREADS, 'M', "Maximum number of threads" },
+        { "thread-cache", OPT_THREAD_CACHE, '-',
+          "Turn on the per thread fetch cache" },
+        { NULL }
+    };
+    return test_options;
+}
+
+int setup_tests(void)
+{
+    OPTION_CHOICE o;
+    ossl_intmax_t threads;
+
+    if (!opt_intmax(FETCH_COUNT, &fetch_count)
+            || !opt_intmax(FETCH_THREADS, &threads))
+        return 0;
+
+    while ((o = opt_next()) != OPT_EOF) {
+        switch (o) {
+        case OPT_COUNT:
+            if (!opt_intmax(opt_arg(), &fetch_count) || fetch_count < 1)
+                return 0;
+            break;
+        case OPT_THREADS:
+            if (!opt_intmax(opt_arg(), &threads)
+                    || threads < 1 || threads > 1024)
+                return 0;
+            break;
+        case OPT_THREAD_CACHE:
+            thread_cache = 1;
+            break;
+        case OPT_TEST_CASES:
+            break;
+        default:
+        case OPT_ERR:
+            return 0;
+        }
+    }
+
+    max_threads = (int)threads;
+    ADD_TEST(test_fetch_scaling);
+    return 1;
+}
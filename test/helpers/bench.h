@@ -0,0 +1,42 @@
+/*
+ * Copyright 2021 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+#ifndef OSSL_TEST_BENCH_H
+# define OSSL_TEST_BENCH_H
+
+/*
+ * Wall clock helper for the microbenchmarks under test/.  These are run with
+ * small counts by "make test" to keep them working; run the programs directly
+ * with larger counts to get meaningful numbers.
+ */
+
+# if defined(_WIN32)
+#  include <windows.h>
+
+static ossl_unused double bench_time(void)
+{
+    LARGE_INTEGER freq, now;
+
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (double)now.QuadPart / (double)freq.QuadPart;
+}
+# else
+#  include <sys/time.h>
+
+static ossl_unused double bench_time(void)
+{
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    return (double)now.tv_sec + (double)now.tv_usec / 1e6;
+}
+# endif
+
+#endif
@@ -0,0 +1,187 @@
+/*
+ * Copyright 2021 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * Multi-threaded namemap lookup microbenchmark.
+ *
+ * Each thread repeatedly maps a set of algorithm names to their numbers in
+ * the namemap of the default library context, or with -num2name maps the
+ * numbers back to their first name.  The run is repeated with 1, 2, 4, ...
+ * threads up to -threads, and the aggregate lookup rate is reported for each,
+ * which shows how the namemap read path scales.
+ */
+
+#include <openssl/evp.h>
+#include "internal/namemap.h"
+#include "internal/nelem.h"
+#include "testutil.h"
+#include "threadstest.h"
+#include "helpers/bench.h"
+
+#define LOOKUP_COUNT    "100000"
+#define LOOKUP_THREADS  "4"
+
+static const char *names[] = {
+    "SHA2-256", "sha256", "SHA2-512", "SHA3-256", "SHA1", "AES-128-CBC",
+    "aes-256-gcm", "ChaCha20-Poly1305", "RSA", "EC", "X25519", "HMAC"
+};
+
+static ossl_intmax_t lookup_count;
+static int max_threads;
+static int num2name = 0;
+static OSSL_NAMEMAP *namemap;
+static int numbers[OSSL_NELEM(names)];
+static int bench_success;
+
+static void do_nothing_md(EVP_MD *md, void *arg)
+{
+}
+
+static void do_nothing_cipher(EVP_CIPHER *cipher, void *arg)
+{
+}
+
+static void do_nothing_keymgmt(EVP_KEYMGMT *keymgmt, void *arg)
+{
+}
+
+static void do_nothing_mac(EVP_MAC *mac, void *arg)
+{
+}
+
+static void thread_lookup(void)
+{
+    ossl_intmax_t i;
+    size_t j;
+
+    for (i = 0; i < lookup_count; i++) {
+        j = (size_t)i % OSSL_NELEM(names);
+        if (num2name) {
+            if (ossl_namemap_num2name(namemap, numbers[j], 0) == NULL)
+                bench_success = 0;
+        } else if (ossl_namemap_name2num(namemap, names[j]) != numbers[j]) {
+            bench_success = 0;
+        }
+    }
+}
+
+static int test_namemap_scaling(void)
+{
+    thread_t *threads;
+    int nthreads, started, i;
+    double start, elapsed, rate;
+    int testresult = 0;
+    size_t j;
+
+    /* Have the providers register all their algorithm names */
+    EVP_MD_do_all_provided(NULL, do_nothing_md, NULL);
+    EVP_CIPHER_do_all_provided(NULL, do_nothing_cipher, NULL);
+    EVP_KEYMGMT_do_all_provided(NULL, do_nothing_keymgmt, NULL);
+    EVP_MAC_do_all_provided(NULL, do_nothing_mac, NULL);
+
+    if (!TEST_ptr(namemap = ossl_namemap_stored(NULL)))
+        return 0;
+    for (j = 0; j < OSSL_NELEM(names); j++) {
+        numbers[j] = ossl_namemap_name2num(namemap, names[j]);
+        if (!TEST_int_ne(numbers[j], 0))
+            return 0;
+    }
+
+    if (!TEST_ptr(threads = OPENSSL_malloc(sizeof(*threads) * max_threads)))
+        return 0;
+
+    bench_success = 1;
+    for (nthreads = 1; ; nthreads *= 2) {
+        if (nthreads > max_threads)
+            nthreads = max_threads;
+
+        start = bench_time();
+        for (started = 0; started < nthreads; started++)
+            if (!TEST_true(run_thread(&threads[started], thread_lookup)))
+                break;
+        for (i = 0; i < started; i++)
+            if (!TEST_true(wait_for_thread(threads[i])))
+                bench_success = 0;
+        elapsed = bench_time() - start;
+
+        if (!TEST_int_eq(started, nthreads) || !TEST_true(bench_success))
+            goto end;
+
+        rate = elapsed > 0 ? (double)lookup_count * nthreads / elapsed : 0;
+        TEST_info("%3d threads: %12.0f %s lookups/s, %12.0f per thread",
+                  nthreads, rate, num2name ? "num2name" : "name2num",
+                  rate / nthreads);
+
+        if (nthreads == max_threads)
+            break;
+    }
+
+    testresult = 1;
+ end:
+    OPENSSL_free(threads);
+    return testresult;
+}
+
+typedef enum OPTION_choice {
+    OPT_ERR = -1,
+    OPT_EOF = 0,
+    OPT_COUNT,
+    OPT_THREADS,
+    OPT_NUM2NAME,
+    OPT_TEST_ENUM
+} OPTION_CHOICE;
+
+const OPTIONS *test_get_options(void)
+{
+    static const OPTIONS test_options[] = {
+        OPT_TEST_OPTIONS_DEFAULT_USAGE,
+        { "count", OPT_COUNT, 'M', "Number of lookups per thread" },
+        { "threads", OPT_THREADS, 'M', "Maximum number of threads" },
+        { "num2name", OPT_NUM2NAME, '-',
+          "Map numbers to names instead of names to numbers" },
+        { NULL }
+    };
+    return test_options;
+}
+
+int setup_tests(void)
+{
+    OPTION_CHOICE o;
+    ossl_intmax_t threads;
+
+    if (!opt_intmax(LOOKUP_COUNT, &lookup_count)
+            || !opt_intmax(LOOKUP_THREADS, &threads))
+        return 0;
+
+    while ((o = opt_next()) != OPT_EOF) {
+        switch (o) {
+        case OPT_COUNT:
+            if (!opt_intmax(opt_arg(), &lookup_count) || lookup_count < 1)
+                return 0;
+            break;
+        case OPT_THREADS:
+            if (!opt_intmax(opt_arg(), &threads)
+                    || threads < 1 || threads > 1024)
+                return 0;
+            break;
+        case OPT_NUM2NAME:
+            num2name = 1;
+            break;
+        case OPT_TEST_CASES:
+            break;
+        default:
+        case OPT_ERR:
+            return 0;
+        }
+    }
+
+    max_threads = (int)threads;
+    ADD_TEST(test_namemap_scaling);
+    return 1;
+}
@@ -7,9 +7,12 @@
  * https://www.openssl.org/source/license.html
  */
 
+#include <string.h>
 #include <openssl/evp.h>
 #include "internal/namemap.h"
+#include "internal/nelem.h"
 #include "testutil.h"
+#include "threadstest.h"
 
 #define NAME1 "name1"
 #define NAME2 "name2"
@@ -62,6 +65,113 @@ static int test_namemap_independent(void)
     return ok;
 }
 
+/* Enough names to make the name table grow a few times */
+#define MANY_NAMES 2000
+
+static int test_namemap_many(void)
+{
+    OSSL_NAMEMAP *nm = ossl_namemap_new();
+    char name[32];
+    int i, num = 0, ok = 0;
+
+    if (!TEST_ptr(nm))
+        return 0;
+
+    for (i = 0; i < MANY_NAMES; i++) {
+        BIO_snprintf(name, sizeof(name), "name-%d", i);
+        num = ossl_namemap_add_name(nm, i % 2 == 0 ? 0 : num, name);
+        if (!TEST_int_ne(num, 0))
+            goto err;
+    }
+    for (i = 0; i < MANY_NAMES; i++) {
+        BIO_snprintf(name, sizeof(name), "NAME-%d", i);
+        num = ossl_namemap_name2num(nm, name);
+        if (!TEST_int_eq(num, i / 2 + 1))
+            goto err;
+        /* Aliases are returned in the order they were added */
+        BIO_snprintf(name, sizeof(name), "name-%d", i);
+        if (!TEST_str_eq(ossl_namemap_num2name(nm, num, i % 2), name))
+            goto err;
+    }
+    if (!TEST_ptr_null(ossl_namemap_num2name(nm, 1, 2))
+        || !TEST_ptr_null(ossl_namemap_num2name(nm, MANY_NAMES, 0))
+        || !TEST_int_eq(ossl_namemap_name2num_n(nm, "name-12xyz", 7), 7))
+        goto err;
+    ok = 1;
+ err:
+    ossl_namemap_free(nm);
+    return ok;
+}
+
+static OSSL_NAMEMAP *thread_nm;
+static int thread_nm_success;
+
+static void count_names(const char *name, void *data)
+{
+    (*(int *)data)++;
+}
+
+static void namemap_lookup_worker(void)
+{
+    static const char *names[] = { NAME1, NAME2, ALIAS1, ALIAS1_UC };
+    char name[32];
+    const char *aname;
+    int i, num, count;
+    size_t j;
+
+    for (i = 0; i < MANY_NAMES; i++) {
+        for (j = 0; j < OSSL_NELEM(names); j++)
+            if (ossl_namemap_name2num(thread_nm, names[j]) == 0)
+                thread_nm_success = 0;
+        /* These may or may not have been added yet */
+        BIO_snprintf(name, sizeof(name), "thread-%d", i);
+        if ((num = ossl_namemap_name2num(thread_nm, name)) == 0)
+            continue;
+        /* But once a name is there, its number must lead back to it */
+        for (j = 0;
+             (aname = ossl_namemap_num2name(thread_nm, num, j)) != NULL;
+             j++)
+            if (strcmp(aname, name) == 0)
+                break;
+        count = 0;
+        if (aname == NULL
+            || !ossl_namemap_doall_names(thread_nm, num, count_names, &count)
+            || count < (int)j + 1)
+            thread_nm_success = 0;
+    }
+}
+
+/*
+ * Look up names while the name table and the number table grow under the
+ * readers' feet, and alias chains get longer
+ */
+static int test_namemap_threads(void)
+{
+    thread_t t1, t2;
+    char name[32];
+    int i, num = 0, ok = 0;
+
+    thread_nm_success = 1;
+    if (!TEST_ptr(thread_nm = ossl_namemap_new())
+        || !TEST_true(test_namemap(thread_nm))
+        || !TEST_true(run_thread(&t1, namemap_lookup_worker))
+        || !TEST_true(run_thread(&t2, namemap_lookup_worker)))
+        goto err;
+    for (i = 0; i < MANY_NAMES; i++) {
+        BIO_snprintf(name, sizeof(name), "thread-%d", i);
+        if ((num = ossl_namemap_add_name(thread_nm, i % 4 == 0 ? 0 : num,
+                                         name)) == 0)
+            thread_nm_success = 0;
+    }
+    ok = TEST_true(wait_for_thread(t1))
+        & TEST_true(wait_for_thread(t2))
+        & TEST_true(thread_nm_success);
+ err:
+    ossl_namemap_free(thread_nm);
+    thread_nm = NULL;
+    return ok;
+}
+
 static int test_namemap_stored(void)
 {
     OSSL_NAMEMAP *nm = ossl_namemap_stored(NULL);
@@ -174,6 +284,8 @@ int setup_tests(void)
 {
     ADD_TEST(test_namemap_empty);
     ADD_TEST(test_namemap_independent);
+    ADD_TEST(test_namemap_many);
+    ADD_TEST(test_namemap_threads);
     ADD_TEST(test_namemap_stored);
     ADD_TEST(test_digestbyname);
     ADD_TEST(test_cipherbyname);
@@ -0,0 +1,40 @@
+#! /usr/bin/env perl
+# Copyright 2021 The OpenSSL Project Authors. All Rights Reserved.
+#
+# Licensed under the Apache License 2.0 (the "License").  You may not use
+# this file except in compliance with the License.  You can obtain a copy
+# in the file LICENSE in the source distribution or at
+# https://www.openssl.org/source/license.html
+
+
+use strict;
+use warnings;
+
+use OpenSSL::Test qw(:DEFAULT srctop_file);
+use OpenSSL::Test::Utils;
+
+setup("test_aes_ia32cap");
+
+# Run the AES vectors, GCM and CTR included, on the code paths that are used
+# without AES-NI on x86: the bit-sliced and vector permutation AES, with and
+# without PCLMULQDQ and AVX2.  Elsewhere OPENSSL_ia32cap has no effect.
+# The extended capabilities are cleared unless they are given after a colon,
+# so ":~0" keeps them as detected.
+my @masks = (
+    '~0x200000000000000:~0',            # no AES-NI
+    '~0x200000200000000:~0',            # no AES-NI and PCLMULQDQ
+    '~0x200000200000000:~0x20',         # no AVX2 either
+);
+
+plan tests => 2 * scalar @masks;
+
+foreach my $mask (@masks) {
+    local $ENV{OPENSSL_ia32cap} = $mask;
+
+    ok(run(test(["evp_test", "-config", srctop_file("test", "default.cnf"),
+                 srctop_file("test", "recipes", "30-test_evp_data",
+                             "evpciph_aes_common.txt")])),
+       "running evp_test evpciph_aes_common.txt with OPENSSL_ia32cap=$mask");
+    ok(run(test(["aesgcmtest"])),
+       "running aesgcmtest with OPENSSL_ia32cap=$mask");
+}
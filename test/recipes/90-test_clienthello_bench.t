@@ -0,0 +1,26 @@
+#! /usr/bin/env perl
+# Copyright 2021 The OpenSSL Project Authors. All Rights Reserved.
+#
+# Licensed under the Apache License 2.0 (the "License").  You may not use
+# this file except in compliance with the License.  You can obtain a copy
+# in the file LICENSE in the source distribution or at
+# https://www.openssl.org/source/license.html
+
+use strict;
+use warnings;
+
+use OpenSSL::Test;
+use OpenSSL::Test::Utils;
+
+setup("test_clienthello_bench");
+
+plan skip_all => "No TLS/SSL protocols are supported by this OpenSSL build"
+    if alldisabled(available_protocols("tls"));
+
+plan tests => 2;
+
+# Only a short run to keep the benchmark working; run clienthello_bench
+# directly with a larger -count for meaningful numbers.
+ok(run(test(["clienthello_bench"])), "running clienthello_bench");
+ok(run(test(["clienthello_bench", "-custom-seccb"])),
+   "running clienthello_bench without the ClientHello template");
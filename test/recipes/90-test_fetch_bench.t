@@ -0,0 +1,22 @@
+#! /usr/bin/env perl
+# Copyright 2021 The OpenSSL Project Authors. All Rights Reserved.
+#
+# Licensed under the Apache License 2.0 (the "License").  You may not use
+# this file except in compliance with the License.  You can obtain a copy
+# in the file LICENSE in the source distribution or at
+# https://www.openssl.org/source/license.html
+
+use strict;
+use warnings;
+
+use OpenSSL::Test;
+
+setup("test_fetch_bench");
+
+plan tests => 2;
+
+# Only a short run to keep the benchmark working; run fetch_bench directly
+# with larger -count and -threads values for meaningful numbers.
+ok(run(test(["fetch_bench"])), "running fetch_bench");
+ok(run(test(["fetch_bench", "-thread-cache"])),
+   "running fetch_bench with the per thread fetch cache");
@@ -0,0 +1,167 @@
+/*
+ * Copyright 2021 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License 2.0 (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * SSL_new()/SSL_free() microbenchmark.
+ *
+ * A server SSL_CTX is set up with a certificate, a chain certificate,
+ * signature algorithms, groups and ALPN, and SSL objects are created from it
+ * and freed again.  The rate of SSL_new()+SSL_free() pairs is reported
+ * together with the number of allocations and bytes allocated for each pair,
+ * which shows how much of the SSL_CTX state is copied into every connection.
+ *
+ * We use a proper main function here instead of the custom main from the
+ * test framework, because the memory functions that count the allocations
+ * must be installed before anything is allocated.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <openssl/crypto.h>
+#include <openssl/err.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include "helpers/bench.h"
+
+#define NEW_COUNT       1000
+#define MEASURE_COUNT   100
+
+static int counting = 0;
+static size_t alloc_count, alloc_bytes;
+
+static void *bench_malloc(size_t num, const char *file, int line)
+{
+    if (counting) {
+        alloc_count++;
+        alloc_bytes += num;
+    }
+    return malloc(num);
+}
+
+static void *bench_realloc(void *str, size_t num, const char *file, int line)
+{
+    if (num == 0) {
+        free(str);
+        return NULL;
+    }
+    if (counting) {
+        alloc_count++;
+        alloc_bytes += num;
+    }
+    return realloc(str, num);
+}
+
+static void bench_free(void *str, const char *file, int line)
+{
+    free(str);
+}
+
+static SSL_CTX *create_server_ctx(const char *certfile, const char *keyfile,
+                                  const char *chainfile)
+{
+    static const unsigned char alpn[] = {
+        2, 'h', '2', 8, 'h', 't', 't', 'p', '/', '1', '.', '1'
+    };
+    SSL_CTX *ctx = SSL_CTX_new(TLS_server_method());
+    X509 *chain = NULL;
+    BIO *in = NULL;
+
+    if (ctx == NULL
+            || SSL_CTX_use_certificate_file(ctx, certfile,
+                                            SSL_FILETYPE_PEM) <= 0
+            || SSL_CTX_use_PrivateKey_file(ctx, keyfile,
+                                           SSL_FILETYPE_PEM) <= 0
+            || (in = BIO_new_file(chainfile, "r")) == NULL
+            || (chain = PEM_read_bio_X509(in, NULL, NULL, NULL)) == NULL
+            || !SSL_CTX_add0_chain_cert(ctx, chain))
+        goto err;
+    chain = NULL;
+
+    if (!SSL_CTX_set1_sigalgs_list(ctx,
+                                   "RSA-PSS+SHA256:RSA+SHA256:ECDSA+SHA256")
+            || !SSL_CTX_set1_groups_list(ctx, "X25519:P-256:P-384")
+            || SSL_CTX_set_alpn_protos(ctx, alpn, sizeof(alpn)) != 0)
+        goto err;
+
+    BIO_free(in);
+    return ctx;
+
+ err:
+    X509_free(chain);
+    BIO_free(in);
+    SSL_CTX_free(ctx);
+    return NULL;
+}
+
+static int new_free(SSL_CTX *ctx, long count)
+{
+    SSL *s;
+    long i;
+
+    for (i = 0; i < count; i++) {
+        if ((s = SSL_new(ctx)) == NULL)
+            return 0;
+        SSL_free(s);
+    }
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    SSL_CTX *ctx = NULL;
+    long count = NEW_COUNT;
+    double start, elapsed;
+    int ret = EXIT_FAILURE;
+
+    if (!CRYPTO_set_mem_functions(bench_malloc, bench_realloc, bench_free)) {
+        fprintf(stderr, "Failed to set the memory functions\n");
+        return EXIT_FAILURE;
+    }
+
+    if (argc < 4 || argc > 5 || (argc == 5 && (count = atol(argv[4])) < 1)) {
+        fprintf(stderr, "Usage: %s certfile keyfile chainfile [count]\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if ((ctx = create_server_ctx(argv[1], argv[2], argv[3])) == NULL) {
+        fprintf(stderr, "Failed to create the SSL_CTX\n");
+        goto end;
+    }
+
+    /* The first SSL_new() may initialise things that are shared later on */
+    if (!new_free(ctx, 1))
+        goto err;
+
+    counting = 1;
+    if (!new_free(ctx, MEASURE_COUNT))
+        goto err;
+    counting = 0;
+
+    start = bench_time();
+    if (!new_free(ctx, count))
+        goto err;
+    elapsed = bench_time() - start;
+
+    printf("SSL_new+SSL_free: %12.0f/s, %6.1f allocations, %8.0f bytes"
+           " per connection\n",
+           elapsed > 0 ? count / elapsed : 0,
+           (double)alloc_count / MEASURE_COUNT,
+           (double)alloc_bytes / MEASURE_COUNT);
+    ret = EXIT_SUCCESS;
+    goto end;
+
+ err:
+    fprintf(stderr, "SSL_new() failed\n");
+ end:
+    if (ret != EXIT_SUCCESS)
+        ERR_print_errors_fp(stderr);
+    SSL_CTX_free(ctx);
+    return ret;
+}
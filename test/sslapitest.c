@@ -42,6 +42,12 @@
 #include "../ssl/ssl_local.h"
 #include "filterprov.h"
 
+#if defined(OPENSSL_SYS_UNIX)
+# include <sys/types.h>
+# include <sys/wait.h>
+# include <unistd.h>
+#endif
+
 #undef OSSL_NO_USABLE_TLS1_3
 #if defined(OPENSSL_NO_TLS1_3) \
     || (defined(OPENSSL_NO_EC) && defined(OPENSSL_NO_DH))
@@ -1140,6 +1146,23 @@ end:
     return 0;
 }
 
+#ifdef OPENSSL_KTLS_TLS13_KEY_UPDATE
+static int ktls_send_recv(SSL *sender, SSL *receiver)
+{
+    static const char msg[] = "after key update";
+    char buf[sizeof(msg)];
+    size_t written, readbytes;
+
+    if (!TEST_true(SSL_write_ex(sender, msg, sizeof(msg), &written)))
+        return 0;
+    while (!SSL_read_ex(receiver, buf, sizeof(buf), &readbytes)) {
+        if (!TEST_int_eq(SSL_get_error(receiver, 0), SSL_ERROR_WANT_READ))
+            return 0;
+    }
+    return TEST_mem_eq(buf, readbytes, msg, sizeof(msg));
+}
+#endif
+
 static int execute_test_ktls(int cis_ktls, int sis_ktls,
                              int tls_version, const char *cipher)
 {
@@ -1216,7 +1239,8 @@ static int execute_test_ktls(int cis_ktls, int sis_ktls,
 #if defined(OPENSSL_NO_KTLS_RX)
     rx_supported = 0;
 #else
-    rx_supported = (tls_version != TLS1_3_VERSION);
+    rx_supported = tls_version != TLS1_3_VERSION
+                   || ktls_tls13_key_update_supported();
 #endif
     if (!cis_ktls || !rx_supported) {
         if (!TEST_false(BIO_get_ktls_recv(clientssl->rbio)))
@@ -1244,6 +1268,18 @@ static int execute_test_ktls(int cis_ktls, int sis_ktls,
     if (!TEST_true(ping_pong_query(clientssl, serverssl)))
         goto end;
 
+#ifdef OPENSSL_KTLS_TLS13_KEY_UPDATE
+    /* Both sides update their keys, which must be passed to the kernel */
+    if (tls_version == TLS1_3_VERSION
+            && ktls_tls13_key_update_supported()
+            && (!TEST_true(SSL_key_update(clientssl,
+                                          SSL_KEY_UPDATE_REQUESTED))
+                || !TEST_true(ktls_send_recv(clientssl, serverssl))
+                || !TEST_true(ktls_send_recv(serverssl, clientssl))
+                || !TEST_true(ktls_send_recv(clientssl, serverssl))))
+        goto end;
+#endif
+
     testresult = 1;
 end:
     if (clientssl) {
@@ -8277,232 +8313,1617 @@ static int test_session_timeout(int test)
 }
 
 /*
- * Test 0: Client sets servername and server acknowledges it (TLSv1.2)
- * Test 1: Client sets servername and server does not acknowledge it (TLSv1.2)
- * Test 2: Client sets inconsistent servername on resumption (TLSv1.2)
- * Test 3: Client does not set servername on initial handshake (TLSv1.2)
- * Test 4: Client does not set servername on resumption handshake (TLSv1.2)
- * Test 5: Client sets servername and server acknowledges it (TLSv1.3)
- * Test 6: Client sets servername and server does not acknowledge it (TLSv1.3)
- * Test 7: Client sets inconsistent servername on resumption (TLSv1.3)
- * Test 8: Client does not set servername on initial handshake(TLSv1.3)
- * Test 9: Client does not set servername on resumption handshake (TLSv1.3)
+ * Test the sharded session cache: sessions are spread over the shards, the
+ * overall counters still add up, and adding a session retires the expired
+ * sessions of its shard.
  */
-static int test_servername(int tst)
+static int test_session_cache_shards(void)
 {
-    SSL_CTX *cctx = NULL, *sctx = NULL;
-    SSL *clientssl = NULL, *serverssl = NULL;
-    int testresult = 0;
-    SSL_SESSION *sess = NULL;
-    const char *sexpectedhost = NULL, *cexpectedhost = NULL;
-
-#ifdef OPENSSL_NO_TLS1_2
-    if (tst <= 4)
-        return 1;
-#endif
-#ifdef OSSL_NO_USABLE_TLS1_3
-    if (tst >= 5)
-        return 1;
-#endif
+#define SHARDS      8
+#define NUM_SESS    64
+    SSL_SESSION *sess[NUM_SESS + 1];
+    SSL_CTX *ctx;
+    long now = (long)time(NULL);
+    long total, used = 0;
+    int i, testresult = 0;
 
-    if (!TEST_true(create_ssl_ctx_pair(libctx, TLS_server_method(),
-                                       TLS_client_method(),
-                                       TLS1_VERSION,
-                                       (tst <= 4) ? TLS1_2_VERSION
-                                                  : TLS1_3_VERSION,
-                                       &sctx, &cctx, cert, privkey))
-            || !TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
-                                             NULL, NULL)))
+    memset(sess, 0, sizeof(sess));
+    if (!TEST_ptr(ctx = SSL_CTX_new_ex(libctx, NULL, TLS_method()))
+        || !TEST_long_eq(SSL_CTX_get_session_cache_shards(ctx), 1)
+        || !TEST_false(SSL_CTX_set_session_cache_shards(ctx, 0))
+        || !TEST_true(SSL_CTX_set_session_cache_shards(ctx, SHARDS))
+        || !TEST_long_eq(SSL_CTX_get_session_cache_shards(ctx), SHARDS))
         goto end;
 
-    if (tst != 1 && tst != 6) {
-        if (!TEST_true(SSL_CTX_set_tlsext_servername_callback(sctx,
-                                                              hostname_cb)))
+    for (i = 0; i < NUM_SESS + 1; i++) {
+        if (!TEST_ptr(sess[i] = SSL_SESSION_new()))
             goto end;
+        sess[i]->session_id_length = SSL3_SSL_SESSION_ID_LENGTH;
+        memset(sess[i]->session_id, i + 1, SSL3_SSL_SESSION_ID_LENGTH);
     }
-
-    if (tst != 3 && tst != 8) {
-        if (!TEST_true(SSL_set_tlsext_host_name(clientssl, "goodhost")))
+    for (i = 0; i < NUM_SESS; i++)
+        if (!TEST_int_eq(SSL_CTX_add_session(ctx, sess[i]), 1))
             goto end;
-        sexpectedhost = cexpectedhost = "goodhost";
-    }
 
-    if (!TEST_true(create_ssl_connection(serverssl, clientssl, SSL_ERROR_NONE)))
+    if (!TEST_long_eq(SSL_CTX_sess_number(ctx), NUM_SESS)
+        || !TEST_false(SSL_CTX_set_session_cache_shards(ctx, 4))
+        || !TEST_long_eq(SSL_CTX_sess_shard_number(ctx, SHARDS), -1))
         goto end;
+    for (i = 0, total = 0; i < SHARDS; i++) {
+        long n = SSL_CTX_sess_shard_number(ctx, i);
 
-    if (!TEST_str_eq(SSL_get_servername(clientssl, TLSEXT_NAMETYPE_host_name),
-                     cexpectedhost)
-            || !TEST_str_eq(SSL_get_servername(serverssl,
-                                               TLSEXT_NAMETYPE_host_name),
-                            sexpectedhost))
+        total += n;
+        if (n > 0)
+            used++;
+    }
+    if (!TEST_long_eq(total, NUM_SESS)
+        || !TEST_long_gt(used, 1))
         goto end;
 
-    /* Now repeat with a resumption handshake */
-
-    if (!TEST_int_eq(SSL_shutdown(clientssl), 0)
-            || !TEST_ptr_ne(sess = SSL_get1_session(clientssl), NULL)
-            || !TEST_true(SSL_SESSION_is_resumable(sess))
-            || !TEST_int_eq(SSL_shutdown(serverssl), 0))
+    /* Let all of them expire, then add one more */
+    for (i = 0; i < NUM_SESS; i++)
+        if (!TEST_int_ne(SSL_SESSION_set_time(sess[i], now - 100), 0)
+            || !TEST_int_ne(SSL_SESSION_set_timeout(sess[i], 10), 0))
+            goto end;
+    if (!TEST_int_eq(SSL_CTX_add_session(ctx, sess[NUM_SESS]), 1)
+        || !TEST_ptr(sess[NUM_SESS]->prev)
+        || !TEST_long_lt(SSL_CTX_sess_number(ctx), NUM_SESS))
         goto end;
 
-    SSL_free(clientssl);
-    SSL_free(serverssl);
-    clientssl = serverssl = NULL;
-
-    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl, NULL,
-                                      NULL)))
+    /* Removing and flushing still covers every shard */
+    if (!TEST_true(SSL_CTX_remove_session(ctx, sess[NUM_SESS]))
+        || !TEST_ptr_null(sess[NUM_SESS]->prev))
         goto end;
+    SSL_CTX_flush_sessions(ctx, now);
+    if (!TEST_long_eq(SSL_CTX_sess_number(ctx), 0))
+        goto end;
+    for (i = 0; i < NUM_SESS; i++)
+        if (!TEST_ptr_null(sess[i]->prev))
+            goto end;
 
-    if (!TEST_true(SSL_set_session(clientssl, sess)))
+    /* An empty cache can be resharded */
+    if (!TEST_true(SSL_CTX_set_session_cache_shards(ctx, 2))
+        || !TEST_int_eq(SSL_CTX_add_session(ctx, sess[0]), 1)
+        || !TEST_long_eq(SSL_CTX_sess_number(ctx), 1))
         goto end;
 
-    sexpectedhost = cexpectedhost = "goodhost";
-    if (tst == 2 || tst == 7) {
-        /* Set an inconsistent hostname */
-        if (!TEST_true(SSL_set_tlsext_host_name(clientssl, "altgoodhost")))
-            goto end;
-        /*
-         * In TLSv1.2 we expect the hostname from the original handshake, in
-         * TLSv1.3 we expect the hostname from this handshake
-         */
-        if (tst == 7)
-            sexpectedhost = cexpectedhost = "altgoodhost";
+    testresult = 1;
+ end:
+    SSL_CTX_free(ctx);
+    for (i = 0; i < NUM_SESS + 1; i++)
+        SSL_SESSION_free(sess[i]);
+    return testresult;
+#undef SHARDS
+#undef NUM_SESS
+}
 
-        if (!TEST_str_eq(SSL_get_servername(clientssl,
-                                            TLSEXT_NAMETYPE_host_name),
-                         "altgoodhost"))
-            goto end;
-    } else if (tst == 4 || tst == 9) {
-        /*
-         * A TLSv1.3 session does not associate a session with a servername,
-         * but a TLSv1.2 session does.
-         */
-        if (tst == 9)
-            sexpectedhost = cexpectedhost = NULL;
+#ifndef OPENSSL_NO_TLS1_2
+/*
+ * Create a TLSv1.2 server and client SSL_CTX pair, where the server finds
+ * sessions in |cache| only.
+ */
+static int create_shcache_ctx_pair(SSL_SHARED_SESSION_CACHE *cache,
+                                   SSL_CTX **sctx, SSL_CTX **cctx)
+{
+    static const unsigned char sid_ctx[] = "shcache";
 
-        if (!TEST_str_eq(SSL_get_servername(clientssl,
-                                            TLSEXT_NAMETYPE_host_name),
-                         cexpectedhost))
-            goto end;
-    } else {
-        if (!TEST_true(SSL_set_tlsext_host_name(clientssl, "goodhost")))
-            goto end;
-        /*
-         * In a TLSv1.2 resumption where the hostname was not acknowledged
-         * we expect the hostname on the server to be empty. On the client we
-         * return what was requested in this case.
-         *
-         * Similarly if the client didn't set a hostname on an original TLSv1.2
-         * session but is now, the server hostname will be empty, but the client
-         * is as we set it.
-         */
-        if (tst == 1 || tst == 3)
-            sexpectedhost = NULL;
+    if (!TEST_true(create_ssl_ctx_pair(libctx, TLS_server_method(),
+                                       TLS_client_method(), TLS1_2_VERSION,
+                                       TLS1_2_VERSION, sctx, cctx,
+                                       cert, privkey)))
+        return 0;
 
-        if (!TEST_str_eq(SSL_get_servername(clientssl,
-                                            TLSEXT_NAMETYPE_host_name),
-                         "goodhost"))
-            goto end;
+    SSL_CTX_set_options(*sctx, SSL_OP_NO_TICKET);
+    SSL_CTX_set_session_cache_mode(*sctx, SSL_SESS_CACHE_SERVER
+                                          | SSL_SESS_CACHE_NO_INTERNAL);
+    return TEST_true(SSL_CTX_set_session_id_context(*sctx, sid_ctx,
+                                                    sizeof(sid_ctx)))
+        && TEST_true(SSL_CTX_set1_shared_session_cache(*sctx, cache));
+}
+
+/*
+ * Connect to |sctx| from |cctx|, offering |sess| if not NULL.  On success
+ * |*reused| says whether the server resumed the session, and |*newsess| is
+ * set to the session of the client if |newsess| is not NULL.
+ */
+static int shcache_connect(SSL_CTX *sctx, SSL_CTX *cctx, SSL_SESSION *sess,
+                           int *reused, SSL_SESSION **newsess)
+{
+    SSL *serverssl = NULL, *clientssl = NULL;
+    int ret = 0;
+
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                      NULL, NULL))
+            || (sess != NULL && !TEST_true(SSL_set_session(clientssl, sess)))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE))
+            || (newsess != NULL
+                && !TEST_ptr(*newsess = SSL_get1_session(clientssl)))) {
+        SSL_free(serverssl);
+        SSL_free(clientssl);
+        return 0;
     }
+    *reused = SSL_session_reused(serverssl);
+    ret = 1;
+    shutdown_ssl_connection(serverssl, clientssl);
+    return ret;
+}
 
-    if (!TEST_true(create_ssl_connection(serverssl, clientssl, SSL_ERROR_NONE)))
+/*
+ * Test that a session established with one server SSL_CTX can be resumed with
+ * another one sharing the same shared session cache, as in separate worker
+ * processes, and that removing the session removes it for both.
+ */
+static int test_shared_session_cache(void)
+{
+    SSL_CTX *sctx1 = NULL, *sctx2 = NULL, *cctx = NULL, *cctx2 = NULL;
+    SSL_SHARED_SESSION_CACHE *cache = NULL;
+    SSL_SESSION *clntsess = NULL, *srvrsess = NULL;
+    SSL *serverssl = NULL, *clientssl = NULL;
+    int testresult = 0, reused;
+
+    if ((cache = SSL_SHARED_SESSION_CACHE_new(64, 0)) == NULL) {
+        testresult = TEST_skip("No shared session cache on this platform");
         goto end;
+    }
 
-    if (!TEST_true(SSL_session_reused(clientssl))
+    if (!create_shcache_ctx_pair(cache, &sctx1, &cctx)
+            || !create_shcache_ctx_pair(cache, &sctx2, &cctx2)
+            || !TEST_ptr_eq(SSL_CTX_get0_shared_session_cache(sctx2), cache))
+        goto end;
+
+    if (!shcache_connect(sctx1, cctx, NULL, &reused, &clntsess))
+        goto end;
+
+    /* Resume with the other server SSL_CTX */
+    if (!TEST_true(create_ssl_objects(sctx2, cctx, &serverssl, &clientssl,
+                                      NULL, NULL))
+            || !TEST_true(SSL_set_session(clientssl, clntsess))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE))
             || !TEST_true(SSL_session_reused(serverssl))
-            || !TEST_str_eq(SSL_get_servername(clientssl,
-                                               TLSEXT_NAMETYPE_host_name),
-                            cexpectedhost)
-            || !TEST_str_eq(SSL_get_servername(serverssl,
-                                               TLSEXT_NAMETYPE_host_name),
-                            sexpectedhost))
+            || !TEST_ptr(srvrsess = SSL_get1_session(serverssl)))
         goto end;
+    shutdown_ssl_connection(serverssl, clientssl);
+    serverssl = clientssl = NULL;
 
-    testresult = 1;
+    /*
+     * Once removed through one SSL_CTX, the other cannot resume it either.
+     * The return value only reports on the internal cache, which is not used.
+     */
+    SSL_CTX_remove_session(sctx1, srvrsess);
+    if (!shcache_connect(sctx2, cctx, clntsess, &reused, NULL)
+            || !TEST_false(reused))
+        goto end;
 
+    testresult = 1;
  end:
-    SSL_SESSION_free(sess);
     SSL_free(serverssl);
     SSL_free(clientssl);
-    SSL_CTX_free(sctx);
+    SSL_SESSION_free(clntsess);
+    SSL_SESSION_free(srvrsess);
+    SSL_SHARED_SESSION_CACHE_free(cache);
+    SSL_CTX_free(sctx1);
+    SSL_CTX_free(sctx2);
     SSL_CTX_free(cctx);
-
+    SSL_CTX_free(cctx2);
     return testresult;
 }
 
-#if !defined(OPENSSL_NO_EC) \
-    && (!defined(OSSL_NO_USABLE_TLS1_3) || !defined(OPENSSL_NO_TLS1_2))
+# if defined(OPENSSL_SYS_UNIX)
 /*
- * Test that if signature algorithms are not available, then we do not offer or
- * accept them.
- * Test 0: Two RSA sig algs available: both RSA sig algs shared
- * Test 1: The client only has SHA2-256: only SHA2-256 algorithms shared
- * Test 2: The server only has SHA2-256: only SHA2-256 algorithms shared
- * Test 3: An RSA and an ECDSA sig alg available: both sig algs shared
- * Test 4: The client only has an ECDSA sig alg: only ECDSA algorithms shared
- * Test 5: The server only has an ECDSA sig alg: only ECDSA algorithms shared
+ * Test the shared session cache across processes: a forked child stores a
+ * session and hands the client side of it to the parent, which then resumes
+ * it with its own server SSL_CTX.
  */
-static int test_sigalgs_available(int idx)
+static int test_shared_session_cache_fork(void)
 {
-    SSL_CTX *cctx = NULL, *sctx = NULL;
-    SSL *clientssl = NULL, *serverssl = NULL;
-    int testresult = 0;
-    OSSL_LIB_CTX *tmpctx = OSSL_LIB_CTX_new();
-    OSSL_LIB_CTX *clientctx = libctx, *serverctx = libctx;
-    OSSL_PROVIDER *filterprov = NULL;
-    int sig, hash;
-
-    if (!TEST_ptr(tmpctx))
-        goto end;
+    SSL_CTX *sctx = NULL, *cctx = NULL;
+    SSL_SHARED_SESSION_CACHE *cache = NULL;
+    SSL_SESSION *sess = NULL;
+    unsigned char der[8192];
+    const unsigned char *p = der;
+    ssize_t derlen = 0;
+    int fd[2], status, reused, testresult = 0;
+    pid_t pid;
 
-    if (idx != 0 && idx != 3) {
-        if (!TEST_true(OSSL_PROVIDER_add_builtin(tmpctx, "filter",
-                                                 filter_provider_init)))
-            goto end;
+    if ((cache = SSL_SHARED_SESSION_CACHE_new(64, 0)) == NULL)
+        return TEST_skip("No shared session cache on this platform");
 
-        filterprov = OSSL_PROVIDER_load(tmpctx, "filter");
-        if (!TEST_ptr(filterprov))
-            goto end;
+    if (!TEST_int_ge(pipe(fd), 0))
+        goto end;
+    if (!TEST_int_ge(pid = fork(), 0)) {
+        close(fd[0]);
+        close(fd[1]);
+        goto end;
+    }
 
-        if (idx < 3) {
-            /*
-             * Only enable SHA2-256 so rsa_pss_rsae_sha384 should not be offered
-             * or accepted for the peer that uses this libctx. Note that libssl
-             * *requires* SHA2-256 to be available so we cannot disable that. We
-             * also need SHA1 for our certificate.
-             */
-            if (!TEST_true(filter_provider_set_filter(OSSL_OP_DIGEST,
-                                                      "SHA2-256:SHA1")))
-                goto end;
-        } else {
-            if (!TEST_true(filter_provider_set_filter(OSSL_OP_SIGNATURE,
-                                                      "ECDSA"))
-                    || !TEST_true(filter_provider_set_filter(OSSL_OP_KEYMGMT,
-                                                             "EC:X25519:X448")))
-                goto end;
-        }
+    if (pid == 0) {
+        /* I'm the child: store a session and send it to the parent */
+        unsigned char *q = der;
+        int len, ok;
 
-        if (idx == 1 || idx == 4)
-            clientctx = tmpctx;
-        else
-            serverctx = tmpctx;
+        close(fd[0]);
+        ok = create_shcache_ctx_pair(cache, &sctx, &cctx)
+            && shcache_connect(sctx, cctx, NULL, &reused, &sess)
+            && TEST_int_gt(len = i2d_SSL_SESSION(sess, NULL), 0)
+            && TEST_size_t_le((size_t)len, sizeof(der))
+            && TEST_int_eq(i2d_SSL_SESSION(sess, &q), len)
+            && TEST_true(write(fd[1], der, len) == len);
+        close(fd[1]);
+        _exit(ok ? 0 : 1);
     }
 
-    cctx = SSL_CTX_new_ex(clientctx, NULL, TLS_client_method());
-    sctx = SSL_CTX_new_ex(serverctx, NULL, TLS_server_method());
-    if (!TEST_ptr(cctx) || !TEST_ptr(sctx))
+    /* I'm the parent: collect the session, then look it up myself */
+    close(fd[1]);
+    derlen = read(fd[0], der, sizeof(der));
+    close(fd[0]);
+    if (!TEST_int_eq(waitpid(pid, &status, 0), pid)
+            || !TEST_int_eq(status, 0)
+            || !TEST_int_gt((int)derlen, 0)
+            || !TEST_ptr(sess = d2i_SSL_SESSION(NULL, &p, (long)derlen)))
         goto end;
 
-    if (idx != 5) {
-        if (!TEST_true(create_ssl_ctx_pair(libctx, TLS_server_method(),
-                                           TLS_client_method(),
-                                           TLS1_VERSION,
-                                           0,
-                                           &sctx, &cctx, cert, privkey)))
-            goto end;
-    } else {
-        if (!TEST_true(create_ssl_ctx_pair(libctx, TLS_server_method(),
-                                           TLS_client_method(),
+    if (!create_shcache_ctx_pair(cache, &sctx, &cctx)
+            || !shcache_connect(sctx, cctx, sess, &reused, NULL)
+            || !TEST_true(reused))
+        goto end;
+
+    testresult = 1;
+ end:
+    SSL_SESSION_free(sess);
+    SSL_SHARED_SESSION_CACHE_free(cache);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    return testresult;
+}
+# endif
+#endif
+
+#if !defined(OPENSSL_NO_TLS1_2) && !defined(OSSL_NO_USABLE_TLS1_3)
+/*
+ * Offer |sess| with early data to |sctx| and check whether the early data was
+ * accepted or rejected as |status| says.
+ */
+static int shcache_early_data(SSL_CTX *sctx, SSL_CTX *cctx, SSL_SESSION *sess,
+                              int status)
+{
+    SSL *serverssl = NULL, *clientssl = NULL;
+    unsigned char buf[20];
+    size_t readbytes, written;
+    int ret = 0;
+
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                      NULL, NULL))
+            || !TEST_true(SSL_set_session(clientssl, sess))
+            || !TEST_true(SSL_write_early_data(clientssl, MSG1, strlen(MSG1),
+                                               &written)))
+        goto end;
+
+    if (status == SSL_EARLY_DATA_ACCEPTED) {
+        if (!TEST_int_eq(SSL_read_early_data(serverssl, buf, sizeof(buf),
+                                             &readbytes),
+                         SSL_READ_EARLY_DATA_SUCCESS)
+                || !TEST_mem_eq(MSG1, strlen(MSG1), buf, readbytes)
+                || !TEST_int_gt(SSL_connect(clientssl), 0)
+                || !TEST_int_eq(SSL_read_early_data(serverssl, buf,
+                                                    sizeof(buf), &readbytes),
+                                SSL_READ_EARLY_DATA_FINISH))
+            goto end;
+    } else if (!TEST_int_eq(SSL_read_early_data(serverssl, buf, sizeof(buf),
+                                                &readbytes),
+                            SSL_READ_EARLY_DATA_FINISH)) {
+        goto end;
+    }
+    if (!TEST_int_eq(SSL_get_early_data_status(serverssl), status)
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE)))
+        goto end;
+    ret = 1;
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    return ret;
+}
+
+/*
+ * Test that a ticket that allows early data is only accepted for early data
+ * once by two server SSL_CTXs sharing a shared session cache, as in separate
+ * worker processes.  The SSL_CTX that issued the ticket keeps it in its
+ * internal cache, and the other one adds it to its own when it finds it in
+ * the shared cache, so the internal caches alone can't stop the replay.
+ * Test 0: the second SSL_CTX takes the ticket first, the issuer sees a replay
+ * Test 1: the issuer takes the ticket first, the second SSL_CTX sees a replay
+ */
+static int test_shared_session_cache_early_data(int idx)
+{
+    static const unsigned char sid_ctx[] = "shcache";
+    SSL_CTX *sctx1 = NULL, *sctx2 = NULL, *cctx = NULL;
+    SSL_SHARED_SESSION_CACHE *cache = NULL;
+    SSL_SESSION *sess = NULL;
+    int testresult = 0, reused;
+
+    if ((cache = SSL_SHARED_SESSION_CACHE_new(64, 0)) == NULL)
+        return TEST_skip("No shared session cache on this platform");
+
+    if (!TEST_true(create_ssl_ctx_pair(libctx, TLS_server_method(),
+                                       TLS_client_method(), TLS1_3_VERSION,
+                                       TLS1_3_VERSION, &sctx1, &cctx,
+                                       cert, privkey))
+            || !TEST_true(create_ssl_ctx_pair(libctx, TLS_server_method(),
+                                              NULL, TLS1_3_VERSION,
+                                              TLS1_3_VERSION, &sctx2, NULL,
+                                              cert, privkey))
+            || !TEST_true(SSL_CTX_set_max_early_data(sctx1,
+                                                     SSL3_RT_MAX_PLAIN_LENGTH))
+            || !TEST_true(SSL_CTX_set_max_early_data(sctx2,
+                                                     SSL3_RT_MAX_PLAIN_LENGTH))
+            || !TEST_true(SSL_CTX_set_session_id_context(sctx1, sid_ctx,
+                                                         sizeof(sid_ctx)))
+            || !TEST_true(SSL_CTX_set_session_id_context(sctx2, sid_ctx,
+                                                         sizeof(sid_ctx)))
+            || !TEST_true(SSL_CTX_set1_shared_session_cache(sctx1, cache))
+            || !TEST_true(SSL_CTX_set1_shared_session_cache(sctx2, cache)))
+        goto end;
+
+    /* Get a ticket from sctx1 */
+    if (!shcache_connect(sctx1, cctx, NULL, &reused, &sess)
+            || !TEST_uint_gt(SSL_SESSION_get_max_early_data(sess), 0))
+        goto end;
+
+    if (!shcache_early_data(idx == 0 ? sctx2 : sctx1, cctx, sess,
+                            SSL_EARLY_DATA_ACCEPTED)
+            || !shcache_early_data(idx == 0 ? sctx1 : sctx2, cctx, sess,
+                                   SSL_EARLY_DATA_REJECTED))
+        goto end;
+
+    testresult = 1;
+ end:
+    SSL_SESSION_free(sess);
+    SSL_SHARED_SESSION_CACHE_free(cache);
+    SSL_CTX_free(sctx1);
+    SSL_CTX_free(sctx2);
+    SSL_CTX_free(cctx);
+    return testresult;
+}
+#endif
+
+static int bio_write_calls = 0;
+
+static long count_writes_cb(BIO *bio, int oper, const char *argp, size_t len,
+                            int argi, long argl, int ret, size_t *processed)
+{
+    if (oper == (BIO_CB_WRITE | BIO_CB_RETURN) && ret > 0)
+        bio_write_calls++;
+    return ret;
+}
+
+/*
+ * Test that with max_pipelines and SSL_MODE_BATCH_AEAD_WRITES set, several
+ * records are sealed with an AEAD cipher that has no pipeline support and
+ * written out in one go, and that they are written one by one without the
+ * mode.
+ * Test 0: TLSv1.2 with AES-GCM
+ * Test 1: TLSv1.3
+ * Test 2: TLSv1.3 without SSL_MODE_BATCH_AEAD_WRITES
+ */
+static int test_record_batching(int tst)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    unsigned char *msg = NULL, *buf = NULL;
+    size_t msglen = 4 * SSL3_RT_MAX_PLAIN_LENGTH;
+    size_t len, written, readbytes, total;
+    int version = tst == 0 ? TLS1_2_VERSION : TLS1_3_VERSION;
+    int batch = tst != 2;
+    static const char tls12_cipher[] = "ECDHE-RSA-AES128-GCM-SHA256";
+    size_t i;
+    int testresult = 0;
+
+#ifdef OPENSSL_NO_TLS1_2
+    if (tst == 0)
+        return TEST_skip("No TLSv1.2 in this build");
+#endif
+#ifdef OSSL_NO_USABLE_TLS1_3
+    if (tst != 0)
+        return TEST_skip("No TLSv1.3 in this build");
+#endif
+
+    if (!TEST_ptr(msg = OPENSSL_malloc(msglen))
+            || !TEST_ptr(buf = OPENSSL_malloc(msglen)))
+        goto end;
+    for (i = 0; i < msglen; i++)
+        msg[i] = (unsigned char)(i * 7);
+
+    if (!TEST_true(create_ssl_ctx_pair(libctx, TLS_server_method(),
+                                       TLS_client_method(), version, version,
+                                       &sctx, &cctx, cert, privkey))
+            || (tst == 0
+                && !TEST_true(SSL_CTX_set_cipher_list(cctx, tls12_cipher)))
+            || !TEST_true(SSL_CTX_set_max_pipelines(cctx, 4)))
+        goto end;
+    if (batch)
+        SSL_CTX_set_mode(cctx, SSL_MODE_BATCH_AEAD_WRITES);
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                      NULL, NULL))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE)))
+        goto end;
+
+    BIO_set_callback_ex(SSL_get_wbio(clientssl), count_writes_cb);
+
+    /* Full records first, then records that are only partly filled */
+    for (len = msglen; len > msglen - 2000; len -= 1000) {
+        bio_write_calls = 0;
+        if (!TEST_true(SSL_write_ex(clientssl, msg, len, &written))
+                || !TEST_size_t_eq(written, len)
+                || !TEST_int_eq(bio_write_calls, batch ? 1 : 4))
+            goto end;
+
+        for (total = 0; total < len; total += readbytes) {
+            if (!TEST_true(SSL_read_ex(serverssl, buf + total, len - total,
+                                       &readbytes)))
+                goto end;
+        }
+        if (!TEST_mem_eq(buf, len, msg, len))
+            goto end;
+    }
+
+    testresult = 1;
+ end:
+    OPENSSL_free(msg);
+    OPENSSL_free(buf);
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    return testresult;
+}
+
+/*
+ * Test SSL_writev_ex()
+ * Test 0: Small fragments that fit into a single record
+ * Test 1: Fragments of all sizes, some spanning several records
+ */
+static int test_writev(int tst)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    static const size_t small[] = { 0, 120, 1000, 1, 1000 };
+    static const size_t mixed[] = { 300, 40000, 500, 0, 20000, 16384, 7 };
+    const size_t *lens = tst == 0 ? small : mixed;
+    size_t nbufs = tst == 0 ? OSSL_NELEM(small) : OSSL_NELEM(mixed);
+    const void *bufs[OSSL_NELEM(mixed)];
+    unsigned char *msg = NULL, *buf = NULL;
+    size_t total = 0, written, readbytes, i;
+    int testresult = 0;
+
+    for (i = 0; i < nbufs; i++)
+        total += lens[i];
+    if (!TEST_ptr(msg = OPENSSL_malloc(total))
+            || !TEST_ptr(buf = OPENSSL_malloc(total)))
+        goto end;
+    for (i = 0; i < total; i++)
+        msg[i] = (unsigned char)(i * 13);
+    for (i = 0, written = 0; i < nbufs; written += lens[i++])
+        bufs[i] = msg + written;
+
+    if (!TEST_true(create_ssl_ctx_pair(libctx, TLS_server_method(),
+                                       TLS_client_method(), TLS1_VERSION, 0,
+                                       &sctx, &cctx, cert, privkey))
+            || !TEST_true(create_ssl_objects(sctx, cctx, &serverssl,
+                                             &clientssl, NULL, NULL))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE)))
+        goto end;
+
+    BIO_set_callback_ex(SSL_get_wbio(clientssl), count_writes_cb);
+    bio_write_calls = 0;
+    if (!TEST_true(SSL_writev_ex(clientssl, bufs, lens, nbufs, &written))
+            || !TEST_size_t_eq(written, total)
+            || (tst == 0 && !TEST_int_eq(bio_write_calls, 1)))
+        goto end;
+
+    for (written = 0; written < total; written += readbytes) {
+        if (!TEST_true(SSL_read_ex(serverssl, buf + written, total - written,
+                                   &readbytes)))
+            goto end;
+    }
+    if (!TEST_mem_eq(buf, total, msg, total))
+        goto end;
+
+    testresult = 1;
+ end:
+    OPENSSL_free(msg);
+    OPENSSL_free(buf);
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    return testresult;
+}
+
+/*
+ * Read everything that is available on |ssl| into |buf| at |*got|.
+ */
+static int writev_drain(SSL *ssl, unsigned char *buf, size_t len, size_t *got)
+{
+    size_t readbytes;
+
+    while (*got < len) {
+        if (!SSL_read_ex(ssl, buf + *got, len - *got, &readbytes))
+            return TEST_int_eq(SSL_get_error(ssl, 0), SSL_ERROR_WANT_READ);
+        *got += readbytes;
+    }
+    return 1;
+}
+
+/*
+ * Test SSL_writev_ex() over a transport that only takes part of the data at a
+ * time, so that writes are interrupted and have to be retried.
+ * Test 0: Retry with the same fragments
+ * Test 1: SSL_MODE_ENABLE_PARTIAL_WRITE, retry with the remaining data
+ */
+static int test_writev_retry(int tst)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    BIO *cbio = NULL, *sbio = NULL;
+    static const size_t lens[] = { 100, 3000, 1, 20000, 700, 9000, 2 };
+    const void *bufs[OSSL_NELEM(lens)], *rbufs[OSSL_NELEM(lens)];
+    size_t rlens[OSSL_NELEM(lens)];
+    unsigned char *msg = NULL, *buf = NULL;
+    size_t total = 0, done = 0, got = 0, written, skip, nbufs, i;
+    int retries = 0, testresult = 0;
+
+    for (i = 0; i < OSSL_NELEM(lens); i++)
+        total += lens[i];
+    if (!TEST_ptr(msg = OPENSSL_malloc(total))
+            || !TEST_ptr(buf = OPENSSL_malloc(total)))
+        goto end;
+    for (i = 0; i < total; i++)
+        msg[i] = (unsigned char)(i * 29);
+    for (i = 0, written = 0; i < OSSL_NELEM(lens); written += lens[i++])
+        bufs[i] = msg + written;
+
+    if (!TEST_true(create_ssl_ctx_pair(libctx, TLS_server_method(),
+                                       TLS_client_method(), TLS1_VERSION, 0,
+                                       &sctx, &cctx, cert, privkey))
+            || !TEST_true(create_ssl_objects(sctx, cctx, &serverssl,
+                                             &clientssl, NULL, NULL))
+            || !TEST_true(BIO_new_bio_pair(&cbio, 4096, &sbio, 4096)))
+        goto end;
+    SSL_set_bio(clientssl, cbio, cbio);
+    SSL_set_bio(serverssl, sbio, sbio);
+    if (!TEST_true(create_ssl_connection(serverssl, clientssl,
+                                         SSL_ERROR_NONE)))
+        goto end;
+    if (tst == 1)
+        SSL_set_mode(clientssl, SSL_MODE_ENABLE_PARTIAL_WRITE);
+
+    while (done < total) {
+        /* With partial writes, only pass what is left */
+        for (i = 0, nbufs = 0, skip = tst == 1 ? done : 0;
+             i < OSSL_NELEM(lens); i++) {
+            if (skip >= lens[i]) {
+                skip -= lens[i];
+                continue;
+            }
+            rbufs[nbufs] = (const unsigned char *)bufs[i] + skip;
+            rlens[nbufs++] = lens[i] - skip;
+            skip = 0;
+        }
+
+        if (SSL_writev_ex(clientssl, rbufs, rlens, nbufs, &written)) {
+            if (!TEST_size_t_le(written, total - done))
+                goto end;
+            done += written;
+            if (tst == 0 && !TEST_size_t_eq(done, total))
+                goto end;
+        } else {
+            if (!TEST_int_eq(SSL_get_error(clientssl, 0),
+                             SSL_ERROR_WANT_WRITE))
+                goto end;
+            retries++;
+        }
+        if (!writev_drain(serverssl, buf, total, &got))
+            goto end;
+    }
+    if (!writev_drain(serverssl, buf, total, &got)
+            || !TEST_int_gt(retries, 0)
+            || !TEST_mem_eq(buf, got, msg, total))
+        goto end;
+
+    testresult = 1;
+ end:
+    OPENSSL_free(msg);
+    OPENSSL_free(buf);
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    return testresult;
+}
+
+/*
+ * Test SSL_MODE_DECRYPT_INTO_APP_BUFFER
+ * Test 0: Buffers large enough for whole records
+ * Test 1: Buffers too small for whole records
+ */
+static int test_read_into_app_buffer(int tst)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    unsigned char *msg = NULL, *buf = NULL;
+    size_t msglen = 3 * SSL3_RT_MAX_PLAIN_LENGTH + 100;
+    size_t bufsize = tst == 0 ? SSL3_RT_MAX_PLAIN_LENGTH + 1 : 1000;
+    size_t written, readbytes, total, i;
+    int testresult = 0;
+
+    if (!TEST_ptr(msg = OPENSSL_malloc(msglen))
+            || !TEST_ptr(buf = OPENSSL_malloc(msglen + bufsize)))
+        goto end;
+    for (i = 0; i < msglen; i++)
+        msg[i] = (unsigned char)(i * 17);
+
+    /* The client receives the tickets as well, with the mode set */
+    if (!TEST_true(create_ssl_ctx_pair(libctx, TLS_server_method(),
+                                       TLS_client_method(), TLS1_3_VERSION,
+                                       TLS1_3_VERSION, &sctx, &cctx, cert,
+                                       privkey)))
+        goto end;
+    SSL_CTX_set_mode(cctx, SSL_MODE_DECRYPT_INTO_APP_BUFFER);
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                      NULL, NULL))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE))
+            || !TEST_true(SSL_write_ex(serverssl, msg, msglen, &written))
+            || !TEST_size_t_eq(written, msglen))
+        goto end;
+
+    for (total = 0; total < msglen; total += readbytes) {
+        if (!TEST_true(SSL_read_ex(clientssl, buf + total, bufsize,
+                                   &readbytes)))
+            goto end;
+    }
+    if (!TEST_mem_eq(buf, total, msg, msglen))
+        goto end;
+
+    /* The connection is still usable in both directions */
+    if (!TEST_true(SSL_write_ex(clientssl, msg, 100, &written))
+            || !TEST_true(SSL_read_ex(serverssl, buf, bufsize, &readbytes))
+            || !TEST_mem_eq(buf, readbytes, msg, 100))
+        goto end;
+
+    testresult = 1;
+ end:
+    OPENSSL_free(msg);
+    OPENSSL_free(buf);
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    return testresult;
+}
+
+/*
+ * Test that with SSL_MODE_DECRYPT_INTO_APP_BUFFER, the buffer passed to
+ * SSL_read() is wiped of anything that is not valid application data.
+ * Test 0: A record with a corrupted tag
+ * Test 1: A KeyUpdate message, which is processed out of the read buffer
+ */
+static int test_read_into_app_buffer_cleanse(int tst)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    static const unsigned char zeros[64];
+    unsigned char msg[sizeof(zeros)], buf[1000];
+    char *data;
+    long datalen;
+    /* The whole message, or the KeyUpdate message header and body */
+    size_t wiped = tst == 0 ? sizeof(msg) : SSL3_HM_HEADER_LENGTH + 1;
+    size_t written, readbytes;
+    int testresult = 0;
+
+#ifdef OSSL_NO_USABLE_TLS1_3
+    return TEST_skip("No TLSv1.3 in this build");
+#endif
+
+    memset(msg, 'A', sizeof(msg));
+    memset(buf, 0xff, sizeof(buf));
+
+    if (!TEST_true(create_ssl_ctx_pair(libctx, TLS_server_method(),
+                                       TLS_client_method(), TLS1_3_VERSION,
+                                       TLS1_3_VERSION, &sctx, &cctx, cert,
+                                       privkey)))
+        goto end;
+    SSL_CTX_set_mode(cctx, SSL_MODE_DECRYPT_INTO_APP_BUFFER);
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                      NULL, NULL))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE)))
+        goto end;
+
+    if (tst == 0) {
+        if (!TEST_true(SSL_write_ex(serverssl, msg, sizeof(msg), &written))
+                || !TEST_long_gt(datalen = BIO_get_mem_data(
+                                     SSL_get_rbio(clientssl), &data), 0))
+            goto end;
+        /* Flip a bit of the tag at the end of the record */
+        data[datalen - 1] ^= 1;
+        if (!TEST_false(SSL_read_ex(clientssl, buf, sizeof(buf), &readbytes))
+                || !TEST_int_eq(SSL_get_error(clientssl, 0), SSL_ERROR_SSL))
+            goto end;
+    } else {
+        if (!TEST_true(SSL_key_update(serverssl,
+                                      SSL_KEY_UPDATE_NOT_REQUESTED))
+                || !TEST_int_eq(SSL_do_handshake(serverssl), 1)
+                || !TEST_false(SSL_read_ex(clientssl, buf, sizeof(buf),
+                                           &readbytes))
+                || !TEST_int_eq(SSL_get_error(clientssl, 0),
+                                SSL_ERROR_WANT_READ))
+            goto end;
+    }
+
+    /* Whatever was decrypted into the buffer has been wiped */
+    if (!TEST_mem_eq(buf, wiped, zeros, wiped))
+        goto end;
+
+    testresult = 1;
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    return testresult;
+}
+
+static int test_peek_record(void)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    static const char msg1[] = "first record", msg2[] = "second record";
+    const unsigned char *data;
+    unsigned char buf[sizeof(msg2)];
+    size_t len, written, readbytes;
+    int testresult = 0;
+
+    if (!TEST_true(create_ssl_ctx_pair(libctx, TLS_server_method(),
+                                       TLS_client_method(), TLS1_VERSION, 0,
+                                       &sctx, &cctx, cert, privkey))
+            || !TEST_true(create_ssl_objects(sctx, cctx, &serverssl,
+                                             &clientssl, NULL, NULL))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE))
+            || !TEST_true(SSL_write_ex(serverssl, msg1, sizeof(msg1),
+                                       &written))
+            || !TEST_true(SSL_write_ex(serverssl, msg2, sizeof(msg2),
+                                       &written)))
+        goto end;
+
+    /* Only the data of the first record is returned */
+    if (!TEST_true(SSL_peek_record_ex(clientssl, &data, &len))
+            || !TEST_mem_eq(data, len, msg1, sizeof(msg1))
+            || !TEST_false(SSL_consume(clientssl, len + 1))
+            || !TEST_true(SSL_consume(clientssl, 6))
+            || !TEST_true(SSL_peek_record_ex(clientssl, &data, &len))
+            || !TEST_mem_eq(data, len, msg1 + 6, sizeof(msg1) - 6)
+            || !TEST_true(SSL_consume(clientssl, len)))
+        goto end;
+
+    /* The next record can be peeked at or read as usual */
+    if (!TEST_true(SSL_peek_record_ex(clientssl, &data, &len))
+            || !TEST_mem_eq(data, len, msg2, sizeof(msg2))
+            || !TEST_true(SSL_read_ex(clientssl, buf, sizeof(buf), &readbytes))
+            || !TEST_mem_eq(buf, readbytes, msg2, sizeof(msg2))
+            || !TEST_int_eq(SSL_pending(clientssl), 0))
+        goto end;
+
+    testresult = 1;
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    return testresult;
+}
+
+static int test_buffer_pool(void)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    static const char msg[] = "pooled";
+    unsigned char buf[sizeof(msg)];
+    size_t written, readbytes;
+    int testresult = 0, i;
+
+    if (!TEST_true(create_ssl_ctx_pair(libctx, TLS_server_method(),
+                                       TLS_client_method(), TLS1_VERSION, 0,
+                                       &sctx, &cctx, cert, privkey))
+            || !TEST_long_eq(SSL_CTX_get_buffer_pool_size(sctx), 0)
+            || !TEST_false(SSL_CTX_set_buffer_pool_size(sctx, -1))
+            /* Enough for every part of the pool to keep some buffers */
+            || !TEST_true(SSL_CTX_set_buffer_pool_size(sctx, 16))
+            || !TEST_long_eq(SSL_CTX_get_buffer_pool_size(sctx), 16))
+        goto end;
+    SSL_CTX_set_mode(sctx, SSL_MODE_RELEASE_BUFFERS);
+
+    for (i = 0; i < 3; i++) {
+        if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                          NULL, NULL))
+                || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                    SSL_ERROR_NONE))
+                || !TEST_true(SSL_write_ex(serverssl, msg, sizeof(msg),
+                                           &written))
+                || !TEST_true(SSL_read_ex(clientssl, buf, sizeof(buf),
+                                          &readbytes))
+                || !TEST_true(SSL_write_ex(clientssl, msg, sizeof(msg),
+                                           &written))
+                || !TEST_true(SSL_read_ex(serverssl, buf, sizeof(buf),
+                                          &readbytes))
+                || !TEST_mem_eq(buf, readbytes, msg, sizeof(msg)))
+            goto end;
+        /* With released buffers the idle connection borrows nothing */
+        if (!TEST_long_eq(SSL_CTX_buffer_pool_in_use(sctx), 0))
+            goto end;
+        SSL_free(serverssl);
+        SSL_free(clientssl);
+        serverssl = clientssl = NULL;
+    }
+
+    if (!TEST_long_gt(SSL_CTX_buffer_pool_hits(sctx), 0)
+            || !TEST_long_gt(SSL_CTX_buffer_pool_misses(sctx), 0)
+            || !TEST_long_ge(SSL_CTX_buffer_pool_peak_in_use(sctx), 1)
+            || !TEST_long_gt(SSL_CTX_buffer_pool_cached(sctx), 0)
+            || !TEST_long_le(SSL_CTX_buffer_pool_cached(sctx), 16)
+            || !TEST_true(SSL_CTX_set_buffer_pool_size(sctx, 0))
+            || !TEST_long_eq(SSL_CTX_buffer_pool_cached(sctx), 0))
+        goto end;
+
+    testresult = 1;
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    return testresult;
+}
+
+/*
+ * An SSL shares the certificate configuration of its SSL_CTX until one of
+ * them changes it: changes must not leak from one to the other.
+ */
+static int test_shared_cert(void)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL, *serverssl2 = NULL;
+    STACK_OF(X509) *chain = NULL;
+    BIO *certbio = NULL;
+    X509 *x = NULL;
+    int testresult = 0, level;
+
+    if (!TEST_true(create_ssl_ctx_pair(libctx, TLS_server_method(),
+                                       TLS_client_method(), TLS1_VERSION, 0,
+                                       &sctx, &cctx, cert, privkey))
+            || !TEST_ptr(certbio = BIO_new_file(cert, "r"))
+            || !TEST_ptr(x = X509_new_ex(libctx, NULL))
+            || !TEST_ptr(PEM_read_bio_X509(certbio, &x, NULL, NULL))
+            || !TEST_true(create_ssl_objects(sctx, cctx, &serverssl,
+                                             &clientssl, NULL, NULL))
+            || !TEST_ptr_eq(SSL_get_certificate(serverssl),
+                            SSL_CTX_get0_certificate(sctx)))
+        goto end;
+
+    /* Changes made through the SSL stay with the SSL */
+    level = SSL_CTX_get_security_level(sctx);
+    SSL_set_security_level(serverssl, 0);
+    if (!TEST_int_eq(SSL_get_security_level(serverssl), 0)
+            || !TEST_int_eq(SSL_CTX_get_security_level(sctx), level)
+            || !TEST_true(SSL_add1_chain_cert(serverssl, x))
+            || !TEST_true(SSL_CTX_get0_chain_certs(sctx, &chain))
+            || !TEST_ptr_null(chain)
+            || !TEST_true(SSL_get0_chain_certs(serverssl, &chain))
+            || !TEST_int_eq(sk_X509_num(chain), 1))
+        goto end;
+
+    /* ...and changes made through the SSL_CTX stay with the SSL_CTX */
+    if (!TEST_ptr(serverssl2 = SSL_new(sctx)))
+        goto end;
+    SSL_CTX_set_security_level(sctx, level + 1);
+    if (!TEST_int_eq(SSL_get_security_level(serverssl2), level)
+            || !TEST_true(SSL_CTX_add1_chain_cert(sctx, x))
+            || !TEST_true(SSL_get0_chain_certs(serverssl2, &chain))
+            || !TEST_ptr_null(chain))
+        goto end;
+    SSL_free(serverssl2);
+    if (!TEST_ptr(serverssl2 = SSL_new(sctx))
+            || !TEST_int_eq(SSL_get_security_level(serverssl2), level + 1)
+            || !TEST_true(SSL_get0_chain_certs(serverssl2, &chain))
+            || !TEST_int_eq(sk_X509_num(chain), 1))
+        goto end;
+
+    if (!TEST_true(create_ssl_connection(serverssl, clientssl,
+                                         SSL_ERROR_NONE))
+            || !TEST_ptr_eq(SSL_get_certificate(serverssl),
+                            SSL_CTX_get0_certificate(sctx)))
+        goto end;
+
+    testresult = 1;
+ end:
+    X509_free(x);
+    BIO_free(certbio);
+    SSL_free(serverssl2);
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    return testresult;
+}
+
+struct ch_parts {
+    unsigned char *ciphers, *sigalgs, *groups;
+    size_t ciphers_len, sigalgs_len, groups_len;
+};
+
+static unsigned char *ch_ext_dup(SSL *s, unsigned int type, size_t *len)
+{
+    const unsigned char *p;
+
+    if (!SSL_client_hello_get0_ext(s, type, &p, len)) {
+        *len = 0;
+        return NULL;
+    }
+    return OPENSSL_memdup(p, *len);
+}
+
+static int ch_parts_cb(SSL *s, int *al, void *arg)
+{
+    struct ch_parts *parts = arg;
+    const unsigned char *p;
+
+    parts->ciphers_len = SSL_client_hello_get0_ciphers(s, &p);
+    parts->ciphers = OPENSSL_memdup(p, parts->ciphers_len);
+    parts->sigalgs = ch_ext_dup(s, TLSEXT_TYPE_signature_algorithms,
+                                &parts->sigalgs_len);
+    parts->groups = ch_ext_dup(s, TLSEXT_TYPE_supported_groups,
+                               &parts->groups_len);
+    return SSL_CLIENT_HELLO_SUCCESS;
+}
+
+static int ch_parts_connect(SSL_CTX *sctx, SSL_CTX *cctx, const char *groups,
+                            struct ch_parts *parts)
+{
+    SSL *clientssl = NULL, *serverssl = NULL;
+    int ret = 0;
+
+    SSL_CTX_set_client_hello_cb(sctx, ch_parts_cb, parts);
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                      NULL, NULL)))
+        goto end;
+    if (groups != NULL && !TEST_true(SSL_set1_groups_list(clientssl, groups)))
+        goto end;
+    if (!TEST_true(create_ssl_connection(serverssl, clientssl,
+                                         SSL_ERROR_NONE)))
+        goto end;
+
+    ret = 1;
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    return ret;
+}
+
+/*
+ * Clients copy parts of their ClientHello from a template kept in the SSL_CTX
+ * after the first one. Check that the copies match the original, and that
+ * configuration changes are not masked by the template.
+ */
+static int test_ch_template(void)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    struct ch_parts parts[5];
+    static const unsigned char pss_sha256[] = { 0x00, 0x02, 0x08, 0x04 };
+#ifndef OPENSSL_NO_EC
+    static const unsigned char p256[] = { 0x00, 0x02, 0x00, 0x17 };
+#endif
+    int testresult = 0;
+    size_t i;
+
+    memset(parts, 0, sizeof(parts));
+    if (!TEST_true(create_ssl_ctx_pair(libctx, TLS_server_method(),
+                                       TLS_client_method(), TLS1_VERSION, 0,
+                                       &sctx, &cctx, cert, privkey))
+            || !ch_parts_connect(sctx, cctx, NULL, &parts[0])
+            || !ch_parts_connect(sctx, cctx, NULL, &parts[1])
+            || !TEST_mem_eq(parts[0].ciphers, parts[0].ciphers_len,
+                            parts[1].ciphers, parts[1].ciphers_len)
+            || !TEST_mem_eq(parts[0].sigalgs, parts[0].sigalgs_len,
+                            parts[1].sigalgs, parts[1].sigalgs_len)
+            || !TEST_mem_eq(parts[0].groups, parts[0].groups_len,
+                            parts[1].groups, parts[1].groups_len))
+        goto end;
+
+    /* Changes to the SSL_CTX are picked up by the next connection */
+    if (!TEST_true(SSL_CTX_set1_sigalgs_list(cctx, "rsa_pss_rsae_sha256"))
+            || !ch_parts_connect(sctx, cctx, NULL, &parts[2])
+            || !TEST_mem_eq(parts[2].sigalgs, parts[2].sigalgs_len,
+                            pss_sha256, sizeof(pss_sha256))
+            || !TEST_true(SSL_CTX_set_cipher_list(cctx, "AES128-SHA"))
+            || !ch_parts_connect(sctx, cctx, NULL, &parts[3])
+            || !TEST_mem_ne(parts[2].ciphers, parts[2].ciphers_len,
+                            parts[3].ciphers, parts[3].ciphers_len))
+        goto end;
+
+#ifndef OPENSSL_NO_EC
+    /* So are changes to the SSL, which leave the template of the SSL_CTX */
+    if (!ch_parts_connect(sctx, cctx, "P-256", &parts[4])
+            || !TEST_mem_eq(parts[4].groups, parts[4].groups_len,
+                            p256, sizeof(p256))
+            || !TEST_mem_eq(parts[3].ciphers, parts[3].ciphers_len,
+                            parts[4].ciphers, parts[4].ciphers_len))
+        goto end;
+#endif
+
+    testresult = 1;
+ end:
+    for (i = 0; i < OSSL_NELEM(parts); i++) {
+        OPENSSL_free(parts[i].ciphers);
+        OPENSSL_free(parts[i].sigalgs);
+        OPENSSL_free(parts[i].groups);
+    }
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    return testresult;
+}
+
+static int allow_all_security_cb(const SSL *s, const SSL_CTX *ctx, int op,
+                                 int bits, int nid, void *other, void *ex)
+{
+    return 1;
+}
+
+/*
+ * Shared sigalgs and groups are filtered by the security level, which is
+ * looked up in tables precomputed by the SSL_CTX unless the SSL has a custom
+ * security callback.
+ * Test 0: sigalgs at security level 0
+ * Test 1: sigalgs at security level 1
+ * Test 2: groups
+ */
+static int test_shared_seclevel(int tst)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    int testresult = 0;
+
+#ifdef OPENSSL_NO_EC
+    if (tst == 2)
+        return TEST_skip("No EC support");
+#endif
+
+    if (!TEST_true(create_ssl_ctx_pair(libctx, TLS_server_method(),
+                                       TLS_client_method(), TLS1_VERSION, 0,
+                                       &sctx, &cctx, cert, privkey)))
+        goto end;
+    SSL_CTX_set_security_level(cctx, 0);
+    SSL_CTX_set_security_level(sctx, tst == 0 ? 0 : 1);
+    if (!TEST_true(SSL_CTX_set1_sigalgs_list(cctx,
+                                             "rsa_pkcs1_sha1:"
+                                             "rsa_pss_rsae_sha256"))
+            || !TEST_true(create_ssl_objects(sctx, cctx, &serverssl,
+                                             &clientssl, NULL, NULL)))
+        goto end;
+    if (tst == 2
+            && !TEST_true(SSL_set1_groups_list(clientssl, "P-256:P-384")))
+        goto end;
+    if (!TEST_true(create_ssl_connection(serverssl, clientssl,
+                                         SSL_ERROR_NONE)))
+        goto end;
+
+    if (tst < 2) {
+        /* SHA1 has less than the 80 bits of security of level 1 */
+        if (!TEST_int_eq(SSL_get_shared_sigalgs(serverssl, 0, NULL, NULL, NULL,
+                                                NULL, NULL), 2 - tst))
+            goto end;
+    } else {
+        if (!TEST_int_eq(SSL_get_shared_group(serverssl, 0),
+                         NID_X9_62_prime256v1)
+                || !TEST_int_eq(SSL_get_shared_group(serverssl, -1), 2))
+            goto end;
+        /* Only P-384 has the 192 bits of security of level 4 */
+        SSL_set_security_level(serverssl, 4);
+        if (!TEST_int_eq(SSL_get_shared_group(serverssl, 0), NID_secp384r1)
+                || !TEST_int_eq(SSL_get_shared_group(serverssl, -1), 1))
+            goto end;
+        SSL_set_security_callback(serverssl, allow_all_security_cb);
+        if (!TEST_int_eq(SSL_get_shared_group(serverssl, -1), 2))
+            goto end;
+    }
+
+    testresult = 1;
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    return testresult;
+}
+
+static EVP_PKEY *pkey_method_key = NULL;
+static unsigned char *pkey_method_tbs = NULL;
+static size_t pkey_method_tbslen = 0;
+static int pkey_method_calls = 0;
+
+/*
+ * Signs with rsa_pss_rsae_sha256, but only when called for the second time
+ * with the same data.
+ */
+static int pkey_method_sign_cb(SSL *s, unsigned char *sig, size_t *siglen,
+                               size_t sigsize, int sigalg,
+                               const unsigned char *tbs, size_t tbslen,
+                               void *arg)
+{
+    EVP_MD_CTX *mctx = NULL;
+    EVP_PKEY_CTX *pctx = NULL;
+    int ret = 0;
+
+    if (pkey_method_calls++ % 2 == 0) {
+        OPENSSL_free(pkey_method_tbs);
+        pkey_method_tbs = OPENSSL_memdup(tbs, tbslen);
+        pkey_method_tbslen = tbslen;
+        return pkey_method_tbs != NULL ? -1 : 0;
+    }
+    if (!TEST_int_eq(sigalg, TLSEXT_SIGALG_rsa_pss_rsae_sha256)
+            || !TEST_mem_eq(tbs, tbslen, pkey_method_tbs, pkey_method_tbslen)
+            || !TEST_ptr(mctx = EVP_MD_CTX_new())
+            || !TEST_int_eq(EVP_DigestSignInit_ex(mctx, &pctx, "SHA256",
+                                                  libctx, NULL,
+                                                  pkey_method_key, NULL), 1)
+            || !TEST_int_gt(EVP_PKEY_CTX_set_rsa_padding(pctx,
+                                                         RSA_PKCS1_PSS_PADDING),
+                            0)
+            || !TEST_int_gt(EVP_PKEY_CTX_set_rsa_pss_saltlen(pctx,
+                                                        RSA_PSS_SALTLEN_DIGEST),
+                            0))
+        goto end;
+    *siglen = sigsize;
+    if (!TEST_int_eq(EVP_DigestSign(mctx, sig, siglen, tbs, tbslen), 1))
+        goto end;
+
+    ret = 1;
+ end:
+    EVP_MD_CTX_free(mctx);
+    return ret;
+}
+
+/*
+ * Sign handshake messages with a private key method whose key is only known
+ * to the application. The certificate is loaded with just its public key.
+ * Test 0: TLSv1.3 server CertificateVerify
+ * Test 1: TLSv1.2 ECDHE ServerKeyExchange
+ * Test 2: TLSv1.2 DHE ServerKeyExchange
+ * Test 3: TLSv1.3 client CertificateVerify
+ * Test 4: DTLSv1.2 ECDHE ServerKeyExchange
+ */
+static int test_private_key_method(int tst)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL, *keyctx;
+    SSL *clientssl = NULL, *serverssl = NULL, *keyssl;
+    X509 *x509 = NULL;
+    int testresult = 0;
+
+#ifdef OSSL_NO_USABLE_TLS1_3
+    if (tst == 0 || tst == 3)
+        return TEST_skip("No TLSv1.3 support");
+#endif
+#ifdef OPENSSL_NO_TLS1_2
+    if (tst == 1 || tst == 2)
+        return TEST_skip("No TLSv1.2 support");
+#endif
+#ifdef OPENSSL_NO_EC
+    if (tst == 1 || tst == 4)
+        return TEST_skip("No EC support");
+#endif
+#ifdef OPENSSL_NO_DH
+    if (tst == 2)
+        return TEST_skip("No DH support");
+#endif
+#ifdef OPENSSL_NO_DTLS1_2
+    if (tst == 4)
+        return TEST_skip("No DTLSv1.2 support");
+#endif
+
+    pkey_method_calls = 0;
+    if (tst == 4) {
+        if (!TEST_true(create_ssl_ctx_pair(libctx, DTLS_server_method(),
+                                           DTLS_client_method(),
+                                           DTLS1_2_VERSION, DTLS1_2_VERSION,
+                                           &sctx, &cctx, cert, privkey)))
+            goto end;
+    } else {
+        int maxver = tst == 0 || tst == 3 ? 0 : TLS1_2_VERSION;
+
+        if (!TEST_true(create_ssl_ctx_pair(libctx, TLS_server_method(),
+                                           TLS_client_method(), TLS1_2_VERSION,
+                                           maxver, &sctx, &cctx, cert,
+                                           privkey)))
+            goto end;
+    }
+    if (!TEST_true(SSL_CTX_set1_sigalgs_list(cctx, "rsa_pss_rsae_sha256"))
+            || !TEST_true(SSL_CTX_set1_sigalgs_list(sctx,
+                                                    "rsa_pss_rsae_sha256")))
+        goto end;
+    if (tst == 1 || tst == 4) {
+        if (!TEST_true(SSL_CTX_set_cipher_list(cctx,
+                                               "ECDHE-RSA-AES128-GCM-SHA256")))
+            goto end;
+    } else if (tst == 2) {
+        if (!TEST_true(SSL_CTX_set_cipher_list(cctx,
+                                               "DHE-RSA-AES128-GCM-SHA256"))
+                || !TEST_true(SSL_CTX_set_dh_auto(sctx, 1)))
+            goto end;
+    }
+
+    keyctx = sctx;
+    if (tst == 3) {
+        SSL_CTX_set_verify(sctx, SSL_VERIFY_PEER, verify_cb);
+        if (!TEST_int_eq(SSL_CTX_use_certificate_file(cctx, cert,
+                                                      SSL_FILETYPE_PEM), 1))
+            goto end;
+        keyctx = cctx;
+    }
+    /* Replace the private key with the public key of the certificate */
+    if (!TEST_ptr(pkey_method_key = load_pkey_pem(privkey, libctx))
+            || !TEST_ptr(x509 = load_cert_pem(cert, libctx))
+            || !TEST_int_eq(SSL_CTX_use_PrivateKey(keyctx,
+                                                   X509_get0_pubkey(x509)), 1))
+        goto end;
+    SSL_CTX_set_private_key_sign_cb(keyctx, pkey_method_sign_cb, NULL);
+
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                      NULL, NULL)))
+        goto end;
+    keyssl = tst == 3 ? clientssl : serverssl;
+    if (!TEST_false(create_ssl_connection(serverssl, clientssl,
+                                          SSL_ERROR_WANT_PRIVATE_KEY_OPERATION))
+            || !TEST_true(SSL_want_private_key_operation(keyssl))
+            || !TEST_int_eq(pkey_method_calls, 1))
+        goto end;
+    /* Resuming the handshake calls the callback again, which then signs */
+    if (!TEST_true(create_ssl_connection(serverssl, clientssl,
+                                         SSL_ERROR_NONE))
+            || !TEST_int_eq(pkey_method_calls, 2))
+        goto end;
+    if (tst == 3 && !TEST_ptr(SSL_get0_peer_certificate(serverssl)))
+        goto end;
+
+    testresult = 1;
+ end:
+    OPENSSL_free(pkey_method_tbs);
+    pkey_method_tbs = NULL;
+    EVP_PKEY_free(pkey_method_key);
+    pkey_method_key = NULL;
+    X509_free(x509);
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    return testresult;
+}
+
+static int retry_verify_calls = 0;
+
+static int retry_verify_cb(int preverify_ok, X509_STORE_CTX *ctx)
+{
+    SSL *s = X509_STORE_CTX_get_ex_data(ctx,
+                                        SSL_get_ex_data_X509_STORE_CTX_idx());
+
+    /* Suspend the first time, as if waiting for a CRL or OCSP response */
+    if (retry_verify_calls++ == 0) {
+        if (!TEST_true(SSL_set_retry_verify(s)))
+            return 1;
+        return 0;
+    }
+    return preverify_ok;
+}
+
+/*
+ * Test the server suspending and resuming the verification of the client
+ * certificate from its verify callback.
+ * Test 0: TLSv1.2
+ * Test 1: TLSv1.3
+ */
+static int test_server_cert_verify_retry(int tst)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    char *rootfile = test_mk_file_path(certsdir, "root-cert.pem");
+    char *ccert = test_mk_file_path(certsdir, "ee-client-chain.pem");
+    char *ckey = test_mk_file_path(certsdir, "ee-key.pem");
+    int testresult = 0;
+    int version = tst == 0 ? TLS1_2_VERSION : TLS1_3_VERSION;
+
+#ifdef OPENSSL_NO_TLS1_2
+    if (tst == 0)
+        return TEST_skip("TLSv1.2 is disabled");
+#endif
+#ifdef OSSL_NO_USABLE_TLS1_3
+    if (tst == 1)
+        return TEST_skip("No usable TLSv1.3");
+#endif
+
+    retry_verify_calls = 0;
+    if (!TEST_ptr(rootfile)
+            || !TEST_ptr(ccert)
+            || !TEST_ptr(ckey)
+            || !TEST_true(create_ssl_ctx_pair(libctx, TLS_server_method(),
+                                              TLS_client_method(), version,
+                                              version, &sctx, &cctx, cert,
+                                              privkey))
+            || !TEST_true(SSL_CTX_load_verify_locations(sctx, rootfile, NULL))
+            || !TEST_int_eq(SSL_CTX_use_certificate_chain_file(cctx, ccert), 1)
+            || !TEST_int_eq(SSL_CTX_use_PrivateKey_file(cctx, ckey,
+                                                        SSL_FILETYPE_PEM), 1))
+        goto end;
+    SSL_CTX_set_verify(sctx, SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT,
+                       retry_verify_cb);
+
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                      NULL, NULL))
+            || !TEST_false(create_ssl_connection(serverssl, clientssl,
+                                                 SSL_ERROR_WANT_RETRY_VERIFY))
+            || !TEST_true(SSL_want_retry_verify(serverssl))
+            || !TEST_ptr_null(SSL_get0_peer_certificate(serverssl))
+            || !TEST_int_eq(retry_verify_calls, 1))
+        goto end;
+
+    /* The verification has completed in the background: resume */
+    if (!TEST_true(create_ssl_connection(serverssl, clientssl,
+                                         SSL_ERROR_NONE))
+            || !TEST_int_gt(retry_verify_calls, 1)
+            || !TEST_ptr(SSL_get0_peer_certificate(serverssl))
+            || !TEST_long_eq(SSL_get_verify_result(serverssl), X509_V_OK))
+        goto end;
+
+    testresult = 1;
+ end:
+    OPENSSL_free(rootfile);
+    OPENSSL_free(ccert);
+    OPENSSL_free(ckey);
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    return testresult;
+}
+
+/*
+ * Test 0: Client sets servername and server acknowledges it (TLSv1.2)
+ * Test 1: Client sets servername and server does not acknowledge it (TLSv1.2)
+ * Test 2: Client sets inconsistent servername on resumption (TLSv1.2)
+ * Test 3: Client does not set servername on initial handshake (TLSv1.2)
+ * Test 4: Client does not set servername on resumption handshake (TLSv1.2)
+ * Test 5: Client sets servername and server acknowledges it (TLSv1.3)
+ * Test 6: Client sets servername and server does not acknowledge it (TLSv1.3)
+ * Test 7: Client sets inconsistent servername on resumption (TLSv1.3)
+ * Test 8: Client does not set servername on initial handshake(TLSv1.3)
+ * Test 9: Client does not set servername on resumption handshake (TLSv1.3)
+ */
+static int test_servername(int tst)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    int testresult = 0;
+    SSL_SESSION *sess = NULL;
+    const char *sexpectedhost = NULL, *cexpectedhost = NULL;
+
+#ifdef OPENSSL_NO_TLS1_2
+    if (tst <= 4)
+        return 1;
+#endif
+#ifdef OSSL_NO_USABLE_TLS1_3
+    if (tst >= 5)
+        return 1;
+#endif
+
+    if (!TEST_true(create_ssl_ctx_pair(libctx, TLS_server_method(),
+                                       TLS_client_method(),
+                                       TLS1_VERSION,
+                                       (tst <= 4) ? TLS1_2_VERSION
+                                                  : TLS1_3_VERSION,
+                                       &sctx, &cctx, cert, privkey))
+            || !TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                             NULL, NULL)))
+        goto end;
+
+    if (tst != 1 && tst != 6) {
+        if (!TEST_true(SSL_CTX_set_tlsext_servername_callback(sctx,
+                                                              hostname_cb)))
+            goto end;
+    }
+
+    if (tst != 3 && tst != 8) {
+        if (!TEST_true(SSL_set_tlsext_host_name(clientssl, "goodhost")))
+            goto end;
+        sexpectedhost = cexpectedhost = "goodhost";
+    }
+
+    if (!TEST_true(create_ssl_connection(serverssl, clientssl, SSL_ERROR_NONE)))
+        goto end;
+
+    if (!TEST_str_eq(SSL_get_servername(clientssl, TLSEXT_NAMETYPE_host_name),
+                     cexpectedhost)
+            || !TEST_str_eq(SSL_get_servername(serverssl,
+                                               TLSEXT_NAMETYPE_host_name),
+                            sexpectedhost))
+        goto end;
+
+    /* Now repeat with a resumption handshake */
+
+    if (!TEST_int_eq(SSL_shutdown(clientssl), 0)
+            || !TEST_ptr_ne(sess = SSL_get1_session(clientssl), NULL)
+            || !TEST_true(SSL_SESSION_is_resumable(sess))
+            || !TEST_int_eq(SSL_shutdown(serverssl), 0))
+        goto end;
+
+    SSL_free(clientssl);
+    SSL_free(serverssl);
+    clientssl = serverssl = NULL;
+
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl, NULL,
+                                      NULL)))
+        goto end;
+
+    if (!TEST_true(SSL_set_session(clientssl, sess)))
+        goto end;
+
+    sexpectedhost = cexpectedhost = "goodhost";
+    if (tst == 2 || tst == 7) {
+        /* Set an inconsistent hostname */
+        if (!TEST_true(SSL_set_tlsext_host_name(clientssl, "altgoodhost")))
+            goto end;
+        /*
+         * In TLSv1.2 we expect the hostname from the original handshake, in
+         * TLSv1.3 we expect the hostname from this handshake
+         */
+        if (tst == 7)
+            sexpectedhost = cexpectedhost = "altgoodhost";
+
+        if (!TEST_str_eq(SSL_get_servername(clientssl,
+                                            TLSEXT_NAMETYPE_host_name),
+                         "altgoodhost"))
+            goto end;
+    } else if (tst == 4 || tst == 9) {
+        /*
+         * A TLSv1.3 session does not associate a session with a servername,
+         * but a TLSv1.2 session does.
+         */
+        if (tst == 9)
+            sexpectedhost = cexpectedhost = NULL;
+
+        if (!TEST_str_eq(SSL_get_servername(clientssl,
+                                            TLSEXT_NAMETYPE_host_name),
+                         cexpectedhost))
+            goto end;
+    } else {
+        if (!TEST_true(SSL_set_tlsext_host_name(clientssl, "goodhost")))
+            goto end;
+        /*
+         * In a TLSv1.2 resumption where the hostname was not acknowledged
+         * we expect the hostname on the server to be empty. On the client we
+         * return what was requested in this case.
+         *
+         * Similarly if the client didn't set a hostname on an original TLSv1.2
+         * session but is now, the server hostname will be empty, but the client
+         * is as we set it.
+         */
+        if (tst == 1 || tst == 3)
+            sexpectedhost = NULL;
+
+        if (!TEST_str_eq(SSL_get_servername(clientssl,
+                                            TLSEXT_NAMETYPE_host_name),
+                         "goodhost"))
+            goto end;
+    }
+
+    if (!TEST_true(create_ssl_connection(serverssl, clientssl, SSL_ERROR_NONE)))
+        goto end;
+
+    if (!TEST_true(SSL_session_reused(clientssl))
+            || !TEST_true(SSL_session_reused(serverssl))
+            || !TEST_str_eq(SSL_get_servername(clientssl,
+                                               TLSEXT_NAMETYPE_host_name),
+                            cexpectedhost)
+            || !TEST_str_eq(SSL_get_servername(serverssl,
+                                               TLSEXT_NAMETYPE_host_name),
+                            sexpectedhost))
+        goto end;
+
+    testresult = 1;
+
+ end:
+    SSL_SESSION_free(sess);
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+
+    return testresult;
+}
+
+#if !defined(OPENSSL_NO_EC) \
+    && (!defined(OSSL_NO_USABLE_TLS1_3) || !defined(OPENSSL_NO_TLS1_2))
+/*
+ * Test that if signature algorithms are not available, then we do not offer or
+ * accept them.
+ * Test 0: Two RSA sig algs available: both RSA sig algs shared
+ * Test 1: The client only has SHA2-256: only SHA2-256 algorithms shared
+ * Test 2: The server only has SHA2-256: only SHA2-256 algorithms shared
+ * Test 3: An RSA and an ECDSA sig alg available: both sig algs shared
+ * Test 4: The client only has an ECDSA sig alg: only ECDSA algorithms shared
+ * Test 5: The server only has an ECDSA sig alg: only ECDSA algorithms shared
+ */
+static int test_sigalgs_available(int idx)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    int testresult = 0;
+    OSSL_LIB_CTX *tmpctx = OSSL_LIB_CTX_new();
+    OSSL_LIB_CTX *clientctx = libctx, *serverctx = libctx;
+    OSSL_PROVIDER *filterprov = NULL;
+    int sig, hash;
+
+    if (!TEST_ptr(tmpctx))
+        goto end;
+
+    if (idx != 0 && idx != 3) {
+        if (!TEST_true(OSSL_PROVIDER_add_builtin(tmpctx, "filter",
+                                                 filter_provider_init)))
+            goto end;
+
+        filterprov = OSSL_PROVIDER_load(tmpctx, "filter");
+        if (!TEST_ptr(filterprov))
+            goto end;
+
+        if (idx < 3) {
+            /*
+             * Only enable SHA2-256 so rsa_pss_rsae_sha384 should not be offered
+             * or accepted for the peer that uses this libctx. Note that libssl
+             * *requires* SHA2-256 to be available so we cannot disable that. We
+             * also need SHA1 for our certificate.
+             */
+            if (!TEST_true(filter_provider_set_filter(OSSL_OP_DIGEST,
+                                                      "SHA2-256:SHA1")))
+                goto end;
+        } else {
+            if (!TEST_true(filter_provider_set_filter(OSSL_OP_SIGNATURE,
+                                                      "ECDSA"))
+                    || !TEST_true(filter_provider_set_filter(OSSL_OP_KEYMGMT,
+                                                             "EC:X25519:X448")))
+                goto end;
+        }
+
+        if (idx == 1 || idx == 4)
+            clientctx = tmpctx;
+        else
+            serverctx = tmpctx;
+    }
+
+    cctx = SSL_CTX_new_ex(clientctx, NULL, TLS_client_method());
+    sctx = SSL_CTX_new_ex(serverctx, NULL, TLS_server_method());
+    if (!TEST_ptr(cctx) || !TEST_ptr(sctx))
+        goto end;
+
+    if (idx != 5) {
+        if (!TEST_true(create_ssl_ctx_pair(libctx, TLS_server_method(),
+                                           TLS_client_method(),
+                                           TLS1_VERSION,
+                                           0,
+                                           &sctx, &cctx, cert, privkey)))
+            goto end;
+    } else {
+        if (!TEST_true(create_ssl_ctx_pair(libctx, TLS_server_method(),
+                                           TLS_client_method(),
                                            TLS1_VERSION,
                                            0,
                                            &sctx, &cctx, cert2, privkey2)))
@@ -9442,6 +10863,28 @@ int setup_tests(void)
     ADD_TEST(test_inherit_verify_param);
     ADD_TEST(test_set_alpn);
     ADD_ALL_TESTS(test_session_timeout, 1);
+    ADD_TEST(test_session_cache_shards);
+#ifndef OPENSSL_NO_TLS1_2
+    ADD_TEST(test_shared_session_cache);
+# if defined(OPENSSL_SYS_UNIX)
+    ADD_TEST(test_shared_session_cache_fork);
+# endif
+#endif
+#if !defined(OPENSSL_NO_TLS1_2) && !defined(OSSL_NO_USABLE_TLS1_3)
+    ADD_ALL_TESTS(test_shared_session_cache_early_data, 2);
+#endif
+    ADD_ALL_TESTS(test_record_batching, 3);
+    ADD_ALL_TESTS(test_writev, 2);
+    ADD_ALL_TESTS(test_writev_retry, 2);
+    ADD_ALL_TESTS(test_read_into_app_buffer, 2);
+    ADD_ALL_TESTS(test_read_into_app_buffer_cleanse, 2);
+    ADD_TEST(test_peek_record);
+    ADD_TEST(test_buffer_pool);
+    ADD_TEST(test_shared_cert);
+    ADD_TEST(test_ch_template);
+    ADD_ALL_TESTS(test_shared_seclevel, 3);
+    ADD_ALL_TESTS(test_private_key_method, 5);
+    ADD_ALL_TESTS(test_server_cert_verify_retry, 2);
     return 1;
 
  err:
@@ -19,6 +19,7 @@
 #include <openssl/rsa.h>
 #include <openssl/aes.h>
 #include <openssl/rsa.h>
+#include "internal/nelem.h"
 #include "testutil.h"
 #include "threadstest.h"
 
@@ -286,6 +287,44 @@ static void thread_multi_simple_fetch(void)
         multi_success = 0;
 }
 
+/*
+ * Repeatedly fetch a handful of algorithms so that most fetches are satisfied
+ * from the method store query cache while other threads are using it.
+ */
+#define MULTI_CACHE_FETCH_LOOPS 200
+static void thread_multi_cache_fetch(void)
+{
+    static const char *mdnames[] = {
+        "SHA2-256", "SHA2-512", "SHA3-256", "SHA1"
+    };
+    static const char *ciphnames[] = {
+        "AES-128-CBC", "AES-256-GCM", "ChaCha20-Poly1305"
+    };
+    EVP_MD *md;
+    EVP_CIPHER *ciph;
+    size_t i, j;
+
+    for (i = 0; i < MULTI_CACHE_FETCH_LOOPS; i++) {
+        for (j = 0; j < OSSL_NELEM(mdnames); j++) {
+            md = EVP_MD_fetch(multi_libctx, mdnames[j], NULL);
+            if (md == NULL) {
+                multi_success = 0;
+                return;
+            }
+            EVP_MD_free(md);
+        }
+        for (j = 0; j < OSSL_NELEM(ciphnames); j++) {
+            ciph = EVP_CIPHER_fetch(multi_libctx, ciphnames[j],
+                                    "provider=default");
+            if (ciph == NULL) {
+                multi_success = 0;
+                return;
+            }
+            EVP_CIPHER_free(ciph);
+        }
+    }
+}
+
 static EVP_PKEY *shared_evp_pkey = NULL;
 
 static void thread_shared_evp_pkey(void)
@@ -368,6 +407,8 @@ static void thread_provider_load_unload(void)
  * Test 3: Worker downgrading a shared EVP_PKEY
  * Test 4: Worker using a shared EVP_PKEY
  * Test 5: Worker loading and unloading a provider
+ * Test 6: Workers fetching from the query cache while a provider is loaded
+ *         and unloaded
  */
 static int test_multi(int idx)
 {
@@ -429,6 +470,10 @@ static int test_multi(int idx)
         prov = NULL;
         worker = thread_provider_load_unload;
         break;
+    case 6:
+        worker = thread_multi_cache_fetch;
+        worker2 = thread_provider_load_unload;
+        break;
     default:
         TEST_error("Invalid test index");
         goto err;
@@ -589,7 +634,7 @@ int setup_tests(void)
     ADD_TEST(test_thread_local);
     ADD_TEST(test_atomic);
     ADD_TEST(test_multi_load);
-    ADD_ALL_TESTS(test_multi, 6);
+    ADD_ALL_TESTS(test_multi, 7);
     return 1;
 }
 